@@ -0,0 +1,116 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+//===----------------------------------------------------------------------===//
+//
+// Throughput comparison of the content hashes in polar/utils, both for one
+// large buffer and for many small independent buffers (the cache-key case).
+//
+//   HashBenchmark [total-megabytes]
+//
+//===----------------------------------------------------------------------===//
+
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/utils/Blake3.h"
+#include "polar/utils/Format.h"
+#include "polar/utils/Md5.h"
+#include "polar/utils/RawOutStream.h"
+#include "polar/utils/Sha1.h"
+#include "polar/utils/Sha256.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using polar::basic::ArrayRef;
+using namespace polar::utils;
+
+namespace {
+
+/// Keeps the optimizer from discarding a digest.
+volatile uint8_t sg_sink;
+
+template <size_t N>
+void consume(const std::array<uint8_t, N> &digest)
+{
+   sg_sink = sg_sink ^ digest[0];
+}
+
+void run(StringRef name, size_t totalBytes, const std::function<void()> &body)
+{
+   body(); // warm up caches and one-time CPU feature probing
+   auto start = std::chrono::steady_clock::now();
+   body();
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+   out_stream() << format("  %-28s %9.1f MB/s\n", name.getStr().c_str(),
+                          totalBytes / elapsed.count() / (1 << 20));
+}
+
+void bench_large(const std::vector<uint8_t> &data)
+{
+   ArrayRef<uint8_t> input(data);
+   out_stream() << format("one %zu MiB buffer:\n", data.size() >> 20);
+   run("Md5", data.size(), [&] { consume(Md5::hash(input)); });
+   run("Sha1", data.size(), [&] { consume(Sha1::hash(input)); });
+   run("Sha256", data.size(), [&] { consume(Sha256::hash(input)); });
+   run("Blake3 (tree-parallel)", data.size(), [&] { consume(Blake3::hash(input)); });
+}
+
+void bench_small(const std::vector<uint8_t> &data, size_t bufferSize)
+{
+   std::vector<ArrayRef<uint8_t>> inputs;
+   for (size_t offset = 0; offset + bufferSize <= data.size(); offset += bufferSize) {
+      inputs.push_back(ArrayRef<uint8_t>(data.data() + offset, bufferSize));
+   }
+   size_t totalBytes = inputs.size() * bufferSize;
+   out_stream() << format("%zu buffers of %zu bytes:\n", inputs.size(), bufferSize);
+   run("Md5", totalBytes, [&] {
+      for (ArrayRef<uint8_t> input : inputs) {
+         consume(Md5::hash(input));
+      }
+   });
+   run("Sha1", totalBytes, [&] {
+      for (ArrayRef<uint8_t> input : inputs) {
+         consume(Sha1::hash(input));
+      }
+   });
+   run("Sha1::hashBatch", totalBytes, [&] { consume(Sha1::hashBatch(inputs).back()); });
+   run("Sha256", totalBytes, [&] {
+      for (ArrayRef<uint8_t> input : inputs) {
+         consume(Sha256::hash(input));
+      }
+   });
+   run("Sha256::hashBatch", totalBytes, [&] { consume(Sha256::hashBatch(inputs).back()); });
+   run("Blake3", totalBytes, [&] {
+      for (ArrayRef<uint8_t> input : inputs) {
+         consume(Blake3::hash(input));
+      }
+   });
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+   size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+   std::vector<uint8_t> data(std::max<size_t>(megabytes, 1) << 20);
+   for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = uint8_t(i * 2654435761u >> 13);
+   }
+   out_stream() << format("SHA extensions: %s\n",
+                          Sha1::hasHardwareAcceleration() ? "yes" : "no");
+   bench_large(data);
+   for (size_t bufferSize : {64, 256, 4096}) {
+      bench_small(data, bufferSize);
+   }
+   return 0;
+}
@@ -12,6 +12,7 @@
 #ifndef POLAR_BASIC_ADT_HASING_H
 #define POLAR_BASIC_ADT_HASING_H
 
+#include "polar/global/Config.h"
 #include "polar/global/DataTypes.h"
 #include "polar/utils/SwapByteOrder.h"
 #include "polar/utils/TypeTraits.h"
@@ -119,6 +120,12 @@ void set_fixed_execution_hash_seed(size_t fixed_value);
 namespace hashing {
 namespace internal {
 
+/// Hashes \p length contiguous bytes with XXH3 (see utils/FastHash.h). Used
+/// for byte ranges longer than 64 bytes when the build enables
+/// POLAR_ENABLE_XXH3_HASHING; hash_combine_range() over such a range then no
+/// longer matches the equivalent hash_combine() call.
+uint64_t hash_bytes_xxh3(const char *s, size_t length, uint64_t seed);
+
 inline uint64_t fetch64(const char *p)
 {
    uint64_t result;
@@ -461,6 +468,10 @@ hash_combine_range_impl(ValueType *first, ValueType *last)
    if (length <= 64) {
       return hash_short(strBegin, length, seed);
    }
+#if POLAR_ENABLE_XXH3_HASHING
+   (void)strEnd;
+   return hash_bytes_xxh3(strBegin, length, seed);
+#else
    const char *strAlignedEnd = strBegin + (length & ~63);
    HashState state = state.create(strBegin, seed);
    strBegin += 64;
@@ -472,6 +483,7 @@ hash_combine_range_impl(ValueType *first, ValueType *last)
       state.mix(strEnd - 64);
    }
    return state.finalize(length);
+#endif
 }
 
 } // namespace internal
@@ -220,11 +220,17 @@ inline bool to_float(const Twine &twine, N &num, N (*strToFunc)(const char *, ch
 
 inline bool to_float(const Twine &twine, float &num)
 {
+   if (twine.isSingleStringRef() && try_parse_decimal_float(twine.getSingleStringRef(), num)) {
+      return true;
+   }
    return internal::to_float(twine, num, strtof);
 }
 
 inline bool to_float(const Twine &twine, double &num)
 {
+   if (twine.isSingleStringRef() && try_parse_decimal_float(twine.getSingleStringRef(), num)) {
+      return true;
+   }
    return internal::to_float(twine, num, strtod);
 }
 
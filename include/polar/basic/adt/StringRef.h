@@ -43,6 +43,15 @@ bool consume_unsigned_integer(StringRef &str, unsigned radix,
                               unsigned long long &result);
 bool consume_signed_integer(StringRef &str, unsigned radix, long long &result);
 
+/// Parses all of \p str as a decimal number, [+-]digits[.digits][(e|E)[+-]digits],
+/// into the nearest double or float, as strtod() and ApFloat do. Returns
+/// false, leaving \p result alone, when \p str has any other form or is a
+/// case left to a general parser: more than 19 significant digits, a result
+/// which is subnormal or out of range, or one too close to half way to
+/// settle quickly.
+bool try_parse_decimal_float(StringRef str, double &result);
+bool try_parse_decimal_float(StringRef str, float &result);
+
 /// StringRef - Represent a constant reference to a string, i.e. a character
 /// array and a length, which need not be null terminated.
 ///
@@ -299,6 +299,9 @@
 /* Define if zlib compression is available */
 #cmakedefine01 POLAR_ENABLE_ZLIB
 
+/* Define if HashCode hashes long byte ranges with XXH3 */
+#cmakedefine01 POLAR_ENABLE_XXH3_HASHING
+
 /* Whether tools show host and target info when invoked with --version */
 #cmakedefine01 POLAR_VERSION_PRINTER_SHOW_HOST_TARGET_INFO
 
@@ -0,0 +1,92 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#ifndef POLAR_UTILS_AHO_CORASICK_H
+#define POLAR_UTILS_AHO_CORASICK_H
+
+#include "polar/basic/adt/StringRef.h"
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace polar {
+namespace utils {
+
+using polar::basic::StringRef;
+
+/// \brief Finds every occurrence of a set of literal strings in a single pass
+/// over a text.
+///
+/// Literals are added with insert() and compiled by build() into a
+/// deterministic automaton: one table lookup per byte of text, whatever the
+/// number of literals. To keep the table small, bytes are first mapped to
+/// classes, with every byte that appears in no literal sharing class 0.
+class AhoCorasick
+{
+public:
+   /// Adds \p literal, which is reported as \p id by search(). A literal may
+   /// be added several times with different ids. Empty literals are ignored.
+   void insert(StringRef literal, unsigned id);
+
+   /// Compiles the literals added so far. Must be called before search(),
+   /// and again after further insertions.
+   void build();
+
+   bool isEmpty() const
+   {
+      return m_outputs.empty();
+   }
+
+   /// Calls \p callback with the id of every literal that occurs in \p text,
+   /// once per occurrence.
+   template <typename CallbackT>
+   void search(StringRef text, CallbackT callback) const
+   {
+      assert(m_built && "search() before build()");
+      uint32_t state = 0;
+      for (unsigned char c : text) {
+         uint16_t byteClass = m_classes[c];
+         state = byteClass ? m_delta[state * m_numClasses + byteClass - 1] : 0;
+         for (uint32_t match = m_states[state].m_hasOutput ? state : m_states[state].m_outputLink;
+              match; match = m_states[match].m_outputLink) {
+            const State &matched = m_states[match];
+            for (uint32_t i = matched.m_outputBegin; i != matched.m_outputEnd; ++i) {
+               callback(m_outputs[i]);
+            }
+         }
+      }
+   }
+
+private:
+   struct State
+   {
+      /// Outputs of this state are m_outputs[m_outputBegin, m_outputEnd).
+      uint32_t m_outputBegin = 0;
+      uint32_t m_outputEnd = 0;
+      /// Nearest state on the failure chain with outputs of its own, 0 if none.
+      uint32_t m_outputLink = 0;
+      bool m_hasOutput = false;
+   };
+
+   std::vector<std::pair<std::string, unsigned>> m_literals;
+   std::vector<State> m_states;
+   std::vector<uint32_t> m_delta;
+   std::vector<unsigned> m_outputs;
+   uint16_t m_classes[256] = {};
+   unsigned m_numClasses = 0;
+   bool m_built = false;
+};
+
+} // utils
+} // polar
+
+#endif // POLAR_UTILS_AHO_CORASICK_H
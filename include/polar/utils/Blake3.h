@@ -0,0 +1,118 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+//===----------------------------------------------------------------------===//
+//
+// BLAKE3 (https://github.com/BLAKE3-team/BLAKE3-specs) in its default hashing
+// mode with a 256-bit output. Input is split into 1 KiB chunks that form a
+// binary Merkle tree; large updates hash whole subtrees of that tree on the
+// thread pool and only merge their chaining values on the calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef POLAR_UTILS_BLAKE3_H
+#define POLAR_UTILS_BLAKE3_H
+
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/basic/adt/StringRef.h"
+#include <array>
+#include <cstdint>
+
+namespace polar {
+namespace utils {
+
+using polar::basic::ArrayRef;
+using polar::basic::StringRef;
+
+namespace internal {
+
+struct Blake3Output;
+
+/// The chunk currently being absorbed by a Blake3 hasher.
+struct Blake3ChunkState
+{
+   uint32_t m_cv[8];
+   uint64_t m_chunkCounter;
+   uint8_t m_buffer[64];
+   uint8_t m_bufferLength;
+   uint8_t m_blocksCompressed;
+
+   void reset(uint64_t chunkCounter);
+   size_t getLength() const;
+   void update(const uint8_t *data, size_t size);
+   Blake3Output getOutput() const;
+};
+
+} // internal
+
+/// A class that wrap the Blake3 algorithm.
+class Blake3
+{
+public:
+   Blake3()
+   {
+      init();
+   }
+
+   /// Reinitialize the internal state
+   void init();
+
+   /// Digest more data. Updates of at least getParallelThreshold() bytes hash
+   /// their complete subtrees in parallel.
+   void update(ArrayRef<uint8_t> data);
+
+   /// Digest more data.
+   void update(StringRef str)
+   {
+      update(ArrayRef<uint8_t>((uint8_t *)const_cast<char *>(str.getData()),
+                               str.getSize()));
+   }
+
+   /// Return a reference to the raw 256-bits Blake3 for the digested data
+   /// since the last call to init(). Unlike Sha1 finalizing does not consume
+   /// the state, so more data may still be added afterwards.
+   StringRef final();
+
+   /// Same as final(), provided for interface parity with Sha1.
+   StringRef result()
+   {
+      return final();
+   }
+
+   /// Returns a raw 256-bit Blake3 hash for the given data.
+   static std::array<uint8_t, 32> hash(ArrayRef<uint8_t> data);
+
+   /// Smallest subtree, in bytes, that is split across the thread pool.
+   static constexpr size_t getParallelThreshold()
+   {
+      return 128 * 1024;
+   }
+
+private:
+   enum { BLOCK_LENGTH = 64 };
+   enum { CHUNK_LENGTH = 1024 };
+   enum { HASH_LENGTH = 32 };
+   enum { MAX_DEPTH = 54 };
+
+   void pushChainingValue(const uint32_t cv[8], uint64_t chunkCounter);
+   void mergeChainingValues(uint64_t totalChunks);
+
+   internal::Blake3ChunkState m_chunk;
+   // One more entry than the tree is deep, as merging is done lazily.
+   uint32_t m_cvStack[MAX_DEPTH + 1][8];
+   uint8_t m_cvStackLength;
+   uint8_t m_hashResult[HASH_LENGTH];
+};
+
+} // utils
+} // polar
+
+#endif // POLAR_UTILS_BLAKE3_H
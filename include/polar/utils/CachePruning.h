@@ -12,9 +12,13 @@
 #ifndef POLAR_UTILS_CACHE_PRUNING_H
 #define POLAR_UTILS_CACHE_PRUNING_H
 
+#include "polar/basic/adt/ArrayRef.h"
 #include "polar/basic/adt/StringRef.h"
+#include "polar/utils/Chrono.h"
 #include <chrono>
 #include <optional>
+#include <string>
+#include <system_error>
 
 namespace polar {
 namespace utils {
@@ -56,23 +60,57 @@ struct CachePruningPolicy
   /// systems have a limit on how many files can be contained in a directory
   /// (notably ext4, which is limited to around 6000000 files).
   uint64_t m_maxSizeFiles = 1000000;
+
+  /// Drive pruning by the index that writers maintain with
+  /// record_cache_access() rather than by scanning the directory. Files are
+  /// then aged by their recorded access time instead of their atime, and size
+  /// pruning evicts the least recently used files first. The index is built
+  /// by a scan the first time it is missing.
+  bool m_useIndex = false;
 };
 
 /// Parse the given string as a cache pruning policy. Defaults are taken from a
 /// default constructed CachePruningPolicy object.
-/// For example: "prune_interval=30s:prune_after=24h:cache_size=50%"
-/// which means a pruning interval of 30 seconds, expiration time of 24 hours
-/// and maximum cache size of 50% of available disk space.
+/// For example: "prune_interval=30s:prune_after=24h:cache_size=50%:index=1"
+/// which means a pruning interval of 30 seconds, expiration time of 24 hours,
+/// maximum cache size of 50% of available disk space, and pruning driven by
+/// the access index (see CachePruningPolicy::m_useIndex).
 Expected<CachePruningPolicy> parse_cache_pruning_policy(StringRef policyStr);
 
 /// Peform pruning using the supplied policy, returns true if pruning
-/// occured, i.e. if Policy.interval was expired.
+/// occured, i.e. if Policy.interval was expired and, with
+/// CachePruningPolicy::m_useIndex, no other process was pruning already.
 ///
 /// As a safeguard against data loss if the user specifies the wrong directory
 /// as their cache directory, this function will ignore files not matching the
 /// pattern "llvmcache-*".
 bool prune_cache(StringRef path, CachePruningPolicy policy);
 
+/// Appends to the index of the cache directory \p path a record that the file
+/// \p filename, of \p size bytes, was written or used at \p accessTime.
+/// Records are small and appended by a single write, so any number of
+/// processes may record concurrently.
+std::error_code record_cache_access(StringRef path, StringRef filename, uint64_t size,
+                                    TimePoint<> accessTime = std::chrono::system_clock::now());
+
+/// A use of a file of a cache directory, see record_cache_accesses().
+struct CacheAccess
+{
+  std::string m_filename;
+  uint64_t m_size;
+  TimePoint<> m_accessTime;
+};
+
+/// Appends to the index of the cache directory \p path the records of
+/// \p accesses by a single write, for callers that batch their accesses. The
+/// index keeps the most recent access of a file, so records may come late.
+/// Nothing is recorded if a file name is not one of the cache.
+std::error_code record_cache_accesses(StringRef path, polar::basic::ArrayRef<CacheAccess> accesses);
+
+/// Appends to the index of the cache directory \p path a record that the file
+/// \p filename was removed by something else than prune_cache().
+std::error_code record_cache_removal(StringRef path, StringRef filename);
+
 } // utils
 } // polar
 
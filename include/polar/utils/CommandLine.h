@@ -40,6 +40,7 @@
 #include <cstddef>
 #include <functional>
 #include <initializer_list>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -220,6 +221,8 @@ public:
 // The general Option Category (used as default category).
 extern OptionCategory sg_generalCategory;
 
+class OptionNameTrie;
+
 //===----------------------------------------------------------------------===//
 // SubCommand class
 //
@@ -234,12 +237,9 @@ protected:
    void unregisterSubCommand();
 
 public:
-   SubCommand(StringRef name, StringRef Description = "")
-      : m_name(name), m_description(Description)
-   {
-      registerSubCommand();
-   }
-   SubCommand() = default;
+   SubCommand(StringRef name, StringRef Description = "");
+   SubCommand();
+   ~SubCommand();
 
    void reset();
 
@@ -260,6 +260,11 @@ public:
    StringMap<Option *> m_optionsMap;
 
    Option *m_consumeAfterOpt = nullptr; // The ConsumeAfter option if it exists.
+
+   // The names of m_optionsMap in a trie, for prefix and grouping options.
+   // Built on the first lookup which needs it, and dropped whenever the
+   // options change.
+   std::unique_ptr<OptionNameTrie> m_optionIndex;
 };
 
 // A special subcommand representing no subcommand
@@ -2506,6 +2511,14 @@ bool expand_response_files(StringSaver &saver, TokenizerCallback tokenizer,
                            SmallVectorImpl<const char *> &argv,
                            bool markEOLs = false, bool relativeNames = false);
 
+/// Caches the tokens of the response files read by expand_response_files()
+/// and read_config_file() in the directory \p path, for later processes
+/// reading the same files. A cache file is used only if the response file
+/// still has the size, modification time and contents hash it was made from,
+/// and only for the tokenizers of this library. An empty path, the default,
+/// turns the cache off.
+void set_response_file_cache_directory(StringRef path);
+
 /// Mark all options not part of this category as cl::ReallyHidden.
 ///
 /// \param Category the category of options to keep displaying
@@ -19,6 +19,7 @@ namespace polar {
 // forward declare class with namespace
 namespace basic {
 class StringRef;
+template <typename T> class ArrayRef;
 template <typename T> class SmallVectorImpl;
 } // basic
 
@@ -27,6 +28,7 @@ namespace utils {
 
 class Error;
 
+using polar::basic::ArrayRef;
 using polar::basic::StringRef;
 using polar::basic::SmallVectorImpl;
 
@@ -54,6 +56,18 @@ Error uncompress(StringRef inputBuffer,
 
 uint32_t crc32(StringRef buffer);
 
+/// Compresses the concatenation of \p inputBuffers into a single gzip member
+/// (RFC 1952). Members may be concatenated into a multi-member gzip file,
+/// which gzip readers decompress as the concatenation of their data.
+Error compress_gzip(ArrayRef<StringRef> inputBuffers,
+                    SmallVectorImpl<char> &compressedBuffer,
+                    CompressionLevel level = DefaultCompression);
+
+/// Decompresses the single gzip member \p inputBuffer, whose data must be
+/// \p uncompressedSize bytes long, and checks its CRC.
+Error uncompress_gzip(StringRef inputBuffer, char *uncompressedBuffer,
+                      size_t uncompressedSize);
+
 }  // End of namespace zlib
 
 } // utils
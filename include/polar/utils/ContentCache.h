@@ -0,0 +1,118 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#ifndef POLAR_UTILS_CONTENT_CACHE_H
+#define POLAR_UTILS_CONTENT_CACHE_H
+
+#include "polar/basic/adt/StlExtras.h"
+#include "polar/basic/adt/StringRef.h"
+#include "polar/utils/CachePruning.h"
+#include "polar/utils/ErrorType.h"
+#include "polar/utils/MemoryBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace polar {
+namespace utils {
+
+using polar::basic::FunctionRef;
+using polar::basic::StringRef;
+
+/// \brief A cache of build artifacts in a local directory, addressed by key.
+///
+/// Keys are hashed with BLAKE3, and the entry of a key is stored as
+/// "<directory>/<xx>/polarcache-<digest>", with xx the first byte of the
+/// digest, so that no directory grows too large. Any number of threads and
+/// processes may share a cache:
+///  - entries are written to a temporary file which is renamed over the
+///    entry, so readers see either no entry or a whole one;
+///  - readers map entries, and a mapping stays valid if the entry is replaced
+///    or pruned meanwhile;
+///  - every write is recorded in the index of CachePruning.h, which drives
+///    pruning and keeps two processes from pruning at once; hits are
+///    recorded in batches, when enough have been seen, before pruning and
+///    when the cache is destroyed.
+///
+/// Hits, misses and bytes moved are counted by the cache and reported as
+/// statistics.
+class ContentCache
+{
+public:
+   struct Counters
+   {
+      uint64_t m_hits = 0;
+      uint64_t m_misses = 0;
+      uint64_t m_bytesRead = 0;
+      uint64_t m_bytesWritten = 0;
+   };
+
+   /// Opens the cache in \p directory, creating the directory if needed.
+   /// Pruning follows \p policy, always from the cache index. If the policy
+   /// has a non-zero interval, put() prunes as often as that, which
+   /// prune_cache() checks for all processes sharing the cache.
+   static Expected<std::unique_ptr<ContentCache>>
+   create(StringRef directory, CachePruningPolicy policy = CachePruningPolicy());
+
+   /// Returns the entry of \p key, or nullptr if there is none.
+   std::unique_ptr<MemoryBuffer> get(StringRef key);
+
+   /// Stores \p data as the entry of \p key, replacing any previous one.
+   Error put(StringRef key, StringRef data);
+
+   /// Stores as the entry of \p key the \p size bytes \p writer fills in,
+   /// directly in the mapping of the entry file.
+   Error put(StringRef key, size_t size, FunctionRef<void(uint8_t *)> writer);
+
+   ~ContentCache();
+
+   /// Prunes the cache now, whatever the interval of the policy. Returns false
+   /// if it did not, because another process is at it or the policy prunes
+   /// nothing.
+   bool prune();
+
+   /// Returns the path of the entry of \p key.
+   std::string getEntryPath(StringRef key) const;
+
+   StringRef getDirectory() const
+   {
+      return m_directory;
+   }
+
+   Counters getCounters() const;
+
+private:
+   ContentCache(StringRef directory, CachePruningPolicy policy);
+
+   /// The path of the entry of \p key relative to the cache directory.
+   std::string getEntryName(StringRef key) const;
+   void recordHit(std::string name, uint64_t size);
+   void flushHits();
+   void pruneIfDue();
+
+   std::string m_directory;
+   CachePruningPolicy m_policy;
+   std::atomic<uint64_t> m_hits{0};
+   std::atomic<uint64_t> m_misses{0};
+   std::atomic<uint64_t> m_bytesRead{0};
+   std::atomic<uint64_t> m_bytesWritten{0};
+   /// Hits not recorded in the index yet.
+   std::mutex m_hitMutex;
+   std::vector<CacheAccess> m_pendingHits;
+};
+
+} // utils
+} // polar
+
+#endif // POLAR_UTILS_CONTENT_CACHE_H
@@ -0,0 +1,129 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#ifndef POLAR_UTILS_DIRECTORY_WALKER_H
+#define POLAR_UTILS_DIRECTORY_WALKER_H
+
+#include "polar/basic/adt/StlExtras.h"
+#include "polar/basic/adt/StringRef.h"
+#include "polar/basic/adt/Twine.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/GlobPattern.h"
+#include <climits>
+#include <string>
+#include <system_error>
+
+namespace polar {
+namespace fs {
+
+using polar::basic::FunctionRef;
+using polar::basic::StringRef;
+using polar::basic::Twine;
+using polar::utils::GlobSet;
+
+namespace internal {
+class TreeWalker;
+} // internal
+
+/// Options of walk_directory_tree().
+struct WalkOptions
+{
+   /// Descend into symbolic links to directories. Every directory is still
+   /// visited once, whatever cycles the links make.
+   bool m_followSymlinks = false;
+
+   /// Read the full status of every entry, not only its type.
+   bool m_needStatus = false;
+
+   /// Walk subdirectories concurrently on the thread pool of Parallel.h.
+   bool m_parallel = true;
+
+   /// Deepest level to descend into, the entries of the root being level 0.
+   unsigned m_maxLevel = UINT_MAX;
+
+   /// If set, only entries whose path relative to the root matches one of
+   /// these patterns are reported. Other directories are still descended into.
+   const GlobSet *m_include = nullptr;
+
+   /// Entries whose path relative to the root matches one of these patterns
+   /// are neither reported nor descended into.
+   const GlobSet *m_exclude = nullptr;
+};
+
+/// An entry reported by walk_directory_tree().
+class WalkEntry
+{
+public:
+   /// The path of the entry, the root joined with getRelativePath().
+   const std::string &getPath() const
+   {
+      return m_path;
+   }
+
+   /// The path of the entry relative to the root, as matched by the filters.
+   StringRef getRelativePath() const
+   {
+      return StringRef(m_path).substr(m_relativeStart);
+   }
+
+   StringRef getFilename() const
+   {
+      return StringRef(m_path).substr(m_filenameStart);
+   }
+
+   FileType getType() const
+   {
+      return m_type;
+   }
+
+   unsigned getLevel() const
+   {
+      return m_level;
+   }
+
+   /// The full status of the entry, if WalkOptions::m_needStatus was set and
+   /// the status could be read, nullptr otherwise.
+   const FileStatus *getStatus() const
+   {
+      return m_hasStatus ? &m_status : nullptr;
+   }
+
+private:
+   friend class internal::TreeWalker;
+
+   std::string m_path;
+   size_t m_relativeStart = 0;
+   size_t m_filenameStart = 0;
+   FileType m_type = FileType::type_unknown;
+   unsigned m_level = 0;
+   FileStatus m_status;
+   bool m_hasStatus = false;
+};
+
+/// Calls \p callback for every entry of the tree rooted at \p root, except
+/// the root itself.
+///
+/// Unlike RecursiveDirectoryIterator, subdirectories fan out to the thread
+/// pool, and entry types are taken from the directory listings, so that
+/// files are only stat'ed when the file system does not report types or when
+/// WalkOptions::m_needStatus asks for it. Entries are reported directory by
+/// directory, in no particular order. Calls to \p callback never overlap,
+/// but may come from any thread.
+///
+/// Unreadable subdirectories are skipped. Returns the first error met, root
+/// included, after walking everything else.
+std::error_code walk_directory_tree(const Twine &root, const WalkOptions &options,
+                                    FunctionRef<void(const WalkEntry &)> callback);
+
+} // fs
+} // polar
+
+#endif // POLAR_UTILS_DIRECTORY_WALKER_H
@@ -0,0 +1,400 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+//===----------------------------------------------------------------------===//
+//
+// An open addressed on disk hash table for mmapped lookups. Where the chained
+// table of DiskHashTable.h walks a chain through the payload, this format
+// keeps a fingerprint and an offset for every entry in cache line sized
+// buckets, and confines probing to the page of buckets the key hashes to.
+// A lookup therefore reads one bucket page, plus the payload of the entries
+// whose fingerprint matches, which is almost always only the one looked for.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef POLAR_UTILS_DISK_BUCKETED_HASH_TABLE_H
+#define POLAR_UTILS_DISK_BUCKETED_HASH_TABLE_H
+
+#include "polar/basic/adt/SmallVector.h"
+#include "polar/basic/adt/StringRef.h"
+#include "polar/utils/DiskHashTable.h"
+#include "polar/utils/EndianStream.h"
+#include "polar/utils/ErrorType.h"
+#include "polar/utils/MathExtras.h"
+#include "polar/utils/Memory.h"
+#include "polar/utils/RawOutStream.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+namespace polar {
+namespace utils {
+
+namespace internal {
+
+/// \brief The bucket layout shared by the generator and the reader.
+///
+/// A bucket is one cache line:
+///
+/// \code
+///   uint16_t count;                    // used slots, filled front to back
+///   uint16_t fingerprints[SLOTS];
+///   ...padding...
+///   OffsetType offsets[SLOTS];         // entry offsets, at the line's end
+/// \endcode
+///
+/// The buckets of a table are split into windows of at most BUCKETS_PER_PAGE
+/// buckets. A key is placed in the first bucket with a free slot when probing
+/// linearly, with wrap around, from its home bucket through its home window.
+/// The generator grows the table until every key fits in its home window, so
+/// a lookup never leaves the window, and thus the page, it started in.
+template <typename OffsetType>
+struct BucketedHashTableLayout
+{
+   enum : uint64_t
+   {
+      BUCKET_SIZE = 64,
+      PAGE_SIZE = 4096,
+      BUCKETS_PER_PAGE = PAGE_SIZE / BUCKET_SIZE,
+      SLOTS = (BUCKET_SIZE - sizeof(OffsetType)) / (sizeof(uint16_t) + sizeof(OffsetType)),
+      FINGERPRINTS_START = sizeof(uint16_t),
+      OFFSETS_START = BUCKET_SIZE - SLOTS * sizeof(OffsetType)
+   };
+   static_assert(FINGERPRINTS_START + SLOTS * sizeof(uint16_t) <= OFFSETS_START,
+                 "fingerprints overlap offsets");
+   static_assert(SLOTS <= UINT16_MAX, "slot count does not fit the bucket header");
+
+   static uint64_t getHomeBucket(uint64_t hash, uint64_t numBuckets)
+   {
+      if (numBuckets == 1) {
+         return 0;
+      }
+      return (hash * 0x9E3779B97F4A7C15ULL) >> (64 - log2_64(numBuckets));
+   }
+
+   static uint16_t getFingerprint(uint64_t hash)
+   {
+      return uint16_t((hash * 0xC2B2AE3D27D4EB4FULL) >> 48);
+   }
+
+   /// The number of buckets probed for a key, i.e. the size of its window.
+   static uint64_t getWindowSize(uint64_t numBuckets)
+   {
+      return std::min<uint64_t>(numBuckets, BUCKETS_PER_PAGE);
+   }
+
+   /// The bucket visited by probe number \p probe, for
+   /// 0 <= probe < getWindowSize(numBuckets).
+   static uint64_t getProbeBucket(uint64_t home, uint64_t probe, uint64_t numBuckets)
+   {
+      uint64_t windowSize = getWindowSize(numBuckets);
+      assert(probe < windowSize && "probing past the home window");
+      uint64_t windowStart = home & ~(windowSize - 1);
+      return windowStart + ((home + probe) & (windowSize - 1));
+   }
+
+   /// Bucket arrays are aligned to their own size up to a page, so that no
+   /// window straddles a page boundary when the table's base is page aligned.
+   static uint64_t getBucketsAlignment(uint64_t numBuckets)
+   {
+      return std::min<uint64_t>(numBuckets * BUCKET_SIZE, PAGE_SIZE);
+   }
+};
+
+} // internal
+
+/// \brief Generates an open addressed on disk hash table.
+///
+/// This takes the same \c Info as DiskChainedHashTableGenerator, except that
+/// equalKey is never used. Entries are serialized when they are inserted.
+///
+/// The table is laid out as the payload, i.e. the entries as written by the
+/// \c Info emitters without their hash, followed by the number of buckets
+/// and the number of entries at the offset returned by emit(), and the bucket
+/// array at the next suitably aligned offset. Every lookup reads a single page
+/// of the bucket array as long as offset 0 of the stream is mapped at a page
+/// aligned address, as it is when the file is mmapped.
+template <typename Info>
+class DiskBucketedHashTableGenerator
+{
+public:
+   typedef typename Info::hash_value_type hash_value_type;
+   typedef typename Info::OffsetType OffsetType;
+   typedef internal::BucketedHashTableLayout<OffsetType> Layout;
+
+   /// \brief Insert an entry into the table.
+   void insert(typename Info::key_type_ref key,
+               typename Info::data_type_ref data)
+   {
+      Info infoObj;
+      insert(key, data, infoObj);
+   }
+
+   /// \brief Insert an entry into the table.
+   ///
+   /// Uses the provided Info instead of a stack allocated one.
+   void insert(typename Info::key_type_ref key,
+               typename Info::data_type_ref data, Info &infoObj)
+   {
+      Entry entry;
+      entry.m_hash = infoObj.computeHash(key);
+      entry.m_offset = m_payload.size();
+      RawSvectorOutStream outstream(m_payload);
+      const std::pair<OffsetType, OffsetType> &length =
+            infoObj.emitKeyDataLength(outstream, key, data);
+      infoObj.emitKey(outstream, key, length.first);
+      infoObj.emitData(outstream, key, data, length.second);
+      m_entries.push_back(entry);
+   }
+
+   OffsetType getNumEntries() const
+   {
+      return m_entries.size();
+   }
+
+   /// \brief Emit the table to outstream, returning the offset of its header.
+   ///
+   /// Fails, without writing anything, if so many entries share a hash value
+   /// that their home window overflows however large the table is.
+   Expected<OffsetType> emit(RawOutStream &outstream)
+   {
+      endian::Writer<Endianness::Little> le(outstream);
+
+      // Aim for buckets that are at most 3/4 full on average, and double the
+      // bucket count until no window overflows, which is only likely to take
+      // more than one attempt with very unevenly distributed hashes.
+      uint64_t numBuckets = next_power_of_two((m_entries.size() * 4 / 3) / Layout::SLOTS);
+      uint64_t maxBuckets = numBuckets << MAX_GROWTH;
+      std::vector<uint8_t> buckets;
+      for (;;) {
+         bool fits = true;
+         buckets.assign(numBuckets * Layout::BUCKET_SIZE, 0);
+         for (const Entry &entry : m_entries) {
+            if (!place(buckets.data(), numBuckets, entry, outstream.tell() + entry.m_offset)) {
+               fits = false;
+               break;
+            }
+         }
+         if (fits) {
+            break;
+         }
+         if (numBuckets == maxBuckets) {
+            return make_error<StringError>("too many colliding hashes for a bucketed hash table",
+                                           std::make_error_code(std::errc::value_too_large));
+         }
+         numBuckets *= 2;
+      }
+
+      outstream << StringRef(m_payload.getData(), m_payload.size());
+
+      // Pad with zeros so that we can start the header at an aligned address.
+      uint64_t tableOffset = outstream.tell();
+      uint64_t padding = offset_to_alignment(tableOffset, alignof(OffsetType));
+      tableOffset += padding;
+      while (padding--) {
+         le.write<uint8_t>(0);
+      }
+      le.write<OffsetType>(numBuckets);
+      le.write<OffsetType>(m_entries.size());
+      padding = offset_to_alignment(outstream.tell(), Layout::getBucketsAlignment(numBuckets));
+      while (padding--) {
+         le.write<uint8_t>(0);
+      }
+      outstream.write(reinterpret_cast<const char *>(buckets.data()), buckets.size());
+      return tableOffset;
+   }
+
+private:
+   struct Entry
+   {
+      hash_value_type m_hash;
+      uint64_t m_offset;
+   };
+
+   enum : uint64_t
+   {
+      /// How many times emit() doubles the bucket count before it gives up.
+      MAX_GROWTH = 8
+   };
+
+   /// \brief Store \p entry in the first free slot of its home window.
+   /// Returns false, leaving \p buckets alone, if the window is full.
+   static bool place(uint8_t *buckets, uint64_t numBuckets, const Entry &entry,
+                     uint64_t offset)
+   {
+      uint64_t home = Layout::getHomeBucket(entry.m_hash, numBuckets);
+      uint64_t windowSize = Layout::getWindowSize(numBuckets);
+      for (uint64_t probe = 0; probe < windowSize; ++probe) {
+         uint8_t *bucket = buckets + Layout::getProbeBucket(home, probe, numBuckets) * Layout::BUCKET_SIZE;
+         uint16_t count = endian::read16le(bucket);
+         if (count == Layout::SLOTS) {
+            continue;
+         }
+         endian::write16le(bucket, count + 1);
+         endian::write16le(bucket + Layout::FINGERPRINTS_START + count * sizeof(uint16_t),
+                           Layout::getFingerprint(entry.m_hash));
+         endian::write<OffsetType, Endianness::Little, UNALIGNED>(
+                  bucket + Layout::OFFSETS_START + count * sizeof(OffsetType), OffsetType(offset));
+         return true;
+      }
+      return false;
+   }
+
+   SmallVector<char, 0> m_payload;
+   std::vector<Entry> m_entries;
+};
+
+/// \brief Provides lookup on a table written by DiskBucketedHashTableGenerator.
+///
+/// This takes the same \c Info as DiskChainedHashTable.
+template <typename Info>
+class DiskBucketedHashTable
+{
+public:
+   typedef Info InfoType;
+   typedef typename Info::internal_key_type internal_key_type;
+   typedef typename Info::external_key_type external_key_type;
+   typedef typename Info::data_type data_type;
+   typedef typename Info::hash_value_type hash_value_type;
+   typedef typename Info::OffsetType OffsetType;
+   typedef typename DiskChainedHashTable<Info>::iterator iterator;
+   typedef internal::BucketedHashTableLayout<OffsetType> Layout;
+
+   DiskBucketedHashTable(OffsetType numBuckets, OffsetType numEntries,
+                         const unsigned char *buckets,
+                         const unsigned char *base,
+                         const Info &infoObj = Info())
+      : m_numBuckets(numBuckets), m_numEntries(numEntries), m_buckets(buckets),
+        m_base(base), m_infoObj(infoObj)
+   {
+      assert(is_power_of_two_64(m_numBuckets) && "bucket count must be a power of two");
+   }
+
+   OffsetType getNumBuckets() const
+   {
+      return m_numBuckets;
+   }
+
+   OffsetType getNumEntries() const
+   {
+      return m_numEntries;
+   }
+
+   const unsigned char *getBase() const
+   {
+      return m_base;
+   }
+
+   const unsigned char *getBuckets() const
+   {
+      return m_buckets;
+   }
+
+   bool isEmpty() const
+   {
+      return m_numEntries == 0;
+   }
+
+   Info &getInfoObj()
+   {
+      return m_infoObj;
+   }
+
+   /// \brief Look up the stored data for a particular key.
+   iterator find(const external_key_type &ekey, Info *infoPtr = nullptr)
+   {
+      const internal_key_type &ikey = m_infoObj.getInternalKey(ekey);
+      hash_value_type keyHash = m_infoObj.computeHash(ikey);
+      return findHashed(ikey, keyHash, infoPtr);
+   }
+
+   /// \brief Look up the stored data for a particular key with a known hash.
+   iterator findHashed(const internal_key_type &ikey, hash_value_type keyHash,
+                       Info *infoPtr = nullptr)
+   {
+      if (!infoPtr) {
+         infoPtr = &m_infoObj;
+      }
+      uint64_t home = Layout::getHomeBucket(keyHash, m_numBuckets);
+      uint16_t fingerprint = Layout::getFingerprint(keyHash);
+      uint64_t windowSize = Layout::getWindowSize(m_numBuckets);
+      for (uint64_t probe = 0; probe < windowSize; ++probe) {
+         const unsigned char *bucket = m_buckets +
+               Layout::getProbeBucket(home, probe, m_numBuckets) * Layout::BUCKET_SIZE;
+         uint16_t count = endian::read16le(bucket);
+         for (uint16_t slot = 0; slot < count; ++slot) {
+            if (endian::read16le(bucket + Layout::FINGERPRINTS_START + slot * sizeof(uint16_t)) != fingerprint) {
+               continue;
+            }
+            OffsetType offset = endian::read<OffsetType, Endianness::Little, UNALIGNED>(
+                     bucket + Layout::OFFSETS_START + slot * sizeof(OffsetType));
+            const unsigned char *items = m_base + offset;
+            const std::pair<OffsetType, OffsetType> &length = Info::readKeyDataLength(items);
+            const internal_key_type &item = infoPtr->readKey(items, length.first);
+            if (infoPtr->equalKey(item, ikey)) {
+               return iterator(item, items + length.first, length.second, infoPtr);
+            }
+         }
+         // Entries only move on to the next bucket when this one is full.
+         if (count < Layout::SLOTS) {
+            break;
+         }
+      }
+      return iterator();
+   }
+
+   iterator end() const
+   {
+      return iterator();
+   }
+
+   /// \brief Pass \p advice for the pages holding the bucket array, e.g.
+   /// MA_WILL_NEED to fault in a table that is about to be hammered, or
+   /// MA_RANDOM to turn off readahead for sparse lookups.
+   std::error_code adviseBuckets(sys::Memory::AccessAdvice advice) const
+   {
+      return sys::Memory::adviseMappedMemory(m_buckets, uint64_t(m_numBuckets) * Layout::BUCKET_SIZE,
+                                             advice);
+   }
+
+   /// \brief Create the hash table.
+   ///
+   /// \param table is the header of the table, the value returned by
+   /// DiskBucketedHashTableGenerator::emit added to \p base.
+   ///
+   /// \param base is the point from which all offsets into the structure are
+   /// based. This is offset 0 in the stream that was used when emitting the
+   /// table.
+   static DiskBucketedHashTable *create(const unsigned char *table,
+                                        const unsigned char *const base,
+                                        const Info &infoObj = Info())
+   {
+      assert(table > base);
+      OffsetType numBuckets = endian::read_next<OffsetType, Endianness::Little, ALIGNED>(table);
+      OffsetType numEntries = endian::read_next<OffsetType, Endianness::Little, ALIGNED>(table);
+      table += offset_to_alignment(table - base, Layout::getBucketsAlignment(numBuckets));
+      return new DiskBucketedHashTable<Info>(numBuckets, numEntries, table, base, infoObj);
+   }
+
+private:
+   const OffsetType m_numBuckets;
+   const OffsetType m_numEntries;
+   const unsigned char *const m_buckets;
+   const unsigned char *const m_base;
+   Info m_infoObj;
+};
+
+} // utils
+} // polar
+
+#endif // POLAR_UTILS_DISK_BUCKETED_HASH_TABLE_H
@@ -14,18 +14,38 @@
 
 #include "polar/utils/Allocator.h"
 #include "polar/global/DataTypes.h"
+#include "polar/global/Global.h"
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/basic/adt/SmallVector.h"
 #include "polar/utils/EndianStream.h"
+#include "polar/utils/ErrorType.h"
 #include "polar/utils/Host.h"
 #include "polar/utils/MathExtras.h"
+#include "polar/utils/Parallel.h"
 #include "polar/utils/RawOutStream.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
 
 namespace polar {
 namespace utils {
 
+using polar::basic::ArrayRef;
 using polar::basic::IteratorRange;
 using polar::basic::make_range;
+using polar::basic::MutableArrayRef;
+using polar::basic::SmallString;
+using polar::basic::SmallVector;
+using polar::basic::StringRef;
+
+class FileOutputBuffer;
+class MemoryBuffer;
 
 /// \brief Generates an on disk hash table.
 ///
@@ -137,14 +157,14 @@ public:
       if (4 * m_numEntries >= 3 * m_numBuckets) {
          resize(m_numBuckets * 2);
       }
-      insert(buckets, m_numBuckets, new (m_bumpPtrAllocator.allocate()) Item(key, data, infoObj));
+      insert(m_buckets, m_numBuckets, new (m_bumpPtrAllocator.allocate()) Item(key, data, infoObj));
    }
 
    /// \brief Determine whether an entry has been inserted.
    bool contains(typename Info::key_type_ref key, Info &infoObj)
    {
       unsigned hash = infoObj.computeHash(key);
-      for (Item *item = buckets[hash & (m_numBuckets - 1)].m_head; item; item = item->m_next) {
+      for (Item *item = m_buckets[hash & (m_numBuckets - 1)].m_head; item; item = item->m_next) {
          if (item->m_hash == hash && infoObj.equalKey(item->m_key, key)) {
             return true;
          }
@@ -153,7 +173,7 @@ public:
    }
 
    /// \brief emit the table to outstream, which must not be at offset 0.
-   OffsetType emit(RawOutStream &outstreamstream)
+   OffsetType emit(RawOutStream &outstream)
    {
       Info infoObj;
       return emit(outstream, infoObj);
@@ -210,7 +230,7 @@ public:
             // In asserts mode, check that the users length matches the data they
             // wrote.
             uint64_t keyStart = outstream.tell();
-            infoObj.emitKey(outstream, item->m_key, Len.first);
+            infoObj.emitKey(outstream, item->m_key, length.first);
             uint64_t dataStart = outstream.tell();
             infoObj.emitData(outstream, item->m_key, item->m_data, length.second);
             uint64_t end = outstream.tell();
@@ -253,6 +273,495 @@ public:
    }
 };
 
+namespace internal {
+
+/// \brief Returns the bytes \p buffer maps for writing.
+MutableArrayRef<uint8_t> get_output_bytes(FileOutputBuffer &buffer);
+
+/// \brief Creates a temporary file to spill sorted records to, returning its
+/// descriptor in \p fd and its name in \p path.
+std::error_code create_run_file(int &fd, SmallVectorImpl<char> &path);
+
+/// \brief Deletes a run file, ignoring errors.
+void remove_run_file(StringRef path);
+
+/// \brief A run file mapped back in for reading.
+class MappedRunFile
+{
+public:
+   MappedRunFile();
+   MappedRunFile(MappedRunFile &&other) noexcept;
+   ~MappedRunFile();
+
+   std::error_code open(StringRef path);
+
+   StringRef getContents() const;
+
+private:
+   std::unique_ptr<MemoryBuffer> m_buffer;
+};
+
+/// \brief madvise(MADV_WILLNEED) the pages holding \p addresses, in as few
+/// calls as possible. Reorders \p addresses.
+void advise_will_need(std::vector<const unsigned char *> &addresses);
+
+} // internal
+
+/// \brief Generates the same on disk hash table as
+/// DiskChainedHashTableGenerator, for key sets too large to keep around as
+/// individual items.
+///
+/// Entries are serialized with the \c Info emitters as soon as they are
+/// inserted, so memory holds roughly the final payload instead of key and data
+/// objects. They are kept in NUM_PARTITIONS partitions chosen by the low bits
+/// of their hash; since the bucket index is taken from the low bits as well,
+/// each partition owns a fixed subset of the final buckets whatever the final
+/// bucket count turns out to be. Whenever the buffered entries outgrow the
+/// memory budget, every partition is sorted by bucket and spilled to a
+/// temporary run file. The table is then produced in two steps: layout()
+/// computes where every partition lands, so the caller can size the output,
+/// and emit() merges and writes all partitions concurrently, straight into the
+/// mapping of a FileOutputBuffer:
+///
+/// \code
+///   ParallelDiskChainedHashTableGenerator<ExampleInfo> generator;
+///   generator.insertRange(entries);
+///   Expected<uint64_t> end = generator.layout(headerSize);
+///   Expected<std::unique_ptr<FileOutputBuffer>> buffer =
+///         FileOutputBuffer::create(path, *end);
+///   Expected<OffsetType> tableOffset = generator.emit(**buffer);
+/// \endcode
+///
+/// \c Info is the same trait DiskChainedHashTableGenerator uses, minus
+/// equalKey which is never called. Within a bucket, entries are ordered by
+/// hash rather than by insertion.
+template <typename Info>
+class ParallelDiskChainedHashTableGenerator
+{
+public:
+   typedef typename Info::key_type key_type;
+   typedef typename Info::data_type data_type;
+   typedef typename Info::hash_value_type hash_value_type;
+   typedef typename Info::OffsetType OffsetType;
+
+   enum : size_t
+   {
+      NUM_PARTITIONS = 64,
+      DEFAULT_MEMORY_BUDGET = 256 << 20,
+   };
+
+   explicit ParallelDiskChainedHashTableGenerator(size_t memoryBudget = DEFAULT_MEMORY_BUDGET)
+      : m_memoryBudget(memoryBudget),
+        m_partitions(NUM_PARTITIONS)
+   {}
+
+   ParallelDiskChainedHashTableGenerator(const ParallelDiskChainedHashTableGenerator &) = delete;
+   ParallelDiskChainedHashTableGenerator &operator=(const ParallelDiskChainedHashTableGenerator &) = delete;
+
+   ~ParallelDiskChainedHashTableGenerator()
+   {
+      for (Partition &partition : m_partitions) {
+         for (const std::string &run : partition.m_runs) {
+            internal::remove_run_file(run);
+         }
+      }
+   }
+
+   /// \brief Insert an entry into the table.
+   void insert(typename Info::key_type_ref key,
+               typename Info::data_type_ref data)
+   {
+      Info infoObj;
+      insert(key, data, infoObj);
+   }
+
+   /// \brief Insert an entry into the table.
+   ///
+   /// Uses the provided Info instead of a stack allocated one.
+   void insert(typename Info::key_type_ref key,
+               typename Info::data_type_ref data, Info &infoObj)
+   {
+      hash_value_type hash = infoObj.computeHash(key);
+      Partition &partition = m_partitions[hash & (NUM_PARTITIONS - 1)];
+      size_t before = partition.getMemoryUsage();
+      serialize(partition, hash, key, data, infoObj);
+      ++m_numEntries;
+      m_bufferedBytes += partition.getMemoryUsage() - before;
+      if (m_bufferedBytes > m_memoryBudget) {
+         spill();
+      }
+   }
+
+   /// \brief Insert every (key, data) pair of the random access range
+   /// \p entries, hashing and serializing them on all available threads.
+   template <typename RangeT>
+   void insertRange(const RangeT &entries)
+   {
+      const size_t batchSize = size_t(1) << 16;
+      const size_t chunkSize = size_t(1) << 10;
+      auto first = std::begin(entries);
+      size_t count = std::distance(first, std::end(entries));
+      for (size_t batchStart = 0; batchStart < count; batchStart += batchSize) {
+         size_t batchEnd = std::min(count, batchStart + batchSize);
+         size_t numChunks = (batchEnd - batchStart + chunkSize - 1) / chunkSize;
+         // Every chunk serializes into its own partitions first, which are
+         // then appended in chunk order so the result does not depend on
+         // scheduling.
+         std::vector<std::vector<Partition>> staged(numChunks);
+         parallel::for_each_n(parallel::par, size_t(0), numChunks, [&](size_t chunk) {
+            Info infoObj;
+            std::vector<Partition> &partitions = staged[chunk];
+            partitions.resize(NUM_PARTITIONS);
+            size_t end = std::min(batchEnd, batchStart + (chunk + 1) * chunkSize);
+            for (size_t i = batchStart + chunk * chunkSize; i < end; ++i) {
+               key_type key = first[i].first;
+               data_type data = first[i].second;
+               hash_value_type hash = infoObj.computeHash(key);
+               serialize(partitions[hash & (NUM_PARTITIONS - 1)], hash, key, data, infoObj);
+            }
+         });
+         std::vector<size_t> grown(NUM_PARTITIONS);
+         parallel::for_each_n(parallel::par, size_t(0), size_t(NUM_PARTITIONS), [&](size_t index) {
+            Partition &partition = m_partitions[index];
+            size_t before = partition.getMemoryUsage();
+            for (std::vector<Partition> &partitions : staged) {
+               partition.append(partitions[index]);
+            }
+            grown[index] = partition.getMemoryUsage() - before;
+         });
+         for (size_t bytes : grown) {
+            m_bufferedBytes += bytes;
+         }
+         m_numEntries += batchEnd - batchStart;
+         if (m_bufferedBytes > m_memoryBudget) {
+            spill();
+         }
+      }
+   }
+
+   /// \brief Number of entries inserted so far.
+   OffsetType getNumEntries() const
+   {
+      return m_numEntries;
+   }
+
+   /// \brief Number of run files spilled to disk so far.
+   size_t getNumRuns() const
+   {
+      size_t numRuns = 0;
+      for (const Partition &partition : m_partitions) {
+         numRuns += partition.m_runs.size();
+      }
+      return numRuns;
+   }
+
+   /// \brief Decide where the table goes once all entries are inserted.
+   ///
+   /// The payload starts at \p offset, which must not be 0. Returns the offset
+   /// one past the end of the table, i.e. the minimum size of the buffer
+   /// handed to emit(), or the first error hit while spilling or reading back
+   /// run files.
+   Expected<uint64_t> layout(uint64_t offset)
+   {
+      assert(offset && "Cannot write a bucket at offset 0. Please add padding.");
+      if (m_error) {
+         return error_code_to_error(m_error);
+      }
+      m_numBuckets = m_numEntries <= 2 ? 1 : next_power_of_two(m_numEntries * 4 / 3);
+      parallel::for_each(parallel::par, m_partitions.begin(), m_partitions.end(),
+                         [](Partition &partition) { partition.sort(); });
+      // Partitions whose indices agree modulo the bucket count share buckets
+      // and have to be merged into one group.
+      size_t numGroups = std::min<size_t>(NUM_PARTITIONS, m_numBuckets);
+      std::vector<uint64_t> groupSizes(numGroups);
+      std::vector<std::error_code> errors(numGroups);
+      parallel::for_each_n(parallel::par, size_t(0), numGroups, [&](size_t group) {
+         uint64_t size = 0;
+         errors[group] = forEachRecord(group, numGroups, [&](size_t, bool firstInBucket, StringRef record) {
+            size += record.getSize() + (firstInBucket ? sizeof(uint16_t) : 0);
+         });
+         groupSizes[group] = size;
+      });
+      for (std::error_code error : errors) {
+         if (error) {
+            return error_code_to_error(error);
+         }
+      }
+      m_groupOffsets.assign(1, offset);
+      for (uint64_t size : groupSizes) {
+         m_groupOffsets.push_back(m_groupOffsets.back() + size);
+      }
+      uint64_t payloadEnd = m_groupOffsets.back();
+      m_tableOffset = payloadEnd + offset_to_alignment(payloadEnd, alignof(OffsetType));
+      return m_tableOffset + (2 + uint64_t(m_numBuckets)) * sizeof(OffsetType);
+   }
+
+   /// \brief Write the table into \p buffer at the offsets computed by the
+   /// last call to layout(), returning the offset of the bucket table.
+   ///
+   /// Bytes of \p buffer before the offset passed to layout() are left alone.
+   Expected<OffsetType> emit(FileOutputBuffer &buffer)
+   {
+      assert(!m_groupOffsets.empty() && "layout() must be called before emit()");
+      MutableArrayRef<uint8_t> bytes = internal::get_output_bytes(buffer);
+      assert(bytes.getSize() >= m_tableOffset + (2 + uint64_t(m_numBuckets)) * sizeof(OffsetType) &&
+             "buffer is smaller than the laid out table");
+      uint8_t *base = bytes.getData();
+      uint8_t *table = base + m_tableOffset;
+      uint64_t payloadEnd = m_groupOffsets.back();
+      std::memset(base + payloadEnd, 0, m_tableOffset - payloadEnd);
+      endian::write<OffsetType, Endianness::Little, ALIGNED>(table, m_numBuckets);
+      endian::write<OffsetType, Endianness::Little, ALIGNED>(table + sizeof(OffsetType), m_numEntries);
+      uint8_t *buckets = table + 2 * sizeof(OffsetType);
+      std::memset(buckets, 0, uint64_t(m_numBuckets) * sizeof(OffsetType));
+
+      // Groups own disjoint payload ranges and disjoint sets of buckets, so
+      // they can be written without any synchronization.
+      size_t numGroups = m_groupOffsets.size() - 1;
+      std::vector<std::error_code> errors(numGroups);
+      parallel::for_each_n(parallel::par, size_t(0), numGroups, [&](size_t group) {
+         uint8_t *out = base + m_groupOffsets[group];
+         uint8_t *bucketStart = nullptr;
+         uint16_t bucketLength = 0;
+         errors[group] = forEachRecord(group, numGroups, [&](size_t bucket, bool firstInBucket, StringRef record) {
+            if (firstInBucket) {
+               if (bucketStart) {
+                  endian::write16le(bucketStart, bucketLength);
+               }
+               bucketStart = out;
+               bucketLength = 0;
+               out += sizeof(uint16_t);
+               endian::write<OffsetType, Endianness::Little, ALIGNED>(
+                        buckets + bucket * sizeof(OffsetType), OffsetType(bucketStart - base));
+            }
+            assert(bucketLength != UINT16_MAX && "too many entries in one bucket");
+            ++bucketLength;
+            std::memcpy(out, record.getData(), record.getSize());
+            out += record.getSize();
+         });
+         if (bucketStart) {
+            endian::write16le(bucketStart, bucketLength);
+         }
+         assert((errors[group] || out == base + m_groupOffsets[group + 1]) &&
+                "run files changed between layout() and emit()");
+      });
+      for (std::error_code error : errors) {
+         if (error) {
+            return error_code_to_error(error);
+         }
+      }
+      return OffsetType(m_tableOffset);
+   }
+
+private:
+   /// \brief Where a serialized entry lives inside Partition::m_bytes.
+   struct Record
+   {
+      /// The bit reversed hash, so that sorting on it orders entries by
+      /// bucket for every power of two bucket count.
+      uint64_t m_sortKey;
+      uint64_t m_offset;
+      uint64_t m_length;
+   };
+
+   /// \brief Entries whose hash has the same low bits, in their on disk form:
+   /// the hash followed by whatever the Info emitters wrote.
+   struct Partition
+   {
+      SmallVector<char, 0> m_bytes;
+      std::vector<Record> m_records;
+      std::vector<std::string> m_runs;
+
+      size_t getMemoryUsage() const
+      {
+         return m_bytes.getCapacityInBytes() + m_records.capacity() * sizeof(Record);
+      }
+
+      void append(const Partition &other)
+      {
+         uint64_t delta = m_bytes.size();
+         m_bytes.append(other.m_bytes.begin(), other.m_bytes.end());
+         for (Record record : other.m_records) {
+            record.m_offset += delta;
+            m_records.push_back(record);
+         }
+      }
+
+      void sort()
+      {
+         std::stable_sort(m_records.begin(), m_records.end(),
+                          [](const Record &lhs, const Record &rhs) {
+            return lhs.m_sortKey < rhs.m_sortKey;
+         });
+      }
+
+      StringRef getRecord(const Record &record) const
+      {
+         return StringRef(m_bytes.getData() + record.m_offset, record.m_length);
+      }
+   };
+
+   static uint64_t get_sort_key(hash_value_type hash)
+   {
+      return reverse_bits<uint64_t>(uint64_t(hash));
+   }
+
+   static void serialize(Partition &partition, hash_value_type hash,
+                         typename Info::key_type_ref key,
+                         typename Info::data_type_ref data, Info &infoObj)
+   {
+      uint64_t start = partition.m_bytes.size();
+      {
+         RawSvectorOutStream outstream(partition.m_bytes);
+         endian::Writer<Endianness::Little>(outstream).write<hash_value_type>(hash);
+         const std::pair<OffsetType, OffsetType> &length =
+               infoObj.emitKeyDataLength(outstream, key, data);
+         infoObj.emitKey(outstream, key, length.first);
+         infoObj.emitData(outstream, key, data, length.second);
+      }
+      partition.m_records.push_back({get_sort_key(hash), start, partition.m_bytes.size() - start});
+   }
+
+   /// \brief Sort every partition and write it out as a run file of
+   /// [uint32 length][record] frames.
+   void spill()
+   {
+      std::vector<std::error_code> errors(NUM_PARTITIONS);
+      parallel::for_each_n(parallel::par, size_t(0), size_t(NUM_PARTITIONS), [&](size_t index) {
+         errors[index] = spillPartition(m_partitions[index]);
+      });
+      for (std::error_code error : errors) {
+         if (error && !m_error) {
+            m_error = error;
+         }
+      }
+      m_bufferedBytes = 0;
+   }
+
+   static std::error_code spillPartition(Partition &partition)
+   {
+      if (partition.m_records.empty()) {
+         return std::error_code();
+      }
+      partition.sort();
+      int fd;
+      SmallString<128> path;
+      if (std::error_code error = internal::create_run_file(fd, path)) {
+         return error;
+      }
+      partition.m_runs.push_back(path.getStr());
+      RawFdOutStream outstream(fd, /*shouldClose=*/true);
+      endian::Writer<Endianness::Little> le(outstream);
+      for (const Record &record : partition.m_records) {
+         le.write<uint32_t>(record.m_length);
+         outstream << partition.getRecord(record);
+      }
+      outstream.close();
+      // Release the memory, spilling is all about getting it back.
+      SmallVector<char, 0>().swap(partition.m_bytes);
+      std::vector<Record>().swap(partition.m_records);
+      if (outstream.hasError()) {
+         std::error_code error = outstream.getErrorCode();
+         outstream.clearError();
+         return error;
+      }
+      return std::error_code();
+   }
+
+   /// \brief Reads one sorted stream of records, either the in memory part of
+   /// a partition or one of its run files.
+   struct RecordCursor
+   {
+      const Partition *m_partition = nullptr;
+      size_t m_index = 0;
+      const char *m_ptr = nullptr;
+      const char *m_end = nullptr;
+      uint64_t m_sortKey = 0;
+      StringRef m_record;
+
+      bool next()
+      {
+         if (m_partition) {
+            if (m_index == m_partition->m_records.size()) {
+               return false;
+            }
+            const Record &record = m_partition->m_records[m_index++];
+            m_sortKey = record.m_sortKey;
+            m_record = m_partition->getRecord(record);
+            return true;
+         }
+         if (m_ptr == m_end) {
+            return false;
+         }
+         uint32_t length = endian::read_next<uint32_t, Endianness::Little, UNALIGNED>(m_ptr);
+         m_record = StringRef(m_ptr, length);
+         m_ptr += length;
+         m_sortKey = get_sort_key(endian::read<hash_value_type, Endianness::Little, UNALIGNED>(
+                                     m_record.getData()));
+         return true;
+      }
+   };
+
+   /// \brief Merge all records of the partitions making up \p group and pass
+   /// them to \p callback in bucket order, along with their bucket index and
+   /// whether they start a new bucket.
+   template <typename CallbackT>
+   std::error_code forEachRecord(size_t group, size_t numGroups, CallbackT callback) const
+   {
+      std::vector<internal::MappedRunFile> runs;
+      std::vector<RecordCursor> cursors;
+      for (size_t index = group; index < NUM_PARTITIONS; index += numGroups) {
+         const Partition &partition = m_partitions[index];
+         for (const std::string &run : partition.m_runs) {
+            runs.emplace_back();
+            if (std::error_code error = runs.back().open(run)) {
+               return error;
+            }
+            StringRef contents = runs.back().getContents();
+            RecordCursor cursor;
+            cursor.m_ptr = contents.begin();
+            cursor.m_end = contents.end();
+            cursors.push_back(cursor);
+         }
+         RecordCursor cursor;
+         cursor.m_partition = &partition;
+         cursors.push_back(cursor);
+      }
+      cursors.erase(std::remove_if(cursors.begin(), cursors.end(),
+                                   [](RecordCursor &cursor) { return !cursor.next(); }),
+            cursors.end());
+      size_t lastBucket = SIZE_MAX;
+      // There are only a handful of streams per group, a linear scan for the
+      // smallest one beats maintaining a heap.
+      while (!cursors.empty()) {
+         size_t smallest = 0;
+         for (size_t i = 1; i < cursors.size(); ++i) {
+            if (cursors[i].m_sortKey < cursors[smallest].m_sortKey) {
+               smallest = i;
+            }
+         }
+         RecordCursor &cursor = cursors[smallest];
+         size_t bucket = endian::read<hash_value_type, Endianness::Little, UNALIGNED>(
+                  cursor.m_record.getData()) & (m_numBuckets - 1);
+         callback(bucket, bucket != lastBucket, cursor.m_record);
+         lastBucket = bucket;
+         if (!cursor.next()) {
+            cursors.erase(cursors.begin() + smallest);
+         }
+      }
+      return std::error_code();
+   }
+
+   size_t m_memoryBudget;
+   size_t m_bufferedBytes = 0;
+   OffsetType m_numEntries = 0;
+   OffsetType m_numBuckets = 0;
+   std::vector<Partition> m_partitions;
+   std::error_code m_error;
+   std::vector<uint64_t> m_groupOffsets;
+   uint64_t m_tableOffset = 0;
+};
+
 /// \brief Provides lookup on an on disk hash table.
 ///
 /// This needs an \c Info that handles reading values from the hash table's
@@ -415,11 +924,108 @@ public:
       if (!infoPtr) {
          infoPtr = &m_infoObj;
       }
+      return findInBucket(ikey, keyHash, readBucket(keyHash), infoPtr);
+   }
+
+   /// \brief Look up the stored data for all of \p keys, in order.
+   ///
+   /// Rather than taking the cache misses of one key after the other, every
+   /// key is hashed up front and the bucket entries and then the bucket
+   /// payloads of the next window of keys are prefetched while the current
+   /// window is resolved. With \p adviseWillNeed the pages involved are first passed to
+   /// madvise(MADV_WILLNEED) as well, so that the kernel can read in the cold
+   /// pages of a mapped table concurrently instead of on one page fault after
+   /// the other. That costs a few system calls and only pays off for tables
+   /// that are mostly not resident.
+   std::vector<iterator> findBatch(ArrayRef<external_key_type> keys,
+                                   bool adviseWillNeed = false,
+                                   Info *infoPtr = nullptr)
+   {
+      if (!infoPtr) {
+         infoPtr = &m_infoObj;
+      }
+      const size_t count = keys.getSize();
+      std::vector<internal_key_type> ikeys;
+      std::vector<hash_value_type> hashes;
+      ikeys.reserve(count);
+      hashes.reserve(count);
+      for (const external_key_type &ekey : keys) {
+         ikeys.push_back(m_infoObj.getInternalKey(ekey));
+         hashes.push_back(m_infoObj.computeHash(ikeys.back()));
+      }
+      std::vector<const unsigned char *> addresses;
+      if (adviseWillNeed) {
+         addresses.reserve(count);
+         for (hash_value_type hash : hashes) {
+            addresses.push_back(getBucket(hash));
+         }
+         internal::advise_will_need(addresses);
+      }
+
+      // Both passes below are software pipelined: the prefetches for the next
+      // window are issued before the current one is resolved, so they have a
+      // whole window's worth of work to complete in.
+      auto prefetchBuckets = [&](size_t start) {
+         for (size_t i = start, e = std::min<size_t>(count, start + BATCH_WINDOW); i < e; ++i) {
+            POLAR_PREFETCH(getBucket(hashes[i]), 0, 3);
+         }
+      };
+      std::vector<OffsetType> offsets(count);
+      prefetchBuckets(0);
+      for (size_t start = 0; start < count; start += BATCH_WINDOW) {
+         prefetchBuckets(start + BATCH_WINDOW);
+         for (size_t i = start, e = std::min<size_t>(count, start + BATCH_WINDOW); i < e; ++i) {
+            offsets[i] = readBucket(hashes[i]);
+         }
+      }
+      if (adviseWillNeed) {
+         addresses.clear();
+         for (OffsetType offset : offsets) {
+            if (offset) {
+               addresses.push_back(m_base + offset);
+            }
+         }
+         internal::advise_will_need(addresses);
+      }
+
+      auto prefetchPayloads = [&](size_t start) {
+         for (size_t i = start, e = std::min<size_t>(count, start + BATCH_WINDOW); i < e; ++i) {
+            if (offsets[i]) {
+               POLAR_PREFETCH(m_base + offsets[i], 0, 3);
+            }
+         }
+      };
+      std::vector<iterator> results;
+      results.reserve(count);
+      prefetchPayloads(0);
+      for (size_t start = 0; start < count; start += BATCH_WINDOW) {
+         prefetchPayloads(start + BATCH_WINDOW);
+         for (size_t i = start, e = std::min<size_t>(count, start + BATCH_WINDOW); i < e; ++i) {
+            results.push_back(findInBucket(ikeys[i], hashes[i], offsets[i], infoPtr));
+         }
+      }
+      return results;
+   }
+
+private:
+   /// Number of keys findBatch() prefetches for ahead of the ones it resolves;
+   /// enough to cover the memory latency, few enough to stay in the L1 cache.
+   enum { BATCH_WINDOW = 16 };
+
+   const unsigned char *getBucket(hash_value_type keyHash) const
+   {
       // Each bucket is just an offset into the hash table file.
-      OffsetType idx = keyHash & (m_numBuckets - 1);
-      const unsigned char *bucket = m_buckets + sizeof(OffsetType) * idx;
+      return m_buckets + sizeof(OffsetType) * (keyHash & (m_numBuckets - 1));
+   }
 
-      OffsetType offset = endian::read_next<OffsetType, Endianness::Little, ALIGNED>(bucket);
+   OffsetType readBucket(hash_value_type keyHash) const
+   {
+      return endian::read<OffsetType, Endianness::Little, ALIGNED>(getBucket(keyHash));
+   }
+
+   iterator findInBucket(const internal_key_type &ikey, hash_value_type keyHash,
+                         OffsetType offset, Info *infoPtr)
+   {
       if (offset == 0) {
          return iterator(); // Empty bucket.
       }
@@ -462,6 +1068,7 @@ public:
       return iterator();
    }
 
+public:
    iterator end() const
    {
       return iterator();
@@ -544,7 +1151,7 @@ private:
             // 'items' starts with a 16-bit unsigned integer representing the
             // number of items in this bucket.
             m_numItemsInBucketLeft =
-                  endian::read_next<uint16_t, Endianness, UNALIGNED>(m_ptr);
+                  endian::read_next<uint16_t, Endianness::Little, UNALIGNED>(m_ptr);
          }
          m_ptr += sizeof(hash_value_type); // Skip the hash.
          // Determine the length of the key and the data.
@@ -585,7 +1192,7 @@ public:
 
       KeyIterator(const unsigned char *const ptr, OffsetType numEntries,
                   Info *infoObj)
-         : IteratorBase(m_ptr, m_numEntries), m_infoObj(infoObj)
+         : IteratorBase(ptr, numEntries), m_infoObj(infoObj)
       {}
 
       KeyIterator() : IteratorBase(), m_infoObj()
@@ -612,12 +1219,12 @@ public:
          auto length = Info::readKeyDataLength(localPtr);
 
          // Read the key.
-         return infoObj->readKey(localPtr, length.first);
+         return m_infoObj->readKey(localPtr, length.first);
       }
 
       value_type operator*() const
       {
-         return infoObj->GetExternalKey(getInternalKey());
+         return m_infoObj->getExternalKey(getInternalKey());
       }
    };
 
@@ -646,7 +1253,7 @@ public:
 
       DataIterator(const unsigned char *const ptr, OffsetType numEntries,
                    Info *infoObj)
-         : IteratorBase(m_ptr, m_numEntries), m_infoObj(infoObj)
+         : IteratorBase(ptr, numEntries), m_infoObj(infoObj)
       {}
 
       DataIterator() : IteratorBase(), m_infoObj()
@@ -673,8 +1280,8 @@ public:
          auto length = Info::readKeyDataLength(localPtr);
 
          // Read the key.
-         const internal_key_type &key = infoObj->readKey(localPtr, length.first);
-         return infoObj->ReadData(key, localPtr + length.first, length.second);
+         const internal_key_type &key = m_infoObj->readKey(localPtr, length.first);
+         return m_infoObj->readData(key, localPtr + length.first, length.second);
       }
    };
 
@@ -44,18 +44,138 @@
 */
 
 /* based on revision d2df04efcbef7d7f6886d345861e5dfda4edacc1 Removed
- * everything but a simple interface for computing XXh64. */
+ * everything but a simple interface for computing XXh64. XXH3 follows the
+ * 0.8 release of the reference implementation. */
 
 #ifndef POLAR_UTILS_FAST_HASH_H
 #define POLAR_UTILS_FAST_HASH_H
 
+#include "polar/basic/adt/ArrayRef.h"
 #include "polar/basic/adt/StringRef.h"
+#include <cstdint>
 
 namespace polar {
+
+namespace basic {
+class Twine;
+} // basic
+
 namespace utils {
 
+using polar::basic::ArrayRef;
+using polar::basic::HashCode;
+using polar::basic::StringRef;
+using polar::basic::Twine;
+
 uint64_t fast_hash64(StringRef data);
 
+/// A 128-bit XXH3 digest.
+struct Xxh3Hash128
+{
+   uint64_t m_low64;
+   uint64_t m_high64;
+
+   friend bool operator==(const Xxh3Hash128 &lhs, const Xxh3Hash128 &rhs)
+   {
+      return lhs.m_low64 == rhs.m_low64 && lhs.m_high64 == rhs.m_high64;
+   }
+
+   friend bool operator!=(const Xxh3Hash128 &lhs, const Xxh3Hash128 &rhs)
+   {
+      return !(lhs == rhs);
+   }
+};
+
+/// Allows 128-bit digests to be used as keys of the Hashing.h based
+/// containers.
+HashCode hash_value(const Xxh3Hash128 &hash);
+
+/// Returns the 64-bit XXH3 hash of \p data.
+uint64_t xxh3_hash64(ArrayRef<uint8_t> data, uint64_t seed = 0);
+uint64_t xxh3_hash64(StringRef data, uint64_t seed = 0);
+
+/// Returns the 128-bit XXH3 hash of \p data.
+Xxh3Hash128 xxh3_hash128(ArrayRef<uint8_t> data, uint64_t seed = 0);
+Xxh3Hash128 xxh3_hash128(StringRef data, uint64_t seed = 0);
+
+namespace internal {
+
+/// The kernels XXH3 can accumulate inputs longer than 240 bytes with. Host
+/// picks the widest one the processor supports.
+enum class Xxh3Implementation
+{
+   Host,
+   Scalar,
+   Sse2,
+   Avx2
+};
+
+/// Makes every XXH3 hash use the \p impl kernel from now on, so tests can
+/// check each kernel on any host. Returns false, leaving the current choice
+/// alone, if \p impl is not built for this target or the processor lacks it.
+/// Not safe to call while other threads are hashing.
+bool set_xxh3_implementation(Xxh3Implementation impl);
+
+} // internal
+
+/// Computes XXH3 over data that arrives in pieces, e.g. a file read in
+/// chunks or the fragments of a Twine. Feeding the same bytes through any
+/// sequence of update() calls yields the one-shot xxh3_hash64() and
+/// xxh3_hash128() values.
+class Xxh3Hasher
+{
+public:
+   explicit Xxh3Hasher(uint64_t seed = 0)
+   {
+      init(seed);
+   }
+
+   /// Reinitialize the internal state
+   void init(uint64_t seed = 0);
+
+   /// Digest more data.
+   void update(ArrayRef<uint8_t> data);
+
+   /// Digest more data.
+   void update(StringRef str)
+   {
+      update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(str.getData()),
+                               str.getSize()));
+   }
+
+   /// Digest the concatenation of \p str without flattening it first.
+   void update(const Twine &str);
+
+   /// Returns the 64-bit hash of everything digested since init(). The state
+   /// is left untouched, so more data may be added afterwards.
+   uint64_t final() const;
+
+   /// Returns the 128-bit hash of everything digested since init(). The state
+   /// is left untouched, so more data may be added afterwards.
+   Xxh3Hash128 final128() const;
+
+   /// Returns the number of bytes digested since init().
+   uint64_t getLength() const
+   {
+      return m_totalLength;
+   }
+
+private:
+   enum { SECRET_SIZE = 192 };
+   enum { BUFFER_SIZE = 256 };
+
+   const uint8_t *getSecret() const;
+   void digestLong(uint64_t *acc) const;
+
+   alignas(64) uint64_t m_acc[8];
+   alignas(64) uint8_t m_customSecret[SECRET_SIZE];
+   alignas(64) uint8_t m_buffer[BUFFER_SIZE];
+   uint64_t m_totalLength;
+   uint64_t m_seed;
+   size_t m_stripesSoFar;
+   uint32_t m_bufferedSize;
+};
+
 } // utils
 } // polar
 
@@ -23,6 +23,10 @@
 #include "polar/global/DataTypes.h"
 #include "polar/utils/ErrorType.h"
 #include "polar/utils/FileSystem.h"
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 namespace polar {
 namespace utils {
@@ -38,12 +42,14 @@ class FileOutputBuffer
 {
 public:
    enum  {
-      F_executable = 1  /// set the 'x' bit on the resulting file
+      F_executable = 1, /// set the 'x' bit on the resulting file
+      F_growable = 2    /// allow resize() to grow the buffer
    };
 
    /// Factory method to create an OutputBuffer object which manages a read/write
    /// buffer of the specified size. When committed, the buffer will be written
-   /// to the file at the specified path.
+   /// to the file at the specified path. With F_growable, \p size is only the
+   /// initial size, and may be 0.
    static Expected<std::unique_ptr<FileOutputBuffer>>
    create(StringRef filePath, size_t size, unsigned flags = 0);
 
@@ -56,6 +62,19 @@ public:
    /// Returns size of the buffer.
    virtual size_t getBufferSize() const = 0;
 
+   /// Changes the size of the buffer, which is what commit() writes. Any
+   /// buffer may shrink, only those created with F_growable may grow. Growing
+   /// may move the buffer, and zero-fills it past the old size. To make
+   /// growing by small steps cheap, the file behind the buffer grows
+   /// geometrically, and is cut to size by commit().
+   virtual Error resize(size_t size) = 0;
+
+   /// Starts writing [offset, offset + length) of the buffer to disk, without
+   /// waiting for the writes to complete. Calling this for ranges as they are
+   /// filled spreads the writes over the lifetime of the buffer, rather than
+   /// leaving them all to commit(). Does nothing for buffers held in memory.
+   virtual Error writeBack(size_t offset, size_t length) = 0;
+
    /// Returns path where file will show up if buffer is committed.
    StringRef getPath() const
    {
@@ -83,6 +102,90 @@ protected:
    std::string m_finalPath;
 };
 
+/// ParallelOutputWriter - Lays out a FileOutputBuffer as sections, to be
+/// filled by concurrent workers. One thread allocates the sections and hands
+/// them out; workers fill them and report them complete from any thread;
+/// commit() waits for them all before committing the buffer.
+class ParallelOutputWriter
+{
+public:
+   /// A range of the buffer reserved for one worker.
+   class Section
+   {
+   public:
+      uint8_t *getData() const
+      {
+         return m_buffer->getBufferStart() + m_offset;
+      }
+
+      size_t getOffset() const
+      {
+         return m_offset;
+      }
+
+      size_t getSize() const
+      {
+         return m_size;
+      }
+
+   private:
+      friend class ParallelOutputWriter;
+
+      Section(FileOutputBuffer *buffer, size_t offset, size_t size)
+         : m_buffer(buffer),
+           m_offset(offset),
+           m_size(size)
+      {}
+
+      FileOutputBuffer *m_buffer;
+      size_t m_offset;
+      size_t m_size;
+   };
+
+   /// With \p writeBackCompleted, every section is written back to disk as
+   /// soon as it is complete, see FileOutputBuffer::writeBack().
+   explicit ParallelOutputWriter(FileOutputBuffer &buffer, bool writeBackCompleted = false)
+      : m_buffer(buffer),
+        m_writeBack(writeBackCompleted)
+   {}
+
+   /// Reserves \p size bytes at the first multiple of \p alignment, a power
+   /// of two, past the sections allocated so far. If they do not fit, a
+   /// buffer created with F_growable grows, which may move it, so that no
+   /// worker may be filling a section meanwhile. Sections allocated before
+   /// follow the move. Other buffers report an error.
+   Expected<Section> allocate(size_t size, size_t alignment = 1);
+
+   /// Reserves \p size bytes like allocate(), but on pages of their own.
+   /// Besides avoiding false sharing between workers, this places the pages
+   /// of a section on the NUMA node of the worker that fills it, as pages are
+   /// placed where they are first touched.
+   Expected<Section> allocatePages(size_t size);
+
+   /// Marks \p section as filled. Thread-safe.
+   void complete(const Section &section);
+
+   /// Waits until every section allocated so far is complete.
+   void wait();
+
+   /// Sets the bytes of the buffer that no section covers to \p value, on
+   /// the thread pool for large paddings.
+   void fillPadding(uint8_t value);
+
+   /// Waits for every section, then commits the buffer.
+   Error commit();
+
+private:
+   FileOutputBuffer &m_buffer;
+   bool m_writeBack;
+   /// Offsets and sizes of the sections, in buffer order.
+   std::vector<std::pair<size_t, size_t>> m_sections;
+   size_t m_end = 0;
+   std::mutex m_mutex;
+   std::condition_variable m_allComplete;
+   size_t m_pending = 0;
+};
+
 } // utils
 } // polar
 
@@ -975,6 +975,7 @@ private:
    size_t m_size;
    void *m_mapping;
    int m_fd;
+   uint64_t m_offset;
    MapMode m_mode;
 
    std::error_code init(int fd, uint64_t offset, MapMode mode);
@@ -1001,6 +1002,15 @@ public:
 
    /// \returns The minimum alignment offset must be.
    static int getAlignment();
+
+   /// Changes the length of the mapping, which may move it. The file must
+   /// already cover the new length. On failure, the mapping is unchanged.
+   std::error_code resize(size_t length);
+
+   /// Starts writing back the modified pages of [offset, offset + length) of
+   /// a readwrite mapping to the file, without waiting for the writes to
+   /// complete.
+   std::error_code writeBack(size_t offset, size_t length);
 };
 
 /// Return the path to the main executable, given the value of argv[0] from
@@ -1045,6 +1055,10 @@ public:
 
    OptionalError<BasicFileStatus> getStatus() const;
 
+   /// Returns the type of the entry. It comes from the directory listing when
+   /// the file system reports it, and from getStatus() otherwise.
+   FileType getType() const;
+
    bool operator==(const DirectoryEntry &other) const
    {
       return m_path == other.m_path;
@@ -1069,6 +1083,26 @@ std::error_code directory_iterator_construct(DirIterState &, StringRef, bool);
 std::error_code directory_iterator_increment(DirIterState &);
 std::error_code DirectoryIterator_destruct(DirIterState &);
 
+/// An entry read by list_directory().
+struct ListedEntry
+{
+   std::string m_name;
+   FileType m_type = FileType::type_unknown;
+   /// Only valid if m_hasStatus is set.
+   FileStatus m_status;
+   bool m_hasStatus = false;
+};
+
+/// Appends the entries of the directory \p path, but "." and "..", to
+/// \p entries. Types come from the listing where the file system reports
+/// them; otherwise, for symbolic links when \p followSymlinks is set, and for
+/// every entry when \p needStatus is set, the entry is stat'ed relative to
+/// the open directory. If \p dirStatus is given, it receives the status of
+/// the directory itself.
+std::error_code list_directory(StringRef path, bool followSymlinks, bool needStatus,
+                               std::vector<ListedEntry> &entries,
+                               FileStatus *dirStatus = nullptr);
+
 /// Keeps state for the DirectoryIterator.
 struct DirIterState {
    ~DirIterState() {
@@ -1189,8 +1223,7 @@ public:
       if (m_state->m_hasNoPushRequest) {
          m_state->m_hasNoPushRequest = false;
       } else {
-         OptionalError<BasicFileStatus> status = m_state->m_stack.top()->getStatus();
-         if (status && is_directory(*status)) {
+         if (m_state->m_stack.top()->getType() == FileType::directory_file) {
             m_state->m_stack.push(DirectoryIterator(*m_state->m_stack.top(), errorCode, m_follow));
             if (m_state->m_stack.top() != endIter) {
                ++m_state->m_level;
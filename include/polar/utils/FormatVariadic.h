@@ -12,13 +12,16 @@
 #ifndef POLAR_UTILS_FORMAT_VARIADIC_H
 #define POLAR_UTILS_FORMAT_VARIADIC_H
 
+#include "polar/basic/adt/ArrayRef.h"
 #include "polar/basic/adt/StlExtras.h"
 #include "polar/basic/adt/SmallString.h"
+#include "polar/basic/adt/SmallVector.h"
 #include "polar/basic/adt/StringRef.h"
 #include "polar/utils/FormatCommon.h"
 #include "polar/utils/FormatProviders.h"
 #include "polar/utils/FormatVariadicDetails.h"
 #include "polar/utils/RawOutStream.h"
+#include <array>
 #include <cstddef>
 #include <string>
 #include <tuple>
@@ -29,6 +32,8 @@
 namespace polar {
 namespace utils {
 
+using polar::basic::ArrayRef;
+
 enum class ReplacementType
 {
    Empty,
@@ -38,13 +43,13 @@ enum class ReplacementType
 
 struct ReplacementItem
 {
-   ReplacementItem() = default;
-   explicit ReplacementItem(StringRef literal)
+   constexpr ReplacementItem() = default;
+   constexpr explicit ReplacementItem(StringRef literal)
       : m_type(ReplacementType::Literal), m_spec(literal)
    {}
    
-   ReplacementItem(StringRef spec, size_t index, size_t align, AlignStyle where,
-                   char pad, StringRef options)
+   constexpr ReplacementItem(StringRef spec, size_t index, size_t align, AlignStyle where,
+                             char pad, StringRef options)
       : m_type(ReplacementType::Format), m_spec(spec), m_index(index), m_align(align),
         m_where(where), m_pad(pad), m_options(options)
    {}
@@ -54,7 +59,7 @@ struct ReplacementItem
    size_t m_index = 0;
    size_t m_align = 0;
    AlignStyle m_where = AlignStyle::Right;
-   char m_pad;
+   char m_pad = ' ';
    StringRef m_options;
 };
 
@@ -63,22 +68,24 @@ class FormatvObjectBase
 protected:
    // The parameters are stored in a std::tuple, which does not provide runtime
    // indexing capabilities.  In order to enable runtime indexing, we use this
-   // structure to put the parameters into a std::vector.  Since the parameters
+   // structure to put the parameters into a std::array.  Since the parameters
    // are not all the same type, we use some type-erasure by wrapping the
    // parameters in a template class that derives from a non-template superclass.
    // Essentially, we are converting a std::tuple<Derived<Ts...>> to a
-   // std::vector<Base*>.
+   // std::array<Base*, N>.
    struct create_adapters {
       template <typename... Ts>
-      std::vector<internal::FormatAdapterImpl *> operator()(Ts &... items)
+      std::array<internal::FormatAdapterImpl *, sizeof...(Ts)> operator()(Ts &... items)
       {
-         return std::vector<internal::FormatAdapterImpl *>{&items...};
+         return {{&items...}};
       }
    };
    
+   // The adapters and the replacements are owned by the derived classes, which
+   // point these at them, so that formatting allocates nothing.
    StringRef m_fmt;
-   std::vector<internal::FormatAdapterImpl *> m_adapters;
-   std::vector<ReplacementItem> m_replacements;
+   ArrayRef<internal::FormatAdapterImpl *> m_adapters;
+   ArrayRef<ReplacementItem> m_replacements;
    
    static bool consumeFieldLayout(StringRef &spec, AlignStyle &where,
                                   size_t &align, char &pad);
@@ -86,23 +93,13 @@ protected:
    static std::pair<ReplacementItem, StringRef>
    splitLiteralAndReplacement(StringRef fmt);
    
-public:
-   FormatvObjectBase(StringRef fmt, std::size_t paramCount)
-      : m_fmt(fmt), m_replacements(parseFormatString(fmt))
-   {
-      m_adapters.reserve(paramCount);
-   }
+   FormatvObjectBase(StringRef fmt)
+      : m_fmt(fmt)
+   {}
    
+public:
    FormatvObjectBase(FormatvObjectBase const &rhs) = delete;
    
-   FormatvObjectBase(FormatvObjectBase &&rhs)
-      : m_fmt(std::move(rhs.m_fmt)),
-        m_adapters(), // m_adapters are initialized by FormatvObject
-        m_replacements(std::move(rhs.m_replacements))
-   {
-      m_adapters.reserve(rhs.m_adapters.size());
-   }
-   
    void format(RawOutStream &outStream) const
    {
       for (auto &replacement : m_replacements) {
@@ -112,7 +109,7 @@ public:
             outStream << replacement.m_spec;
             continue;
          }
-         if (replacement.m_index >= m_adapters.size()) {
+         if (replacement.m_index >= m_adapters.getSize()) {
             outStream << replacement.m_spec;
             continue;
          }
@@ -126,6 +123,9 @@ public:
    
    static std::vector<ReplacementItem> parseFormatString(StringRef fmt);
    
+   static void parseFormatString(StringRef fmt,
+                                 SmallVectorImpl<ReplacementItem> &replacements);
+   
    static std::optional<ReplacementItem> parseReplacementItem(StringRef spec);
    
    std::string getStr() const
@@ -163,25 +163,246 @@ class FormatvObject : public FormatvObjectBase
    // of the parameters, we have to own the storage for the parameters here, and
    // have the base class store type-erased pointers into this tuple.
    Tuple m_parameters;
+   std::array<internal::FormatAdapterImpl *, std::tuple_size<Tuple>::value> m_adapterStorage;
+   SmallVector<ReplacementItem, 8> m_replacementStorage;
    
 public:
    FormatvObject(StringRef fmt, Tuple &&params)
-      : FormatvObjectBase(fmt, std::tuple_size<Tuple>::value),
+      : FormatvObjectBase(fmt),
         m_parameters(std::move(params))
    {
-      m_adapters = polar::basic::apply_tuple(create_adapters(), m_parameters);
+      parseFormatString(fmt, m_replacementStorage);
+      m_adapterStorage = polar::basic::apply_tuple(create_adapters(), m_parameters);
+      m_adapters = m_adapterStorage;
+      m_replacements = m_replacementStorage;
    }
    
    FormatvObject(FormatvObject const &rhs) = delete;
    
    FormatvObject(FormatvObject &&rhs)
-      : FormatvObjectBase(std::move(rhs)),
-        m_parameters(std::move(rhs.m_parameters))
+      : FormatvObjectBase(rhs.m_fmt),
+        m_parameters(std::move(rhs.m_parameters)),
+        m_replacementStorage(std::move(rhs.m_replacementStorage))
    {
-      m_adapters = polar::basic::apply_tuple(create_adapters(), m_parameters);
+      m_adapterStorage = polar::basic::apply_tuple(create_adapters(), m_parameters);
+      m_adapters = m_adapterStorage;
+      m_replacements = m_replacementStorage;
    }
 };
 
+namespace internal {
+
+/// The replacements of a format string parsed at compile time, by
+/// compile_format().
+template <size_t N>
+struct CompiledFormat
+{
+   std::array<ReplacementItem, N> m_items;
+   /// One more than the largest index of a replacement, or 0.
+   size_t m_numArgs = 0;
+   bool m_valid = true;
+};
+
+constexpr bool is_format_space(char character)
+{
+   return character == ' ' || character == '\t' || character == '\n' ||
+         character == '\v' || character == '\f' || character == '\r';
+}
+
+constexpr void skip_format_spaces(const char *fmt, size_t &begin, size_t &end)
+{
+   while (begin < end && is_format_space(fmt[begin])) {
+      ++begin;
+   }
+   while (end > begin && is_format_space(fmt[end - 1])) {
+      --end;
+   }
+}
+
+/// Consumes the decimal integer at \p begin, as StringRef::consumeInteger()
+/// does. Indices and widths with other radixes are not taken at compile time.
+constexpr bool consume_format_integer(const char *fmt, size_t &begin, size_t end,
+                                      size_t &value)
+{
+   if (begin == end || fmt[begin] < '0' || fmt[begin] > '9' ||
+       (fmt[begin] == '0' && begin + 1 < end &&
+        (fmt[begin + 1] == 'x' || fmt[begin + 1] == 'X' || fmt[begin + 1] == 'b' ||
+         fmt[begin + 1] == 'o' || (fmt[begin + 1] >= '0' && fmt[begin + 1] <= '9')))) {
+      return false;
+   }
+   value = 0;
+   while (begin < end && fmt[begin] >= '0' && fmt[begin] <= '9') {
+      value = value * 10 + (fmt[begin++] - '0');
+   }
+   return true;
+}
+
+constexpr bool translate_format_loc_char(char character, AlignStyle &where)
+{
+   switch (character) {
+   case '-':
+      where = AlignStyle::Left;
+      return true;
+   case '=':
+      where = AlignStyle::Center;
+      return true;
+   case '+':
+      where = AlignStyle::Right;
+      return true;
+   default:
+      return false;
+   }
+}
+
+/// Parses the replacement field between \p begin and \p end, without its
+/// braces, as FormatvObjectBase::parseReplacementItem() does.
+constexpr bool parse_format_field(const char *fmt, size_t begin, size_t end,
+                                  ReplacementItem &item)
+{
+   size_t index = 0;
+   size_t align = 0;
+   AlignStyle where = AlignStyle::Right;
+   char pad = ' ';
+   StringRef options;
+   size_t pos = begin;
+   size_t last = end;
+   skip_format_spaces(fmt, pos, last);
+   if (!consume_format_integer(fmt, pos, last, index)) {
+      return false;
+   }
+   skip_format_spaces(fmt, pos, last);
+   if (pos < last && fmt[pos] == ',') {
+      ++pos;
+      if (pos < last) {
+         if (last - pos > 1 && translate_format_loc_char(fmt[pos + 1], where)) {
+            pad = fmt[pos];
+            pos += 2;
+         } else if (last - pos > 1 && translate_format_loc_char(fmt[pos], where)) {
+            pos += 1;
+         }
+         if (!consume_format_integer(fmt, pos, last, align)) {
+            return false;
+         }
+      }
+   }
+   skip_format_spaces(fmt, pos, last);
+   if (pos < last && fmt[pos] == ':') {
+      size_t optionsBegin = pos + 1;
+      skip_format_spaces(fmt, optionsBegin, last);
+      options = StringRef(fmt + optionsBegin, last - optionsBegin);
+      pos = last;
+   }
+   if (pos != last) {
+      return false;
+   }
+   item = ReplacementItem(StringRef(fmt + begin, end - begin), index, align, where,
+                          pad, options);
+   return true;
+}
+
+/// Splits the next replacement off \p fmt at \p pos, as
+/// FormatvObjectBase::splitLiteralAndReplacement() does, and moves \p pos past
+/// it.
+constexpr bool next_format_item(const char *fmt, size_t size, size_t &pos,
+                                ReplacementItem &item)
+{
+   size_t bo = pos;
+   while (bo < size && fmt[bo] != '{') {
+      ++bo;
+   }
+   if (bo != pos) {
+      item = ReplacementItem(StringRef(fmt + pos, bo - pos));
+      pos = bo;
+      return true;
+   }
+   size_t braces = 0;
+   while (bo + braces < size && fmt[bo + braces] == '{') {
+      ++braces;
+   }
+   if (braces > 1) {
+      item = ReplacementItem(StringRef(fmt + bo, braces / 2));
+      pos = bo + braces / 2 * 2;
+      return true;
+   }
+   size_t bc = bo + 1;
+   while (bc < size && fmt[bc] != '}') {
+      if (fmt[bc] == '{') {
+         // Unterminated, or split by another brace.
+         return false;
+      }
+      ++bc;
+   }
+   if (bc == size) {
+      return false;
+   }
+   pos = bc + 1;
+   return parse_format_field(fmt, bo + 1, bc, item);
+}
+
+/// Returns how many replacements compile_format() makes of \p fmt.
+template <size_t N>
+constexpr size_t count_format_items(const char (&fmt)[N])
+{
+   size_t count = 0;
+   ReplacementItem item;
+   for (size_t pos = 0; pos < N - 1;) {
+      if (!next_format_item(fmt, N - 1, pos, item)) {
+         break;
+      }
+      ++count;
+   }
+   return count;
+}
+
+/// Parses the string literal \p fmt into \p Count replacements, at compile
+/// time.
+template <size_t Count, size_t N>
+constexpr CompiledFormat<Count> compile_format(const char (&fmt)[N])
+{
+   CompiledFormat<Count> result;
+   size_t count = 0;
+   for (size_t pos = 0; pos < N - 1;) {
+      ReplacementItem item;
+      if (!next_format_item(fmt, N - 1, pos, item)) {
+         result.m_valid = false;
+         break;
+      }
+      if (item.m_type == ReplacementType::Format && item.m_index >= result.m_numArgs) {
+         result.m_numArgs = item.m_index + 1;
+      }
+      result.m_items[count++] = item;
+   }
+   return result;
+}
+
+} // internal
+
+/// A formatv() object whose format string was parsed at compile time, made
+/// by POLAR_FORMATV().
+template <typename Tuple>
+class CompiledFormatvObject : public FormatvObjectBase
+{
+   Tuple m_parameters;
+   std::array<internal::FormatAdapterImpl *, std::tuple_size<Tuple>::value> m_adapterStorage;
+   
+public:
+   CompiledFormatvObject(StringRef fmt, ArrayRef<ReplacementItem> replacements,
+                         Tuple &&params)
+      : FormatvObjectBase(fmt),
+        m_parameters(std::move(params))
+   {
+      m_adapterStorage = polar::basic::apply_tuple(create_adapters(), m_parameters);
+      m_adapters = m_adapterStorage;
+      m_replacements = replacements;
+   }
+   
+   CompiledFormatvObject(CompiledFormatvObject const &rhs) = delete;
+   
+   CompiledFormatvObject(CompiledFormatvObject &&rhs)
+      : CompiledFormatvObject(rhs.m_fmt, rhs.m_replacements, std::move(rhs.m_parameters))
+   {}
+};
+
 // \brief Format text given a format string and replacement parameters.
 //
 // ===General Description===
@@ -273,6 +494,58 @@ inline auto formatv(const char *fmt, Ts &&... values) -> FormatvObject<decltype(
             std::make_tuple(internal::build_format_adapter(std::forward<Ts>(values))...));
 }
 
+namespace internal {
+
+template <typename Compiler, typename... Ts>
+inline auto compiled_formatv(Compiler, const char *, Ts &&... values) -> CompiledFormatvObject<decltype(
+      std::make_tuple(build_format_adapter(std::forward<Ts>(values))...))>
+{
+   static constexpr auto format = Compiler()();
+   static_assert(format.m_valid, "invalid format string");
+   static_assert(format.m_numArgs <= sizeof...(Ts),
+                 "format string refers to an argument which is not given");
+   using ParamTuple = decltype(
+   std::make_tuple(build_format_adapter(std::forward<Ts>(values))...));
+   return CompiledFormatvObject<ParamTuple>(
+            Compiler::getFormat(),
+            ArrayRef<ReplacementItem>(format.m_items.data(), format.m_items.size()),
+            std::make_tuple(build_format_adapter(std::forward<Ts>(values))...));
+}
+
+} // internal
+
+// \brief formatv() with a string literal format, parsed at compile time.
+//
+// POLAR_FORMATV("{0} of {1,-8}", value, name) formats just as
+// formatv("{0} of {1,-8}", value, name), but the format string is parsed into
+// its replacements once, by the compiler, and formatting allocates nothing.
+// A format string which does not match the grammar described above, or
+// which refers to an argument that is not given, is a compile error. Indices
+// and widths are decimal.
+#define POLAR_FORMATV(...)                                                        \
+   ::polar::utils::internal::compiled_formatv(                                      \
+      [] {                                                                          \
+         struct Compiler                                                            \
+         {                                                                          \
+            static constexpr ::polar::basic::StringRef getFormat()                  \
+            {                                                                       \
+               return ::polar::basic::StringRef(                                    \
+                  POLAR_FORMATV_FORMAT(__VA_ARGS__, ),                              \
+                  sizeof(POLAR_FORMATV_FORMAT(__VA_ARGS__, )) - 1);                 \
+            }                                                                       \
+            constexpr auto operator()() const                                       \
+            {                                                                       \
+               return ::polar::utils::internal::compile_format<                     \
+                  ::polar::utils::internal::count_format_items(                     \
+                     POLAR_FORMATV_FORMAT(__VA_ARGS__, ))>(                         \
+                  POLAR_FORMATV_FORMAT(__VA_ARGS__, ));                             \
+            }                                                                       \
+         };                                                                         \
+         return Compiler();                                                         \
+      }(), __VA_ARGS__)
+
+#define POLAR_FORMATV_FORMAT(fmt, ...) fmt
+
 // Allow a FormatvObject to be formatted (no options supported).
 template <typename T> struct FormatProvider<FormatvObject<T>>
 {
@@ -282,6 +555,14 @@ template <typename T> struct FormatProvider<FormatvObject<T>>
    }
 };
 
+template <typename T> struct FormatProvider<CompiledFormatvObject<T>>
+{
+   static void format(const CompiledFormatvObject<T> &value, RawOutStream &outStream, StringRef)
+   {
+      outStream << value;
+   }
+};
+
 } // utils
 } // polar
 
@@ -12,28 +12,36 @@
 #ifndef POLAR_UTILS_GLOB_PATTERN_H
 #define POLAR_UTILS_GLOB_PATTERN_H
 
-#include "polar/basic/adt/BitVector.h"
+#include "polar/basic/adt/SmallVector.h"
+#include "polar/basic/adt/StringMap.h"
 #include "polar/basic/adt/StringRef.h"
 #include "polar/utils/ErrorType.h"
-#include <vector>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <vector>
 
 // This class represents a glob pattern. Supported metacharacters
 // are "*", "?", "[<chars>]" and "[^<chars>]".
 
 namespace polar {
-
-namespace basic {
-class BitVector;
-template <typename T>
-class ArrayRef;
-} // basic
-
 namespace utils {
 
-using polar::basic::BitVector;
-using polar::basic::ArrayRef;
+using polar::basic::SmallVectorImpl;
+using polar::basic::StringMap;
+
+namespace internal {
+class LazyGlobDfa;
+} // internal
 
+/// A glob pattern compiled for matching.
+///
+/// Every non-'*' token of the pattern is a position consuming exactly one
+/// character; a '*' lets the preceding position repeat any character. Patterns
+/// of at most 64 positions are run as a Shift-And automaton, one word of state
+/// updated by a handful of bit operations per character. Longer patterns build
+/// a DFA lazily, a state per set of active positions met so far, which is
+/// shared by the copies of a pattern and read by match() without locking.
 class GlobPattern
 {
 public:
@@ -41,10 +49,18 @@ public:
    bool match(StringRef str) const;
 
 private:
-   bool matchOne(ArrayRef<BitVector> pattern, StringRef str) const;
+   friend class GlobSet;
 
-   // Parsed glob pattern.
-   std::vector<BitVector> m_tokens;
+   enum { MAX_SHIFT_AND_POSITIONS = 64 };
+
+   // For patterns of at most MAX_SHIFT_AND_POSITIONS positions, bit i of
+   // m_masks[c] is set if position i accepts c, and bit i of m_loops if a
+   // '*' follows position i.
+   std::vector<uint64_t> m_masks;
+   uint64_t m_loops = 0;
+   unsigned m_numPositions = 0;
+   bool m_leadingStar = false;
+   std::shared_ptr<internal::LazyGlobDfa> m_dfa;
 
    // The following members are for optimization.
    std::optional<StringRef> m_exact;
@@ -52,6 +68,63 @@ private:
    std::optional<StringRef> m_suffix;
 };
 
+/// A set of glob patterns matched against a string in a single pass.
+///
+/// Patterns without wildcards are looked up in a hash table. The Shift-And
+/// automata of the others are packed side by side into 64-bit words and
+/// advanced together, so a string is read once whatever the number of
+/// patterns. Patterns too long for a word are matched on their own.
+class GlobSet
+{
+public:
+   /// Adds \p pattern, which match() reports by its insertion index.
+   Error add(StringRef pattern);
+
+   unsigned getSize() const
+   {
+      return m_size;
+   }
+
+   bool isEmpty() const
+   {
+      return m_size == 0;
+   }
+
+   /// Returns true if any pattern of the set matches \p str.
+   bool matchAny(StringRef str) const;
+
+   /// Appends the indexes of the patterns matching \p str, in ascending
+   /// order, to \p indexes. Returns true if there is any.
+   bool match(StringRef str, SmallVectorImpl<unsigned> &indexes) const;
+
+private:
+   /// Runs the packed automata over \p str, leaving the final states of all
+   /// the words in \p states. Returns false if none can accept.
+   bool run(StringRef str, SmallVectorImpl<uint64_t> &states) const;
+
+   struct Word
+   {
+      /// First and last bit of every pattern of this word.
+      uint64_t m_first = 0;
+      uint64_t m_accept = 0;
+      /// First bits of the patterns starting with '*'.
+      uint64_t m_leadingStars = 0;
+      uint64_t m_loops = 0;
+      unsigned m_numBits = 0;
+      /// The pattern index of every accepting bit, in bit order.
+      std::vector<unsigned> m_patterns;
+   };
+
+   StringMap<std::vector<unsigned>> m_exact;
+   std::vector<unsigned> m_matchAll;
+   std::vector<Word> m_words;
+   // 256 masks per word, laid out word after word.
+   std::vector<uint64_t> m_masks;
+   std::vector<std::pair<GlobPattern, unsigned>> m_large;
+   unsigned m_size = 0;
+   bool m_anyLeadingStar = false;
+};
+
 } // utils
 } // polar
 
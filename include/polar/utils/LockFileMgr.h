@@ -14,6 +14,7 @@
 
 #include "polar/basic/adt/SmallString.h"
 #include "polar/utils/FileSystem.h"
+#include <chrono>
 #include <system_error>
 #include <utility> // for std::pair
 
@@ -72,6 +73,7 @@ private:
   std::optional<std::pair<std::string, int> > m_owner;
   std::error_code m_errorCode;
   std::string m_errorDiagMsg;
+  std::chrono::nanoseconds m_waitTime{0};
 
   LockFileManager(const LockFileManager &) = delete;
   LockFileManager &operator=(const LockFileManager &) = delete;
@@ -95,8 +97,20 @@ public:
   }
 
   /// \brief For a shared lock, wait until the owner releases the lock.
+  ///
+  /// Where the platform can notify of the removal of the lock file (inotify
+  /// on Linux), the wait ends as soon as the owner removes it. Otherwise, or
+  /// if notifications cannot be set up, the lock file is polled with an
+  /// exponential backoff. In both cases, the owner is checked for liveness
+  /// at the polling intervals, and the wait times out after ~1.5 minutes.
   WaitForUnlockResult waitForUnlock();
 
+  /// \brief Total time spent in waitForUnlock() by this instance.
+  std::chrono::nanoseconds getWaitTime() const
+  {
+     return m_waitTime;
+  }
+
   /// \brief Remove the lock file.  This may delete a different lock file than
   /// the one previously read if there is a race.
   std::error_code unsafeRemoveLockFile();
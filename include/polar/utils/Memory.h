@@ -70,6 +70,15 @@ public:
       MF_EXEC  = 0x4000000
    };
 
+   enum AccessAdvice
+   {
+      MA_NORMAL,
+      MA_RANDOM,
+      MA_SEQUENTIAL,
+      MA_WILL_NEED,
+      MA_DONT_NEED
+   };
+
    /// This method allocates a block of memory that is suitable for loading
    /// dynamically generated code (e.g. JIT). An attempt to allocate
    /// \p NumBytes bytes of virtual memory is made.
@@ -128,6 +137,16 @@ public:
    static std::error_code protectMappedMemory(const MemoryBlock &block,
                                               unsigned flags);
 
+   /// Tells the system how the memory in [\p addr, \p addr + \p len) is going
+   /// to be accessed, e.g. that a part of a mapped file will be needed soon.
+   /// The range is widened to page boundaries. This is only a hint; it does
+   /// not change the contents of the memory and is a no-op on systems without
+   /// posix_madvise.
+   ///
+   /// @brief Advise on the access pattern of mapped memory.
+   static std::error_code adviseMappedMemory(const void *addr, size_t len,
+                                             AccessAdvice advice);
+
    /// invalidateInstructionCache - Before the JIT can run a block of code
    /// that has been emitted it must invalidate the instruction cache on some
    /// platforms.
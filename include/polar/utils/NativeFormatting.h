@@ -62,6 +62,12 @@ void write_hex(RawOutStream &outStream, uint64_t size, HexPrintStyle style,
 void write_double(RawOutStream &outStream, double D, FloatStyle style,
                   std::optional<size_t> precision = std::nullopt);
 
+/// Writes \p value in the fewest significant digits which read back as
+/// \p value, in decimal notation, or in scientific notation when the
+/// decimal exponent is below -4 or above 16.
+void write_shortest(RawOutStream &outStream, double value);
+void write_shortest(RawOutStream &outStream, float value);
+
 } // utils
 } // polar
 
@@ -24,6 +24,7 @@
 #include "polar/basic/adt/StringRef.h"
 #include <array>
 #include <cstdint>
+#include <vector>
 
 namespace polar {
 
@@ -75,6 +76,33 @@ public:
    /// Returns a raw 160-bit Sha1 hash for the given data.
    static std::array<uint8_t, 20> hash(ArrayRef<uint8_t> data);
 
+   /// Returns the raw 160-bit Sha1 hashes of many independent buffers, in
+   /// input order. Small buffers are interleaved through SIMD lanes so that
+   /// hashing N of them costs far less than N calls to hash().
+   static std::vector<std::array<uint8_t, 20>>
+   hashBatch(ArrayRef<ArrayRef<uint8_t>> data);
+
+   /// Returns true if blocks are compressed with the x86 SHA extensions.
+   static bool hasHardwareAcceleration();
+
+   /// The ways blocks can be compressed. Host uses the SHA extensions when the
+   /// processor has them and interleaves hashBatch() through SIMD lanes when
+   /// it does not; the other two pin one path so tests can cover each of them
+   /// on any host.
+   enum class Implementation
+   {
+      Host,
+      Portable,
+      MultiBuffer
+   };
+
+   /// Makes hash() and hashBatch() use \p impl from now on. Portable runs the
+   /// plain C++ compression for every message; MultiBuffer runs it for single
+   /// messages and the SIMD lanes for batches. Returns false, leaving the
+   /// current choice alone, if \p impl is not built for this target. Meant
+   /// for tests; not safe to call while other threads are hashing.
+   static bool setImplementation(Implementation impl);
+
 private:
    /// Define some constants.
    /// "static constexpr" would be cleaner but MSVC does not support it yet.
@@ -83,12 +111,9 @@ private:
 
    // Internal State
    struct {
-      union {
-         uint8_t C[BLOCK_LENGTH];
-         uint32_t L[BLOCK_LENGTH / 4];
-      } m_buffer;
+      uint8_t m_buffer[BLOCK_LENGTH];
       uint32_t m_state[HASH_LENGTH / 4];
-      uint32_t m_byteCount;
+      uint64_t m_byteCount;
       uint8_t m_bufferOffset;
    } m_internalState;
 
@@ -96,8 +121,6 @@ private:
    uint32_t m_hashResult[HASH_LENGTH / 4];
 
    // Helper
-   void writebyte(uint8_t data);
-   void hashBlock();
    void addUncounted(uint8_t data);
    void pad();
 };
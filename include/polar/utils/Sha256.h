@@ -0,0 +1,119 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+//===----------------------------------------------------------------------===//
+//
+// SHA-256 (FIPS 180-4) with the same interface as Sha1. Blocks are
+// compressed with the x86 SHA extensions when the host has them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef POLAR_UTILS_SHA256_H
+#define POLAR_UTILS_SHA256_H
+
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/basic/adt/StringRef.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace polar {
+namespace utils {
+
+using polar::basic::ArrayRef;
+using polar::basic::StringRef;
+
+/// A class that wrap the Sha256 algorithm.
+class Sha256
+{
+public:
+   Sha256()
+   {
+      init();
+   }
+
+   /// Reinitialize the internal state
+   void init();
+
+   /// Digest more data.
+   void update(ArrayRef<uint8_t> data);
+
+   /// Digest more data.
+   void update(StringRef str)
+   {
+      update(ArrayRef<uint8_t>((uint8_t *)const_cast<char *>(str.getData()),
+                               str.getSize()));
+   }
+
+   /// Return a reference to the current raw 256-bits Sha256 for the digested
+   /// data since the last call to init(). This call will add data to the
+   /// internal state and as such is not suited for getting an intermediate
+   /// result (see result()).
+   StringRef final();
+
+   /// Return a reference to the current raw 256-bits Sha256 for the digested
+   /// data since the last call to init(). This is suitable for getting the
+   /// Sha256 at any time without invalidating the internal state so that more
+   /// calls can be made into update.
+   StringRef result();
+
+   /// Returns a raw 256-bit Sha256 hash for the given data.
+   static std::array<uint8_t, 32> hash(ArrayRef<uint8_t> data);
+
+   /// Returns the raw 256-bit Sha256 hashes of many independent buffers, in
+   /// input order. Small buffers are interleaved through SIMD lanes so that
+   /// hashing N of them costs far less than N calls to hash().
+   static std::vector<std::array<uint8_t, 32>>
+   hashBatch(ArrayRef<ArrayRef<uint8_t>> data);
+
+   /// Returns true if blocks are compressed with the x86 SHA extensions.
+   static bool hasHardwareAcceleration();
+
+   /// The ways blocks can be compressed. Host uses the SHA extensions when the
+   /// processor has them and interleaves hashBatch() through SIMD lanes when
+   /// it does not; the other two pin one path so tests can cover each of them
+   /// on any host.
+   enum class Implementation
+   {
+      Host,
+      Portable,
+      MultiBuffer
+   };
+
+   /// Makes hash() and hashBatch() use \p impl from now on. Portable runs the
+   /// plain C++ compression for every message; MultiBuffer runs it for single
+   /// messages and the SIMD lanes for batches. Returns false, leaving the
+   /// current choice alone, if \p impl is not built for this target. Meant
+   /// for tests; not safe to call while other threads are hashing.
+   static bool setImplementation(Implementation impl);
+
+private:
+   enum { BLOCK_LENGTH = 64 };
+   enum { HASH_LENGTH = 32 };
+
+   // Internal State
+   struct {
+      uint8_t m_buffer[BLOCK_LENGTH];
+      uint32_t m_state[HASH_LENGTH / 4];
+      uint64_t m_byteCount;
+      uint8_t m_bufferOffset;
+   } m_internalState;
+
+   // Internal copy of the hash, populated and accessed on calls to result()
+   uint32_t m_hashResult[HASH_LENGTH / 4];
+
+   void pad();
+};
+
+} // utils
+} // polar
+
+#endif // POLAR_UTILS_SHA256_H
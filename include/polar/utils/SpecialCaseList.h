@@ -59,6 +59,7 @@
 
 #include "polar/basic/adt/StringMap.h"
 #include "polar/basic/adt/StringSet.h"
+#include "polar/utils/AhoCorasick.h"
 #include "polar/utils/TrigramIndex.h"
 #include <string>
 #include <vector>
@@ -130,18 +131,41 @@ protected:
    /// "literal" (i.e. no regex metacharacters) are stored in m_strings.  The
    /// reason for doing so is efficiency; StringMap is much faster at matching
    /// literal strings than Regex.
+   ///
+   /// Once compiled, the literal text every other regex requires is searched
+   /// for with a single automaton, and only the regexes whose literal shows up
+   /// in the query, or that require none, are run. Wildcard-only patterns are
+   /// then matched without std::regex.
    class Matcher
    {
    public:
       bool insert(std::string regexp, unsigned lineNumber, std::string &reError);
+      // Builds the automaton over the regexes inserted so far. Until this is
+      // called, match() tries every regex in turn.
+      void compile();
       // Returns the line number in the source file that this query matches to.
       // Returns zero if no match is found.
       unsigned match(StringRef query) const;
 
    private:
+      struct RegexEntry
+      {
+         std::unique_ptr<std::regex> m_regex;
+         unsigned m_lineNumber;
+         // The pattern as written if '*' is its only metacharacter, else empty.
+         std::string m_glob;
+      };
+
+      bool matches(const RegexEntry &entry, StringRef query) const;
+
       StringMap<unsigned> m_strings;
       TrigramIndex m_trigrams;
-      std::vector<std::pair<std::unique_ptr<std::regex>, unsigned>> m_regExes;
+      std::vector<RegexEntry> m_regExes;
+      // Maps the literal required by a regex to its index in m_regExes.
+      AhoCorasick m_factors;
+      // Indices of the regexes that do not require any literal, ascending.
+      std::vector<unsigned> m_unfiltered;
+      bool m_compiled = false;
    };
 
    using SectionEntries = StringMap<StringMap<Matcher>>;
@@ -156,6 +180,9 @@ protected:
 
    std::vector<Section> m_sections;
 
+   /// Compiles the matchers of all sections, once parsing is done.
+   void compileMatchers();
+
    /// Parses just-constructed SpecialCaseList entries from a memory buffer.
    bool parse(const MemoryBuffer *memoryBuffer, StringMap<size_t> &m_sectionsMap,
               std::string &error);
@@ -28,6 +28,11 @@ public:
    StringSaver(BumpPtrAllocator &alloc) : m_alloc(alloc)
    {}
 
+   BumpPtrAllocator &getAllocator() const
+   {
+      return m_alloc;
+   }
+
    StringRef save(const char *str)
    {
       return save(StringRef(str));
@@ -12,28 +12,141 @@
 #ifndef POLAR_UTILS_TAR_WRITER_H
 #define POLAR_UTILS_TAR_WRITER_H
 
+#include "polar/basic/adt/SmallVector.h"
+#include "polar/basic/adt/StringMap.h"
 #include "polar/basic/adt/StringRef.h"
 #include "polar/basic/adt/StringSet.h"
 #include "polar/utils/ErrorType.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/Parallel.h"
 #include "polar/utils/RawOutStream.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
 
 namespace polar {
 namespace utils {
 
+using polar::basic::SmallVector;
+using polar::basic::StringMap;
 using polar::basic::StringSet;
 
-class TarWriter {
+namespace internal {
+
+/// Where a member lies in an IndexedGzip archive.
+struct TarIndexEntry
+{
+   /// Path relative to the base directory.
+   std::string m_path;
+   /// Offset and size of the gzip member holding the tar member.
+   uint64_t m_offset;
+   uint64_t m_compressedSize;
+   /// Offset and size of the data in the decompressed tar member, past the
+   /// headers.
+   uint64_t m_dataOffset;
+   uint64_t m_dataSize;
+};
+
+} // internal
+
+/// \brief Writes a tar archive, one member at a time.
+///
+/// In the IndexedGzip format, every member is compressed on its own, on the
+/// thread pool, into a gzip member of a multi-member gzip file. The result is
+/// a regular .tar.gz, and it ends with an index of its members and a footer
+/// pointing to the index, for IndexedTarReader to read members in any order
+/// without decompressing the others.
+class TarWriter
+{
 public:
+   enum Format
+   {
+      Plain,
+      IndexedGzip
+   };
+
    static Expected<std::unique_ptr<TarWriter>> create(StringRef outputPath,
-                                                      StringRef baseDir);
+                                                      StringRef baseDir,
+                                                      Format format = Plain);
 
+   ~TarWriter();
+
+   /// Adds \p data as the member \p path. Members already added are skipped.
    void append(StringRef path, StringRef data);
 
+   /// Adds the contents of the file \p filePath as the member \p path. The
+   /// file is copied from disk to disk, with copy_file_range() where
+   /// available, rather than loaded in memory. Sparse files are archived
+   /// as regular members, with their holes stored as zeros: the GNU sparse
+   /// member formats are not written, and IndexedTarReader does not read
+   /// them.
+   Error appendFile(StringRef path, StringRef filePath);
+
+   /// Completes the archive. Called by the destructor if need be, which must
+   /// then drop any error. Compression errors are only reported here.
+   Error finish();
+
 private:
-   TarWriter(int fd, StringRef baseDir);
+   /// A member being compressed.
+   struct PendingMember
+   {
+      internal::TarIndexEntry m_entry;
+      SmallVector<char, 0> m_compressed;
+      std::string m_errorMessage;
+      bool m_done = false;
+   };
+
+   TarWriter(int fd, StringRef baseDir, Format format);
+   void queueMember(std::string relativePath, std::string headers,
+                    std::unique_ptr<MemoryBuffer> data);
+   void writeCompressedMembers(size_t maxPending);
+   void writeTerminator();
+
+   int m_fd;
    RawFdOutStream m_outstream;
    std::string m_baseDir;
    StringSet<> m_files;
+   Format m_format;
+   bool m_finished = false;
+
+   // IndexedGzip state.
+   polar::utils::parallel::internal::TaskGroup m_tasks;
+   std::mutex m_mutex;
+   std::condition_variable m_memberDone;
+   std::deque<std::unique_ptr<PendingMember>> m_pending;
+   std::vector<internal::TarIndexEntry> m_index;
+   std::string m_errorMessage;
+};
+
+/// \brief Reads the members of an archive written by TarWriter in the
+/// IndexedGzip format, in any order.
+class IndexedTarReader
+{
+public:
+   static Expected<std::unique_ptr<IndexedTarReader>> create(StringRef archivePath);
+
+   /// The paths of the members, relative to the base directory of the
+   /// archive, in archive order.
+   std::vector<StringRef> getMemberPaths() const;
+
+   bool hasMember(StringRef path) const
+   {
+      return m_lookup.count(path) != 0;
+   }
+
+   /// Decompresses the member \p path, and only that member.
+   Expected<std::unique_ptr<MemoryBuffer>> read(StringRef path) const;
+
+private:
+   IndexedTarReader(std::unique_ptr<MemoryBuffer> archive)
+      : m_archive(std::move(archive))
+   {}
+   Error readIndex();
+
+   std::unique_ptr<MemoryBuffer> m_archive;
+   std::vector<internal::TarIndexEntry> m_entries;
+   StringMap<size_t> m_lookup;
 };
 
 } // utils
@@ -28,38 +28,76 @@ class StringRef;
 
 namespace utils {
 
+using polar::basic::SmallVectorImpl;
 using polar::basic::StringRef;
 
+/// Splits \p regex into the literal runs every match contains, in order.
+/// As in SpecialCaseList, '*' is a wildcard on its own. Groups, bracket
+/// expressions, '.', anchors, wildcards and escapes of letters or digits
+/// separate runs, while escaped punctuation is literal; a character followed
+/// by '?' or a '{' quantifier is optional and dropped.
+/// Returns false if nothing can be relied upon, because of a top level
+/// alternation or a back reference.
+bool get_required_regex_runs(StringRef regex, std::vector<std::string> &runs);
+
+/// An inverted index from the trigrams of regex rules to the rules, used to
+/// avoid running most of the rules against a query.
+///
+/// Every rule gets an ID, its insertion index. From each rule the literal text
+/// any match has to contain is worked out, ignoring optional parts, groups and
+/// bracket expressions, and its trigrams are indexed. A query then yields the
+/// rules whose indexed trigrams all occur in it, plus the rules nothing could
+/// be indexed for, which are candidates for every query.
 class TrigramIndex
 {
 public:
    /// Inserts a new Regex into the index.
    void insert(std::string regex);
 
+   /// Inserts a rule given the runs get_required_regex_runs() found in it,
+   /// for callers that need the runs themselves as well.
+   void insertRuns(const std::vector<std::string> &runs);
+
+   /// Inserts a rule that is not indexed and so is a candidate for every
+   /// query, keeping the rule IDs in step with the caller's.
+   void insertUnindexed();
+
    /// Returns true, if special case list definitely does not have a line
    /// that matches the query. Returns false, if it's not sure.
    bool isDefinitelyOut(StringRef query) const;
 
+   /// Appends the IDs of the rules that may match \p query to \p candidates,
+   /// in ascending order.
+   void getCandidates(StringRef query, SmallVectorImpl<unsigned> &candidates) const;
+
    /// Returned true, iff the heuristic is defeated and not useful.
    /// In this case isDefinitelyOut always returns false.
    bool isDefeated()
    {
       return m_defeated;
    }
+
+   size_t getNumRules() const
+   {
+      return m_counts.size();
+   }
+
 private:
-   // If true, the rules are too complicated for the check to work, and full
-   // regex matching is needed for every rule.
+   // If true, some rule is too complicated for the check to work or has no
+   // trigrams, and full regex matching is needed for it on every query.
    bool m_defeated = false;
    // The minimum number of trigrams which should match for a rule to have a
-   // chance to match the query. The number of elements equals the number of
-   // regex rules in the SpecialCaseList.
+   // chance to match the query, 0 for rules that are not indexed. The number
+   // of elements equals the number of rules.
    std::vector<unsigned> m_counts;
+   // The rules that are not indexed, in ascending order.
+   std::vector<unsigned> m_unindexed;
    // m_index holds a list of rules indices for each trigram. The same indices
    // are used in m_counts to store per-rule limits.
    // If a trigram is too common (>4 rules with it), we stop tracking it,
    // which increases the probability for a need to match using regex, but
    // decreases the costs in the regular case.
-   std::unordered_map<unsigned, SmallVector<size_t, 4>> m_index{256};
+   std::unordered_map<unsigned, SmallVector<unsigned, 4>> m_index{256};
 };
 
 } // utils
@@ -0,0 +1,309 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#ifndef POLAR_UTILS_YAML_BINARY_IO_H
+#define POLAR_UTILS_YAML_BINARY_IO_H
+
+#include "polar/basic/adt/SmallVector.h"
+#include "polar/basic/adt/StringMap.h"
+#include "polar/basic/adt/StringRef.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/RawOutStream.h"
+#include "polar/utils/yaml/YamlTraits.h"
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace polar {
+namespace yaml {
+
+using polar::utils::MemoryBufferRef;
+
+/// \brief The binary counterpart of Output, for types with YAML traits.
+///
+/// BinaryOutput and BinaryInput write and read the same trees as Output and
+/// Input, through the same traits, in a compact encoding that needs no
+/// parsing. Scalars keep the text their ScalarTraits give them, so the two
+/// encodings hold the same values. A file is laid out as:
+///
+///     file     := magic value* strings trailer
+///     value    := Scalar uleb(size) bytes
+///              |  Enum uleb(string)
+///              |  BitSet uleb(count) uleb(string)*
+///              |  Sequence uleb(count) value*
+///              |  Mapping entry* 0
+///              |  TaggedMapping uleb(string) entry* 0
+///     entry    := uleb(key string + 1) uleb(size of value) value
+///     strings  := uleb(count) (uleb(size) bytes)*
+///     trailer  := le64(offset of strings) magic
+///
+/// with one value per document. Keys, tags and enumeration and bit names are
+/// interned in the string table, and the value of each mapping entry is
+/// preceded by its size, so a reader can skip what it does not look at.
+///
+/// A document is assembled in memory and written out whole, so memory use is
+/// bounded by the largest document rather than by the stream.
+class BinaryOutput : public IO
+{
+public:
+   BinaryOutput(RawOutStream &out, void *context = nullptr);
+   ~BinaryOutput() override;
+
+   bool outputting() override;
+   bool mapTag(StringRef, bool) override;
+   void beginMapping() override;
+   void endMapping() override;
+   bool preflightKey(const char *key, bool, bool, bool &, void *&) override;
+   void postflightKey(void *) override;
+   std::vector<StringRef> getKeys() override;
+   void beginFlowMapping() override;
+   void endFlowMapping() override;
+   unsigned beginSequence() override;
+   void endSequence() override;
+   bool preflightElement(unsigned, void *&) override;
+   void postflightElement(void *) override;
+   unsigned beginFlowSequence() override;
+   bool preflightFlowElement(unsigned, void *&) override;
+   void postflightFlowElement(void *) override;
+   void endFlowSequence() override;
+   void beginEnumScalar() override;
+   bool matchEnumScalar(const char*, bool) override;
+   bool matchEnumFallback() override;
+   void endEnumScalar() override;
+   bool beginBitSetScalar(bool &) override;
+   bool bitSetMatch(const char *, bool ) override;
+   void endBitSetScalar() override;
+   void scalarString(StringRef &, QuotingType) override;
+   void blockScalarString(StringRef &) override;
+   void setError(const Twine &message) override;
+   bool canElideEmptySequence() override;
+
+   // These are only used by operator<<. They could be private
+   // if that templated operator could be made a friend.
+   void beginDocuments();
+   bool preflightDocument(unsigned);
+   void postflightDocument();
+   void endDocuments();
+
+private:
+   void writeKind(uint8_t kind);
+   void writeUleb(uint64_t value);
+   void insertUleb(size_t offset, uint64_t value);
+   unsigned intern(StringRef str);
+
+   RawOutStream &m_out;
+   /// The document being written.
+   SmallVector<uint8_t, 0> m_document;
+   /// Bytes written to m_out, before the document.
+   uint64_t m_offset = 0;
+   StringMap<unsigned> m_stringIndex;
+   /// The interned strings in order, owned by m_stringIndex.
+   std::vector<StringRef> m_strings;
+   /// Where the open mappings start.
+   SmallVector<size_t, 8> m_mappings;
+   /// Where the values of the open mapping entries start.
+   SmallVector<size_t, 8> m_entryValues;
+   /// Where the element counts of the open sequences go, and the counts.
+   SmallVector<std::pair<size_t, unsigned>, 8> m_sequences;
+   SmallVector<unsigned, 8> m_bitValues;
+   bool m_enumerationMatchFound = false;
+};
+
+/// \brief Reads what a BinaryOutput wrote.
+///
+/// The input is read in place: scalars are handed out as references into it,
+/// and values which are not asked for are skipped over unread. Over a file
+/// mapped by MemoryBuffer::getFile(), only the pages holding what is read are
+/// ever touched.
+///
+/// Malformed input is reported through getError() and getErrorMessage()
+/// like any other error, never read past.
+class BinaryInput : public IO
+{
+public:
+   BinaryInput(StringRef inputContent, void *context = nullptr);
+   BinaryInput(MemoryBufferRef input, void *context = nullptr);
+   ~BinaryInput() override;
+
+   /// Checks whether there was an error in the input, or in its values.
+   std::error_code getError();
+
+   /// Returns the message of the first error, if any.
+   StringRef getErrorMessage() const
+   {
+      return m_errorMessage;
+   }
+
+   /// Returns true if \p input starts like a BinaryOutput file.
+   static bool isBinaryInput(StringRef input);
+
+private:
+   bool outputting() override;
+   bool mapTag(StringRef, bool) override;
+   void beginMapping() override;
+   void endMapping() override;
+   bool preflightKey(const char *, bool, bool, bool &, void *&) override;
+   void postflightKey(void *) override;
+   std::vector<StringRef> getKeys() override;
+   void beginFlowMapping() override;
+   void endFlowMapping() override;
+   unsigned beginSequence() override;
+   void endSequence() override;
+   bool preflightElement(unsigned index, void *&) override;
+   void postflightElement(void *) override;
+   unsigned beginFlowSequence() override;
+   bool preflightFlowElement(unsigned , void *&) override;
+   void postflightFlowElement(void *) override;
+   void endFlowSequence() override;
+   void beginEnumScalar() override;
+   bool matchEnumScalar(const char*, bool) override;
+   bool matchEnumFallback() override;
+   void endEnumScalar() override;
+   bool beginBitSetScalar(bool &) override;
+   bool bitSetMatch(const char *, bool ) override;
+   void endBitSetScalar() override;
+   void scalarString(StringRef &, QuotingType) override;
+   void blockScalarString(StringRef &) override;
+   void setError(const Twine &message) override;
+   bool canElideEmptySequence() override;
+
+public:
+   // These are only used by operator>>. They could be private
+   // if those templated things could be made friends.
+   bool setCurrentDocument();
+   bool nextDocument();
+
+private:
+   struct Entry
+   {
+      unsigned m_key;
+      const uint8_t *m_value;
+      bool m_used;
+   };
+
+   struct MappingFrame
+   {
+      const uint8_t *m_node;
+      /// The tag, or ~0U.
+      unsigned m_tag;
+      size_t m_firstEntry;
+      /// Where the next lookup starts, as keys are mostly asked for in the
+      /// order they were written.
+      size_t m_nextEntry;
+      bool m_isMapping;
+   };
+
+   struct SequenceFrame
+   {
+      const uint8_t *m_node;
+      const uint8_t *m_nextElement;
+      unsigned m_size;
+   };
+
+   void readHeader();
+   uint8_t readKind(const uint8_t *&ptr);
+   bool readUleb(const uint8_t *&ptr, uint64_t &value);
+   bool readString(const uint8_t *&ptr, unsigned &index);
+   const uint8_t *skipValue(const uint8_t *ptr, unsigned depth = 0);
+   void setMalformed();
+
+   StringRef m_input;
+   /// Where the documents end, and the string table starts.
+   const uint8_t *m_end = nullptr;
+   std::vector<StringRef> m_strings;
+   std::error_code m_errorCode;
+   std::string m_errorMessage;
+   /// The next document, and the value being read.
+   const uint8_t *m_nextDocument = nullptr;
+   const uint8_t *m_currentNode = nullptr;
+   std::vector<Entry> m_entries;
+   SmallVector<MappingFrame, 8> m_mappings;
+   SmallVector<SequenceFrame, 8> m_sequences;
+   SmallVector<std::pair<unsigned, bool>, 8> m_bitValues;
+   bool m_scalarMatchFound = false;
+};
+
+// Define non-member operator>> so that BinaryInput can read a document list.
+template <typename T>
+inline
+typename std::enable_if<HasDocumentListTraits<T>::value, BinaryInput &>::type
+operator>>(BinaryInput &in, T &docList)
+{
+   int i = 0;
+   EmptyContext context;
+   while (in.setCurrentDocument()) {
+      yamlize(in, DocumentListTraits<T>::element(in, docList, i), true, context);
+      if (in.getError()) {
+         return in;
+      }
+      in.nextDocument();
+      ++i;
+   }
+   return in;
+}
+
+// Define non-member operator>> so that BinaryInput can read any other value
+// as a document.
+template <typename T>
+inline
+typename std::enable_if<!HasDocumentListTraits<T>::value &&
+!missingTraits<T, EmptyContext>::value, BinaryInput &>::type
+operator>>(BinaryInput &in, T &value)
+{
+   EmptyContext context;
+   if (in.setCurrentDocument()) {
+      yamlize(in, value, true, context);
+   }
+   return in;
+}
+
+// Define non-member operator<< so that BinaryOutput can write a document list.
+template <typename T>
+inline
+typename std::enable_if<HasDocumentListTraits<T>::value, BinaryOutput &>::type
+operator<<(BinaryOutput &out, T &docList)
+{
+   EmptyContext context;
+   out.beginDocuments();
+   const size_t count = DocumentListTraits<T>::size(out, docList);
+   for (size_t i = 0; i < count; ++i) {
+      if (out.preflightDocument(i)) {
+         yamlize(out, DocumentListTraits<T>::element(out, docList, i), true, context);
+         out.postflightDocument();
+      }
+   }
+   out.endDocuments();
+   return out;
+}
+
+// Define non-member operator<< so that BinaryOutput can write any other value
+// as a document.
+template <typename T>
+inline
+typename std::enable_if<!HasDocumentListTraits<T>::value &&
+!missingTraits<T, EmptyContext>::value, BinaryOutput &>::type
+operator<<(BinaryOutput &out, T &value)
+{
+   EmptyContext context;
+   out.beginDocuments();
+   if (out.preflightDocument(0)) {
+      yamlize(out, value, true, context);
+      out.postflightDocument();
+   }
+   out.endDocuments();
+   return out;
+}
+
+} // yaml
+} // polar
+
+#endif // POLAR_UTILS_YAML_BINARY_IO_H
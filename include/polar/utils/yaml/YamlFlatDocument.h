@@ -0,0 +1,176 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#ifndef POLAR_UTILS_YAML_FLAT_DOCUMENT_H
+#define POLAR_UTILS_YAML_FLAT_DOCUMENT_H
+
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/basic/adt/StlExtras.h"
+#include "polar/basic/adt/StringRef.h"
+#include "polar/basic/adt/Twine.h"
+#include "polar/utils/Allocator.h"
+#include "polar/utils/yaml/YamlParser.h"
+#include <cstdint>
+#include <vector>
+
+namespace polar {
+namespace yaml {
+
+using polar::basic::ArrayRef;
+using polar::basic::FunctionRef;
+
+/// \brief A flat, read-only copy of the tree of a parsed YAML document.
+///
+/// The parser lets one walk its nodes only once, and in document order. A
+/// FlatDocument walks them once and keeps what it finds in two arrays: one
+/// of nodes, and one of the entries of all mappings and sequences, with the
+/// entries of each collection contiguous. Scalars refer to the source buffer
+/// when they need no unescaping, and to the arena of the FlatDocument when
+/// they do. Mappings are searched by key, the larger ones through a sorted
+/// index.
+///
+/// Nodes refer to the parser's nodes for tags and diagnostics, so a
+/// FlatDocument is valid as long as the Document it was built from.
+class FlatDocument
+{
+public:
+   enum class NodeKind : uint8_t
+   {
+      Empty,
+      Scalar,
+      Mapping,
+      Sequence
+   };
+
+   class FlatNode
+   {
+   public:
+      NodeKind getKind() const
+      {
+         return m_kind;
+      }
+
+      /// Returns the node of the parser this one stands for.
+      Node *getNode() const
+      {
+         return m_node;
+      }
+
+      /// Returns the value of a scalar, unescaped.
+      StringRef getValue() const
+      {
+         return m_value;
+      }
+
+      /// Returns the number of entries of a mapping or sequence.
+      unsigned getSize() const
+      {
+         return m_numEntries;
+      }
+
+   private:
+      friend class FlatDocument;
+
+      Node *m_node = nullptr;
+      StringRef m_value;
+      uint32_t m_firstEntry = 0;
+      uint32_t m_numEntries = 0;
+      /// Where the sorted index of a large mapping starts, or ~0U.
+      uint32_t m_firstIndex = ~0U;
+      NodeKind m_kind = NodeKind::Empty;
+   };
+
+   /// An entry of a mapping or sequence. The keys of sequence entries are
+   /// empty.
+   struct Entry
+   {
+      StringRef m_key;
+      uint32_t m_value;
+   };
+
+   using ErrorHandler = FunctionRef<void(Node *, const Twine &)>;
+
+   /// Scalar values which have to be unescaped or copied are kept in the
+   /// arena of the document, until the next build() or clear(), or in
+   /// \p stringAllocator if given, for values which outlive the document.
+   explicit FlatDocument(BumpPtrAllocator *stringAllocator = nullptr)
+      : m_stringAllocator(stringAllocator)
+   {}
+
+   /// Replaces the content of this document with the tree under \p root.
+   /// Mappings with keys that are not scalars or with missing values are
+   /// reported to \p onError, as are unknown nodes, and the tree is cut
+   /// short there. Returns false if that happened.
+   bool build(Node *root, ErrorHandler onError);
+
+   /// Forgets the nodes and frees the arena, keeping the arrays for reuse.
+   void clear();
+
+   /// Returns the root of the document, or nullptr before build().
+   const FlatNode *getRoot() const
+   {
+      return m_nodes.empty() ? nullptr : &m_nodes.front();
+   }
+
+   /// Returns the entries of a mapping or sequence, in document order.
+   ArrayRef<Entry> getEntries(const FlatNode &node) const
+   {
+      return ArrayRef<Entry>(m_entries.data() + node.m_firstEntry, node.m_numEntries);
+   }
+
+   /// Returns the position of \p entry among the entries of the document,
+   /// from 0 to getNumEntries().
+   unsigned getEntryIndex(const Entry &entry) const
+   {
+      return &entry - m_entries.data();
+   }
+
+   unsigned getNumEntries() const
+   {
+      return m_entries.size();
+   }
+
+   unsigned getNumNodes() const
+   {
+      return m_nodes.size();
+   }
+
+   const FlatNode &getValue(const Entry &entry) const
+   {
+      return m_nodes[entry.m_value];
+   }
+
+   /// Returns the entry of \p mapping with key \p key, the last one if the
+   /// key is repeated, or nullptr if there is none.
+   const Entry *lookup(const FlatNode &mapping, StringRef key) const;
+
+private:
+   uint32_t buildNode(Node *node, ErrorHandler onError);
+
+   BumpPtrAllocator &getStringAllocator()
+   {
+      return m_stringAllocator ? *m_stringAllocator : m_allocator;
+   }
+
+   std::vector<FlatNode> m_nodes;
+   std::vector<Entry> m_entries;
+   /// The entries of every large mapping by key, then by position.
+   std::vector<uint32_t> m_sortedEntries;
+   /// Unescaped keys, and scalar values unless m_stringAllocator is set.
+   BumpPtrAllocator m_allocator;
+   BumpPtrAllocator *m_stringAllocator;
+   bool m_failed = false;
+};
+
+} // yaml
+} // polar
+
+#endif // POLAR_UTILS_YAML_FLAT_DOCUMENT_H
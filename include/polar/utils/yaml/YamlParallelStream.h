@@ -0,0 +1,99 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#ifndef POLAR_UTILS_YAML_PARALLEL_STREAM_H
+#define POLAR_UTILS_YAML_PARALLEL_STREAM_H
+
+#include "polar/basic/adt/StlExtras.h"
+#include "polar/basic/adt/StringRef.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/Parallel.h"
+#include "polar/utils/SourceMgr.h"
+#include "polar/utils/yaml/YamlFlatDocument.h"
+#include "polar/utils/yaml/YamlParser.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace polar {
+namespace yaml {
+
+/// \brief A YAML stream whose documents are parsed concurrently.
+///
+/// The stream is cut before every "---" line, and the pieces are parsed on
+/// the thread pool, each by a Stream of its own with its own allocators, into
+/// FlatDocuments. forEachDocument() hands the documents out in order as they
+/// become ready.
+///
+/// A "---" line does not always start a document: a plain scalar at the top
+/// level runs on over it, and it may be part of a quoted scalar or of a flow
+/// collection. So a piece only counts as a document if it parsed cleanly and
+/// the piece before it ended in a collection or an empty node; from the first
+/// piece which does not, the rest of the stream is parsed in order, as Stream
+/// would. Streams with directives or "..." lines are parsed in order
+/// throughout. Either way the documents are those Stream finds.
+///
+/// The whole input is registered with the SourceMgr first, and parse errors
+/// are only ever reported from the in-order parse, so diagnostics carry the
+/// same locations as with Stream.
+class ParallelStream
+{
+public:
+   /// This keeps a reference to the string referenced by \p input.
+   ParallelStream(StringRef input, SourceMgr &sm, bool showColors = true);
+   ParallelStream(MemoryBufferRef inputBuffer, SourceMgr &sm, bool showColors = true);
+   ~ParallelStream();
+
+   /// Calls \p callback with every document of the stream, in order. A
+   /// document is valid during the call only. Stops at the first error and
+   /// returns false then, true otherwise. Can be called once.
+   bool forEachDocument(FunctionRef<void(const FlatDocument &)> callback);
+
+   /// Reports \p msg at \p node, of a document handed out by
+   /// forEachDocument().
+   void printError(Node *node, const Twine &msg);
+
+   bool failed() const
+   {
+      return m_failed;
+   }
+
+private:
+   struct Piece;
+
+   void findPieces();
+   void spawnBatch();
+   void parsePieces(size_t begin, size_t end);
+   bool parseInOrder(size_t begin, FunctionRef<void(const FlatDocument &)> callback);
+
+   MemoryBufferRef m_input;
+   SourceMgr &m_srcMgr;
+   bool m_showColors;
+   bool m_failed = false;
+   /// Where the pieces start in the input.
+   std::vector<size_t> m_starts;
+   std::unique_ptr<Piece[]> m_pieces;
+   /// Where the batches of pieces parsed by one task start, and the end.
+   std::vector<size_t> m_batchStarts;
+   size_t m_numSpawned = 0;
+   std::mutex m_mutex;
+   std::condition_variable m_pieceParsed;
+   std::atomic<bool> m_cancelled{false};
+   /// Last, so that its tasks are waited for before anything goes.
+   polar::utils::parallel::internal::TaskGroup m_tasks;
+};
+
+} // yaml
+} // polar
+
+#endif // POLAR_UTILS_YAML_PARALLEL_STREAM_H
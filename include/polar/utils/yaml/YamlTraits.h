@@ -12,6 +12,7 @@
 #ifndef POLAR_UTILS_YAML_TRAITS_H
 #define POLAR_UTILS_YAML_TRAITS_H
 
+#include "polar/basic/adt/SmallString.h"
 #include "polar/basic/adt/SmallVector.h"
 #include "polar/basic/adt/StringExtras.h"
 #include "polar/basic/adt/StringMap.h"
@@ -21,6 +22,7 @@
 #include "polar/utils/Allocator.h"
 #include "polar/utils/Endian.h"
 #include "polar/utils/SourceMgr.h"
+#include "polar/utils/yaml/YamlFlatDocument.h"
 #include "polar/utils/yaml/YamlParser.h"
 #include "polar/utils/RawOutStream.h"
 #include <cassert>
@@ -41,11 +43,14 @@ namespace polar {
 namespace yaml {
 
 using polar::basic::is_alnum;
+using polar::utils::RawFdOutStream;
 using polar::utils::RawStringOutStream;
+using polar::utils::RawSvectorOutStream;
 using polar::utils::error_stream;
 using polar::utils::internal::PackedEndianSpecificIntegral;
 using polar::utils::AlignedCharArrayUnion;
 using polar::basic::StringMap;
+using polar::basic::SmallString;
 using polar::basic::SmallVector;
 using polar::basic::SameType;
 
@@ -910,16 +915,34 @@ yamlize(IO &io, T &value, bool, EmptyContext &context) {
    }
 }
 
+namespace internal {
+
+/// Formats \p value into a buffer on the stack, which only goes to the heap
+/// for scalars longer than that. Strings are their own text, and go out
+/// without a copy.
 template <typename T>
-typename std::enable_if<HasScalarTraits<T>::value, void>::type
-yamlize(IO &io, T &value, bool, EmptyContext &context)
+void output_scalar(IO &io, T &value)
 {
-   if ( io.outputting() ) {
-      std::string storage;
-      RawStringOutStream buffer(storage);
+   if constexpr (std::is_same<T, StringRef>::value || std::is_same<T, std::string>::value) {
+      StringRef str = value;
+      io.scalarString(str, ScalarTraits<T>::mustQuote(str));
+   } else {
+      SmallString<128> storage;
+      RawSvectorOutStream buffer(storage);
       ScalarTraits<T>::output(value, io.getContext(), buffer);
       StringRef str = buffer.getStr();
       io.scalarString(str, ScalarTraits<T>::mustQuote(str));
+   }
+}
+
+} // end namespace internal
+
+template <typename T>
+typename std::enable_if<HasScalarTraits<T>::value, void>::type
+yamlize(IO &io, T &value, bool, EmptyContext &context)
+{
+   if ( io.outputting() ) {
+      internal::output_scalar(io, value);
    } else {
       StringRef str;
       io.scalarString(str, ScalarTraits<T>::mustQuote(str));
@@ -935,10 +958,11 @@ typename std::enable_if<HasBlockScalarTraits<T>::value, void>::type
 yamlize(IO &yamlIo, T &value, bool, EmptyContext &context)
 {
    if (yamlIo.outputting()) {
-      std::string storage;
-      RawStringOutStream buffer(storage);
+      SmallString<128> storage;
+      RawSvectorOutStream buffer(storage);
       BlockScalarTraits<T>::output(value, yamlIo.getContext(), buffer);
-      StringRef str = buffer.getStr();
+      // Output splits the lines with a LineIterator, which needs the null.
+      StringRef str(storage.getCStr(), storage.getSize());
       yamlIo.blockScalarString(str);
    } else {
       StringRef str;
@@ -1301,12 +1325,12 @@ private:
 /// and vectors.
 ///
 /// It works by using YAMLParser to do a syntax parse of the entire yaml
-/// document, then the Input class builds a graph of HNodes which wraps
-/// each yaml Node.  The extra layer is buffering.  The low level yaml
-/// parser only lets you look at each node once.  The buffering layer lets
-/// you search and interate multiple times.  This is necessary because
-/// the mapRequired() method calls may not be in the same order
-/// as the getKeys in the document.
+/// document, then the Input class copies the tree into a FlatDocument.
+/// The extra layer is buffering.  The low level yaml parser only lets you
+/// look at each node once.  The buffering layer lets you search and
+/// interate multiple times.  This is necessary because the mapRequired()
+/// method calls may not be in the same order as the getKeys in the
+/// document.
 ///
 class Input : public IO
 {
@@ -1357,114 +1381,9 @@ private:
    void setError(const Twine &message) override;
    bool canElideEmptySequence() override;
 
-   class HNode
-   {
-      virtual void anchor();
-
-   public:
-      HNode(Node *node) : m_node(node)
-      {}
-      virtual ~HNode() = default;
-
-      static bool classof(const HNode *)
-      {
-         return true;
-      }
-
-      Node *m_node;
-   };
-
-   class EmptyHNode : public HNode
-   {
-      void anchor() override;
-
-   public:
-      EmptyHNode(Node *node) : HNode(node)
-      {}
-
-      static bool classof(const HNode *node)
-      {
-         return NullNode::classof(node->m_node);
-      }
-
-      static bool classof(const EmptyHNode *)
-      {
-         return true;
-      }
-   };
-
-   class ScalarHNode : public HNode
-   {
-      void anchor() override;
-
-   public:
-      ScalarHNode(Node *node, StringRef str) : HNode(node), m_value(str)
-      {}
-
-      StringRef value() const { return m_value; }
+   using FlatNode = FlatDocument::FlatNode;
 
-      static bool classof(const HNode *node)
-      {
-         return ScalarNode::classof(node->m_node) ||
-               BlockScalarNode::classof(node->m_node);
-      }
-
-      static bool classof(const ScalarHNode *)
-      {
-         return true;
-      }
-
-   protected:
-      StringRef m_value;
-   };
-
-   class MapHNode : public HNode
-   {
-      void anchor() override;
-
-   public:
-      MapHNode(Node *node) : HNode(node)
-      {}
-
-      static bool classof(const HNode *node)
-      {
-         return MappingNode::classof(node->m_node);
-      }
-
-      static bool classof(const MapHNode *)
-      {
-         return true;
-      }
-
-      using NameToNode = StringMap<std::unique_ptr<HNode>>;
-
-      NameToNode m_mapping;
-      SmallVector<std::string, 6> m_validKeys;
-   };
-
-   class SequenceHNode : public HNode
-   {
-      void anchor() override;
-
-   public:
-      SequenceHNode(Node *node) : HNode(node)
-      {}
-
-      static bool classof(const HNode *node)
-      {
-         return SequenceNode::classof(node->m_node);
-      }
-
-      static bool classof(const SequenceHNode *)
-      {
-         return true;
-      }
-
-      std::vector<std::unique_ptr<HNode>> m_entries;
-   };
-
-   std::unique_ptr<Input::HNode> createHNodes(Node *node);
-   void setError(HNode *hnode, const Twine &message);
+   void setError(const FlatNode *node, const Twine &message);
    void setError(Node *node, const Twine &message);
 
 public:
@@ -1479,12 +1398,17 @@ public:
 private:
    SourceMgr                           m_srcMgr; // must be before m_strm
    std::unique_ptr<polar::yaml::Stream> m_strm;
-   std::unique_ptr<HNode>              m_topNode;
-   std::error_code                     m_errorCode;
+   /// Scalars handed out by scalarString() and blockScalarString() stay
+   /// valid as long as the Input, across documents.
    BumpPtrAllocator                    m_stringAllocator;
+   FlatDocument                        m_document{&m_stringAllocator};
+   std::error_code                     m_errorCode;
    DocumentIterator                   m_docIterator;
    std::vector<bool>                   m_bitValuesUsed;
-   HNode *m_currentNode = nullptr;
+   /// Which entries of m_document were asked for by key, per mapping since
+   /// its beginMapping().
+   std::vector<bool>                   m_keysUsed;
+   const FlatNode *m_currentNode = nullptr;
    bool                                m_scalarMatchFound;
 };
 
@@ -1496,8 +1420,14 @@ class Output : public IO
 {
 public:
    Output(RawOutStream &, void *context = nullptr, int wrapColumn = 70);
+   /// Writes to a file in large blocks: a buffered \p out gets a buffer of
+   /// at least FdBufferSize bytes while the Output lives. Terminals stay
+   /// unbuffered.
+   Output(RawFdOutStream &out, void *context = nullptr, int wrapColumn = 70);
    ~Output() override;
 
+   enum { FdBufferSize = 256 * 1024 };
+
    /// Set whether or not to output optional values which are equal
    /// to the default value.  By default, when outputting if you attempt
    /// to write a value that is equal to the default, the value gets ignored.
@@ -1537,8 +1467,8 @@ public:
    void setError(const Twine &message) override;
    bool canElideEmptySequence() override;
 
-   // These are only used by operator<<. They could be private
-   // if that templated operator could be made a friend.
+   // These are only used by operator<< and SequenceWriter. They could be
+   // private if that templated operator could be made a friend.
    void beginDocuments();
    bool preflightDocument(unsigned);
    void postflightDocument();
@@ -1549,6 +1479,7 @@ private:
    void outputUpToEndOfLine(StringRef s);
    void newLineCheck();
    void outputNewLine();
+   void outputIndent(unsigned numSpaces);
    void paddedKey(StringRef key);
    void flowKey(StringRef Key);
 
@@ -1562,6 +1493,8 @@ private:
    };
 
    RawOutStream &m_out;
+   /// The buffer size of m_out to restore, if it was raised.
+   size_t m_savedBufferSize = 0;
    int m_wrapColumn;
    SmallVector<InState, 8> m_stateStack;
    int m_column = 0;
@@ -1811,6 +1744,74 @@ operator<<(Output &yout, T &seq)
    return yout;
 }
 
+/// Writes a document holding a block sequence one element at a time, so that
+/// the elements need not all be in memory at once. The text is the same as
+/// that of the whole sequence written with operator<<:
+///
+///     yaml::Output yout(file);
+///     yaml::SequenceWriter writer(yout);
+///     while (readRecord(record)) {
+///       writer.write(record);
+///     }
+///     writer.finish();
+class SequenceWriter
+{
+public:
+   explicit SequenceWriter(Output &out)
+      : m_out(out)
+   {
+      m_out.beginDocuments();
+      m_out.preflightDocument(0);
+      m_out.beginSequence();
+   }
+
+   ~SequenceWriter()
+   {
+      finish();
+   }
+
+   template <typename T>
+   void write(T &element)
+   {
+      EmptyContext context;
+      write(element, context);
+   }
+
+   template <typename T, typename Context>
+   void write(T &element, Context &context)
+   {
+      assert(!m_finished && "writing to a finished sequence");
+      void *saveInfo;
+      if (m_out.preflightElement(m_numElements, saveInfo)) {
+         yamlize(m_out, element, true, context);
+         m_out.postflightElement(saveInfo);
+      }
+      ++m_numElements;
+   }
+
+   /// Ends the sequence and the document. Nothing is written after.
+   void finish()
+   {
+      if (m_finished) {
+         return;
+      }
+      m_finished = true;
+      m_out.endSequence();
+      m_out.postflightDocument();
+      m_out.endDocuments();
+   }
+
+   unsigned getNumElements() const
+   {
+      return m_numElements;
+   }
+
+private:
+   Output &m_out;
+   unsigned m_numElements = 0;
+   bool m_finished = false;
+};
+
 template <bool B> struct IsFlowSequenceBase
 {};
 
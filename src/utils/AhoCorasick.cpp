@@ -0,0 +1,99 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/AhoCorasick.h"
+#include <algorithm>
+#include <deque>
+
+namespace polar {
+namespace utils {
+
+void AhoCorasick::insert(StringRef literal, unsigned id)
+{
+   if (literal.empty()) {
+      return;
+   }
+   m_literals.emplace_back(literal.getStr(), id);
+   m_built = false;
+}
+
+void AhoCorasick::build()
+{
+   // Bytes are numbered by first appearance; class 0 stands for every byte
+   // that appears in no literal and always leads back to the root.
+   std::fill(std::begin(m_classes), std::end(m_classes), 0);
+   m_numClasses = 0;
+   for (const auto &literal : m_literals) {
+      for (unsigned char c : literal.first) {
+         if (!m_classes[c]) {
+            m_classes[c] = ++m_numClasses;
+         }
+      }
+   }
+
+   // Build the trie. Row s of m_delta holds the goto function of state s,
+   // with 0 (the root) standing for "no edge" until failure links are known.
+   m_states.assign(1, State());
+   m_delta.assign(m_numClasses, 0);
+   std::vector<std::vector<unsigned>> stateOutputs(1);
+   for (const auto &literal : m_literals) {
+      uint32_t state = 0;
+      for (unsigned char c : literal.first) {
+         uint32_t &next = m_delta[state * m_numClasses + m_classes[c] - 1];
+         if (!next) {
+            next = m_states.size();
+            m_states.emplace_back();
+            stateOutputs.emplace_back();
+            m_delta.resize(m_delta.size() + m_numClasses, 0);
+         }
+         // m_delta may have been reallocated.
+         state = m_delta[state * m_numClasses + m_classes[c] - 1];
+      }
+      stateOutputs[state].push_back(literal.second);
+   }
+
+   // Breadth first, turn the trie into a DFA: missing edges of a state are
+   // those of its failure state, which is shallower and therefore complete.
+   std::vector<uint32_t> failure(m_states.size(), 0);
+   std::deque<uint32_t> queue;
+   for (unsigned byteClass = 0; byteClass < m_numClasses; ++byteClass) {
+      if (uint32_t child = m_delta[byteClass]) {
+         queue.push_back(child);
+      }
+   }
+   while (!queue.empty()) {
+      uint32_t state = queue.front();
+      queue.pop_front();
+      uint32_t fail = failure[state];
+      m_states[state].m_outputLink = m_states[fail].m_hasOutput ? fail : m_states[fail].m_outputLink;
+      m_states[state].m_hasOutput = !stateOutputs[state].empty();
+      for (unsigned byteClass = 0; byteClass < m_numClasses; ++byteClass) {
+         uint32_t &next = m_delta[state * m_numClasses + byteClass];
+         uint32_t viaFailure = m_delta[fail * m_numClasses + byteClass];
+         if (next) {
+            failure[next] = viaFailure;
+            queue.push_back(next);
+         } else {
+            next = viaFailure;
+         }
+      }
+   }
+   m_outputs.clear();
+   for (uint32_t state = 0; state < m_states.size(); ++state) {
+      m_states[state].m_outputBegin = m_outputs.size();
+      m_outputs.insert(m_outputs.end(), stateOutputs[state].begin(), stateOutputs[state].end());
+      m_states[state].m_outputEnd = m_outputs.size();
+   }
+   m_built = true;
+}
+
+} // utils
+} // polar
@@ -0,0 +1,394 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+//===----------------------------------------------------------------------===//
+//
+// This follows the structure of the BLAKE3 reference implementation
+// (https://github.com/BLAKE3-team/BLAKE3, CC0 / Apache-2.0): a chunk state
+// absorbing the current 1 KiB chunk and a lazily merged stack of subtree
+// chaining values.
+//
+//===----------------------------------------------------------------------===//
+
+#include "polar/utils/Blake3.h"
+#include "polar/utils/Endian.h"
+#include "polar/utils/MathExtras.h"
+#include "polar/utils/Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace polar {
+namespace utils {
+
+namespace {
+
+enum : uint8_t {
+   CHUNK_START = 1 << 0,
+   CHUNK_END = 1 << 1,
+   PARENT = 1 << 2,
+   ROOT = 1 << 3
+};
+
+constexpr size_t BLOCK_LENGTH = 64;
+constexpr size_t CHUNK_LENGTH = 1024;
+
+const uint32_t sg_iv[8] = {
+   0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+   0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+const uint8_t sg_messageSchedule[7][16] = {
+   {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+   {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+   {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+   {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+   {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+   {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+   {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+inline uint32_t rotr(uint32_t value, int bits)
+{
+   return (value >> bits) | (value << (32 - bits));
+}
+
+inline void mix(uint32_t *state, int a, int b, int c, int d, uint32_t x, uint32_t y)
+{
+   state[a] = state[a] + state[b] + x;
+   state[d] = rotr(state[d] ^ state[a], 16);
+   state[c] = state[c] + state[d];
+   state[b] = rotr(state[b] ^ state[c], 12);
+   state[a] = state[a] + state[b] + y;
+   state[d] = rotr(state[d] ^ state[a], 8);
+   state[c] = state[c] + state[d];
+   state[b] = rotr(state[b] ^ state[c], 7);
+}
+
+/// The BLAKE3 compression function; writes all 16 output words.
+void compress(const uint32_t cv[8], const uint8_t block[BLOCK_LENGTH],
+              uint8_t blockLength, uint64_t counter, uint8_t flags,
+              uint32_t out[16])
+{
+   uint32_t message[16];
+   for (int i = 0; i < 16; ++i) {
+      message[i] = endian::read32le(block + 4 * i);
+   }
+   uint32_t state[16] = {
+      cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+      sg_iv[0], sg_iv[1], sg_iv[2], sg_iv[3],
+      uint32_t(counter), uint32_t(counter >> 32), blockLength, flags
+   };
+   for (const uint8_t *schedule : sg_messageSchedule) {
+      mix(state, 0, 4, 8, 12, message[schedule[0]], message[schedule[1]]);
+      mix(state, 1, 5, 9, 13, message[schedule[2]], message[schedule[3]]);
+      mix(state, 2, 6, 10, 14, message[schedule[4]], message[schedule[5]]);
+      mix(state, 3, 7, 11, 15, message[schedule[6]], message[schedule[7]]);
+      mix(state, 0, 5, 10, 15, message[schedule[8]], message[schedule[9]]);
+      mix(state, 1, 6, 11, 12, message[schedule[10]], message[schedule[11]]);
+      mix(state, 2, 7, 8, 13, message[schedule[12]], message[schedule[13]]);
+      mix(state, 3, 4, 9, 14, message[schedule[14]], message[schedule[15]]);
+   }
+   for (int i = 0; i < 8; ++i) {
+      out[i] = state[i] ^ state[i + 8];
+      out[i + 8] = state[i + 8] ^ cv[i];
+   }
+}
+
+} // anonymous namespace
+
+namespace internal {
+
+/// A node whose compression has been set up but not yet run, so the caller
+/// can still decide whether it is the root of the tree.
+struct Blake3Output
+{
+   uint32_t m_cv[8];
+   uint8_t m_block[BLOCK_LENGTH];
+   uint8_t m_blockLength;
+   uint64_t m_counter;
+   uint8_t m_flags;
+
+   static Blake3Output parent(const uint32_t left[8], const uint32_t right[8])
+   {
+      Blake3Output output;
+      std::memcpy(output.m_cv, sg_iv, sizeof(sg_iv));
+      for (int i = 0; i < 8; ++i) {
+         endian::write32le(output.m_block + 4 * i, left[i]);
+         endian::write32le(output.m_block + 32 + 4 * i, right[i]);
+      }
+      output.m_blockLength = BLOCK_LENGTH;
+      output.m_counter = 0;
+      output.m_flags = PARENT;
+      return output;
+   }
+
+   void getChainingValue(uint32_t out[8]) const
+   {
+      uint32_t words[16];
+      compress(m_cv, m_block, m_blockLength, m_counter, m_flags, words);
+      std::memcpy(out, words, 8 * sizeof(uint32_t));
+   }
+
+   void getRootBytes(uint8_t *out, size_t size) const
+   {
+      uint32_t words[16];
+      compress(m_cv, m_block, m_blockLength, 0, m_flags | ROOT, words);
+      for (size_t i = 0; i < size / 4; ++i) {
+         endian::write32le(out + 4 * i, words[i]);
+      }
+   }
+};
+
+void Blake3ChunkState::reset(uint64_t chunkCounter)
+{
+   std::memcpy(m_cv, sg_iv, sizeof(sg_iv));
+   m_chunkCounter = chunkCounter;
+   m_bufferLength = 0;
+   m_blocksCompressed = 0;
+}
+
+size_t Blake3ChunkState::getLength() const
+{
+   return BLOCK_LENGTH * size_t(m_blocksCompressed) + m_bufferLength;
+}
+
+void Blake3ChunkState::update(const uint8_t *data, size_t size)
+{
+   while (size) {
+      // The last block of a chunk is compressed with CHUNK_END by
+      // getOutput(), so a full buffer is only flushed once more input shows
+      // up.
+      if (m_bufferLength == BLOCK_LENGTH) {
+         uint32_t words[16];
+         compress(m_cv, m_buffer, BLOCK_LENGTH, m_chunkCounter,
+                  m_blocksCompressed ? 0 : CHUNK_START, words);
+         std::memcpy(m_cv, words, sizeof(m_cv));
+         ++m_blocksCompressed;
+         m_bufferLength = 0;
+      }
+      size_t take = std::min(size, BLOCK_LENGTH - m_bufferLength);
+      std::memcpy(m_buffer + m_bufferLength, data, take);
+      m_bufferLength += take;
+      data += take;
+      size -= take;
+   }
+}
+
+Blake3Output Blake3ChunkState::getOutput() const
+{
+   Blake3Output output;
+   std::memcpy(output.m_cv, m_cv, sizeof(m_cv));
+   std::memset(output.m_block, 0, BLOCK_LENGTH);
+   std::memcpy(output.m_block, m_buffer, m_bufferLength);
+   output.m_blockLength = m_bufferLength;
+   output.m_counter = m_chunkCounter;
+   output.m_flags = CHUNK_END | (m_blocksCompressed ? 0 : CHUNK_START);
+   return output;
+}
+
+} // internal
+
+namespace {
+
+using internal::Blake3ChunkState;
+using internal::Blake3Output;
+
+void parent_chaining_value(const uint32_t left[8], const uint32_t right[8],
+                           uint32_t out[8])
+{
+   Blake3Output::parent(left, right).getChainingValue(out);
+}
+
+/// Chaining value of a single, complete, non-root chunk.
+void chunk_chaining_value(const uint8_t *data, size_t size,
+                          uint64_t chunkCounter, uint32_t out[8])
+{
+   Blake3ChunkState chunk;
+   chunk.reset(chunkCounter);
+   chunk.update(data, size);
+   chunk.getOutput().getChainingValue(out);
+}
+
+/// Chaining value of a complete subtree of a power-of-two number of chunks
+/// starting at \p chunkCounter. Runs on the calling thread.
+void subtree_chaining_value(const uint8_t *data, size_t size,
+                            uint64_t chunkCounter, uint32_t out[8])
+{
+   uint32_t stack[64][8];
+   size_t depth = 0;
+   for (uint64_t chunk = 0; chunk * CHUNK_LENGTH < size; ++chunk) {
+      chunk_chaining_value(data + chunk * CHUNK_LENGTH, CHUNK_LENGTH,
+                           chunkCounter + chunk, stack[depth]);
+      ++depth;
+      // Every trailing one bit of the chunk index closes a complete subtree.
+      for (uint64_t total = chunk + 1; (total & 1) == 0; total >>= 1) {
+         --depth;
+         parent_chaining_value(stack[depth - 1], stack[depth], stack[depth - 1]);
+      }
+   }
+   std::memcpy(out, stack[0], 8 * sizeof(uint32_t));
+}
+
+/// Chaining values of the left and right halves of a complete subtree of at
+/// least two chunks. The halves are kept apart because, if nothing follows
+/// them, they merge into the root node rather than into a chaining value.
+void subtree_halves(const uint8_t *data, size_t size, uint64_t chunkCounter,
+                    uint32_t left[8], uint32_t right[8])
+{
+   size_t half = size / 2;
+   if (size < Blake3::getParallelThreshold()) {
+      subtree_chaining_value(data, half, chunkCounter, left);
+      subtree_chaining_value(data + half, half, chunkCounter + half / CHUNK_LENGTH,
+                             right);
+      return;
+   }
+   // Hash equally sized leaf subtrees on the thread pool, then fold their
+   // chaining values level by level until only the two halves remain.
+   size_t leafSize = std::max<size_t>(16 * CHUNK_LENGTH, size / 64);
+   size_t numLeaves = size / leafSize;
+   std::vector<std::array<uint32_t, 8>> cvs(numLeaves);
+   parallel::for_each_n(parallel::par, size_t(0), numLeaves, [&](size_t leaf) {
+      subtree_chaining_value(data + leaf * leafSize, leafSize,
+                             chunkCounter + leaf * (leafSize / CHUNK_LENGTH),
+                             cvs[leaf].data());
+   });
+   for (; numLeaves > 2; numLeaves /= 2) {
+      for (size_t i = 0; i < numLeaves / 2; ++i) {
+         parent_chaining_value(cvs[2 * i].data(), cvs[2 * i + 1].data(),
+                               cvs[i].data());
+      }
+   }
+   std::memcpy(left, cvs[0].data(), 8 * sizeof(uint32_t));
+   std::memcpy(right, cvs[1].data(), 8 * sizeof(uint32_t));
+}
+
+} // anonymous namespace
+
+void Blake3::init()
+{
+   m_chunk.reset(0);
+   m_cvStackLength = 0;
+}
+
+void Blake3::mergeChainingValues(uint64_t totalChunks)
+{
+   // A tree of N chunks has one complete subtree per set bit of N; anything
+   // above that on the stack can be merged now that more input has arrived.
+   size_t postMergeLength = count_population(totalChunks);
+   while (m_cvStackLength > postMergeLength) {
+      --m_cvStackLength;
+      parent_chaining_value(m_cvStack[m_cvStackLength - 1],
+                            m_cvStack[m_cvStackLength],
+                            m_cvStack[m_cvStackLength - 1]);
+   }
+}
+
+void Blake3::pushChainingValue(const uint32_t cv[8], uint64_t chunkCounter)
+{
+   mergeChainingValues(chunkCounter);
+   std::memcpy(m_cvStack[m_cvStackLength++], cv, 8 * sizeof(uint32_t));
+}
+
+void Blake3::update(ArrayRef<uint8_t> data)
+{
+   const uint8_t *ptr = data.getData();
+   size_t size = data.getSize();
+
+   // Finish a partially absorbed chunk first. It is only known not to be the
+   // root once more input follows it.
+   if (m_chunk.getLength()) {
+      size_t take = std::min(size, CHUNK_LENGTH - m_chunk.getLength());
+      m_chunk.update(ptr, take);
+      ptr += take;
+      size -= take;
+      if (!size) {
+         return;
+      }
+      uint32_t cv[8];
+      m_chunk.getOutput().getChainingValue(cv);
+      pushChainingValue(cv, m_chunk.m_chunkCounter);
+      m_chunk.reset(m_chunk.m_chunkCounter + 1);
+   }
+
+   // Hash the largest complete subtrees the tree shape allows, always keeping
+   // at least one byte back for the chunk state so that finalization can tell
+   // which node is the root.
+   while (size > CHUNK_LENGTH) {
+      uint64_t subtreeSize = power_of_two_floor(size);
+      uint64_t bytesSoFar = m_chunk.m_chunkCounter * CHUNK_LENGTH;
+      while (((subtreeSize - 1) & bytesSoFar) != 0) {
+         subtreeSize /= 2;
+      }
+      uint64_t subtreeChunks = subtreeSize / CHUNK_LENGTH;
+      if (subtreeSize <= CHUNK_LENGTH) {
+         uint32_t cv[8];
+         chunk_chaining_value(ptr, subtreeSize, m_chunk.m_chunkCounter, cv);
+         pushChainingValue(cv, m_chunk.m_chunkCounter);
+      } else {
+         uint32_t left[8];
+         uint32_t right[8];
+         subtree_halves(ptr, subtreeSize, m_chunk.m_chunkCounter, left, right);
+         pushChainingValue(left, m_chunk.m_chunkCounter);
+         pushChainingValue(right, m_chunk.m_chunkCounter + subtreeChunks / 2);
+      }
+      m_chunk.m_chunkCounter += subtreeChunks;
+      ptr += subtreeSize;
+      size -= subtreeSize;
+   }
+
+   if (size) {
+      m_chunk.update(ptr, size);
+      mergeChainingValues(m_chunk.m_chunkCounter);
+   }
+}
+
+StringRef Blake3::final()
+{
+   // With no subtrees on the stack the current chunk is the root.
+   if (m_cvStackLength == 0) {
+      m_chunk.getOutput().getRootBytes(m_hashResult, HASH_LENGTH);
+      return StringRef((char *)m_hashResult, HASH_LENGTH);
+   }
+   // Otherwise roll the current chunk (or, if it is empty, the top two
+   // stack entries) up through every subtree on the stack.
+   Blake3Output output;
+   size_t remaining;
+   if (m_chunk.getLength()) {
+      remaining = m_cvStackLength;
+      output = m_chunk.getOutput();
+   } else {
+      remaining = m_cvStackLength - 2;
+      output = Blake3Output::parent(m_cvStack[remaining], m_cvStack[remaining + 1]);
+   }
+   while (remaining) {
+      --remaining;
+      uint32_t cv[8];
+      output.getChainingValue(cv);
+      output = Blake3Output::parent(m_cvStack[remaining], cv);
+   }
+   output.getRootBytes(m_hashResult, HASH_LENGTH);
+   return StringRef((char *)m_hashResult, HASH_LENGTH);
+}
+
+std::array<uint8_t, 32> Blake3::hash(ArrayRef<uint8_t> data)
+{
+   Blake3 hash;
+   hash.update(data);
+   StringRef str = hash.final();
+   std::array<uint8_t, 32> array;
+   std::memcpy(array.data(), str.getData(), str.getSize());
+   return array;
+}
+
+} // utils
+} // polar
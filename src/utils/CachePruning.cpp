@@ -10,24 +10,226 @@
 // Created by softboy on 2018/07/03.
 
 #include "polar/utils/CachePruning.h"
+#include "polar/basic/adt/IteratorRange.h"
+#include "polar/basic/adt/StringMap.h"
 #include "polar/utils/Debug.h"
+#include "polar/utils/DirectoryWalker.h"
+#include "polar/utils/Endian.h"
 #include "polar/utils/ErrorCode.h"
 #include "polar/utils/ErrorType.h"
+#include "polar/utils/FastHash.h"
 #include "polar/utils/FileSystem.h"
+#include "polar/utils/LockFileMgr.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/Parallel.h"
 #include "polar/utils/Path.h"
+#include "polar/utils/Process.h"
 #include "polar/utils/RawOutStream.h"
+#include <algorithm>
+#include <memory>
 #include <set>
+#include <string>
 #include <system_error>
+#include <vector>
 
 #define DEBUG_TYPE "cache-pruning"
 
 namespace polar {
 namespace utils {
 
-
+using polar::basic::StringMap;
+using polar::basic::StringMapEntry;
 
 namespace {
 
+const char sg_indexFilename[] = "polarcache.index";
+
+/// Index records are a little endian header, the checksum of the rest of the
+/// record, the length of the file name, the kind of record, a reserved byte,
+/// the access time in seconds and the size of the file, followed by the file
+/// name relative to the cache directory.
+enum : uint8_t
+{
+   RECORD_ACCESS = 1,
+   RECORD_REMOVAL = 2
+};
+
+enum
+{
+   RECORD_HEADER_SIZE = 24
+};
+
+struct IndexedFile
+{
+   int64_t m_time;
+   uint64_t m_size;
+};
+
+/// Files the index may name: like those prune_cache() scans, whose names
+/// start with "polarcache-", possibly in subdirectories of the cache.
+bool is_cache_file_name(StringRef filename)
+{
+   if (filename.empty() || polar::fs::path::is_absolute(filename) ||
+       !polar::fs::path::filename(filename).startsWith("polarcache-")) {
+      return false;
+   }
+   for (StringRef component : polar::basic::make_range(polar::fs::path::begin(filename),
+                                                       polar::fs::path::end(filename))) {
+      if (component == "..") {
+         return false;
+      }
+   }
+   return filename.size() <= UINT16_MAX;
+}
+
+int64_t to_index_time(TimePoint<> time)
+{
+   return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+void encode_index_record(SmallVectorImpl<char> &buffer, uint8_t kind, StringRef filename,
+                         int64_t time, uint64_t size)
+{
+   size_t start = buffer.size();
+   buffer.resize(start + RECORD_HEADER_SIZE);
+   buffer.append(filename.begin(), filename.end());
+   char *record = buffer.getData() + start;
+   endian::write16le(record + 4, filename.size());
+   record[6] = kind;
+   record[7] = 0;
+   endian::write64le(record + 8, time);
+   endian::write64le(record + 16, size);
+   StringRef checked(record + 4, RECORD_HEADER_SIZE - 4 + filename.size());
+   endian::write32le(record, static_cast<uint32_t>(xxh3_hash64(checked)));
+}
+
+/// Applies the records of \p data from \p offset on to \p files. Stops at
+/// the first truncated or corrupt record, and returns the offset after the
+/// last record applied.
+size_t replay_index(StringRef data, size_t offset, StringMap<IndexedFile> &files)
+{
+   while (data.size() - offset >= RECORD_HEADER_SIZE) {
+      const char *record = data.getData() + offset;
+      size_t length = RECORD_HEADER_SIZE + endian::read16le(record + 4);
+      if (data.size() - offset < length ||
+          endian::read32le(record) !=
+          static_cast<uint32_t>(xxh3_hash64(StringRef(record + 4, length - 4)))) {
+         break;
+      }
+      StringRef filename(record + RECORD_HEADER_SIZE, length - RECORD_HEADER_SIZE);
+      if (record[6] == RECORD_ACCESS) {
+         // Batched records may be appended after more recent ones.
+         int64_t time = static_cast<int64_t>(endian::read64le(record + 8));
+         auto inserted = files.insert(std::make_pair(filename, IndexedFile{time, 0}));
+         IndexedFile &file = inserted.first->getValue();
+         if (inserted.second || time >= file.m_time) {
+            file.m_time = time;
+            file.m_size = endian::read64le(record + 16);
+         }
+      } else if (record[6] == RECORD_REMOVAL) {
+         files.erase(filename);
+      }
+      offset += length;
+   }
+   return offset;
+}
+
+/// Appends \p records to the index \p indexPath by a single write. A prune
+/// may replace the index between the open and the write, after it last read
+/// the old one, so the records are appended again to the new index: replaying
+/// a record twice does no harm.
+std::error_code append_index_records(StringRef indexPath, StringRef records)
+{
+   for (;;) {
+      int fd;
+      if (std::error_code errorCode = polar::fs::open_file_for_write(indexPath, fd,
+                                                                    polar::fs::F_Append)) {
+         return errorCode;
+      }
+      // Unbuffered, so that the records go out in one write to the end of the
+      // file, whoever else appends.
+      RawFdOutStream outstream(fd, /*shouldClose=*/true, /*unbuffered=*/true);
+      outstream.write(records.getData(), records.size());
+      polar::fs::FileStatus written;
+      std::error_code statusError = polar::fs::status(fd, written);
+      outstream.close();
+      if (outstream.hasError()) {
+         std::error_code errorCode = outstream.getErrorCode();
+         outstream.clearError();
+         return errorCode;
+      }
+      polar::fs::FileStatus current;
+      if (statusError || polar::fs::status(indexPath, current) ||
+          polar::fs::equivalent(written, current)) {
+         return std::error_code();
+      }
+   }
+}
+
+std::error_code append_index_record(StringRef path, uint8_t kind, StringRef filename,
+                                    int64_t time, uint64_t size)
+{
+   if (!is_cache_file_name(filename)) {
+      return std::make_error_code(std::errc::invalid_argument);
+   }
+   SmallString<128> indexPath(path);
+   polar::fs::path::append(indexPath, sg_indexFilename);
+   SmallString<128> record;
+   encode_index_record(record, kind, filename, time, size);
+   return append_index_records(indexPath, record);
+}
+
+/// Builds the index of a cache from the files it holds.
+void scan_cache_directory(StringRef path, StringMap<IndexedFile> &files)
+{
+   polar::fs::WalkOptions options;
+   options.m_needStatus = true;
+   polar::fs::walk_directory_tree(path, options, [&](const polar::fs::WalkEntry &entry) {
+      const polar::fs::FileStatus *status = entry.getStatus();
+      if (!status || entry.getType() != polar::fs::FileType::regular_file ||
+          !is_cache_file_name(entry.getRelativePath())) {
+         return;
+      }
+      IndexedFile &file = files[entry.getRelativePath()];
+      file.m_time = to_index_time(status->getLastAccessedTime());
+      file.m_size = status->getSize();
+   });
+}
+
+/// Writes the index of the files left after pruning over the old one.
+/// Returns false if the old index was left in place.
+bool write_index_snapshot(StringRef path, const StringMap<IndexedFile> &files)
+{
+   SmallString<128> indexPath(path);
+   polar::fs::path::append(indexPath, sg_indexFilename);
+   SmallString<128> tempPath;
+   int fd;
+   if (polar::fs::create_unique_file(indexPath + "-%%%%%%", fd, tempPath)) {
+      return false;
+   }
+   {
+      RawFdOutStream outstream(fd, /*shouldClose=*/true);
+      SmallString<128> record;
+      for (const auto &file : files) {
+         record.clear();
+         encode_index_record(record, RECORD_ACCESS, file.getKey(), file.getValue().m_time,
+                             file.getValue().m_size);
+         outstream.write(record.getData(), record.size());
+      }
+      outstream.close();
+      if (outstream.hasError()) {
+         outstream.clearError();
+         polar::fs::remove(tempPath);
+         return false;
+      }
+   }
+   if (polar::fs::rename(tempPath, indexPath)) {
+      polar::fs::remove(tempPath);
+      return false;
+   }
+   return true;
+}
+
 /// Write a new timestamp file with the given path. This is used for the pruning
 /// interval option.
 static void write_timestamp_file(StringRef timestampFile)
@@ -131,6 +333,15 @@ parse_cache_pruning_policy(StringRef policyStr)
                                            inconvertible_error_code());
          }
 
+      } else if (key == "index") {
+         if (value == "1" || value == "true") {
+            policy.m_useIndex = true;
+         } else if (value == "0" || value == "false") {
+            policy.m_useIndex = false;
+         } else {
+            return make_error<StringError>("'" + value + "' must be 0, 1, true or false",
+                                           inconvertible_error_code());
+         }
       } else {
          return make_error<StringError>("Unknown key: '" + key + "'",
                                         inconvertible_error_code());
@@ -140,6 +351,199 @@ parse_cache_pruning_policy(StringRef policyStr)
    return policy;
 }
 
+std::error_code record_cache_access(StringRef path, StringRef filename, uint64_t size,
+                                    TimePoint<> accessTime)
+{
+   return append_index_record(path, RECORD_ACCESS, filename, to_index_time(accessTime), size);
+}
+
+std::error_code record_cache_accesses(StringRef path, polar::basic::ArrayRef<CacheAccess> accesses)
+{
+   SmallString<1024> records;
+   for (const CacheAccess &access : accesses) {
+      if (!is_cache_file_name(access.m_filename)) {
+         return std::make_error_code(std::errc::invalid_argument);
+      }
+      encode_index_record(records, RECORD_ACCESS, access.m_filename,
+                          to_index_time(access.m_accessTime), access.m_size);
+   }
+   if (records.empty()) {
+      return std::error_code();
+   }
+   SmallString<128> indexPath(path);
+   polar::fs::path::append(indexPath, sg_indexFilename);
+   return append_index_records(indexPath, records);
+}
+
+std::error_code record_cache_removal(StringRef path, StringRef filename)
+{
+   return append_index_record(path, RECORD_REMOVAL, filename, 0, 0);
+}
+
+namespace {
+
+/// Reads the index open as \p fd, as it is now, and applies its records from
+/// \p offset on to \p files. Returns the offset after the last record applied.
+size_t replay_open_index(int fd, StringRef indexPath, size_t offset,
+                         StringMap<IndexedFile> &files,
+                         std::unique_ptr<MemoryBuffer> *contents = nullptr)
+{
+   polar::fs::FileStatus status;
+   if (polar::fs::status(fd, status) || status.getSize() < offset) {
+      return offset;
+   }
+   OptionalError<std::unique_ptr<MemoryBuffer>> buffer =
+         MemoryBuffer::getOpenFile(fd, indexPath, status.getSize(),
+                                   /*requiresNullTerminator=*/false, /*isVolatile=*/true);
+   if (!buffer) {
+      return offset;
+   }
+   offset = replay_index((*buffer)->getBuffer(), offset, files);
+   if (contents) {
+      *contents = std::move(*buffer);
+   }
+   return offset;
+}
+
+/// Prunes the cache according to its index: no directory scan nor stat, the
+/// file system only sees the removals, which run in parallel. Returns false
+/// if another process is pruning or the index cannot be opened.
+bool prune_cache_by_index(StringRef path, CachePruningPolicy &policy,
+                          TimePoint<> currentTime)
+{
+   using namespace std::chrono;
+
+   SmallString<128> indexPath(path);
+   polar::fs::path::append(indexPath, sg_indexFilename);
+   // Only one process replaces the index at a time. The others leave the
+   // pruning to it.
+   LockFileManager locker(indexPath);
+   if (locker.getState() != LockFileManager::LFS_Owned) {
+      POLAR_DEBUG(debug_stream() << "The index is being pruned already\n");
+      return false;
+   }
+   // Writers go on appending to the index while it is pruned, so it is
+   // created right away if missing, and held open until it is replaced to
+   // hand on what was appended to it last.
+   bool haveIndex = polar::fs::exists(indexPath);
+   int indexFd;
+   {
+      int fd;
+      if (polar::fs::open_file_for_write(indexPath, fd, polar::fs::F_Append)) {
+         return false;
+      }
+      polar::sys::Process::safelyCloseFileDescriptor(fd);
+   }
+   if (polar::fs::open_file_for_read(indexPath, indexFd)) {
+      return false;
+   }
+   StringMap<IndexedFile> files;
+   if (!haveIndex) {
+      POLAR_DEBUG(debug_stream() << "No index, scan the cache\n");
+      scan_cache_directory(path, files);
+   }
+   size_t indexEnd = replay_open_index(indexFd, indexPath, 0, files);
+
+   // Least recently used first, by name for determinism.
+   std::vector<StringMapEntry<IndexedFile> *> byAge;
+   byAge.reserve(files.getSize());
+   uint64_t totalSize = 0;
+   for (auto &file : files) {
+      byAge.push_back(&file);
+      totalSize += file.getValue().m_size;
+   }
+   std::sort(byAge.begin(), byAge.end(), [](const StringMapEntry<IndexedFile> *lhs,
+             const StringMapEntry<IndexedFile> *rhs) {
+      if (lhs->getValue().m_time != rhs->getValue().m_time) {
+         return lhs->getValue().m_time < rhs->getValue().m_time;
+      }
+      return lhs->getKey() < rhs->getKey();
+   });
+   // byAge[0, numEvicted) are to be removed.
+   size_t numEvicted = 0;
+   auto evict = [&]() {
+      totalSize -= byAge[numEvicted]->getValue().m_size;
+      ++numEvicted;
+   };
+
+   if (policy.m_expiration != seconds(0)) {
+      int64_t oldest = to_index_time(currentTime) - policy.m_expiration.count();
+      while (numEvicted < byAge.size() && byAge[numEvicted]->getValue().m_time < oldest) {
+         evict();
+      }
+   }
+   if (policy.m_maxSizeFiles) {
+      while (byAge.size() - numEvicted > policy.m_maxSizeFiles) {
+         evict();
+      }
+   }
+   if (policy.m_maxSizePercentageOfAvailableSpace > 0 || policy.m_maxSizeBytes > 0) {
+      auto errOrSpaceInfo = polar::fs::disk_space(path);
+      if (!errOrSpaceInfo) {
+         report_fatal_error("Can't get available size");
+      }
+      polar::fs::SpaceInfo spaceInfo = errOrSpaceInfo.get();
+      auto availableSpace = totalSize + spaceInfo.free;
+      if (policy.m_maxSizePercentageOfAvailableSpace == 0) {
+         policy.m_maxSizePercentageOfAvailableSpace = 100;
+      }
+      if (policy.m_maxSizeBytes == 0) {
+         policy.m_maxSizeBytes = availableSpace;
+      }
+      auto totalSizeTarget = std::min<uint64_t>(
+               availableSpace * policy.m_maxSizePercentageOfAvailableSpace / 100ull,
+               policy.m_maxSizeBytes);
+      while (totalSize > totalSizeTarget && numEvicted < byAge.size()) {
+         evict();
+      }
+   }
+
+   POLAR_DEBUG(debug_stream() << "Remove " << numEvicted << " of " << byAge.size()
+               << " files, new size is " << totalSize << "\n");
+   parallel::for_each(parallel::par, byAge.begin(), byAge.begin() + numEvicted,
+                      [&](const StringMapEntry<IndexedFile> *file) {
+      SmallString<128> filePath(path);
+      polar::fs::path::append(filePath, file->getKey());
+      polar::fs::remove(filePath);
+   });
+   std::vector<std::string> evicted;
+   evicted.reserve(numEvicted);
+   for (size_t i = 0; i < numEvicted; ++i) {
+      evicted.push_back(byAge[i]->getKey());
+      files.erase(byAge[i]->getKey());
+   }
+
+   // Pick up what was recorded in the meantime. Files recorded again after
+   // they were evicted are kept if they were written again, rather than
+   // recorded by someone who used them just before they went.
+   indexEnd = replay_open_index(indexFd, indexPath, indexEnd, files);
+   for (const std::string &filename : evicted) {
+      auto iter = files.find(filename);
+      if (iter == files.end()) {
+         continue;
+      }
+      SmallString<128> filePath(path);
+      polar::fs::path::append(filePath, filename);
+      if (!polar::fs::exists(filePath)) {
+         files.erase(iter);
+      }
+   }
+   // Then compact the index, and pass on the records that were appended to
+   // the old index since it was read last.
+   if (write_index_snapshot(path, files)) {
+      StringMap<IndexedFile> late;
+      std::unique_ptr<MemoryBuffer> contents;
+      size_t lateEnd = replay_open_index(indexFd, indexPath, indexEnd, late, &contents);
+      if (lateEnd > indexEnd) {
+         append_index_records(indexPath, contents->getBuffer().slice(indexEnd, lateEnd));
+      }
+   }
+   polar::sys::Process::safelyCloseFileDescriptor(indexFd);
+   return true;
+}
+
+} // anonymous namespace
+
 /// Prune the cache of files that haven't been accessed in a long time.
 bool prune_cache(StringRef path, CachePruningPolicy policy) {
    using namespace std::chrono;
@@ -202,6 +606,10 @@ bool prune_cache(StringRef path, CachePruningPolicy policy) {
       write_timestamp_file(timestampFile);
    }
 
+   if (policy.m_useIndex) {
+      return prune_cache_by_index(path, policy, currentTime);
+   }
+
    // Keep track of space. Needs to be kept ordered by size for determinism.
    std::set<std::pair<uint64_t, std::string>> fileSizes;
    uint64_t totalSize = 0;
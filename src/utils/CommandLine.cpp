@@ -33,7 +33,9 @@
 #include "polar/global/Config.h"
 #include "polar/utils/ConvertUtf.h"
 #include "polar/utils/Debug.h"
+#include "polar/utils/Endian.h"
 #include "polar/utils/ErrorHandling.h"
+#include "polar/utils/FastHash.h"
 #include "polar/utils/FileSystem.h"
 #include "polar/utils/Host.h"
 #include "polar/global/ManagedStatic.h"
@@ -42,8 +44,9 @@
 #include "polar/utils/Process.h"
 #include "polar/utils/StringSaver.h"
 #include "polar/utils/RawOutStream.h"
+#include <algorithm>
 #include <cstdlib>
-#include <map>
+#include <cstring>
 
 namespace polar {
 namespace cmd {
@@ -83,7 +86,10 @@ using polar::utils::MemoryBuffer;
 using polar::utils::OptionalError;
 using polar::utils::BumpPtrAllocator;
 using polar::utils::RawOutStream;
+using polar::utils::RawFdOutStream;
 using polar::utils::RawStringOutStream;
+using polar::basic::utohexstr;
+namespace endian = polar::utils::endian;
 
 
 // Pin the vtables to this file.
@@ -131,6 +137,93 @@ void Parser<char>::anchor()
 
 //===----------------------------------------------------------------------===//
 
+/// The option names of a subcommand, in a trie whose nodes are laid out in
+/// one array with the children of each node next to each other. The longest
+/// option name which starts an argument is found in one walk down the
+/// argument, instead of looking up ever shorter prefixes of it.
+class OptionNameTrie
+{
+public:
+   explicit OptionNameTrie(const StringMap<Option *> &optionsMap)
+   {
+      std::vector<std::pair<StringRef, Option *>> names;
+      names.reserve(optionsMap.getSize());
+      for (auto &entry : optionsMap) {
+         names.emplace_back(entry.getKey(), entry.m_second);
+      }
+      std::sort(names.begin(), names.end(),
+                [](const std::pair<StringRef, Option *> &lhs,
+                const std::pair<StringRef, Option *> &rhs) {
+         return lhs.first < rhs.first;
+      });
+      m_nodes.emplace_back();
+      m_labels.push_back(0);
+      build(names.data(), names.data() + names.size(), 0, 0);
+   }
+
+   /// Returns the option with the longest name which is a prefix of \p arg,
+   /// the empty name only counting for an empty \p arg, and sets \p length to
+   /// the length of the name. Returns null if there is none.
+   Option *findLongestPrefix(StringRef arg, size_t &length) const
+   {
+      const Node *node = &m_nodes[0];
+      Option *found = arg.empty() ? node->m_option : nullptr;
+      length = 0;
+      for (size_t index = 0, end = arg.getSize(); index != end; ++index) {
+         const char *labels = m_labels.data() + node->m_firstChild;
+         const char *label = std::find(labels, labels + node->m_numChildren, arg[index]);
+         if (label == labels + node->m_numChildren) {
+            break;
+         }
+         node = &m_nodes[label - m_labels.data()];
+         if (node->m_option) {
+            found = node->m_option;
+            length = index + 1;
+         }
+      }
+      return found;
+   }
+
+private:
+   struct Node
+   {
+      Option *m_option = nullptr;
+      unsigned m_firstChild = 0;
+      unsigned m_numChildren = 0;
+   };
+
+   using NameEntry = std::pair<StringRef, Option *>;
+
+   /// Fills in the node \p nodeIndex for the sorted names [begin, end), which
+   /// share their first \p depth characters.
+   void build(const NameEntry *begin, const NameEntry *end, size_t depth, unsigned nodeIndex)
+   {
+      if (begin != end && begin->first.getSize() == depth) {
+         m_nodes[nodeIndex].m_option = begin->second;
+         ++begin;
+      }
+      unsigned firstChild = static_cast<unsigned>(m_nodes.size());
+      SmallVector<const NameEntry *, 8> groups;
+      for (const NameEntry *entry = begin; entry != end; ++entry) {
+         if (groups.empty() || entry->first[depth] != groups.back()->first[depth]) {
+            groups.push_back(entry);
+            m_nodes.emplace_back();
+            m_labels.push_back(entry->first[depth]);
+         }
+      }
+      m_nodes[nodeIndex].m_firstChild = firstChild;
+      m_nodes[nodeIndex].m_numChildren = static_cast<unsigned>(groups.size());
+      for (size_t index = 0, count = groups.size(); index != count; ++index) {
+         const NameEntry *groupEnd = index + 1 == count ? end : groups[index + 1];
+         build(groups[index], groupEnd, depth + 1, firstChild + static_cast<unsigned>(index));
+      }
+   }
+
+   std::vector<Node> m_nodes;
+   /// The character leading to each node, by node index.
+   std::vector<char> m_labels;
+};
+
 namespace {
 
 class CommandLineParser
@@ -166,6 +259,7 @@ public:
       if (option.hasArgStr()) {
          return;
       }
+      subcommand->m_optionIndex.reset();
       if (!subcommand->m_optionsMap.insert(std::make_pair(name, &option)).second) {
          error_stream() << m_programName << ": CommandLine Error: Option '" << name
                         << "' registered more than once!\n";
@@ -199,6 +293,7 @@ public:
       bool hadErrors = false;
       if (option->hasArgStr()) {
          // Add argument to the argument map!
+         subcommand->m_optionIndex.reset();
          if (!subcommand->m_optionsMap.insert(std::make_pair(option->m_argStr, option)).second) {
             error_stream() << m_programName << ": CommandLine Error: Option '" << option->m_argStr
                            << "' registered more than once!\n";
@@ -259,6 +354,7 @@ public:
          optionNames.push_back(option->m_argStr);
       }
       SubCommand &sub = *subcommand;
+      sub.m_optionIndex.reset();
       for (auto name : optionNames) {
          sub.m_optionsMap.erase(name);
       }
@@ -323,6 +419,7 @@ public:
    void updateArgStr(Option *option, StringRef newName, SubCommand *subcommand)
    {
       SubCommand &sub = *subcommand;
+      sub.m_optionIndex.reset();
       if (!sub.m_optionsMap.insert(std::make_pair(newName, option)).second) {
          error_stream() << m_programName << ": CommandLine Error: Option '" << option->m_argStr
                         << "' registered more than once!\n";
@@ -410,6 +507,17 @@ public:
       registerSubCommand(&*sg_allSubCommands);
    }
 
+   /// Returns the trie of the option names of \p subcommand, building it if
+   /// the options changed since it was last built. Whatever changes the
+   /// options map drops the trie.
+   const OptionNameTrie &getOptionIndex(SubCommand &subcommand)
+   {
+      if (!subcommand.m_optionIndex) {
+         subcommand.m_optionIndex.reset(new OptionNameTrie(subcommand.m_optionsMap));
+      }
+      return *subcommand.m_optionIndex;
+   }
+
 private:
    SubCommand *m_activeSubCommand;
 
@@ -466,6 +574,16 @@ ManagedStatic<SubCommand> sg_topLevelSubCommand;
 // A special subcommand that can be used to put an option into all subcommands.
 ManagedStatic<SubCommand> sg_allSubCommands;
 
+SubCommand::SubCommand(StringRef name, StringRef description)
+   : m_name(name), m_description(description)
+{
+   registerSubCommand();
+}
+
+SubCommand::SubCommand() = default;
+
+SubCommand::~SubCommand() = default;
+
 void SubCommand::registerSubCommand()
 {
    sg_globalParser->registerSubCommand(this);
@@ -481,6 +599,7 @@ void SubCommand::reset()
    m_positionalOpts.clear();
    m_sinkOpts.clear();
    m_optionsMap.clear();
+   m_optionIndex.reset();
    m_consumeAfterOpt = nullptr;
 }
 
@@ -707,30 +826,19 @@ inline bool is_prefixed_or_grouping(const Option *option)
    return is_grouping(option) || option->getFormattingFlag() == cmd::Prefix;
 }
 
-// get_option_pred - Check to see if there are any options that satisfy the
-// specified predicate with names that are the prefixes in Name.  This is
-// checked by progressively stripping characters off of the name, checking to
-// see if there options that satisfy the predicate.  If we find one, return it,
+// get_option_pred - Check to see if the option with the longest name that is
+// a prefix of name satisfies the specified predicate.  If so, return it,
 // otherwise return null.
 //
 Option *get_option_pred(StringRef name, size_t &length,
                         bool (*pred)(const Option *),
-                        const StringMap<Option *> &optionsMap)
+                        const OptionNameTrie &optionIndex)
 {
-
-   StringMap<Option *>::const_iterator omi = optionsMap.find(name);
-
-   // Loop while we haven't found an option and Name still has at least two
-   // characters in it (so that the next iteration will not be the empty
-   // string.
-   while (omi == optionsMap.end() && name.getSize() > 1) {
-      name = name.substr(0, name.getSize() - 1); // Chop off the last character.
-      omi = optionsMap.find(name);
-   }
-
-   if (omi != optionsMap.end() && pred(omi->m_second)) {
-      length = name.getSize();
-      return omi->m_second; // Found one!
+   size_t prefixLength;
+   Option *option = optionIndex.findLongestPrefix(name, prefixLength);
+   if (option && pred(option)) {
+      length = prefixLength;
+      return option; // Found one!
    }
    return nullptr; // No option found!
 }
@@ -741,13 +849,13 @@ Option *get_option_pred(StringRef name, size_t &length,
 /// Arg/Value pair and return the Option to parse it with.
 Option *handle_prefixed_or_grouped_option(StringRef &arg, StringRef &value,
                                           bool &errorParsing,
-                                          const StringMap<Option *> &optionsMap) {
+                                          const OptionNameTrie &optionIndex) {
    if (arg.getSize() == 1) {
       return nullptr;
    }
    // Do the lookup!
    size_t length = 0;
-   Option *pgOpt = get_option_pred(arg, length, is_prefixed_or_grouping, optionsMap);
+   Option *pgOpt = get_option_pred(arg, length, is_prefixed_or_grouping, optionIndex);
    if (!pgOpt) {
       return nullptr;
    }
@@ -757,7 +865,6 @@ Option *handle_prefixed_or_grouped_option(StringRef &arg, StringRef &value,
    if (pgOpt->getFormattingFlag() == cmd::Prefix) {
       value = arg.substr(length);
       arg = arg.substr(0, length);
-      assert(optionsMap.count(arg) && optionsMap.find(arg)->m_second == pgOpt);
       return pgOpt;
    }
 
@@ -779,7 +886,7 @@ Option *handle_prefixed_or_grouped_option(StringRef &arg, StringRef &value,
             provide_option(pgOpt, oneArgName, StringRef(), 0, nullptr, dummy);
 
       // Get the next grouping option.
-      pgOpt = get_option_pred(arg, length, is_grouping, optionsMap);
+      pgOpt = get_option_pred(arg, length, is_grouping, optionIndex);
    } while (pgOpt && length != arg.getSize());
 
    // Return the last option with Arg cut down to just the last one.
@@ -808,6 +915,40 @@ bool is_quote(char c)
    return c == '\"' || c == '\'';
 }
 
+/// Returns the end of the run of characters from \p index on which the GNU
+/// tokenizer copies as they are: all but whitespace, quotes and backslashes.
+size_t skip_plain_chars(StringRef src, size_t index)
+{
+   // All the delimiters but the backslash are below '(', so a word of eight
+   // characters is looked at one by one only if it has a character below '('
+   // or a backslash, which is rare in paths and flags outside of Windows.
+   const uint64_t ones = 0x0101010101010101ULL;
+   const uint64_t highBits = 0x8080808080808080ULL;
+   size_t end = src.getSize();
+   while (index != end) {
+      if (index + 8 <= end) {
+         uint64_t word;
+         std::memcpy(&word, src.getData() + index, 8);
+         // Sets the high bit of the characters below '(' and of backslashes,
+         // and maybe of some after them. Characters with their own high bit
+         // set are neither, and are masked out by ~word.
+         uint64_t candidates = ((word - ones * '(') | ((word ^ (ones * '\\')) - ones)) &
+               ~word & highBits;
+         if (candidates == 0) {
+            index += 8;
+            continue;
+         }
+      }
+      for (size_t wordEnd = std::min(index + 8, end); index != wordEnd; ++index) {
+         char c = src[index];
+         if (is_whitespace(c) || is_quote(c) || c == '\\') {
+            return index;
+         }
+      }
+   }
+   return index;
+}
+
 /// Backslashes are interpreted in a rather complicated way in the Windows-style
 /// command line, because backslashes are used both to separate path and to
 /// escape double quote. This method consumes runs of backslashes as well as the
@@ -855,18 +996,230 @@ bool has_utf8_byte_order_mark(ArrayRef<char> str)
    return (str.getSize() >= 3 && str[0] == '\xef' && str[1] == '\xbb' && str[2] == '\xbf');
 }
 
+/// If names of nested response files should be resolved relative to the
+/// including file \p fname, replaces the names in the tokens of \p newArgv
+/// from \p firstToken on with their full paths.
+void fix_response_file_names(StringRef fname, SmallVectorImpl<const char *> &newArgv,
+                             size_t firstToken, StringSaver &saver, bool relativeNames)
+{
+   if (relativeNames) {
+      for (size_t index = firstToken; index < newArgv.getSize(); ++index) {
+         if (newArgv[index]) {
+            StringRef arg = newArgv[index];
+            if (arg.front() == '@') {
+               StringRef fileName = arg.dropFront();
+               if (fs::path::is_relative(fileName)) {
+                  SmallString<128> responseFile;
+                  responseFile.append(1, '@');
+                  if (fs::path::is_relative(fname)) {
+                     SmallString<128> currDir;
+                     fs::current_path(currDir);
+                     responseFile.append(currDir.getStr());
+                  }
+                  fs::path::append(
+                           responseFile, fs::path::parent_path(fname), fileName);
+                  newArgv[index] = saver.save(responseFile.getCStr()).getData();
+               }
+            }
+         }
+      }
+   }
+}
+
+/// The directory in which the tokens of response files are cached, or empty.
+ManagedStatic<std::string> sg_responseFileCacheDir;
+
+enum
+{
+   /// Marks an end of line in the offsets of a token cache file.
+   CachedEndOfLine = 0xffffffffu
+};
+
+const char sg_tokenCacheMagic[] = {'P', 'R', 'S', 'P', 'T', 'O', 'K', '1'};
+
+/// A token cache file holds the tokens of one response file, for one
+/// tokenizer, as:
+///
+///     magic le64(file size) le64(mtime) le64(content hash)
+///     le32(count) le32(block size) le32(offset)* block
+///
+/// where block holds the tokens, each ended by a null character, and an
+/// offset of CachedEndOfLine stands for an end of line marker.
+struct TokenCacheHeader
+{
+   uint64_t m_fileSize;
+   uint64_t m_modificationTime;
+   uint64_t m_contentHash;
+};
+
+/// Returns the path of the cache file for the tokens of \p fname, or an
+/// empty path if there is no cache directory or \p tokenizer is not one
+/// whose tokens can be cached.
+SmallString<128> get_token_cache_path(StringRef fname, TokenizerCallback tokenizer,
+                                      bool markEOLs)
+{
+   SmallString<128> cachePath;
+   char tokenizerId;
+   if (tokenizer == tokenize_gnu_command_line) {
+      tokenizerId = 'g';
+   } else if (tokenizer == tokenize_windows_command_line) {
+      tokenizerId = 'w';
+   } else if (tokenizer == tokenize_config_file) {
+      tokenizerId = 'c';
+   } else {
+      return cachePath;
+   }
+   if (sg_responseFileCacheDir->empty()) {
+      return cachePath;
+   }
+   SmallString<128> key(fname);
+   if (fs::make_absolute(key)) {
+      return cachePath;
+   }
+   key.push_back('\0');
+   key.push_back(tokenizerId);
+   key.push_back(markEOLs ? '1' : '0');
+   fs::path::append(cachePath, *sg_responseFileCacheDir,
+                    utohexstr(polar::utils::fast_hash64(key), /*lowerCase*/ true) + ".rsp");
+   return cachePath;
+}
+
+/// Appends the tokens cached in \p cachePath to \p newArgv, the strings in
+/// one block from the allocator of \p saver, if the cache file is there and
+/// was made from a file like \p header.
+bool read_token_cache(StringRef cachePath, const TokenCacheHeader &header,
+                      StringSaver &saver, SmallVectorImpl<const char *> &newArgv)
+{
+   OptionalError<std::unique_ptr<MemoryBuffer>> cacheOrErr =
+         MemoryBuffer::getFile(cachePath, -1, /*RequiresNullTerminator*/ false);
+   if (!cacheOrErr) {
+      return false;
+   }
+   StringRef cache = (*cacheOrErr)->getBuffer();
+   const size_t fixedSize = sizeof(sg_tokenCacheMagic) + 3 * 8 + 2 * 4;
+   if (cache.getSize() < fixedSize ||
+       std::memcmp(cache.getData(), sg_tokenCacheMagic, sizeof(sg_tokenCacheMagic)) != 0) {
+      return false;
+   }
+   const char *ptr = cache.getData() + sizeof(sg_tokenCacheMagic);
+   if (endian::read64le(ptr) != header.m_fileSize ||
+       endian::read64le(ptr + 8) != header.m_modificationTime ||
+       endian::read64le(ptr + 16) != header.m_contentHash) {
+      return false;
+   }
+   uint64_t count = endian::read32le(ptr + 24);
+   uint64_t blockSize = endian::read32le(ptr + 28);
+   ptr += 32;
+   if (cache.getSize() != fixedSize + count * 4 + blockSize ||
+       (blockSize != 0 && cache.back() != '\0')) {
+      return false;
+   }
+   const char *cachedBlock = ptr + count * 4;
+   for (uint64_t index = 0; index != count; ++index) {
+      uint32_t offset = endian::read32le(ptr + index * 4);
+      if (offset != CachedEndOfLine && offset >= blockSize) {
+         return false;
+      }
+   }
+   char *block = saver.getAllocator().allocate<char>(blockSize);
+   std::memcpy(block, cachedBlock, blockSize);
+   newArgv.reserve(newArgv.getSize() + count);
+   for (uint64_t index = 0; index != count; ++index) {
+      uint32_t offset = endian::read32le(ptr + index * 4);
+      newArgv.push_back(offset == CachedEndOfLine ? nullptr : block + offset);
+   }
+   return true;
+}
+
+/// Writes \p tokens to \p cachePath, through a temporary file so that
+/// concurrent readers never see a partial cache. Failures are ignored, as
+/// the cache is only ever an optimization.
+void write_token_cache(StringRef cachePath, const TokenCacheHeader &header,
+                       ArrayRef<const char *> tokens)
+{
+   std::string block;
+   SmallVector<uint32_t, 0> offsets;
+   offsets.reserve(tokens.getSize());
+   for (const char *token : tokens) {
+      if (!token) {
+         offsets.push_back(CachedEndOfLine);
+         continue;
+      }
+      offsets.push_back(static_cast<uint32_t>(block.size()));
+      block.append(token, std::strlen(token) + 1);
+   }
+   if (block.size() >= CachedEndOfLine || tokens.getSize() >= CachedEndOfLine) {
+      return;
+   }
+   int fd;
+   SmallString<128> tempPath;
+   if (fs::create_unique_file(cachePath + "-%%%%%%%%", fd, tempPath)) {
+      return;
+   }
+   {
+      RawFdOutStream out(fd, /*shouldClose*/ true);
+      out.write(sg_tokenCacheMagic, sizeof(sg_tokenCacheMagic));
+      char buffer[8];
+      for (uint64_t value : {header.m_fileSize, header.m_modificationTime, header.m_contentHash}) {
+         endian::write64le(buffer, value);
+         out.write(buffer, 8);
+      }
+      endian::write32le(buffer, static_cast<uint32_t>(offsets.getSize()));
+      out.write(buffer, 4);
+      endian::write32le(buffer, static_cast<uint32_t>(block.size()));
+      out.write(buffer, 4);
+      for (uint32_t offset : offsets) {
+         endian::write32le(buffer, offset);
+         out.write(buffer, 4);
+      }
+      out << block;
+      out.close();
+      if (out.hasError()) {
+         out.clearError();
+         fs::remove(tempPath);
+         return;
+      }
+   }
+   if (fs::rename(tempPath, cachePath)) {
+      fs::remove(tempPath);
+   }
+}
+
 bool expand_response_file(StringRef fname, StringSaver &saver,
                           TokenizerCallback tokenizer,
                           SmallVectorImpl<const char *> &newArgv,
                           bool markEOLs, bool relativeNames)
 {
+   fs::FileStatus status;
+   if (fs::status(fname, status)) {
+      return false;
+   }
+   // Large response files are mapped rather than read, which needs no null
+   // terminator.
    OptionalError<std::unique_ptr<MemoryBuffer>> memBufOrErr =
-         MemoryBuffer::getFile(fname);
+         MemoryBuffer::getFile(fname, -1, /*RequiresNullTerminator*/ false);
    if (!memBufOrErr) {
       return false;
    }
    MemoryBuffer &memBuf = *memBufOrErr.get();
    StringRef str(memBuf.getBufferStart(), memBuf.getBufferSize());
+   size_t firstToken = newArgv.getSize();
+
+   // The tokens are cached against the contents they were made from, so a
+   // file rewritten within the resolution of its modification time is not
+   // mistaken for the one cached.
+   SmallString<128> cachePath = get_token_cache_path(fname, tokenizer, markEOLs);
+   TokenCacheHeader header = {};
+   if (!cachePath.empty()) {
+      header.m_fileSize = str.getSize();
+      header.m_modificationTime =
+            status.getLastModificationTime().time_since_epoch().count();
+      header.m_contentHash = polar::utils::fast_hash64(str);
+      if (read_token_cache(cachePath, header, saver, newArgv)) {
+         fix_response_file_names(fname, newArgv, firstToken, saver, relativeNames);
+         return true;
+      }
+   }
 
    // If we have a UTF-16 byte order mark, convert to UTF-8 for parsing.
    ArrayRef<char> bufRef(memBuf.getBufferStart(), memBuf.getBufferEnd());
@@ -887,32 +1240,11 @@ bool expand_response_file(StringRef fname, StringSaver &saver,
 
    // Tokenize the contents into NewArgv.
    tokenizer(str, saver, newArgv, markEOLs);
-
-   // If names of nested response files should be resolved relative to including
-   // file, replace the included response file names with their full paths
-   // obtained by required resolution.
-   if (relativeNames) {
-      for (unsigned index = 0; index < newArgv.getSize(); ++index) {
-         if (newArgv[index]) {
-            StringRef arg = newArgv[index];
-            if (arg.front() == '@') {
-               StringRef fileName = arg.dropFront();
-               if (fs::path::is_relative(fileName)) {
-                  SmallString<128> responseFile;
-                  responseFile.append(1, '@');
-                  if (fs::path::is_relative(fname)) {
-                     SmallString<128> currDir;
-                     fs::current_path(currDir);
-                     responseFile.append(currDir.getStr());
-                  }
-                  fs::path::append(
-                           responseFile, fs::path::parent_path(fname), fileName);
-                  newArgv[index] = saver.save(responseFile.getCStr()).getData();
-               }
-            }
-         }
-      }
+   if (!cachePath.empty()) {
+      write_token_cache(cachePath, header,
+                        ArrayRef<const char *>(newArgv.begin() + firstToken, newArgv.end()));
    }
+   fix_response_file_names(fname, newArgv, firstToken, saver, relativeNames);
    return true;
 }
 
@@ -922,10 +1254,20 @@ void tokenize_gnu_command_line(StringRef src, StringSaver &saver,
                                SmallVectorImpl<const char *> &newArgv,
                                bool markEOLs)
 {
-   SmallString<128> token;
+   // The tokens are written one after another into a single block from the
+   // allocator of the saver, each ended by a null character in place of the
+   // whitespace which ended it. Quotes and escapes only ever make a token
+   // shorter than its source, so the block is no larger than the source.
+   char *out = saver.getAllocator().allocate<char>(src.getSize() + 1);
+   char *token = out;
+   auto endToken = [&]() {
+      *out++ = '\0';
+      newArgv.push_back(token);
+      token = out;
+   };
    for (size_t index = 0, end = src.getSize(); index != end; ++index) {
       // Consume runs of whitespace.
-      if (token.empty()) {
+      if (out == token) {
          while (index != end && is_whitespace(src[index])) {
             // Mark the end of lines in response files
             if (markEOLs && src[index] == '\n') {
@@ -944,7 +1286,7 @@ void tokenize_gnu_command_line(StringRef src, StringSaver &saver,
       // Backslash escapes the next character.
       if (index + 1 < end && c == '\\') {
          ++index; // Skip the escape.
-         token.push_back(src[index]);
+         *out++ = src[index];
          continue;
       }
 
@@ -956,7 +1298,7 @@ void tokenize_gnu_command_line(StringRef src, StringSaver &saver,
             if (src[index] == '\\' && index + 1 != end) {
                ++index;
             }
-            token.push_back(src[index]);
+            *out++ = src[index];
             ++index;
          }
          if (index == end) {
@@ -967,19 +1309,21 @@ void tokenize_gnu_command_line(StringRef src, StringSaver &saver,
 
       // End the token if this is whitespace.
       if (is_whitespace(c)) {
-         if (!token.empty()) {
-            newArgv.push_back(saver.save(StringRef(token)).getData());
+         if (out != token) {
+            endToken();
          }
-         token.clear();
          continue;
       }
-      // This is a normal character.  Append it.
-      token.push_back(c);
+      // This is a run of normal characters.  Append it.
+      size_t runEnd = std::max(skip_plain_chars(src, index), index + 1);
+      std::memcpy(out, src.getData() + index, runEnd - index);
+      out += runEnd - index;
+      index = runEnd - 1;
    }
 
    // Append the last token after hitting EOF with no whitespace.
-   if (!token.empty()) {
-      newArgv.push_back(saver.save(StringRef(token)).getData());
+   if (out != token) {
+      endToken();
    }
    // Mark the end of response files
    if (markEOLs) {
@@ -1113,6 +1457,11 @@ void tokenize_config_file(StringRef source, StringSaver &saver,
    }
 }
 
+void set_response_file_cache_directory(StringRef path)
+{
+   *sg_responseFileCacheDir = path;
+}
+
 /// Expand response files on a command line recursively using the given
 /// StringSaver and tokenization strategy.
 bool expand_response_files(StringSaver &saver, TokenizerCallback tokenizer,
@@ -1122,38 +1471,52 @@ bool expand_response_files(StringSaver &saver, TokenizerCallback tokenizer,
    unsigned rspFiles = 0;
    bool allExpanded = true;
 
-   // Don't cache Argv.size() because it can change.
-   for (unsigned index = 0; index != argv.getSize();) {
-      const char *arg = argv[index];
-      // Check if it is an EOL marker
-      if (arg == nullptr) {
-         ++index;
+   // The command line is built in one pass. The arguments still to be looked
+   // at are kept on a stack of ranges, the tokens of the innermost response
+   // file on top, so that each argument is moved once, however deeply the
+   // response files nest.
+   SmallVector<const char *, 0> expandedArgv;
+   SmallVector<SmallVector<const char *, 0>, 4> fileArgvs;
+   SmallVector<std::pair<const char *const *, const char *const *>, 4> pending;
+   pending.emplace_back(argv.begin(), argv.end());
+   while (!pending.empty()) {
+      auto &range = pending.back();
+      if (range.first == range.second) {
+         pending.pop_back();
          continue;
       }
-      if (arg[0] != '@') {
-         ++index;
+      const char *arg = *range.first++;
+      // EOL markers and plain arguments are taken as they are.
+      if (arg == nullptr || arg[0] != '@') {
+         expandedArgv.push_back(arg);
          continue;
       }
 
       // If we have too many response files, leave some unexpanded.  This avoids
       // crashing on self-referential response files.
       if (rspFiles++ > 20) {
-         return false;
+         expandedArgv.push_back(arg);
+         for (; !pending.empty(); pending.pop_back()) {
+            expandedArgv.append(pending.back().first, pending.back().second);
+         }
+         allExpanded = false;
+         break;
       }
       // Replace this response file argument with the tokenization of its
-      // contents.  Nested response files are expanded in subsequent iterations.
-      SmallVector<const char *, 0> expandedArgv;
-      if (!expand_response_file(arg + 1, saver, tokenizer, expandedArgv,
+      // contents.  Nested response files are expanded as they are reached.
+      SmallVector<const char *, 0> fileArgv;
+      if (!expand_response_file(arg + 1, saver, tokenizer, fileArgv,
                                 markEOLs, relativeNames)) {
          // We couldn't read this file, so we leave it in the argument stream and
          // move on.
          allExpanded = false;
-         ++index;
+         expandedArgv.push_back(arg);
          continue;
       }
-      argv.erase(argv.begin() + index);
-      argv.insert(argv.begin() + index, expandedArgv.begin(), expandedArgv.end());
+      fileArgvs.push_back(std::move(fileArgv));
+      pending.emplace_back(fileArgvs.back().begin(), fileArgvs.back().end());
    }
+   argv.swap(expandedArgv);
    return allExpanded;
 }
 
@@ -1389,7 +1752,7 @@ bool CommandLineParser::parseCommandLineOptions(int argc,
          // Check to see if this "option" is really a prefixed or grouped argument.
          if (!handler)
             handler = handle_prefixed_or_grouped_option(argName, value, errorParsing,
-                                                        optionsMap);
+                                                        getOptionIndex(*chosenSubCommand));
 
          // Otherwise, look for the closest available option to report to the user
          // in the upcoming error.
@@ -2157,7 +2520,6 @@ protected:
    void sg_printOptions(StrOptionPairVector &opts, size_t maxArgLen) override
    {
       std::vector<OptionCategory *> sortedCategories;
-      std::map<OptionCategory *, std::vector<Option *>> categorizedOptions;
 
       // Collect registered option categories into vector in preparation for
       // sorting.
@@ -2172,31 +2534,29 @@ protected:
       array_pod_sort(sortedCategories.begin(), sortedCategories.end(),
                      optionCategoryCompare);
 
-      // Create map to empty vectors.
-      for (std::vector<OptionCategory *>::const_iterator
-           iter = sortedCategories.begin(),
-           end = sortedCategories.end();
-           iter != end; ++iter) {
-         categorizedOptions[*iter] = std::vector<Option *>();
-      }
-
-      // Walk through pre-sorted options and assign into categories.
-      // Because the options are already alphabetically sorted the
-      // options within categories will also be alphabetically sorted.
+      // Walk through pre-sorted options and assign into categories, by their
+      // position in sortedCategories. Because the options are already
+      // alphabetically sorted the options within categories will also be
+      // alphabetically sorted.
+      std::vector<std::vector<Option *>> categorizedOptions(sortedCategories.size());
       for (size_t index = 0, end = opts.getSize(); index != end; ++index) {
          Option *option = opts[index].second;
-         assert(categorizedOptions.count(option->m_category) > 0 &&
+         auto category = std::lower_bound(sortedCategories.begin(), sortedCategories.end(),
+                                          option->m_category,
+                                          [](OptionCategory *lhs, OptionCategory *rhs) {
+            return lhs->getName() < rhs->getName();
+         });
+         assert(category != sortedCategories.end() && *category == option->m_category &&
                 "Option has an unregistered category");
-         categorizedOptions[option->m_category].push_back(option);
+         categorizedOptions[category - sortedCategories.begin()].push_back(option);
       }
 
       // Now do printing.
-      for (std::vector<OptionCategory *>::const_iterator
-           iter = sortedCategories.begin(),
-           end = sortedCategories.end();
-           iter != end; ++iter) {
+      for (size_t categoryIndex = 0, categoryCount = sortedCategories.size();
+           categoryIndex != categoryCount; ++categoryIndex) {
+         auto iter = sortedCategories.begin() + categoryIndex;
          // Hide empty categories for -help, but show for -help-hidden.
-         const auto &categoryOptions = categorizedOptions[*iter];
+         const auto &categoryOptions = categorizedOptions[categoryIndex];
          bool isEmptyCategory = categoryOptions.empty();
          if (!m_showHidden && isEmptyCategory) {
             continue;
@@ -2453,6 +2813,8 @@ StringMap<Option *> &get_registered_options(SubCommand &sub) {
    auto &subs = sg_globalParser->m_registeredSubCommands;
    (void)subs;
    assert(polar::basic::is_contained(subs, &sub));
+   // The caller may rename, replace or remove options.
+   sub.m_optionIndex.reset();
    return sub.m_optionsMap;
 }
 
@@ -10,10 +10,13 @@
 // Created by softboy on 2018/07/03.
 
 #include "polar/utils/Compression.h"
+#include "polar/basic/adt/ArrayRef.h"
 #include "polar/basic/adt/SmallVector.h"
 #include "polar/basic/adt/StringRef.h"
 #include "polar/utils/ErrorType.h"
 #include "polar/utils/ErrorHandling.h"
+#include <algorithm>
+#include <climits>
 
 #if POLAR_ENABLE_ZLIB == 1 && HAVE_ZLIB_H
 #include <zlib.h>
@@ -113,6 +116,109 @@ uint32_t crc32(StringRef buffer)
    return ::crc32(0, (const Bytef *)buffer.getData(), buffer.getSize());
 }
 
+Error compress_gzip(ArrayRef<StringRef> inputBuffers,
+                    SmallVectorImpl<char> &compressedBuffer,
+                    CompressionLevel level)
+{
+   z_stream stream = {};
+   // 16 + MAX_WBITS asks for a gzip wrapper instead of a zlib one.
+   int res = ::deflateInit2(&stream, encode_zlib_compression_level(level), Z_DEFLATED,
+                            16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+   if (res != Z_OK) {
+      return create_error(convert_zlib_code_to_string(res));
+   }
+   uLong inputSize = 0;
+   for (StringRef input : inputBuffers) {
+      inputSize += input.getSize();
+   }
+   compressedBuffer.resize(::deflateBound(&stream, inputSize));
+   // z_stream counts bytes in 32 bits, so both sides are handed over in
+   // pieces of at most UINT_MAX bytes.
+   char *nextOut = compressedBuffer.getData();
+   size_t outLeft = compressedBuffer.getSize();
+   // Runs deflate() until it has taken all of avail_in, or, for Z_FINISH,
+   // ended the stream.
+   auto run_deflate = [&](int flush) {
+      do {
+         if (!stream.avail_out) {
+            stream.next_out = (Bytef *)nextOut;
+            stream.avail_out = std::min<size_t>(outLeft, UINT_MAX);
+            nextOut += stream.avail_out;
+            outLeft -= stream.avail_out;
+         }
+         res = ::deflate(&stream, flush);
+      } while (res == Z_OK && (stream.avail_in || flush == Z_FINISH));
+   };
+   for (size_t i = 0, e = inputBuffers.getSize(); i != e && res == Z_OK; ++i) {
+      bool last = i + 1 == e;
+      // deflate() reports an error if it can make no progress.
+      if (inputBuffers[i].empty() && !last) {
+         continue;
+      }
+      const char *nextIn = inputBuffers[i].getData();
+      size_t inLeft = inputBuffers[i].getSize();
+      do {
+         stream.next_in = (Bytef *)nextIn;
+         stream.avail_in = std::min<size_t>(inLeft, UINT_MAX);
+         nextIn += stream.avail_in;
+         inLeft -= stream.avail_in;
+         run_deflate(last && !inLeft ? Z_FINISH : Z_NO_FLUSH);
+      } while (inLeft && res == Z_OK);
+   }
+   if (inputBuffers.empty()) {
+      run_deflate(Z_FINISH);
+   }
+   size_t compressedSize = stream.total_out;
+   ::deflateEnd(&stream);
+   __msan_unpoison(compressedBuffer.getData(), compressedSize);
+   compressedBuffer.resize(compressedSize);
+   // deflateBound() leaves room for everything, so that Z_FINISH completes.
+   return res == Z_STREAM_END ? Error::getSuccess()
+                              : create_error(convert_zlib_code_to_string(
+                                                res == Z_OK ? Z_BUF_ERROR : res));
+}
+
+Error uncompress_gzip(StringRef inputBuffer, char *uncompressedBuffer,
+                      size_t uncompressedSize)
+{
+   z_stream stream = {};
+   int res = ::inflateInit2(&stream, 16 + MAX_WBITS);
+   if (res != Z_OK) {
+      return create_error(convert_zlib_code_to_string(res));
+   }
+   const char *nextIn = inputBuffer.getData();
+   size_t inLeft = inputBuffer.getSize();
+   char *nextOut = uncompressedBuffer;
+   size_t outLeft = uncompressedSize;
+   // As in compress_gzip(), hand over at most UINT_MAX bytes at a time.
+   do {
+      if (!stream.avail_in) {
+         stream.next_in = (Bytef *)nextIn;
+         stream.avail_in = std::min<size_t>(inLeft, UINT_MAX);
+         nextIn += stream.avail_in;
+         inLeft -= stream.avail_in;
+      }
+      if (!stream.avail_out) {
+         stream.next_out = (Bytef *)nextOut;
+         stream.avail_out = std::min<size_t>(outLeft, UINT_MAX);
+         nextOut += stream.avail_out;
+         outLeft -= stream.avail_out;
+      }
+      res = ::inflate(&stream, inLeft || outLeft ? Z_NO_FLUSH : Z_FINISH);
+   } while (res == Z_OK && (inLeft || outLeft));
+   if (res == Z_OK) {
+      res = ::inflate(&stream, Z_FINISH);
+   }
+   size_t outputSize = stream.total_out;
+   ::inflateEnd(&stream);
+   __msan_unpoison(uncompressedBuffer, outputSize);
+   if (res == Z_STREAM_END && outputSize == uncompressedSize) {
+      return Error::getSuccess();
+   }
+   return create_error(convert_zlib_code_to_string(
+                          res == Z_STREAM_END || res == Z_OK || res == Z_NEED_DICT ? Z_DATA_ERROR : res));
+}
+
 #else
 bool is_available()
 {
@@ -143,6 +249,19 @@ uint32_t crc32(StringRef buffer)
 {
    polar_unreachable("zlib::crc32 is unavailable");
 }
+
+Error compress_gzip(ArrayRef<StringRef> inputBuffers,
+                    SmallVectorImpl<char> &compressedBuffer,
+                    CompressionLevel level)
+{
+   polar_unreachable("zlib::compress_gzip is unavailable");
+}
+
+Error uncompress_gzip(StringRef inputBuffer, char *uncompressedBuffer,
+                      size_t uncompressedSize)
+{
+   polar_unreachable("zlib::uncompress_gzip is unavailable");
+}
 #endif
 } // zlib
 } // utils
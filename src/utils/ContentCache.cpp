@@ -0,0 +1,201 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/ContentCache.h"
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/basic/adt/Statistic.h"
+#include "polar/basic/adt/StringExtras.h"
+#include "polar/utils/Blake3.h"
+#include "polar/utils/FileOutputBuffer.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/Path.h"
+#include <chrono>
+#include <cstring>
+
+#define DEBUG_TYPE "content-cache"
+
+namespace polar {
+namespace utils {
+
+using polar::basic::ArrayRef;
+using polar::basic::SmallString;
+
+STATISTIC(NumCacheHits, "Number of content cache hits");
+STATISTIC(NumCacheMisses, "Number of content cache misses");
+STATISTIC(NumCacheBytesRead, "Number of bytes read from the content cache");
+STATISTIC(NumCacheBytesWritten, "Number of bytes written to the content cache");
+
+namespace {
+
+/// Hits recorded in the index by one write.
+const size_t sg_hitBatchSize = 64;
+
+} // anonymous namespace
+
+ContentCache::ContentCache(StringRef directory, CachePruningPolicy policy)
+   : m_directory(directory),
+     m_policy(policy)
+{
+   m_policy.m_useIndex = true;
+}
+
+ContentCache::~ContentCache()
+{
+   flushHits();
+}
+
+Expected<std::unique_ptr<ContentCache>>
+ContentCache::create(StringRef directory, CachePruningPolicy policy)
+{
+   if (std::error_code errorCode = fs::create_directories(directory)) {
+      return error_code_to_error(errorCode);
+   }
+   return std::unique_ptr<ContentCache>(new ContentCache(directory, policy));
+}
+
+std::string ContentCache::getEntryName(StringRef key) const
+{
+   std::array<uint8_t, 32> digest = Blake3::hash(
+            ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(key.getData()), key.size()));
+   std::string hex = polar::basic::to_hex(ArrayRef<uint8_t>(digest));
+   // The pruner only considers files named polarcache-*.
+   return hex.substr(0, 2) + "/polarcache-" + hex;
+}
+
+std::string ContentCache::getEntryPath(StringRef key) const
+{
+   SmallString<128> path(m_directory);
+   fs::path::append(path, getEntryName(key));
+   return path.getStr();
+}
+
+std::unique_ptr<MemoryBuffer> ContentCache::get(StringRef key)
+{
+   std::string name = getEntryName(key);
+   SmallString<128> path(m_directory);
+   fs::path::append(path, name);
+   // Without a null terminator, entries of a few pages or more are mapped
+   // rather than read.
+   OptionalError<std::unique_ptr<MemoryBuffer>> buffer =
+         MemoryBuffer::getFile(path, -1, /*RequiresNullTerminator=*/false);
+   if (!buffer) {
+      ++NumCacheMisses;
+      m_misses.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+   }
+   size_t size = (*buffer)->getBufferSize();
+   ++NumCacheHits;
+   NumCacheBytesRead += size;
+   m_hits.fetch_add(1, std::memory_order_relaxed);
+   m_bytesRead.fetch_add(size, std::memory_order_relaxed);
+   recordHit(std::move(name), size);
+   return std::move(*buffer);
+}
+
+void ContentCache::recordHit(std::string name, uint64_t size)
+{
+   std::vector<CacheAccess> hits;
+   {
+      std::lock_guard<std::mutex> lock(m_hitMutex);
+      m_pendingHits.push_back({std::move(name), size, std::chrono::system_clock::now()});
+      if (m_pendingHits.size() < sg_hitBatchSize) {
+         return;
+      }
+      hits.swap(m_pendingHits);
+   }
+   // A lost access record only makes the entry look older to the pruner.
+   record_cache_accesses(m_directory, hits);
+}
+
+void ContentCache::flushHits()
+{
+   std::vector<CacheAccess> hits;
+   {
+      std::lock_guard<std::mutex> lock(m_hitMutex);
+      hits.swap(m_pendingHits);
+   }
+   record_cache_accesses(m_directory, hits);
+}
+
+Error ContentCache::put(StringRef key, StringRef data)
+{
+   return put(key, data.size(), [&](uint8_t *buffer) {
+      if (!data.empty()) {
+         std::memcpy(buffer, data.getData(), data.size());
+      }
+   });
+}
+
+Error ContentCache::put(StringRef key, size_t size, FunctionRef<void(uint8_t *)> writer)
+{
+   std::string name = getEntryName(key);
+   SmallString<128> path(m_directory);
+   fs::path::append(path, name);
+   if (std::error_code errorCode = fs::create_directories(fs::path::parent_path(path))) {
+      return error_code_to_error(errorCode);
+   }
+   if (size == 0) {
+      // Empty files cannot be mapped.
+      Expected<fs::TempFile> temp = fs::TempFile::create(path + ".tmp%%%%%%%");
+      if (!temp) {
+         return temp.takeError();
+      }
+      if (Error error = temp->keep(path)) {
+         return error;
+      }
+   } else {
+      Expected<std::unique_ptr<FileOutputBuffer>> output = FileOutputBuffer::create(path, size);
+      if (!output) {
+         return output.takeError();
+      }
+      writer((*output)->getBufferStart());
+      if (Error error = (*output)->commit()) {
+         return error;
+      }
+   }
+   NumCacheBytesWritten += size;
+   m_bytesWritten.fetch_add(size, std::memory_order_relaxed);
+   record_cache_access(m_directory, name, size);
+   pruneIfDue();
+   return Error::getSuccess();
+}
+
+void ContentCache::pruneIfDue()
+{
+   // A zero interval would have prune_cache() prune on every put.
+   if (!m_policy.m_interval || *m_policy.m_interval == std::chrono::seconds(0)) {
+      return;
+   }
+   // prune_cache() returns early unless the interval is over.
+   prune_cache(m_directory, m_policy);
+}
+
+bool ContentCache::prune()
+{
+   flushHits();
+   CachePruningPolicy policy = m_policy;
+   policy.m_interval = std::chrono::seconds(0);
+   return prune_cache(m_directory, policy);
+}
+
+ContentCache::Counters ContentCache::getCounters() const
+{
+   Counters counters;
+   counters.m_hits = m_hits.load(std::memory_order_relaxed);
+   counters.m_misses = m_misses.load(std::memory_order_relaxed);
+   counters.m_bytesRead = m_bytesRead.load(std::memory_order_relaxed);
+   counters.m_bytesWritten = m_bytesWritten.load(std::memory_order_relaxed);
+   return counters;
+}
+
+} // utils
+} // polar
@@ -0,0 +1,163 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/DirectoryWalker.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/utils/Parallel.h"
+#include "polar/utils/Path.h"
+
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace polar {
+namespace fs {
+
+namespace internal {
+
+class TreeWalker
+{
+public:
+   TreeWalker(StringRef root, const WalkOptions &options,
+              FunctionRef<void(const WalkEntry &)> callback)
+      : m_root(root),
+        m_options(options),
+        m_callback(callback)
+   {
+      // Where relative paths start in the paths of the entries.
+      SmallString<128> probe(root);
+      polar::fs::path::append(probe, "x");
+      m_relativeStart = probe.size() - 1;
+   }
+
+   std::error_code run()
+   {
+      walkDirectory(m_root, 0);
+      m_tasks.sync();
+      return m_firstError;
+   }
+
+private:
+   void walkDirectory(std::string path, unsigned level);
+   void reportError(std::error_code errorCode);
+   bool markVisited(const FileStatus &status);
+
+   std::string m_root;
+   const WalkOptions &m_options;
+   FunctionRef<void(const WalkEntry &)> m_callback;
+   size_t m_relativeStart;
+   std::mutex m_callbackMutex;
+   std::mutex m_mutex;
+   std::error_code m_firstError;
+   std::set<UniqueId> m_visited;
+   polar::utils::parallel::internal::TaskGroup m_tasks;
+};
+
+void TreeWalker::reportError(std::error_code errorCode)
+{
+   std::lock_guard<std::mutex> locker(m_mutex);
+   if (!m_firstError) {
+      m_firstError = errorCode;
+   }
+}
+
+bool TreeWalker::markVisited(const FileStatus &status)
+{
+   std::lock_guard<std::mutex> locker(m_mutex);
+   return m_visited.insert(status.getUniqueId()).second;
+}
+
+void TreeWalker::walkDirectory(std::string path, unsigned level)
+{
+   std::vector<ListedEntry> listed;
+   std::vector<WalkEntry> entries;
+   std::vector<std::string> subdirs;
+   for (;;) {
+      listed.clear();
+      entries.clear();
+      FileStatus dirStatus;
+      bool follow = m_options.m_followSymlinks;
+      std::error_code errorCode = list_directory(path, follow, m_options.m_needStatus,
+                                                 listed, follow ? &dirStatus : nullptr);
+      if (errorCode) {
+         reportError(errorCode);
+      }
+      // Links may lead back to a directory seen already.
+      if (follow && !errorCode && !markVisited(dirStatus)) {
+         listed.clear();
+      }
+      SmallString<128> entryPath(path);
+      size_t dirLength = entryPath.size();
+      for (ListedEntry &listedEntry : listed) {
+         entryPath.resize(dirLength);
+         polar::fs::path::append(entryPath, listedEntry.m_name);
+         StringRef relative = entryPath.getStr().substr(m_relativeStart);
+         if (m_options.m_exclude && m_options.m_exclude->matchAny(relative)) {
+            continue;
+         }
+         bool isDirectory = listedEntry.m_type == FileType::directory_file;
+         if (isDirectory && level < m_options.m_maxLevel) {
+            subdirs.push_back(entryPath.getStr());
+         }
+         if (m_options.m_include && !m_options.m_include->matchAny(relative)) {
+            continue;
+         }
+         entries.emplace_back();
+         WalkEntry &entry = entries.back();
+         entry.m_path = entryPath.getStr();
+         entry.m_relativeStart = m_relativeStart;
+         entry.m_filenameStart = entryPath.size() - listedEntry.m_name.size();
+         entry.m_type = listedEntry.m_type;
+         entry.m_level = level;
+         entry.m_status = listedEntry.m_status;
+         entry.m_hasStatus = listedEntry.m_hasStatus;
+      }
+      if (!entries.empty()) {
+         std::lock_guard<std::mutex> locker(m_callbackMutex);
+         for (const WalkEntry &entry : entries) {
+            m_callback(entry);
+         }
+      }
+      if (!m_options.m_parallel) {
+         for (std::string &subdir : subdirs) {
+            walkDirectory(std::move(subdir), level + 1);
+         }
+         return;
+      }
+      if (subdirs.empty()) {
+         return;
+      }
+      // Hand all subdirectories but one to the pool, and go on with that one
+      // here.
+      path = std::move(subdirs.back());
+      subdirs.pop_back();
+      for (std::string &subdir : subdirs) {
+         m_tasks.spawn([this, subdir = std::move(subdir), level]() mutable {
+            walkDirectory(std::move(subdir), level + 1);
+         });
+      }
+      subdirs.clear();
+      ++level;
+   }
+}
+
+} // internal
+
+std::error_code walk_directory_tree(const Twine &root, const WalkOptions &options,
+                                    FunctionRef<void(const WalkEntry &)> callback)
+{
+   SmallString<128> rootStorage;
+   internal::TreeWalker walker(root.toStringRef(rootStorage), options, callback);
+   return walker.run();
+}
+
+} // fs
+} // polar
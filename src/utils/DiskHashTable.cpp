@@ -0,0 +1,84 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/DiskHashTable.h"
+#include "polar/utils/FileOutputBuffer.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/Memory.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/Process.h"
+
+namespace polar {
+namespace utils {
+namespace internal {
+
+MutableArrayRef<uint8_t> get_output_bytes(FileOutputBuffer &buffer)
+{
+   return MutableArrayRef<uint8_t>(buffer.getBufferStart(), buffer.getBufferSize());
+}
+
+std::error_code create_run_file(int &fd, SmallVectorImpl<char> &path)
+{
+   return fs::create_temporary_file("polar-hashtable", "run", fd, path);
+}
+
+void remove_run_file(StringRef path)
+{
+   fs::remove(path);
+}
+
+MappedRunFile::MappedRunFile() = default;
+
+MappedRunFile::MappedRunFile(MappedRunFile &&other) noexcept = default;
+
+MappedRunFile::~MappedRunFile() = default;
+
+std::error_code MappedRunFile::open(StringRef path)
+{
+   OptionalError<std::unique_ptr<MemoryBuffer>> buffer =
+         MemoryBuffer::getFile(path, -1, /*requiresNullTerminator=*/false);
+   if (!buffer) {
+      return buffer.getError();
+   }
+   m_buffer = std::move(*buffer);
+   return std::error_code();
+}
+
+StringRef MappedRunFile::getContents() const
+{
+   return m_buffer->getBuffer();
+}
+
+void advise_will_need(std::vector<const unsigned char *> &addresses)
+{
+   static const uintptr_t pageSize = sys::Process::getPageSize();
+   std::vector<uintptr_t> pages;
+   pages.reserve(addresses.size());
+   for (const unsigned char *address : addresses) {
+      pages.push_back(reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1));
+   }
+   std::sort(pages.begin(), pages.end());
+   pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+   for (size_t i = 0; i < pages.size();) {
+      size_t end = i + 1;
+      while (end < pages.size() && pages[end] == pages[end - 1] + pageSize) {
+         ++end;
+      }
+      sys::Memory::adviseMappedMemory(reinterpret_cast<const void *>(pages[i]),
+                                      pages[end - 1] + pageSize - pages[i],
+                                      sys::Memory::MA_WILL_NEED);
+      i = end;
+   }
+}
+
+} // internal
+} // utils
+} // polar
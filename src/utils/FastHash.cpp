@@ -44,14 +44,27 @@
 */
 
 /* based on revision d2df04efcbef7d7f6886d345861e5dfda4edacc1 Removed
- * everything but a simple interface for computing XXh64. */
+ * everything but a simple interface for computing XXh64. XXH3 follows the
+ * 0.8 release of the reference implementation. */
 
 #include "polar/utils/FastHash.h"
+#include "polar/basic/adt/Hashing.h"
+#include "polar/basic/adt/StringMap.h"
+#include "polar/basic/adt/Twine.h"
 #include "polar/utils/Endian.h"
+#include "polar/utils/Host.h"
+#include "polar/utils/RawOutStream.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define POLAR_HAVE_XXH3_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
 namespace polar {
 namespace utils {
 
@@ -149,6 +162,746 @@ uint64_t fast_hash64(StringRef data)
    return h64;
 }
 
+namespace {
+
+const uint32_t PRIME32_1 = 0x9E3779B1U;
+const uint32_t PRIME32_2 = 0x85EBCA77U;
+const uint32_t PRIME32_3 = 0xC2B2AE3DU;
+const uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+const uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+enum { XXH3_STRIPE_LENGTH = 64 };
+enum { XXH3_SECRET_CONSUME_RATE = 8 };
+enum { XXH3_SECRET_SIZE = 192 };
+enum { XXH3_SECRET_LIMIT = XXH3_SECRET_SIZE - XXH3_STRIPE_LENGTH };
+enum { XXH3_STRIPES_PER_BLOCK = XXH3_SECRET_LIMIT / XXH3_SECRET_CONSUME_RATE };
+enum { XXH3_MIDSIZE_MAX = 240 };
+enum { XXH3_MIDSIZE_START_OFFSET = 3 };
+enum { XXH3_MIDSIZE_LAST_OFFSET = 17 };
+enum { XXH3_SECRET_SIZE_MIN = 136 };
+enum { XXH3_SECRET_LASTACC_START = 7 };
+enum { XXH3_SECRET_MERGEACCS_START = 11 };
+
+/// Pseudorandom secret taken directly from FARSH.
+alignas(64) const uint8_t sg_xxh3Secret[XXH3_SECRET_SIZE] = {
+   0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+   0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+   0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+   0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+   0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+   0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+   0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+   0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+   0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+   0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+   0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+   0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+const uint64_t sg_xxh3InitAcc[8] = {
+   PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+   PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+};
+
+inline uint32_t swap32(uint32_t value)
+{
+   return __builtin_bswap32(value);
+}
+
+inline uint64_t swap64(uint64_t value)
+{
+   return __builtin_bswap64(value);
+}
+
+inline Xxh3Hash128 mult64to128(uint64_t lhs, uint64_t rhs)
+{
+#ifdef __SIZEOF_INT128__
+   unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+   return {static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64)};
+#else
+   uint64_t loLo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+   uint64_t hiLo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+   uint64_t loHi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+   uint64_t hiHi = (lhs >> 32) * (rhs >> 32);
+   uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+   uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+   uint64_t lower = (cross << 32) | (loLo & 0xFFFFFFFF);
+   return {lower, upper};
+#endif
+}
+
+inline uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs)
+{
+   Xxh3Hash128 product = mult64to128(lhs, rhs);
+   return product.m_low64 ^ product.m_high64;
+}
+
+inline uint64_t xorshift64(uint64_t value, int shift)
+{
+   return value ^ (value >> shift);
+}
+
+uint64_t xxh64_avalanche(uint64_t hash)
+{
+   hash ^= hash >> 33;
+   hash *= PRIME64_2;
+   hash ^= hash >> 29;
+   hash *= PRIME64_3;
+   hash ^= hash >> 32;
+   return hash;
+}
+
+uint64_t xxh3_avalanche(uint64_t hash)
+{
+   hash = xorshift64(hash, 37);
+   hash *= PRIME_MX1;
+   return xorshift64(hash, 32);
+}
+
+uint64_t xxh3_rrmxmx(uint64_t hash, uint64_t length)
+{
+   hash ^= rotl64(hash, 49) ^ rotl64(hash, 24);
+   hash *= PRIME_MX2;
+   hash ^= (hash >> 35) + length;
+   hash *= PRIME_MX2;
+   return xorshift64(hash, 28);
+}
+
+inline uint64_t mix16(const uint8_t *input, const uint8_t *secret, uint64_t seed)
+{
+   return mul128_fold64(endian::read64le(input) ^ (endian::read64le(secret) + seed),
+                        endian::read64le(input + 8) ^ (endian::read64le(secret + 8) - seed));
+}
+
+inline Xxh3Hash128 mix32(Xxh3Hash128 acc, const uint8_t *input1, const uint8_t *input2,
+                         const uint8_t *secret, uint64_t seed)
+{
+   acc.m_low64 += mix16(input1, secret, seed);
+   acc.m_low64 ^= endian::read64le(input2) + endian::read64le(input2 + 8);
+   acc.m_high64 += mix16(input2, secret + 16, seed);
+   acc.m_high64 ^= endian::read64le(input1) + endian::read64le(input1 + 8);
+   return acc;
+}
+
+uint64_t hash64_0to16(const uint8_t *input, size_t length, const uint8_t *secret,
+                      uint64_t seed)
+{
+   if (length > 8) {
+      uint64_t bitflip1 = (endian::read64le(secret + 24) ^ endian::read64le(secret + 32)) + seed;
+      uint64_t bitflip2 = (endian::read64le(secret + 40) ^ endian::read64le(secret + 48)) - seed;
+      uint64_t inputLow = endian::read64le(input) ^ bitflip1;
+      uint64_t inputHigh = endian::read64le(input + length - 8) ^ bitflip2;
+      uint64_t acc = length + swap64(inputLow) + inputHigh +
+            mul128_fold64(inputLow, inputHigh);
+      return xxh3_avalanche(acc);
+   }
+   if (length >= 4) {
+      seed ^= static_cast<uint64_t>(swap32(static_cast<uint32_t>(seed))) << 32;
+      uint32_t input1 = endian::read32le(input);
+      uint32_t input2 = endian::read32le(input + length - 4);
+      uint64_t bitflip = (endian::read64le(secret + 8) ^ endian::read64le(secret + 16)) - seed;
+      uint64_t input64 = input2 + (static_cast<uint64_t>(input1) << 32);
+      return xxh3_rrmxmx(input64 ^ bitflip, length);
+   }
+   if (length) {
+      uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) |
+            (static_cast<uint32_t>(input[length >> 1]) << 24) |
+            static_cast<uint32_t>(input[length - 1]) |
+            (static_cast<uint32_t>(length) << 8);
+      uint64_t bitflip = (endian::read32le(secret) ^ endian::read32le(secret + 4)) + seed;
+      return xxh64_avalanche(static_cast<uint64_t>(combined) ^ bitflip);
+   }
+   return xxh64_avalanche(seed ^ (endian::read64le(secret + 56) ^ endian::read64le(secret + 64)));
+}
+
+uint64_t hash64_17to128(const uint8_t *input, size_t length, const uint8_t *secret,
+                        uint64_t seed)
+{
+   uint64_t acc = length * PRIME64_1;
+   if (length > 32) {
+      if (length > 64) {
+         if (length > 96) {
+            acc += mix16(input + 48, secret + 96, seed);
+            acc += mix16(input + length - 64, secret + 112, seed);
+         }
+         acc += mix16(input + 32, secret + 64, seed);
+         acc += mix16(input + length - 48, secret + 80, seed);
+      }
+      acc += mix16(input + 16, secret + 32, seed);
+      acc += mix16(input + length - 32, secret + 48, seed);
+   }
+   acc += mix16(input, secret, seed);
+   acc += mix16(input + length - 16, secret + 16, seed);
+   return xxh3_avalanche(acc);
+}
+
+uint64_t hash64_129to240(const uint8_t *input, size_t length, const uint8_t *secret,
+                         uint64_t seed)
+{
+   uint64_t acc = length * PRIME64_1;
+   unsigned rounds = static_cast<unsigned>(length) / 16;
+   for (unsigned i = 0; i < 8; ++i) {
+      acc += mix16(input + 16 * i, secret + 16 * i, seed);
+   }
+   acc = xxh3_avalanche(acc);
+   uint64_t accEnd = mix16(input + length - 16,
+                           secret + XXH3_SECRET_SIZE_MIN - XXH3_MIDSIZE_LAST_OFFSET, seed);
+   for (unsigned i = 8; i < rounds; ++i) {
+      accEnd += mix16(input + 16 * i, secret + 16 * (i - 8) + XXH3_MIDSIZE_START_OFFSET, seed);
+   }
+   return xxh3_avalanche(acc + accEnd);
+}
+
+Xxh3Hash128 hash128_0to16(const uint8_t *input, size_t length, const uint8_t *secret,
+                          uint64_t seed)
+{
+   if (length > 8) {
+      uint64_t bitflipLow = (endian::read64le(secret + 32) ^ endian::read64le(secret + 40)) - seed;
+      uint64_t bitflipHigh = (endian::read64le(secret + 48) ^ endian::read64le(secret + 56)) + seed;
+      uint64_t inputLow = endian::read64le(input);
+      uint64_t inputHigh = endian::read64le(input + length - 8);
+      Xxh3Hash128 m128 = mult64to128(inputLow ^ inputHigh ^ bitflipLow, PRIME64_1);
+      m128.m_low64 += static_cast<uint64_t>(length - 1) << 54;
+      inputHigh ^= bitflipHigh;
+      m128.m_high64 += inputHigh + static_cast<uint64_t>(static_cast<uint32_t>(inputHigh)) *
+            (PRIME32_2 - 1);
+      m128.m_low64 ^= swap64(m128.m_high64);
+      Xxh3Hash128 h128 = mult64to128(m128.m_low64, PRIME64_2);
+      h128.m_high64 += m128.m_high64 * PRIME64_2;
+      h128.m_low64 = xxh3_avalanche(h128.m_low64);
+      h128.m_high64 = xxh3_avalanche(h128.m_high64);
+      return h128;
+   }
+   if (length >= 4) {
+      seed ^= static_cast<uint64_t>(swap32(static_cast<uint32_t>(seed))) << 32;
+      uint32_t inputLow = endian::read32le(input);
+      uint32_t inputHigh = endian::read32le(input + length - 4);
+      uint64_t input64 = inputLow + (static_cast<uint64_t>(inputHigh) << 32);
+      uint64_t bitflip = (endian::read64le(secret + 16) ^ endian::read64le(secret + 24)) + seed;
+      Xxh3Hash128 m128 = mult64to128(input64 ^ bitflip, PRIME64_1 + (length << 2));
+      m128.m_high64 += m128.m_low64 << 1;
+      m128.m_low64 ^= m128.m_high64 >> 3;
+      m128.m_low64 = xorshift64(m128.m_low64, 35);
+      m128.m_low64 *= PRIME_MX2;
+      m128.m_low64 = xorshift64(m128.m_low64, 28);
+      m128.m_high64 = xxh3_avalanche(m128.m_high64);
+      return m128;
+   }
+   if (length) {
+      uint32_t combinedLow = (static_cast<uint32_t>(input[0]) << 16) |
+            (static_cast<uint32_t>(input[length >> 1]) << 24) |
+            static_cast<uint32_t>(input[length - 1]) |
+            (static_cast<uint32_t>(length) << 8);
+      uint32_t swapped = swap32(combinedLow);
+      uint32_t combinedHigh = (swapped << 13) | (swapped >> 19);
+      uint64_t bitflipLow = (endian::read32le(secret) ^ endian::read32le(secret + 4)) + seed;
+      uint64_t bitflipHigh = (endian::read32le(secret + 8) ^ endian::read32le(secret + 12)) - seed;
+      return {xxh64_avalanche(combinedLow ^ bitflipLow),
+               xxh64_avalanche(combinedHigh ^ bitflipHigh)};
+   }
+   uint64_t bitflipLow = endian::read64le(secret + 64) ^ endian::read64le(secret + 72);
+   uint64_t bitflipHigh = endian::read64le(secret + 80) ^ endian::read64le(secret + 88);
+   return {xxh64_avalanche(seed ^ bitflipLow), xxh64_avalanche(seed ^ bitflipHigh)};
+}
+
+Xxh3Hash128 finish_mid128(Xxh3Hash128 acc, size_t length, uint64_t seed)
+{
+   Xxh3Hash128 h128;
+   h128.m_low64 = acc.m_low64 + acc.m_high64;
+   h128.m_high64 = acc.m_low64 * PRIME64_1 + acc.m_high64 * PRIME64_4 +
+         (length - seed) * PRIME64_2;
+   h128.m_low64 = xxh3_avalanche(h128.m_low64);
+   h128.m_high64 = 0 - xxh3_avalanche(h128.m_high64);
+   return h128;
+}
+
+Xxh3Hash128 hash128_17to128(const uint8_t *input, size_t length, const uint8_t *secret,
+                            uint64_t seed)
+{
+   Xxh3Hash128 acc = {length * PRIME64_1, 0};
+   if (length > 32) {
+      if (length > 64) {
+         if (length > 96) {
+            acc = mix32(acc, input + 48, input + length - 64, secret + 96, seed);
+         }
+         acc = mix32(acc, input + 32, input + length - 48, secret + 64, seed);
+      }
+      acc = mix32(acc, input + 16, input + length - 32, secret + 32, seed);
+   }
+   acc = mix32(acc, input, input + length - 16, secret, seed);
+   return finish_mid128(acc, length, seed);
+}
+
+Xxh3Hash128 hash128_129to240(const uint8_t *input, size_t length, const uint8_t *secret,
+                             uint64_t seed)
+{
+   Xxh3Hash128 acc = {length * PRIME64_1, 0};
+   for (size_t i = 32; i < 160; i += 32) {
+      acc = mix32(acc, input + i - 32, input + i - 16, secret + i - 32, seed);
+   }
+   acc.m_low64 = xxh3_avalanche(acc.m_low64);
+   acc.m_high64 = xxh3_avalanche(acc.m_high64);
+   for (size_t i = 160; i <= length; i += 32) {
+      acc = mix32(acc, input + i - 32, input + i - 16,
+                  secret + XXH3_MIDSIZE_START_OFFSET + i - 160, seed);
+   }
+   acc = mix32(acc, input + length - 16, input + length - 32,
+               secret + XXH3_SECRET_SIZE_MIN - XXH3_MIDSIZE_LAST_OFFSET - 16, 0 - seed);
+   return finish_mid128(acc, length, seed);
+}
+
+// Long inputs are consumed one 64-byte stripe at a time into eight 64-bit
+// accumulators, scrambling them after every block of 16 stripes. Those two
+// steps are where nearly all of the time goes, so they come in scalar, SSE2 and
+// AVX2 flavours; the rest of the algorithm only ever calls them through
+// Xxh3Kernel.
+
+typedef void (*Xxh3AccumulateFunc)(uint64_t *acc, const uint8_t *input,
+                                   const uint8_t *secret, size_t stripes);
+typedef void (*Xxh3ScrambleFunc)(uint64_t *acc, const uint8_t *secret);
+
+struct Xxh3Kernel
+{
+   Xxh3AccumulateFunc m_accumulate;
+   Xxh3ScrambleFunc m_scramble;
+};
+
+void accumulate_scalar(uint64_t *acc, const uint8_t *input, const uint8_t *secret,
+                       size_t stripes)
+{
+   for (size_t n = 0; n < stripes; ++n) {
+      const uint8_t *stripe = input + n * XXH3_STRIPE_LENGTH;
+      const uint8_t *key = secret + n * XXH3_SECRET_CONSUME_RATE;
+      for (size_t lane = 0; lane < 8; ++lane) {
+         uint64_t dataValue = endian::read64le(stripe + lane * 8);
+         uint64_t dataKey = dataValue ^ endian::read64le(key + lane * 8);
+         acc[lane ^ 1] += dataValue;
+         acc[lane] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+      }
+   }
+}
+
+void scramble_scalar(uint64_t *acc, const uint8_t *secret)
+{
+   for (size_t lane = 0; lane < 8; ++lane) {
+      uint64_t value = xorshift64(acc[lane], 47);
+      value ^= endian::read64le(secret + lane * 8);
+      acc[lane] = value * PRIME32_1;
+   }
+}
+
+#ifdef POLAR_HAVE_XXH3_X86_KERNELS
+
+void accumulate_sse2(uint64_t *acc, const uint8_t *input, const uint8_t *secret,
+                     size_t stripes)
+{
+   __m128i *xacc = reinterpret_cast<__m128i *>(acc);
+   for (size_t n = 0; n < stripes; ++n) {
+      const __m128i *xinput = reinterpret_cast<const __m128i *>(input + n * XXH3_STRIPE_LENGTH);
+      const __m128i *xsecret =
+            reinterpret_cast<const __m128i *>(secret + n * XXH3_SECRET_CONSUME_RATE);
+      for (size_t i = 0; i < XXH3_STRIPE_LENGTH / sizeof(__m128i); ++i) {
+         __m128i dataVec = _mm_loadu_si128(xinput + i);
+         __m128i dataKey = _mm_xor_si128(dataVec, _mm_loadu_si128(xsecret + i));
+         __m128i dataKeyLow = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+         __m128i product = _mm_mul_epu32(dataKey, dataKeyLow);
+         __m128i dataSwap = _mm_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+         xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], dataSwap));
+      }
+   }
+}
+
+void scramble_sse2(uint64_t *acc, const uint8_t *secret)
+{
+   __m128i *xacc = reinterpret_cast<__m128i *>(acc);
+   const __m128i *xsecret = reinterpret_cast<const __m128i *>(secret);
+   const __m128i prime32 = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+   for (size_t i = 0; i < XXH3_STRIPE_LENGTH / sizeof(__m128i); ++i) {
+      __m128i accVec = xacc[i];
+      __m128i dataVec = _mm_xor_si128(accVec, _mm_srli_epi64(accVec, 47));
+      __m128i dataKey = _mm_xor_si128(dataVec, _mm_loadu_si128(xsecret + i));
+      __m128i dataKeyHigh = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+      __m128i productLow = _mm_mul_epu32(dataKey, prime32);
+      __m128i productHigh = _mm_mul_epu32(dataKeyHigh, prime32);
+      xacc[i] = _mm_add_epi64(productLow, _mm_slli_epi64(productHigh, 32));
+   }
+}
+
+__attribute__((target("avx2")))
+void accumulate_avx2(uint64_t *acc, const uint8_t *input, const uint8_t *secret,
+                     size_t stripes)
+{
+   __m256i *xacc = reinterpret_cast<__m256i *>(acc);
+   for (size_t n = 0; n < stripes; ++n) {
+      const __m256i *xinput = reinterpret_cast<const __m256i *>(input + n * XXH3_STRIPE_LENGTH);
+      const __m256i *xsecret =
+            reinterpret_cast<const __m256i *>(secret + n * XXH3_SECRET_CONSUME_RATE);
+      for (size_t i = 0; i < XXH3_STRIPE_LENGTH / sizeof(__m256i); ++i) {
+         __m256i dataVec = _mm256_loadu_si256(xinput + i);
+         __m256i dataKey = _mm256_xor_si256(dataVec, _mm256_loadu_si256(xsecret + i));
+         __m256i dataKeyLow = _mm256_srli_epi64(dataKey, 32);
+         __m256i product = _mm256_mul_epu32(dataKey, dataKeyLow);
+         __m256i dataSwap = _mm256_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+         xacc[i] = _mm256_add_epi64(product, _mm256_add_epi64(xacc[i], dataSwap));
+      }
+   }
+}
+
+__attribute__((target("avx2")))
+void scramble_avx2(uint64_t *acc, const uint8_t *secret)
+{
+   __m256i *xacc = reinterpret_cast<__m256i *>(acc);
+   const __m256i *xsecret = reinterpret_cast<const __m256i *>(secret);
+   const __m256i prime32 = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+   for (size_t i = 0; i < XXH3_STRIPE_LENGTH / sizeof(__m256i); ++i) {
+      __m256i accVec = xacc[i];
+      __m256i dataVec = _mm256_xor_si256(accVec, _mm256_srli_epi64(accVec, 47));
+      __m256i dataKey = _mm256_xor_si256(dataVec, _mm256_loadu_si256(xsecret + i));
+      __m256i dataKeyHigh = _mm256_srli_epi64(dataKey, 32);
+      __m256i productLow = _mm256_mul_epu32(dataKey, prime32);
+      __m256i productHigh = _mm256_mul_epu32(dataKeyHigh, prime32);
+      xacc[i] = _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32));
+   }
+}
+
+#endif // POLAR_HAVE_XXH3_X86_KERNELS
+
+bool host_has_avx2()
+{
+#ifdef POLAR_HAVE_XXH3_X86_KERNELS
+   static const bool hasAvx2 = [] {
+      polar::basic::StringMap<bool> features;
+      return polar::sys::get_host_cpu_features(features) && features.lookup("avx2");
+   }();
+   return hasAvx2;
+#else
+   return false;
+#endif
+}
+
+/// The kernel set by internal::set_xxh3_implementation(), if any.
+Xxh3Kernel sg_pinnedKernel = {nullptr, nullptr};
+
+/// Picks the widest accumulation kernel the host supports, unless a test
+/// pinned one. The probe runs once per process.
+const Xxh3Kernel &get_xxh3_kernel()
+{
+   if (sg_pinnedKernel.m_accumulate) {
+      return sg_pinnedKernel;
+   }
+   static const Xxh3Kernel kernel = [] {
+#ifdef POLAR_HAVE_XXH3_X86_KERNELS
+      if (host_has_avx2()) {
+         return Xxh3Kernel{accumulate_avx2, scramble_avx2};
+      }
+      return Xxh3Kernel{accumulate_sse2, scramble_sse2};
+#else
+      return Xxh3Kernel{accumulate_scalar, scramble_scalar};
+#endif
+   }();
+   return kernel;
+}
+
+void init_custom_secret(uint8_t *customSecret, uint64_t seed)
+{
+   for (size_t i = 0; i < XXH3_SECRET_SIZE; i += 16) {
+      endian::write64le(customSecret + i, endian::read64le(sg_xxh3Secret + i) + seed);
+      endian::write64le(customSecret + i + 8, endian::read64le(sg_xxh3Secret + i + 8) - seed);
+   }
+}
+
+/// Feeds \p stripes whole stripes to \p acc, scrambling at every block
+/// boundary. \p stripesSoFar tracks the position inside the current block.
+const uint8_t *consume_stripes(const Xxh3Kernel &kernel, uint64_t *acc,
+                               size_t &stripesSoFar, const uint8_t *input,
+                               size_t stripes, const uint8_t *secret)
+{
+   while (stripes) {
+      size_t count = std::min<size_t>(stripes, XXH3_STRIPES_PER_BLOCK - stripesSoFar);
+      kernel.m_accumulate(acc, input, secret + stripesSoFar * XXH3_SECRET_CONSUME_RATE, count);
+      input += count * XXH3_STRIPE_LENGTH;
+      stripes -= count;
+      stripesSoFar += count;
+      if (stripesSoFar == XXH3_STRIPES_PER_BLOCK) {
+         kernel.m_scramble(acc, secret + XXH3_SECRET_LIMIT);
+         stripesSoFar = 0;
+      }
+   }
+   return input;
+}
+
+uint64_t merge_accs(const uint64_t *acc, const uint8_t *secret, uint64_t start)
+{
+   uint64_t result = start;
+   for (size_t i = 0; i < 4; ++i) {
+      result += mul128_fold64(acc[2 * i] ^ endian::read64le(secret + 16 * i),
+                              acc[2 * i + 1] ^ endian::read64le(secret + 16 * i + 8));
+   }
+   return xxh3_avalanche(result);
+}
+
+Xxh3Hash128 merge_accs128(const uint64_t *acc, const uint8_t *secret, uint64_t length)
+{
+   return {merge_accs(acc, secret + XXH3_SECRET_MERGEACCS_START, length * PRIME64_1),
+            merge_accs(acc, secret + XXH3_SECRET_SIZE - 64 - XXH3_SECRET_MERGEACCS_START,
+            ~(length * PRIME64_2))};
+}
+
+/// Runs the accumulation loop over an input longer than XXH3_MIDSIZE_MAX.
+void hash_long(uint64_t *acc, const uint8_t *input, size_t length, const uint8_t *secret)
+{
+   const Xxh3Kernel &kernel = get_xxh3_kernel();
+   std::memcpy(acc, sg_xxh3InitAcc, sizeof(sg_xxh3InitAcc));
+   size_t stripesSoFar = 0;
+   consume_stripes(kernel, acc, stripesSoFar, input, (length - 1) / XXH3_STRIPE_LENGTH, secret);
+   kernel.m_accumulate(acc, input + length - XXH3_STRIPE_LENGTH,
+                       secret + XXH3_SECRET_LIMIT - XXH3_SECRET_LASTACC_START, 1);
+}
+
+uint64_t xxh3_hash64_impl(const uint8_t *input, size_t length, uint64_t seed)
+{
+   if (length <= 16) {
+      return hash64_0to16(input, length, sg_xxh3Secret, seed);
+   }
+   if (length <= 128) {
+      return hash64_17to128(input, length, sg_xxh3Secret, seed);
+   }
+   if (length <= XXH3_MIDSIZE_MAX) {
+      return hash64_129to240(input, length, sg_xxh3Secret, seed);
+   }
+   alignas(64) uint8_t customSecret[XXH3_SECRET_SIZE];
+   const uint8_t *secret = sg_xxh3Secret;
+   if (seed) {
+      init_custom_secret(customSecret, seed);
+      secret = customSecret;
+   }
+   alignas(64) uint64_t acc[8];
+   hash_long(acc, input, length, secret);
+   return merge_accs(acc, secret + XXH3_SECRET_MERGEACCS_START, length * PRIME64_1);
+}
+
+Xxh3Hash128 xxh3_hash128_impl(const uint8_t *input, size_t length, uint64_t seed)
+{
+   if (length <= 16) {
+      return hash128_0to16(input, length, sg_xxh3Secret, seed);
+   }
+   if (length <= 128) {
+      return hash128_17to128(input, length, sg_xxh3Secret, seed);
+   }
+   if (length <= XXH3_MIDSIZE_MAX) {
+      return hash128_129to240(input, length, sg_xxh3Secret, seed);
+   }
+   alignas(64) uint8_t customSecret[XXH3_SECRET_SIZE];
+   const uint8_t *secret = sg_xxh3Secret;
+   if (seed) {
+      init_custom_secret(customSecret, seed);
+      secret = customSecret;
+   }
+   alignas(64) uint64_t acc[8];
+   hash_long(acc, input, length, secret);
+   return merge_accs128(acc, secret, length);
+}
+
+/// Forwards whatever a Twine prints straight into a hasher.
+class Xxh3TwineSink : public RawOutStream
+{
+public:
+   explicit Xxh3TwineSink(Xxh3Hasher &hasher)
+      : RawOutStream(/*unbuffered=*/true),
+        m_hasher(hasher)
+   {}
+
+private:
+   void writeImpl(const char *ptr, size_t size) override
+   {
+      m_hasher.update(StringRef(ptr, size));
+   }
+
+   uint64_t getCurrentPos() const override
+   {
+      return 0;
+   }
+
+   Xxh3Hasher &m_hasher;
+};
+
+} // anonymous namespace
+
+namespace internal {
+
+bool set_xxh3_implementation(Xxh3Implementation impl)
+{
+   switch (impl) {
+   case Xxh3Implementation::Host:
+      sg_pinnedKernel = Xxh3Kernel{nullptr, nullptr};
+      return true;
+   case Xxh3Implementation::Scalar:
+      sg_pinnedKernel = Xxh3Kernel{accumulate_scalar, scramble_scalar};
+      return true;
+#ifdef POLAR_HAVE_XXH3_X86_KERNELS
+   case Xxh3Implementation::Sse2:
+      sg_pinnedKernel = Xxh3Kernel{accumulate_sse2, scramble_sse2};
+      return true;
+   case Xxh3Implementation::Avx2:
+      if (!host_has_avx2()) {
+         return false;
+      }
+      sg_pinnedKernel = Xxh3Kernel{accumulate_avx2, scramble_avx2};
+      return true;
+#endif
+   default:
+      return false;
+   }
+}
+
+} // internal
+
+HashCode hash_value(const Xxh3Hash128 &hash)
+{
+   return polar::basic::hash_combine(hash.m_low64, hash.m_high64);
+}
+
+uint64_t xxh3_hash64(ArrayRef<uint8_t> data, uint64_t seed)
+{
+   return xxh3_hash64_impl(data.getData(), data.getSize(), seed);
+}
+
+uint64_t xxh3_hash64(StringRef data, uint64_t seed)
+{
+   return xxh3_hash64_impl(reinterpret_cast<const uint8_t *>(data.getData()),
+                           data.getSize(), seed);
+}
+
+Xxh3Hash128 xxh3_hash128(ArrayRef<uint8_t> data, uint64_t seed)
+{
+   return xxh3_hash128_impl(data.getData(), data.getSize(), seed);
+}
+
+Xxh3Hash128 xxh3_hash128(StringRef data, uint64_t seed)
+{
+   return xxh3_hash128_impl(reinterpret_cast<const uint8_t *>(data.getData()),
+                            data.getSize(), seed);
+}
+
+void Xxh3Hasher::init(uint64_t seed)
+{
+   std::memcpy(m_acc, sg_xxh3InitAcc, sizeof(m_acc));
+   if (seed) {
+      init_custom_secret(m_customSecret, seed);
+   }
+   m_totalLength = 0;
+   m_seed = seed;
+   m_stripesSoFar = 0;
+   m_bufferedSize = 0;
+}
+
+const uint8_t *Xxh3Hasher::getSecret() const
+{
+   return m_seed ? m_customSecret : sg_xxh3Secret;
+}
+
+void Xxh3Hasher::update(ArrayRef<uint8_t> data)
+{
+   const uint8_t *input = data.getData();
+   const uint8_t *end = input + data.getSize();
+   m_totalLength += data.getSize();
+   if (data.getSize() <= BUFFER_SIZE - m_bufferedSize) {
+      if (!data.empty()) {
+         std::memcpy(m_buffer + m_bufferedSize, input, data.getSize());
+      }
+      m_bufferedSize += data.getSize();
+      return;
+   }
+   // The buffer is only drained once more input is known to follow, so that
+   // the final stripe is always available to final() for the last-stripe
+   // accumulation.
+   const Xxh3Kernel &kernel = get_xxh3_kernel();
+   const uint8_t *secret = getSecret();
+   if (m_bufferedSize) {
+      size_t loadSize = BUFFER_SIZE - m_bufferedSize;
+      std::memcpy(m_buffer + m_bufferedSize, input, loadSize);
+      input += loadSize;
+      consume_stripes(kernel, m_acc, m_stripesSoFar, m_buffer,
+                      BUFFER_SIZE / XXH3_STRIPE_LENGTH, secret);
+      m_bufferedSize = 0;
+   }
+   if (end - input > BUFFER_SIZE) {
+      size_t stripes = static_cast<size_t>(end - 1 - input) / XXH3_STRIPE_LENGTH;
+      input = consume_stripes(kernel, m_acc, m_stripesSoFar, input, stripes, secret);
+      // Keep the last consumed stripe around in case final() needs it to
+      // assemble a trailing partial stripe.
+      std::memcpy(m_buffer + BUFFER_SIZE - XXH3_STRIPE_LENGTH, input - XXH3_STRIPE_LENGTH,
+                  XXH3_STRIPE_LENGTH);
+   }
+   std::memcpy(m_buffer, input, end - input);
+   m_bufferedSize = static_cast<uint32_t>(end - input);
+}
+
+void Xxh3Hasher::update(const Twine &str)
+{
+   if (str.isSingleStringRef()) {
+      update(str.getSingleStringRef());
+      return;
+   }
+   Xxh3TwineSink sink(*this);
+   str.print(sink);
+}
+
+void Xxh3Hasher::digestLong(uint64_t *acc) const
+{
+   const Xxh3Kernel &kernel = get_xxh3_kernel();
+   const uint8_t *secret = getSecret();
+   alignas(64) uint8_t lastStripe[XXH3_STRIPE_LENGTH];
+   const uint8_t *lastStripePtr;
+   std::memcpy(acc, m_acc, sizeof(m_acc));
+   if (m_bufferedSize >= XXH3_STRIPE_LENGTH) {
+      size_t stripesSoFar = m_stripesSoFar;
+      consume_stripes(kernel, acc, stripesSoFar, m_buffer,
+                      (m_bufferedSize - 1) / XXH3_STRIPE_LENGTH, secret);
+      lastStripePtr = m_buffer + m_bufferedSize - XXH3_STRIPE_LENGTH;
+   } else {
+      size_t catchupSize = XXH3_STRIPE_LENGTH - m_bufferedSize;
+      std::memcpy(lastStripe, m_buffer + BUFFER_SIZE - catchupSize, catchupSize);
+      std::memcpy(lastStripe + catchupSize, m_buffer, m_bufferedSize);
+      lastStripePtr = lastStripe;
+   }
+   kernel.m_accumulate(acc, lastStripePtr,
+                       secret + XXH3_SECRET_LIMIT - XXH3_SECRET_LASTACC_START, 1);
+}
+
+uint64_t Xxh3Hasher::final() const
+{
+   if (m_totalLength <= XXH3_MIDSIZE_MAX) {
+      return xxh3_hash64_impl(m_buffer, m_totalLength, m_seed);
+   }
+   alignas(64) uint64_t acc[8];
+   digestLong(acc);
+   return merge_accs(acc, getSecret() + XXH3_SECRET_MERGEACCS_START,
+                     m_totalLength * PRIME64_1);
+}
+
+Xxh3Hash128 Xxh3Hasher::final128() const
+{
+   if (m_totalLength <= XXH3_MIDSIZE_MAX) {
+      return xxh3_hash128_impl(m_buffer, m_totalLength, m_seed);
+   }
+   alignas(64) uint64_t acc[8];
+   digestLong(acc);
+   return merge_accs128(acc, getSecret(), m_totalLength);
+}
 
 } // utils
+
+namespace basic {
+namespace hashing {
+namespace internal {
+
+uint64_t hash_bytes_xxh3(const char *s, size_t length, uint64_t seed)
+{
+   return polar::utils::xxh3_hash64(StringRef(s, length), seed);
+}
+
+} // internal
+} // hashing
+} // basic
 } // polar
@@ -19,8 +19,13 @@
 #include "polar/basic/adt/StlExtras.h"
 #include "polar/basic/adt/SmallString.h"
 #include "polar/utils/ErrorCode.h"
+#include "polar/utils/MathExtras.h"
 #include "polar/utils/Memory.h"
+#include "polar/utils/Parallel.h"
 #include "polar/utils/Path.h"
+#include "polar/utils/Process.h"
+#include <algorithm>
+#include <cstring>
 #include <system_error>
 
 #if !defined(_MSC_VER) && !defined(__MINGW32__)
@@ -44,8 +49,13 @@ class OnDiskBuffer : public FileOutputBuffer
 {
 public:
    OnDiskBuffer(StringRef path, fs::TempFile temp,
-                std::unique_ptr<fs::MappedFileRegion> Buf)
-      : FileOutputBuffer(path), m_buffer(std::move(Buf)), m_temp(std::move(temp))
+                std::unique_ptr<fs::MappedFileRegion> Buf, size_t size, bool growable)
+      : FileOutputBuffer(path),
+        m_buffer(std::move(Buf)),
+        m_temp(std::move(temp)),
+        m_size(size),
+        m_highWater(size),
+        m_growable(growable)
    {}
 
    uint8_t *getBufferStart() const override
@@ -55,18 +65,57 @@ public:
 
    uint8_t *getBufferEnd() const override
    {
-      return (uint8_t *)m_buffer->getData() + m_buffer->getSize();
+      return (uint8_t *)m_buffer->getData() + m_size;
    }
 
    size_t getBufferSize() const override
    {
-      return m_buffer->getSize();
+      return m_size;
+   }
+
+   Error resize(size_t size) override
+   {
+      size_t capacity = m_buffer->getSize();
+      if (size > capacity) {
+         if (!m_growable) {
+            return error_code_to_error(ErrorCode::invalid_argument);
+         }
+         // Grow by half at least, so that appending by small steps takes
+         // amortized constant time.
+         size_t newCapacity = align_to(std::max(size, capacity + capacity / 2),
+                                       fs::MappedFileRegion::getAlignment());
+         if (std::error_code errorCode = fs::resize_file(m_temp.m_fd, newCapacity)) {
+            return error_code_to_error(errorCode);
+         }
+         if (std::error_code errorCode = m_buffer->resize(newCapacity)) {
+            return error_code_to_error(errorCode);
+         }
+      }
+      // The file is all zeros past the high water mark, but not before.
+      if (size > m_size && m_size < m_highWater) {
+         memset(getBufferStart() + m_size, 0, std::min(size, m_highWater) - m_size);
+      }
+      m_size = size;
+      m_highWater = std::max(m_highWater, size);
+      return Error::getSuccess();
+   }
+
+   Error writeBack(size_t offset, size_t length) override
+   {
+      assert(offset <= m_size && length <= m_size - offset && "range out of the buffer");
+      return error_code_to_error(m_buffer->writeBack(offset, length));
    }
 
    Error commit() override
    {
+      bool truncate = m_size != m_buffer->getSize();
       // Unmap buffer, letting OS flush dirty pages to file on disk.
       m_buffer.reset();
+      if (truncate) {
+         if (std::error_code errorCode = fs::resize_file(m_temp.m_fd, m_size)) {
+            return error_code_to_error(errorCode);
+         }
+      }
       // Atomically replace the existing file with the new one.
       return m_temp.keep(m_finalPath);
    }
@@ -81,6 +130,10 @@ public:
 private:
    std::unique_ptr<fs::MappedFileRegion> m_buffer;
    fs::TempFile m_temp;
+   size_t m_size;
+   /// The largest size the buffer had, beyond which the file holds zeros.
+   size_t m_highWater;
+   bool m_growable;
 };
 
 // A FileOutputBuffer which keeps data in memory and writes to the final
@@ -88,8 +141,13 @@ private:
 class InMemoryBuffer : public FileOutputBuffer
 {
 public:
-   InMemoryBuffer(StringRef path, MemoryBlock buffer, unsigned mode)
-      : FileOutputBuffer(path), m_buffer(buffer), m_mode(mode)
+   InMemoryBuffer(StringRef path, MemoryBlock buffer, size_t size, unsigned mode,
+                  bool growable)
+      : FileOutputBuffer(path),
+        m_buffer(buffer),
+        m_size(size),
+        m_mode(mode),
+        m_growable(growable)
    {}
 
    uint8_t *getBufferStart() const override
@@ -99,12 +157,39 @@ public:
 
    uint8_t *getBufferEnd() const override
    {
-      return (uint8_t *)m_buffer.getBase() + m_buffer.getSize();
+      return (uint8_t *)m_buffer.getBase() + m_size;
    }
 
    size_t getBufferSize() const override
    {
-      return m_buffer.getSize();
+      return m_size;
+   }
+
+   Error resize(size_t size) override
+   {
+      if (size > m_buffer.getSize()) {
+         if (!m_growable) {
+            return error_code_to_error(ErrorCode::invalid_argument);
+         }
+         std::error_code errorCode;
+         MemoryBlock block = Memory::allocateMappedMemory(
+                  std::max(size, m_buffer.getSize() + m_buffer.getSize() / 2), nullptr,
+                  sys::Memory::MF_READ | sys::Memory::MF_WRITE, errorCode);
+         if (errorCode) {
+            return error_code_to_error(errorCode);
+         }
+         memcpy(block.getBase(), m_buffer.getBase(), m_size);
+         m_buffer = OwningMemoryBlock(block);
+      } else if (size > m_size) {
+         memset(getBufferStart() + m_size, 0, size - m_size);
+      }
+      m_size = size;
+      return Error::getSuccess();
+   }
+
+   Error writeBack(size_t, size_t) override
+   {
+      return Error::getSuccess();
    }
 
    Error commit() override
@@ -115,30 +200,36 @@ public:
          return error_code_to_error(errorCode);
       }
       RawFdOutStream outstream(fd, /*shouldClose=*/true, /*unbuffered=*/true);
-      outstream << StringRef((const char *)m_buffer.getBase(), m_buffer.getSize());
+      outstream << StringRef((const char *)m_buffer.getBase(), m_size);
       return Error::getSuccess();
    }
 
 private:
    OwningMemoryBlock m_buffer;
+   size_t m_size;
    unsigned m_mode;
+   bool m_growable;
 };
 
 Expected<std::unique_ptr<InMemoryBuffer>>
-createInMemoryBuffer(StringRef path, size_t size, unsigned mode)
+createInMemoryBuffer(StringRef path, size_t size, unsigned mode, bool growable)
 {
    std::error_code errorCode;
    MemoryBlock block = Memory::allocateMappedMemory(
-            size, nullptr, sys::Memory::MF_READ | sys::Memory::MF_WRITE, errorCode);
+            std::max<size_t>(size, 1), nullptr,
+            sys::Memory::MF_READ | sys::Memory::MF_WRITE, errorCode);
    if (errorCode) {
       return error_code_to_error(errorCode);
    }
-   return std::make_unique<InMemoryBuffer>(path, block, mode);
+   return std::make_unique<InMemoryBuffer>(path, block, size, mode, growable);
 }
 
 Expected<std::unique_ptr<OnDiskBuffer>>
-createOnDiskBuffer(StringRef path, size_t size, unsigned mode)
+createOnDiskBuffer(StringRef path, size_t size, unsigned mode, bool growable)
 {
+   // Empty files cannot be mapped, so growable buffers start with a page.
+   size_t capacity = growable ? std::max<size_t>(size, fs::MappedFileRegion::getAlignment())
+                              : size;
    Expected<fs::TempFile> fileOrErr =
          fs::TempFile::create(path + ".tmp%%%%%%%", mode);
    if (!fileOrErr) {
@@ -153,7 +244,7 @@ createOnDiskBuffer(StringRef path, size_t size, unsigned mode)
    // extend the file beforehand. _chsize (ftruncate on Windows) is
    // pretty slow just like it writes specified amount of bytes,
    // so we should avoid calling that function.
-   if (auto errorCode = fs::resize_file(file.m_fd, size)) {
+   if (auto errorCode = fs::resize_file(file.m_fd, capacity)) {
       consume_error(file.discard());
       return error_code_to_error(errorCode);
    }
@@ -162,13 +253,13 @@ createOnDiskBuffer(StringRef path, size_t size, unsigned mode)
    // Mmap it.
    std::error_code errorCode;
    auto mappedFile = std::make_unique<fs::MappedFileRegion>(
-            file.m_fd, fs::MappedFileRegion::readwrite, size, 0, errorCode);
+            file.m_fd, fs::MappedFileRegion::readwrite, capacity, 0, errorCode);
    if (errorCode) {
       consume_error(file.discard());
       return error_code_to_error(errorCode);
    }
    return std::make_unique<OnDiskBuffer>(path, std::move(file),
-                                         std::move(mappedFile));
+                                         std::move(mappedFile), size, growable);
 }
 
 } // namespace
@@ -181,6 +272,7 @@ FileOutputBuffer::create(StringRef path, size_t size, unsigned flags) {
    if (flags & F_executable) {
       mode |= fs::all_exe;
    }
+   bool growable = flags & F_growable;
    fs::FileStatus stat;
    fs::status(path, stat);
 
@@ -198,10 +290,93 @@ FileOutputBuffer::create(StringRef path, size_t size, unsigned flags) {
    case fs::FileType::regular_file:
    case fs::FileType::file_not_found:
    case fs::FileType::status_error:
-      return createOnDiskBuffer(path, size, mode);
+      return createOnDiskBuffer(path, size, mode, growable);
    default:
-      return createInMemoryBuffer(path, size, mode);
+      return createInMemoryBuffer(path, size, mode, growable);
+   }
+}
+
+Expected<ParallelOutputWriter::Section>
+ParallelOutputWriter::allocate(size_t size, size_t alignment)
+{
+   assert(is_power_of_two_64(alignment) && "alignment must be a power of two");
+   size_t offset = align_to(m_end, alignment);
+   if (offset + size > m_buffer.getBufferSize()) {
+      if (Error error = m_buffer.resize(offset + size)) {
+         return std::move(error);
+      }
    }
+   {
+      std::lock_guard<std::mutex> locker(m_mutex);
+      ++m_pending;
+   }
+   m_sections.emplace_back(offset, size);
+   m_end = offset + size;
+   return Section(&m_buffer, offset, size);
+}
+
+Expected<ParallelOutputWriter::Section> ParallelOutputWriter::allocatePages(size_t size)
+{
+   size_t pageSize = sys::Process::getPageSize();
+   Expected<Section> section = allocate(size, pageSize);
+   if (section) {
+      // Keep the next section off the last page of this one.
+      m_end = align_to(m_end, pageSize);
+   }
+   return section;
+}
+
+void ParallelOutputWriter::complete(const Section &section)
+{
+   if (m_writeBack) {
+      // Only an optimization; commit() writes everything anyway.
+      consume_error(m_buffer.writeBack(section.getOffset(), section.getSize()));
+   }
+   std::lock_guard<std::mutex> locker(m_mutex);
+   assert(m_pending && "more sections completed than allocated");
+   if (--m_pending == 0) {
+      m_allComplete.notify_all();
+   }
+}
+
+void ParallelOutputWriter::wait()
+{
+   std::unique_lock<std::mutex> locker(m_mutex);
+   m_allComplete.wait(locker, [this] { return m_pending == 0; });
+}
+
+void ParallelOutputWriter::fillPadding(uint8_t value)
+{
+   // Chunks of the gaps between sections, of at most chunkSize bytes each.
+   const size_t chunkSize = 1 << 20;
+   std::vector<std::pair<size_t, size_t>> chunks;
+   size_t size = m_buffer.getBufferSize();
+   size_t begin = 0;
+   auto addGap = [&](size_t end) {
+      for (size_t offset = begin; offset < end; offset += chunkSize) {
+         chunks.emplace_back(offset, std::min(chunkSize, end - offset));
+      }
+   };
+   for (const std::pair<size_t, size_t> &section : m_sections) {
+      addGap(std::min(section.first, size));
+      begin = std::max(begin, section.first + section.second);
+   }
+   addGap(size);
+   uint8_t *data = m_buffer.getBufferStart();
+   auto fill = [&](const std::pair<size_t, size_t> &chunk) {
+      memset(data + chunk.first, value, chunk.second);
+   };
+   if (chunks.size() > 1) {
+      parallel::for_each(parallel::par, chunks.begin(), chunks.end(), fill);
+   } else {
+      std::for_each(chunks.begin(), chunks.end(), fill);
+   }
+}
+
+Error ParallelOutputWriter::commit()
+{
+   wait();
+   return m_buffer.commit();
 }
 
 } // utils
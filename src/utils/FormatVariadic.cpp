@@ -162,7 +162,14 @@ FormatvObjectBase::splitLiteralAndReplacement(StringRef fmt)
 std::vector<ReplacementItem>
 FormatvObjectBase::parseFormatString(StringRef fmt)
 {
-   std::vector<ReplacementItem> replacements;
+   SmallVector<ReplacementItem, 8> replacements;
+   parseFormatString(fmt, replacements);
+   return std::vector<ReplacementItem>(replacements.begin(), replacements.end());
+}
+
+void FormatvObjectBase::parseFormatString(StringRef fmt,
+                                          SmallVectorImpl<ReplacementItem> &replacements)
+{
    ReplacementItem replacementItem;
    while (!fmt.empty()) {
       std::tie(replacementItem, fmt) = splitLiteralAndReplacement(fmt);
@@ -170,7 +177,6 @@ FormatvObjectBase::parseFormatString(StringRef fmt)
          replacements.push_back(replacementItem);
       }
    }
-   return replacements;
 }
 
 } // utils
@@ -12,9 +12,16 @@
 #include "polar/utils/GlobPattern.h"
 #include "polar/basic/adt/ArrayRef.h"
 #include "polar/basic/adt/BitVector.h"
+#include "polar/basic/adt/Hashing.h"
 #include "polar/basic/adt/StringRef.h"
+#include "polar/basic/adt/SmallVector.h"
 #include "polar/utils/ErrorCode.h"
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
 namespace polar {
 namespace utils {
 
@@ -104,8 +111,244 @@ Expected<BitVector> scan(StringRef &str, StringRef original)
    }
 }
 
+/// A glob pattern split into its positions, the tokens consuming one
+/// character each.
+struct ParsedGlob
+{
+   std::vector<BitVector> m_positions;
+   /// m_loops[k] is true if a '*' follows the first k positions, so the
+   /// state having matched them can consume any character.
+   std::vector<bool> m_loops;
+};
+
+Error parse_glob(StringRef str, ParsedGlob &parsed)
+{
+   StringRef original = str;
+   parsed.m_loops.assign(1, false);
+   while (!str.empty()) {
+      Expected<BitVector> bitVector = scan(str, original);
+      if (!bitVector) {
+         return bitVector.takeError();
+      }
+      if (bitVector->getSize() == 0) {
+         parsed.m_loops.back() = true;
+      } else {
+         parsed.m_positions.push_back(std::move(*bitVector));
+         parsed.m_loops.push_back(false);
+      }
+   }
+   return Error::getSuccess();
+}
+
 } // anonymous namespace
 
+namespace internal {
+
+/// A DFA built on demand from the position automaton of a long glob: every
+/// DFA state is a set of NFA states, bit k standing for "the first k
+/// positions have matched", with the transitions filled in as they are taken.
+///
+/// Matching only reads the transition table, which takes no lock: a
+/// transition slot is published with a release store once the state it leads
+/// to is complete, and states are never freed or moved. New states are built
+/// under m_mutex. Past MAX_STATES states the table stops growing and the rest
+/// of such a string is matched on the position sets directly.
+class LazyGlobDfa
+{
+public:
+   LazyGlobDfa(const ParsedGlob &parsed);
+   ~LazyGlobDfa();
+   bool match(StringRef str);
+
+private:
+   enum : uint32_t
+   {
+      UNKNOWN = ~0u,
+      MAX_STATES = 4096,
+      STATES_PER_CHUNK = 64
+   };
+
+   enum
+   {
+      ACCEPTING = 1,
+      DEAD = 2
+   };
+
+   struct State
+   {
+      std::atomic<uint32_t> m_next[256];
+      std::vector<uint64_t> m_set;
+      uint8_t m_flags;
+   };
+
+   struct SetHash
+   {
+      size_t operator()(const std::vector<uint64_t> &set) const
+      {
+         return polar::basic::hash_combine_range(set.begin(), set.end());
+      }
+   };
+
+   State &getState(uint32_t id) const
+   {
+      return m_chunks[id / STATES_PER_CHUNK].load(std::memory_order_acquire)[id % STATES_PER_CHUNK];
+   }
+
+   void advance(const std::vector<uint64_t> &set, unsigned char c,
+                std::vector<uint64_t> &next) const;
+   uint32_t intern(std::vector<uint64_t> set);
+   uint32_t addTransition(uint32_t state, unsigned char c);
+   bool matchSets(std::vector<uint64_t> set, StringRef str) const;
+
+   unsigned m_numWords;
+   unsigned m_numPositions;
+   // 256 rows of m_numWords words: bit k of row c is set if position k - 1
+   // accepts c.
+   std::vector<uint64_t> m_masks;
+   std::vector<uint64_t> m_loops;
+   // States live in chunks that are allocated as needed and never move.
+   std::atomic<State *> m_chunks[MAX_STATES / STATES_PER_CHUNK];
+   // Guarded by m_mutex.
+   std::unordered_map<std::vector<uint64_t>, uint32_t, SetHash> m_ids;
+   uint32_t m_numStates = 0;
+   std::mutex m_mutex;
+};
+
+LazyGlobDfa::LazyGlobDfa(const ParsedGlob &parsed)
+   : m_numWords((parsed.m_positions.size() + 64) / 64),
+     m_numPositions(parsed.m_positions.size()),
+     m_masks(256 * m_numWords, 0),
+     m_loops(m_numWords, 0)
+{
+   for (unsigned k = 1; k <= m_numPositions; ++k) {
+      const BitVector &position = parsed.m_positions[k - 1];
+      for (unsigned c = 0; c < 256; ++c) {
+         if (position[c]) {
+            m_masks[c * m_numWords + k / 64] |= uint64_t(1) << (k % 64);
+         }
+      }
+   }
+   for (unsigned k = 0; k <= m_numPositions; ++k) {
+      if (parsed.m_loops[k]) {
+         m_loops[k / 64] |= uint64_t(1) << (k % 64);
+      }
+   }
+   for (std::atomic<State *> &chunk : m_chunks) {
+      chunk.store(nullptr, std::memory_order_relaxed);
+   }
+   // State 0 is where every match starts.
+   std::vector<uint64_t> initial(m_numWords, 0);
+   initial[0] = 1;
+   intern(std::move(initial));
+}
+
+LazyGlobDfa::~LazyGlobDfa()
+{
+   for (std::atomic<State *> &chunk : m_chunks) {
+      delete[] chunk.load(std::memory_order_relaxed);
+   }
+}
+
+void LazyGlobDfa::advance(const std::vector<uint64_t> &set, unsigned char c,
+                          std::vector<uint64_t> &next) const
+{
+   const uint64_t *mask = &m_masks[c * m_numWords];
+   next.resize(m_numWords);
+   uint64_t carry = 0;
+   for (unsigned w = 0; w < m_numWords; ++w) {
+      next[w] = (((set[w] << 1) | carry) & mask[w]) | (set[w] & m_loops[w]);
+      carry = set[w] >> 63;
+   }
+}
+
+uint32_t LazyGlobDfa::intern(std::vector<uint64_t> set)
+{
+   auto iter = m_ids.find(set);
+   if (iter != m_ids.end()) {
+      return iter->second;
+   }
+   if (m_numStates == MAX_STATES) {
+      // Bound the memory a pathological pattern may take.
+      return UNKNOWN;
+   }
+   uint32_t id = m_numStates;
+   if (id % STATES_PER_CHUNK == 0) {
+      m_chunks[id / STATES_PER_CHUNK].store(new State[STATES_PER_CHUNK], std::memory_order_release);
+   }
+   State &state = getState(id);
+   for (std::atomic<uint32_t> &next : state.m_next) {
+      next.store(UNKNOWN, std::memory_order_relaxed);
+   }
+   state.m_flags = 0;
+   if (set[m_numPositions / 64] & (uint64_t(1) << (m_numPositions % 64))) {
+      state.m_flags |= ACCEPTING;
+   }
+   if (std::all_of(set.begin(), set.end(), [](uint64_t word) { return word == 0; })) {
+      state.m_flags |= DEAD;
+   }
+   state.m_set = set;
+   m_ids.emplace(std::move(set), id);
+   ++m_numStates;
+   return id;
+}
+
+uint32_t LazyGlobDfa::addTransition(uint32_t state, unsigned char c)
+{
+   std::lock_guard<std::mutex> locker(m_mutex);
+   State &from = getState(state);
+   // Another thread may have added it in the meantime.
+   uint32_t id = from.m_next[c].load(std::memory_order_relaxed);
+   if (id != UNKNOWN) {
+      return id;
+   }
+   std::vector<uint64_t> next;
+   advance(from.m_set, c, next);
+   id = intern(std::move(next));
+   if (id != UNKNOWN) {
+      from.m_next[c].store(id, std::memory_order_release);
+   }
+   return id;
+}
+
+bool LazyGlobDfa::matchSets(std::vector<uint64_t> set, StringRef str) const
+{
+   std::vector<uint64_t> next;
+   for (unsigned char c : str) {
+      advance(set, c, next);
+      set.swap(next);
+      if (std::all_of(set.begin(), set.end(), [](uint64_t word) { return word == 0; })) {
+         return false;
+      }
+   }
+   return set[m_numPositions / 64] & (uint64_t(1) << (m_numPositions % 64));
+}
+
+bool LazyGlobDfa::match(StringRef str)
+{
+   if (str.size() < m_numPositions) {
+      return false;
+   }
+   uint32_t state = 0;
+   for (size_t i = 0, e = str.size(); i != e; ++i) {
+      unsigned char c = str[i];
+      uint32_t next = getState(state).m_next[c].load(std::memory_order_acquire);
+      if (next == UNKNOWN) {
+         next = addTransition(state, c);
+         if (next == UNKNOWN) {
+            // Out of states: carry on without the table.
+            return matchSets(getState(state).m_set, str.dropFront(i));
+         }
+      }
+      state = next;
+      if (getState(state).m_flags & DEAD) {
+         return false;
+      }
+   }
+   return getState(state).m_flags & ACCEPTING;
+}
+
+} // internal
+
 Expected<GlobPattern> GlobPattern::create(StringRef str)
 {
    GlobPattern pattern;
@@ -129,13 +372,29 @@ Expected<GlobPattern> GlobPattern::create(StringRef str)
 
    // Otherwise, we need to do real glob pattern matching.
    // Parse the pattern now.
-   StringRef original = str;
-   while (!str.empty()) {
-      Expected<BitVector> bitVector = scan(str, original);
-      if (!bitVector) {
-         return bitVector.takeError();
+   ParsedGlob parsed;
+   if (Error error = parse_glob(str, parsed)) {
+      return std::move(error);
+   }
+   pattern.m_numPositions = parsed.m_positions.size();
+   pattern.m_leadingStar = parsed.m_loops[0];
+   if (pattern.m_numPositions > MAX_SHIFT_AND_POSITIONS) {
+      pattern.m_dfa = std::make_shared<internal::LazyGlobDfa>(parsed);
+      return pattern;
+   }
+   // Bit i of the Shift-And state stands for "the first i + 1 positions have
+   // matched"; having matched none is implicit.
+   pattern.m_masks.assign(256, 0);
+   for (unsigned i = 0; i < pattern.m_numPositions; ++i) {
+      const BitVector &position = parsed.m_positions[i];
+      for (unsigned c = 0; c < 256; ++c) {
+         if (position[c]) {
+            pattern.m_masks[c] |= uint64_t(1) << i;
+         }
+      }
+      if (parsed.m_loops[i + 1]) {
+         pattern.m_loops |= uint64_t(1) << i;
       }
-      pattern.m_tokens.push_back(*bitVector);
    }
    return pattern;
 }
@@ -151,39 +410,172 @@ bool GlobPattern::match(StringRef str) const
    if (m_suffix) {
       return str.endsWith(*m_suffix);
    }
-   return matchOne(m_tokens, str);
+   if (m_dfa) {
+      return m_dfa->match(str);
+   }
+   // Every position consumes a character.
+   if (str.size() < m_numPositions) {
+      return false;
+   }
+   if (m_numPositions == 0) {
+      // Only stars.
+      return true;
+   }
+   uint64_t state = 0;
+   // Having matched no position stays possible after the first character
+   // only behind a leading star.
+   uint64_t start = 1;
+   for (unsigned char c : str) {
+      state = (((state << 1) | start) & m_masks[c]) | (state & m_loops);
+      if (!m_leadingStar) {
+         start = 0;
+         if (!state) {
+            return false;
+         }
+      }
+   }
+   return state & (uint64_t(1) << (m_numPositions - 1));
 }
 
-// Runs glob pattern pattern against string str.
-bool GlobPattern::matchOne(ArrayRef<BitVector> pattern, StringRef str) const
+Error GlobSet::add(StringRef pattern)
 {
-   for (;;) {
-      if (pattern.empty()) {
-         return str.empty();
-      }
-      // If pattern[0] is '*', try to match pattern[1..] against all possible
-      // tail strings of str to see at least one pattern succeeds.
-      if (pattern[0].getSize() == 0) {
-         pattern = pattern.slice(1);
-         if (pattern.empty()) {
-            // Fast path. If a pattern is '*', it matches anything.
+   unsigned index = m_size;
+   if (!has_wildcard(pattern)) {
+      m_exact[pattern].push_back(index);
+      ++m_size;
+      return Error::getSuccess();
+   }
+   ParsedGlob parsed;
+   if (Error error = parse_glob(pattern, parsed)) {
+      return error;
+   }
+   ++m_size;
+   unsigned numPositions = parsed.m_positions.size();
+   if (numPositions == 0) {
+      m_matchAll.push_back(index);
+      return Error::getSuccess();
+   }
+   if (numPositions > GlobPattern::MAX_SHIFT_AND_POSITIONS) {
+      Expected<GlobPattern> glob = GlobPattern::create(pattern);
+      assert(glob && "pattern parsed once already");
+      m_large.emplace_back(std::move(*glob), index);
+      return Error::getSuccess();
+   }
+   if (m_words.empty() || m_words.back().m_numBits + numPositions > 64) {
+      m_words.emplace_back();
+      m_masks.resize(m_masks.size() + 256, 0);
+   }
+   Word &word = m_words.back();
+   uint64_t *masks = &m_masks[m_masks.size() - 256];
+   unsigned base = word.m_numBits;
+   for (unsigned i = 0; i < numPositions; ++i) {
+      const BitVector &position = parsed.m_positions[i];
+      uint64_t bit = uint64_t(1) << (base + i);
+      for (unsigned c = 0; c < 256; ++c) {
+         if (position[c]) {
+            masks[c] |= bit;
+         }
+      }
+      if (parsed.m_loops[i + 1]) {
+         word.m_loops |= bit;
+      }
+   }
+   word.m_first |= uint64_t(1) << base;
+   word.m_accept |= uint64_t(1) << (base + numPositions - 1);
+   if (parsed.m_loops[0]) {
+      word.m_leadingStars |= uint64_t(1) << base;
+      m_anyLeadingStar = true;
+   }
+   word.m_numBits += numPositions;
+   word.m_patterns.push_back(index);
+   return Error::getSuccess();
+}
+
+bool GlobSet::run(StringRef str, SmallVectorImpl<uint64_t> &states) const
+{
+   size_t numWords = m_words.size();
+   states.assign(numWords, 0);
+   if (!numWords || str.empty()) {
+      return false;
+   }
+   const uint64_t *masks = m_masks.data();
+   bool first = true;
+   for (unsigned char c : str) {
+      uint64_t live = 0;
+      for (size_t w = 0; w < numWords; ++w) {
+         const Word &word = m_words[w];
+         uint64_t state = states[w];
+         // Shifting carries the last bit of a pattern into the first bit of
+         // the next one; first bits only ever come from start injection.
+         uint64_t start = first ? word.m_first : word.m_leadingStars;
+         state = ((((state << 1) & ~word.m_first) | start) & masks[w * 256 + c]) |
+               (state & word.m_loops);
+         states[w] = state;
+         live |= state;
+      }
+      first = false;
+      if (!live && !m_anyLeadingStar) {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool GlobSet::matchAny(StringRef str) const
+{
+   if (!m_matchAll.empty() || m_exact.count(str)) {
+      return true;
+   }
+   SmallVector<uint64_t, 8> states;
+   if (run(str, states)) {
+      for (size_t w = 0; w < m_words.size(); ++w) {
+         if (states[w] & m_words[w].m_accept) {
             return true;
          }
-         for (size_t i = 0, e = str.getSize(); i < e; ++i) {
-            if (matchOne(pattern, str.substr(i))) {
-               return true;
+      }
+   }
+   for (const auto &large : m_large) {
+      if (large.first.match(str)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+bool GlobSet::match(StringRef str, SmallVectorImpl<unsigned> &indexes) const
+{
+   size_t start = indexes.size();
+   indexes.append(m_matchAll.begin(), m_matchAll.end());
+   auto exact = m_exact.find(str);
+   if (exact != m_exact.end()) {
+      indexes.append(exact->getValue().begin(), exact->getValue().end());
+   }
+   SmallVector<uint64_t, 8> states;
+   if (run(str, states)) {
+      for (size_t w = 0; w < m_words.size(); ++w) {
+         const Word &word = m_words[w];
+         uint64_t accepted = states[w] & word.m_accept;
+         if (!accepted) {
+            continue;
+         }
+         // Accepting bits are in pattern order.
+         uint64_t accept = word.m_accept;
+         for (unsigned pattern : word.m_patterns) {
+            uint64_t bit = accept & -accept;
+            if (accepted & bit) {
+               indexes.push_back(pattern);
             }
+            accept ^= bit;
          }
-         return false;
       }
-
-      // If pattern[0] is not '*', it must consume one character.
-      if (str.empty() || !pattern[0][(uint8_t)str[0]]) {
-         return false;
+   }
+   for (const auto &large : m_large) {
+      if (large.first.match(str)) {
+         indexes.push_back(large.second);
       }
-      pattern = pattern.slice(1);
-      str = str.substr(1);
    }
+   std::sort(indexes.begin() + start, indexes.end());
+   return indexes.size() > start;
 }
 
 } // utils
@@ -14,17 +14,21 @@
 #include "polar/basic/adt/StringExtras.h"
 #include "polar/utils/ErrorCode.h"
 #include "polar/utils/OptionalError.h"
+#include "polar/basic/adt/Statistic.h"
 #include "polar/utils/FileSystem.h"
 #include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/Path.h"
 #include "polar/utils/Signals.h"
 #include "polar/utils/RawOutStream.h"
 #include <cerrno>
+#include <chrono>
 #include <ctime>
 #include <memory>
 #include <optional>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <system_error>
+#include <thread>
 #include <tuple>
 
 #ifdef POLAR_OS_WIN
@@ -33,10 +37,20 @@
 #ifdef POLAR_OS_UNIX
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#define POLAR_HAVE_INOTIFY 1
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#define DEBUG_TYPE "lock-file-manager"
 
 namespace polar {
 namespace utils {
 
+STATISTIC(NumLockWaits, "Number of waits for a lock file to be released");
+STATISTIC(NumLockWaitMilliseconds, "Milliseconds spent waiting for lock files");
+
 #if defined(__APPLE__) && defined(__MAC_OS_X_VERSION_MIN_REQUIRED) && (__MAC_OS_X_VERSION_MIN_REQUIRED > 1050)
 #define USE_OSX_GETHOSTUUID 1
 #else
@@ -149,6 +163,107 @@ public:
    void cancel() { Canceled = true; }
 };
 
+/// Waits for a lock file to be removed. On Linux, the directory of the lock
+/// file is watched with inotify so that the waiter wakes up as soon as the
+/// file goes away; elsewhere, or if the watch cannot be set up, it simply
+/// sleeps.
+class LockFileWatcher
+{
+public:
+   explicit LockFileWatcher(StringRef lockFileName)
+   {
+#ifdef POLAR_HAVE_INOTIFY
+      m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (m_fd < 0) {
+         return;
+      }
+      m_name = polar::fs::path::filename(lockFileName).getStr();
+      std::string directory = polar::fs::path::parent_path(lockFileName).getStr();
+      // The lock file goes away by unlink, or by rename when the owner
+      // sweeps it aside.
+      if (inotify_add_watch(m_fd, directory.c_str(),
+                            IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR) < 0) {
+         ::close(m_fd);
+         m_fd = -1;
+      }
+#else
+      (void)lockFileName;
+#endif
+   }
+
+   ~LockFileWatcher()
+   {
+#ifdef POLAR_HAVE_INOTIFY
+      if (m_fd >= 0) {
+         ::close(m_fd);
+      }
+#endif
+   }
+
+   /// Returns after \p timeout, or earlier if the lock file may be gone.
+   void wait(std::chrono::milliseconds timeout)
+   {
+#ifdef POLAR_HAVE_INOTIFY
+      if (m_fd >= 0) {
+         std::chrono::steady_clock::time_point deadline =
+               std::chrono::steady_clock::now() + timeout;
+         for (;;) {
+            std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+            if (left <= std::chrono::steady_clock::duration::zero()) {
+               return;
+            }
+            // Round up, so as not to spin through the last millisecond.
+            int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     left + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+            struct pollfd pollFd = {m_fd, POLLIN, 0};
+            int result = ::poll(&pollFd, 1, milliseconds);
+            if (result < 0 && errno != EINTR) {
+               break;
+            }
+            if (result > 0 && readEvents()) {
+               return;
+            }
+         }
+         std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+         if (left > std::chrono::steady_clock::duration::zero()) {
+            std::this_thread::sleep_for(left);
+         }
+         return;
+      }
+#endif
+      std::this_thread::sleep_for(timeout);
+   }
+
+private:
+#ifdef POLAR_HAVE_INOTIFY
+   /// Drains the pending events, and returns true if one may concern the
+   /// lock file.
+   bool readEvents()
+   {
+      alignas(struct inotify_event) char buffer[4096];
+      bool found = false;
+      for (;;) {
+         ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+         if (length <= 0) {
+            return found;
+         }
+         for (char *ptr = buffer; ptr < buffer + length;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+            // On overflow, events were lost, and one may have been ours.
+            if ((event->mask & IN_Q_OVERFLOW) ||
+                (event->len && m_name == event->name)) {
+               found = true;
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+         }
+      }
+   }
+
+   int m_fd = -1;
+   std::string m_name;
+#endif
+};
+
 } // end anonymous namespace
 
 LockFileManager::LockFileManager(StringRef fileName)
@@ -290,30 +405,28 @@ LockFileManager::~LockFileManager()
    consume_error(m_uniqueLockFile->discard());
 }
 
-LockFileManager::WaitForUnlockResult LockFileManager::waitForUnlock() {
-   if (getState() != LFS_Shared)
+LockFileManager::WaitForUnlockResult LockFileManager::waitForUnlock()
+{
+   if (getState() != LFS_Shared) {
       return Res_Success;
-
-#ifdef POLAR_OS_WIN32
-   unsigned long interval = 1;
-#else
-   struct timespec interval;
-   interval.tv_sec = 0;
-   interval.tv_nsec = 1000000;
-#endif
+   }
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   RAIICleanup accountWaitTime([&]() {
+      std::chrono::nanoseconds waited = std::chrono::steady_clock::now() - start;
+      m_waitTime += waited;
+      ++NumLockWaits;
+      NumLockWaitMilliseconds +=
+            std::chrono::duration_cast<std::chrono::milliseconds>(waited).count();
+   });
+   LockFileWatcher watcher(m_lockFileName);
+   std::chrono::milliseconds interval(1);
    // Don't wait more than 40s per iteration. Total timeout for the file
    // to appear is ~1.5 minutes.
-   const unsigned maxSeconds = 40;
+   const std::chrono::seconds maxInterval(40);
    do {
-      // Sleep for the designated interval, to allow the owning process time to
-      // finish up and remove the lock file.
-      // FIXME: Should we hook in to system APIs to get a notification when the
-      // lock file is deleted?
-#ifdef POLAR_OS_WIN32
-      Sleep(interval);
-#else
-      nanosleep(&interval, nullptr);
-#endif
+      // Wait for the owning process to remove the lock file, or for the
+      // designated interval to check that it is still alive.
+      watcher.wait(interval);
 
       if (polar::fs::access(m_lockFileName.getCStr(), polar::fs::AccessMode::Exist) ==
           ErrorCode::no_such_file_or_directory) {
@@ -329,23 +442,8 @@ LockFileManager::WaitForUnlockResult LockFileManager::waitForUnlock() {
           return Res_OwnerDied;
       }
       // Exponentially increase the time we wait for the lock to be removed.
-#ifdef POLAR_OS_WIN32
       interval *= 2;
-#else
-      interval.tv_sec *= 2;
-      interval.tv_nsec *= 2;
-      if (interval.tv_nsec >= 1000000000) {
-         ++interval.tv_sec;
-         interval.tv_nsec -= 1000000000;
-      }
-#endif
-   } while (
-         #ifdef POLAR_OS_WIN32
-            interval < maxSeconds * 1000
-         #else
-            interval.tv_sec < (time_t)maxSeconds
-         #endif
-            );
+   } while (interval < maxInterval);
 
    // Give up.
    return Res_Timeout;
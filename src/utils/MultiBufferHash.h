@@ -0,0 +1,199 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+//===----------------------------------------------------------------------===//
+//
+// Private helpers shared by the Merkle-Damgard hash implementations (Sha1,
+// Sha256): host feature probing for the SHA instruction set extensions and a
+// multi-buffer scheduler that runs several independent messages through one
+// SIMD compression kernel, one message per 32-bit lane.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef POLAR_UTILS_PRIVATE_MULTI_BUFFER_HASH_H
+#define POLAR_UTILS_PRIVATE_MULTI_BUFFER_HASH_H
+
+#include "polar/basic/adt/ArrayRef.h"
+#include "polar/basic/adt/StringMap.h"
+#include "polar/utils/Endian.h"
+#include "polar/utils/Host.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POLAR_HAVE_SHA_INTRINSICS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define POLAR_HAVE_MULTI_BUFFER_HASH 1
+#endif
+
+namespace polar {
+namespace utils {
+namespace internal {
+
+using polar::basic::ArrayRef;
+
+/// Returns true if the host supports the SHA extensions together with the
+/// SSSE3/SSE4.1 byte shuffles the accelerated kernels rely on. The probe runs
+/// once per process.
+inline bool host_has_sha_extensions()
+{
+#ifdef POLAR_HAVE_SHA_INTRINSICS
+   static const bool hasSha = [] {
+      polar::basic::StringMap<bool> features;
+      if (!polar::sys::get_host_cpu_features(features)) {
+         return false;
+      }
+      return features.lookup("sha") && features.lookup("ssse3") &&
+            features.lookup("sse4.1");
+   }();
+   return hasSha;
+#else
+   return false;
+#endif
+}
+
+#ifdef POLAR_HAVE_MULTI_BUFFER_HASH
+
+/// Number of messages hashed side by side by the multi-buffer kernels.
+constexpr unsigned MULTI_BUFFER_LANES = 4;
+
+typedef uint32_t LaneVector __attribute__((vector_size(16)));
+
+inline LaneVector lane_rotl(LaneVector value, int bits)
+{
+   return (value << bits) | (value >> (32 - bits));
+}
+
+inline LaneVector lane_rotr(LaneVector value, int bits)
+{
+   return (value >> bits) | (value << (32 - bits));
+}
+
+/// Loads big-endian word \p index of each lane's block into one vector.
+inline LaneVector lane_load_be(const uint8_t *const blocks[MULTI_BUFFER_LANES],
+                               unsigned index)
+{
+   return LaneVector{endian::read32be(blocks[0] + 4 * index),
+            endian::read32be(blocks[1] + 4 * index),
+            endian::read32be(blocks[2] + 4 * index),
+            endian::read32be(blocks[3] + 4 * index)};
+}
+
+/// Walks one message block by block, synthesizing the SHA-1/SHA-2 style
+/// padding (0x80, zeros, 64-bit big-endian bit length) in a small tail buffer
+/// so the message body never has to be copied.
+class PaddedMessageCursor
+{
+public:
+   void reset(ArrayRef<uint8_t> data)
+   {
+      m_data = data.getData();
+      m_tailStart = data.getSize() & ~uint64_t(63);
+      size_t tailSize = data.getSize() - m_tailStart;
+      unsigned tailBlocks = tailSize + 9 > 64 ? 2 : 1;
+      std::memset(m_tail, 0, sizeof(m_tail));
+      if (tailSize) {
+         std::memcpy(m_tail, m_data + m_tailStart, tailSize);
+      }
+      m_tail[tailSize] = 0x80;
+      endian::write64be(m_tail + tailBlocks * 64 - 8, uint64_t(data.getSize()) * 8);
+      m_numBlocks = m_tailStart / 64 + tailBlocks;
+      m_block = 0;
+   }
+
+   bool done() const
+   {
+      return m_block == m_numBlocks;
+   }
+
+   const uint8_t *next()
+   {
+      uint64_t offset = m_block++ * 64;
+      return offset < m_tailStart ? m_data + offset : m_tail + (offset - m_tailStart);
+   }
+
+private:
+   const uint8_t *m_data = nullptr;
+   uint64_t m_tailStart = 0;
+   uint64_t m_numBlocks = 0;
+   uint64_t m_block = 0;
+   uint8_t m_tail[128];
+};
+
+/// Hashes every buffer in \p inputs with \p Kernel, keeping all lanes busy by
+/// refilling a lane with the next pending message as soon as its current one
+/// is finished. Digest \p i is written big-endian to
+/// <tt>digests + i * Kernel::STATE_WORDS * 4</tt>.
+///
+/// \p Kernel provides STATE_WORDS, the initial hash value sm_iv and
+/// <tt>compress(LaneVector *state, const uint8_t *const blocks[])</tt>.
+template <typename Kernel>
+void hash_multi_buffer(ArrayRef<ArrayRef<uint8_t>> inputs, uint8_t *digests)
+{
+   constexpr unsigned STATE_WORDS = Kernel::STATE_WORDS;
+   static const uint8_t zeroBlock[64] = {};
+   PaddedMessageCursor cursors[MULTI_BUFFER_LANES];
+   size_t messages[MULTI_BUFFER_LANES];
+   bool active[MULTI_BUFFER_LANES] = {};
+   LaneVector state[STATE_WORDS];
+   size_t nextMessage = 0;
+   unsigned activeLanes = 0;
+
+   auto assignLane = [&](unsigned lane) {
+      active[lane] = nextMessage < inputs.getSize();
+      if (!active[lane]) {
+         return;
+      }
+      messages[lane] = nextMessage;
+      cursors[lane].reset(inputs[nextMessage++]);
+      for (unsigned i = 0; i < STATE_WORDS; ++i) {
+         state[i][lane] = Kernel::sm_iv[i];
+      }
+      ++activeLanes;
+   };
+
+   for (unsigned i = 0; i < STATE_WORDS; ++i) {
+      state[i] = LaneVector{} + Kernel::sm_iv[i];
+   }
+   for (unsigned lane = 0; lane < MULTI_BUFFER_LANES; ++lane) {
+      assignLane(lane);
+   }
+   while (activeLanes) {
+      const uint8_t *blocks[MULTI_BUFFER_LANES];
+      for (unsigned lane = 0; lane < MULTI_BUFFER_LANES; ++lane) {
+         blocks[lane] = active[lane] ? cursors[lane].next() : zeroBlock;
+      }
+      Kernel::compress(state, blocks);
+      for (unsigned lane = 0; lane < MULTI_BUFFER_LANES; ++lane) {
+         if (!active[lane] || !cursors[lane].done()) {
+            continue;
+         }
+         uint8_t *digest = digests + messages[lane] * STATE_WORDS * 4;
+         for (unsigned i = 0; i < STATE_WORDS; ++i) {
+            endian::write32be(digest + 4 * i, state[i][lane]);
+         }
+         --activeLanes;
+         assignLane(lane);
+      }
+   }
+}
+
+#endif // POLAR_HAVE_MULTI_BUFFER_HASH
+
+} // internal
+} // utils
+} // polar
+
+#endif // POLAR_UTILS_PRIVATE_MULTI_BUFFER_HASH_H
@@ -16,7 +16,10 @@
 #include "polar/basic/adt/StringExtras.h"
 #include "polar/utils/Format.h"
 
+#include <cmath>
+#include <cstring>
 #include <float.h>
+#include <limits>
 
 namespace polar {
 namespace utils {
@@ -25,17 +28,44 @@ using polar::basic::SmallString;
 
 namespace {
 
+/// The two digit decimal numbers "00" to "99", one after the other.
+const char sg_digitPairs[] =
+      "00010203040506070809"
+      "10111213141516171819"
+      "20212223242526272829"
+      "30313233343536373839"
+      "40414243444546474849"
+      "50515253545556575859"
+      "60616263646566676869"
+      "70717273747576777879"
+      "80818283848586878889"
+      "90919293949596979899";
+
+/// Writes the decimal digits of \p value so that they end at \p end, two at
+/// a time, and returns where they start.
+template <typename T>
+char *format_decimal(T value, char *end)
+{
+   while (value >= 100) {
+      unsigned pair = static_cast<unsigned>(value % 100) * 2;
+      value /= 100;
+      end -= 2;
+      std::memcpy(end, sg_digitPairs + pair, 2);
+   }
+   if (value >= 10) {
+      end -= 2;
+      std::memcpy(end, sg_digitPairs + static_cast<unsigned>(value) * 2, 2);
+   } else {
+      *--end = static_cast<char>('0' + value);
+   }
+   return end;
+}
+
 template<typename T, std::size_t N>
 int format_to_buffer(T value, char (&buffer)[N])
 {
    char *endPtr = std::end(buffer);
-   char *curPtr = endPtr;
-
-   do {
-      *--curPtr = '0' + char(value % 10);
-      value /= 10;
-   } while (value);
-   return endPtr - curPtr;
+   return endPtr - format_decimal(value, endPtr);
 }
 
 void writeWithCommas(RawOutStream &outStream, ArrayRef<char> buffer)
@@ -61,25 +91,29 @@ void write_unsigned_impl(RawOutStream &outStream, T N, size_t minDigits,
                          IntegerStyle style, bool isNegative) {
    static_assert(std::is_unsigned<T>::value, "Value is not unsigned!");
 
-   char numberBuffer[128];
-   std::memset(numberBuffer, '0', sizeof(numberBuffer));
-
-   size_t len = 0;
-   len = format_to_buffer(N, numberBuffer);
-   if (isNegative) {
-      outStream << '-';
-   }
-   if (len < minDigits && style != IntegerStyle::Number) {
-      for (size_t index = len; index < minDigits; ++index) {
-         outStream << '0';
-      }
-   }
-
    if (style == IntegerStyle::Number) {
+      char numberBuffer[32];
+      size_t len = format_to_buffer(N, numberBuffer);
+      if (isNegative) {
+         outStream << '-';
+      }
       writeWithCommas(outStream, ArrayRef<char>(std::end(numberBuffer) - len, len));
-   } else {
-      outStream.write(std::end(numberBuffer) - len, len);
+      return;
+   }
+   // The sign, the padding and the digits go out in one write.
+   char numberBuffer[128];
+   char *endPtr = std::end(numberBuffer);
+   char *curPtr = format_decimal(N, endPtr);
+   size_t len = endPtr - curPtr;
+   if (len < minDigits) {
+      size_t padding = std::min(minDigits, sizeof(numberBuffer) - 1) - len;
+      curPtr -= padding;
+      std::memset(curPtr, '0', padding);
+   }
+   if (isNegative) {
+      *--curPtr = '-';
    }
+   outStream.write(curPtr, endPtr - curPtr);
 }
 
 template <typename T>
@@ -109,6 +143,444 @@ void write_signed(RawOutStream &outStream, T N, size_t minDigits,
    write_unsigned(outStream, UN, minDigits, style, true);
 }
 
+/// The two digit hexadecimal numbers "00" to "ff", one after the other.
+struct HexPairs
+{
+   char m_digits[513];
+
+   constexpr HexPairs(bool upper)
+      : m_digits()
+   {
+      const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+      for (unsigned i = 0; i < 256; ++i) {
+         m_digits[i * 2] = digits[i >> 4];
+         m_digits[i * 2 + 1] = digits[i & 15];
+      }
+   }
+};
+
+constexpr HexPairs sg_hexPairsLowerTable(false);
+constexpr HexPairs sg_hexPairsUpperTable(true);
+const char *const sg_hexPairsLower = sg_hexPairsLowerTable.m_digits;
+const char *const sg_hexPairsUpper = sg_hexPairsUpperTable.m_digits;
+
+// The shortest digits of floating point numbers are found with the Grisu2
+// algorithm of Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers". The digits always read back as the number they
+// came from, and are the shortest such in all but a handful of cases, where
+// there is one digit more.
+
+/// A floating point number f * 2^e, with a 64-bit significand.
+struct DiyFp
+{
+   uint64_t m_f;
+   int m_e;
+
+   static DiyFp sub(DiyFp lhs, DiyFp rhs)
+   {
+      assert(lhs.m_e == rhs.m_e && lhs.m_f >= rhs.m_f);
+      return DiyFp{lhs.m_f - rhs.m_f, lhs.m_e};
+   }
+
+   /// Returns lhs * rhs, rounded to 64 bits.
+   static DiyFp mul(DiyFp lhs, DiyFp rhs)
+   {
+      uint64_t lhsLow = lhs.m_f & 0xFFFFFFFFu;
+      uint64_t lhsHigh = lhs.m_f >> 32;
+      uint64_t rhsLow = rhs.m_f & 0xFFFFFFFFu;
+      uint64_t rhsHigh = rhs.m_f >> 32;
+      uint64_t lowLow = lhsLow * rhsLow;
+      uint64_t lowHigh = lhsLow * rhsHigh;
+      uint64_t highLow = lhsHigh * rhsLow;
+      uint64_t highHigh = lhsHigh * rhsHigh;
+      uint64_t middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFFu) +
+            (highLow & 0xFFFFFFFFu) + (uint64_t(1) << 31);
+      return DiyFp{highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32),
+                   lhs.m_e + rhs.m_e + 64};
+   }
+
+   static DiyFp normalize(DiyFp value)
+   {
+      assert(value.m_f != 0);
+      int shift = count_leading_zeros(value.m_f);
+      return DiyFp{value.m_f << shift, value.m_e - shift};
+   }
+
+   static DiyFp normalizeTo(DiyFp value, int e)
+   {
+      assert(value.m_e >= e);
+      return DiyFp{value.m_f << (value.m_e - e), e};
+   }
+};
+
+/// The number, and the boundaries of the numbers which round to it, with
+/// the same exponent.
+struct Boundaries
+{
+   DiyFp m_value;
+   DiyFp m_minus;
+   DiyFp m_plus;
+};
+
+template <typename FloatType>
+Boundaries compute_boundaries(FloatType value)
+{
+   static_assert(std::numeric_limits<FloatType>::is_iec559, "not an IEEE number");
+   assert(std::isfinite(value) && value > 0);
+   constexpr int precision = std::numeric_limits<FloatType>::digits;
+   constexpr int bias = std::numeric_limits<FloatType>::max_exponent - 1 + (precision - 1);
+   constexpr int minExponent = 1 - bias;
+   constexpr uint64_t hiddenBit = uint64_t(1) << (precision - 1);
+   using BitsType = typename std::conditional<precision == 24, uint32_t, uint64_t>::type;
+
+   BitsType bits;
+   std::memcpy(&bits, &value, sizeof(bits));
+   uint64_t exponentBits = bits >> (precision - 1);
+   uint64_t significand = bits & (hiddenBit - 1);
+   DiyFp number = exponentBits == 0
+         ? DiyFp{significand, minExponent}
+         : DiyFp{significand + hiddenBit, static_cast<int>(exponentBits) - bias};
+   // The boundaries are half way to the neighbours. At a power of two, but
+   // the smallest, the neighbour below is twice as close.
+   bool lowerIsCloser = significand == 0 && exponentBits > 1;
+   DiyFp plus{2 * number.m_f + 1, number.m_e - 1};
+   DiyFp minus = lowerIsCloser ? DiyFp{4 * number.m_f - 1, number.m_e - 2}
+                               : DiyFp{2 * number.m_f - 1, number.m_e - 1};
+   plus = DiyFp::normalize(plus);
+   return Boundaries{DiyFp::normalize(number), DiyFp::normalizeTo(minus, plus.m_e), plus};
+}
+
+struct CachedPower
+{
+   uint64_t m_f;
+   int m_e;
+   int m_k;
+};
+
+/// 10^k for every eighth k from -300 to 324, rounded to 64 bits.
+const CachedPower sg_cachedPowers[] = {
+{0xAB70FE17C79AC6CA, -1060, -300},
+   {0xFF77B1FCBEBCDC4F, -1034, -292},
+   {0xBE5691EF416BD60C, -1007, -284},
+   {0x8DD01FAD907FFC3C,  -980, -276},
+   {0xD3515C2831559A83,  -954, -268},
+   {0x9D71AC8FADA6C9B5,  -927, -260},
+   {0xEA9C227723EE8BCB,  -901, -252},
+   {0xAECC49914078536D,  -874, -244},
+   {0x823C12795DB6CE57,  -847, -236},
+   {0xC21094364DFB5637,  -821, -228},
+   {0x9096EA6F3848984F,  -794, -220},
+   {0xD77485CB25823AC7,  -768, -212},
+   {0xA086CFCD97BF97F4,  -741, -204},
+   {0xEF340A98172AACE5,  -715, -196},
+   {0xB23867FB2A35B28E,  -688, -188},
+   {0x84C8D4DFD2C63F3B,  -661, -180},
+   {0xC5DD44271AD3CDBA,  -635, -172},
+   {0x936B9FCEBB25C996,  -608, -164},
+   {0xDBAC6C247D62A584,  -582, -156},
+   {0xA3AB66580D5FDAF6,  -555, -148},
+   {0xF3E2F893DEC3F126,  -529, -140},
+   {0xB5B5ADA8AAFF80B8,  -502, -132},
+   {0x87625F056C7C4A8B,  -475, -124},
+   {0xC9BCFF6034C13053,  -449, -116},
+   {0x964E858C91BA2655,  -422, -108},
+   {0xDFF9772470297EBD,  -396, -100},
+   {0xA6DFBD9FB8E5B88F,  -369,  -92},
+   {0xF8A95FCF88747D94,  -343,  -84},
+   {0xB94470938FA89BCF,  -316,  -76},
+   {0x8A08F0F8BF0F156B,  -289,  -68},
+   {0xCDB02555653131B6,  -263,  -60},
+   {0x993FE2C6D07B7FAC,  -236,  -52},
+   {0xE45C10C42A2B3B06,  -210,  -44},
+   {0xAA242499697392D3,  -183,  -36},
+   {0xFD87B5F28300CA0E,  -157,  -28},
+   {0xBCE5086492111AEB,  -130,  -20},
+   {0x8CBCCC096F5088CC,  -103,  -12},
+   {0xD1B71758E219652C,   -77,   -4},
+   {0x9C40000000000000,   -50,    4},
+   {0xE8D4A51000000000,   -24,   12},
+   {0xAD78EBC5AC620000,     3,   20},
+   {0x813F3978F8940984,    30,   28},
+   {0xC097CE7BC90715B3,    56,   36},
+   {0x8F7E32CE7BEA5C70,    83,   44},
+   {0xD5D238A4ABE98068,   109,   52},
+   {0x9F4F2726179A2245,   136,   60},
+   {0xED63A231D4C4FB27,   162,   68},
+   {0xB0DE65388CC8ADA8,   189,   76},
+   {0x83C7088E1AAB65DB,   216,   84},
+   {0xC45D1DF942711D9A,   242,   92},
+   {0x924D692CA61BE758,   269,  100},
+   {0xDA01EE641A708DEA,   295,  108},
+   {0xA26DA3999AEF774A,   322,  116},
+   {0xF209787BB47D6B85,   348,  124},
+   {0xB454E4A179DD1877,   375,  132},
+   {0x865B86925B9BC5C2,   402,  140},
+   {0xC83553C5C8965D3D,   428,  148},
+   {0x952AB45CFA97A0B3,   455,  156},
+   {0xDE469FBD99A05FE3,   481,  164},
+   {0xA59BC234DB398C25,   508,  172},
+   {0xF6C69A72A3989F5C,   534,  180},
+   {0xB7DCBF5354E9BECE,   561,  188},
+   {0x88FCF317F22241E2,   588,  196},
+   {0xCC20CE9BD35C78A5,   614,  204},
+   {0x98165AF37B2153DF,   641,  212},
+   {0xE2A0B5DC971F303A,   667,  220},
+   {0xA8D9D1535CE3B396,   694,  228},
+   {0xFB9B7CD9A4A7443C,   720,  236},
+   {0xBB764C4CA7A44410,   747,  244},
+   {0x8BAB8EEFB6409C1A,   774,  252},
+   {0xD01FEF10A657842C,   800,  260},
+   {0x9B10A4E5E9913129,   827,  268},
+   {0xE7109BFBA19C0C9D,   853,  276},
+   {0xAC2820D9623BF429,   880,  284},
+   {0x80444B5E7AA7CF85,   907,  292},
+   {0xBF21E44003ACDD2D,   933,  300},
+   {0x8E679C2F5E44FF8F,   960,  308},
+   {0xD433179D9C8CB841,   986,  316},
+   {0x9E19DB92B4E31BA9,  1013,  324}
+};
+
+enum
+{
+   CachedPowersMinDecimalExponent = -300,
+   CachedPowersDecimalStep = 8,
+   /// The range the exponent of a number scaled by a cached power falls in.
+   Alpha = -60,
+   Gamma = -32
+};
+
+/// Returns the cached power c = f_c * 2^e_c such that a number with binary
+/// exponent \p e, scaled by c, has an exponent in [Alpha, Gamma].
+CachedPower get_cached_power_for_binary_exponent(int e)
+{
+   // k = ceil((Alpha - e - 1) * log10(2)), in fixed point.
+   int f = Alpha - e - 1;
+   int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+   int index = (-CachedPowersMinDecimalExponent + k + (CachedPowersDecimalStep - 1)) /
+         CachedPowersDecimalStep;
+   assert(index >= 0 && static_cast<size_t>(index) < basic::array_lengthof(sg_cachedPowers));
+   CachedPower cached = sg_cachedPowers[index];
+   assert(Alpha <= cached.m_e + e + 64 && cached.m_e + e + 64 <= Gamma);
+   return cached;
+}
+
+/// Returns the number of decimal digits of \p value, and the largest power
+/// of ten not above it.
+int find_largest_pow10(uint32_t value, uint32_t &pow10)
+{
+   static const uint32_t powers[] = {
+      1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+   };
+   int digits = 10;
+   while (digits > 1 && value < powers[digits - 1]) {
+      --digits;
+   }
+   pow10 = powers[digits - 1];
+   return digits;
+}
+
+/// Moves the last digit towards the number, while the digits stay in the
+/// boundaries, so that they are the closest of the shortest.
+void grisu2_round(char *buffer, int length, uint64_t dist, uint64_t delta,
+                  uint64_t rest, uint64_t tenK)
+{
+   while (rest < dist && delta - rest >= tenK &&
+          (rest + tenK < dist || dist - rest > rest + tenK - dist)) {
+      --buffer[length - 1];
+      rest += tenK;
+   }
+}
+
+/// Generates the digits of \p value, scaled into [Alpha, Gamma], which lie
+/// strictly between \p minus and \p plus.
+void grisu2_digit_gen(char *buffer, int &length, int &decimalExponent,
+                      DiyFp minus, DiyFp value, DiyFp plus)
+{
+   DiyFp one{uint64_t(1) << -plus.m_e, plus.m_e};
+   uint32_t integral = static_cast<uint32_t>(plus.m_f >> -one.m_e);
+   uint64_t fractional = plus.m_f & (one.m_f - 1);
+   uint64_t delta = DiyFp::sub(plus, minus).m_f;
+   uint64_t dist = DiyFp::sub(plus, value).m_f;
+
+   uint32_t pow10;
+   int n = find_largest_pow10(integral, pow10);
+   while (n > 0) {
+      uint32_t digit = integral / pow10;
+      integral %= pow10;
+      buffer[length++] = static_cast<char>('0' + digit);
+      --n;
+      uint64_t rest = (uint64_t(integral) << -one.m_e) + fractional;
+      if (rest <= delta) {
+         decimalExponent += n;
+         grisu2_round(buffer, length, dist, delta, rest, uint64_t(pow10) << -one.m_e);
+         return;
+      }
+      pow10 /= 10;
+   }
+   int m = 0;
+   for (;;) {
+      fractional *= 10;
+      buffer[length++] = static_cast<char>('0' + (fractional >> -one.m_e));
+      fractional &= one.m_f - 1;
+      ++m;
+      delta *= 10;
+      dist *= 10;
+      if (fractional <= delta) {
+         break;
+      }
+   }
+   decimalExponent -= m;
+   grisu2_round(buffer, length, dist, delta, fractional, one.m_f);
+}
+
+/// Writes the shortest digits of the positive number \p value to \p buffer
+/// and returns how many there are. The number is the digits times
+/// 10^decimalExponent.
+template <typename FloatType>
+int shortest_digits(FloatType value, char *buffer, int &decimalExponent)
+{
+   Boundaries boundaries = compute_boundaries(value);
+   CachedPower cached = get_cached_power_for_binary_exponent(boundaries.m_plus.m_e);
+   DiyFp power{cached.m_f, cached.m_e};
+   DiyFp scaled = DiyFp::mul(boundaries.m_value, power);
+   DiyFp minus = DiyFp::mul(boundaries.m_minus, power);
+   DiyFp plus = DiyFp::mul(boundaries.m_plus, power);
+   // The products are off by up to one unit, so the boundaries are narrowed
+   // by one to stay on the safe side.
+   minus.m_f += 1;
+   plus.m_f -= 1;
+   int length = 0;
+   decimalExponent = -cached.m_k;
+   grisu2_digit_gen(buffer, length, decimalExponent, minus, scaled, plus);
+   return length;
+}
+
+/// Writes the exponent of the scientific notation, as printf() does.
+char *format_exponent(int exponent, char *ptr)
+{
+   if (exponent < 0) {
+      *ptr++ = '-';
+      exponent = -exponent;
+   } else {
+      *ptr++ = '+';
+   }
+   char digits[4];
+   char *start = format_decimal(static_cast<unsigned>(exponent), std::end(digits));
+   if (std::end(digits) - start < 2) {
+      *ptr++ = '0';
+   }
+   size_t len = std::end(digits) - start;
+   std::memcpy(ptr, start, len);
+   return ptr + len;
+}
+
+template <typename FloatType>
+void write_shortest_impl(RawOutStream &outStream, FloatType value)
+{
+   if (std::isnan(value)) {
+      outStream << "nan";
+      return;
+   }
+   // Room for the sign, 17 digits, 20 zeros, the point and the exponent.
+   char buffer[48];
+   char *ptr = buffer;
+   if (std::signbit(value)) {
+      *ptr++ = '-';
+      value = -value;
+   }
+   if (std::isinf(value)) {
+      outStream.write(buffer, ptr - buffer);
+      outStream << "inf";
+      return;
+   }
+   if (value == 0) {
+      *ptr++ = '0';
+      outStream.write(buffer, ptr - buffer);
+      return;
+   }
+   char digits[20];
+   int decimalExponent;
+   int length = shortest_digits(value, digits, decimalExponent);
+   // The exponent of the scientific notation.
+   int exponent = length + decimalExponent - 1;
+   if (exponent < -4 || exponent >= 17) {
+      *ptr++ = digits[0];
+      if (length > 1) {
+         *ptr++ = '.';
+         std::memcpy(ptr, digits + 1, length - 1);
+         ptr += length - 1;
+      }
+      *ptr++ = 'e';
+      ptr = format_exponent(exponent, ptr);
+   } else if (exponent < 0) {
+      *ptr++ = '0';
+      *ptr++ = '.';
+      std::memset(ptr, '0', -exponent - 1);
+      ptr += -exponent - 1;
+      std::memcpy(ptr, digits, length);
+      ptr += length;
+   } else if (length <= exponent + 1) {
+      std::memcpy(ptr, digits, length);
+      ptr += length;
+      std::memset(ptr, '0', exponent + 1 - length);
+      ptr += exponent + 1 - length;
+   } else {
+      std::memcpy(ptr, digits, exponent + 1);
+      ptr += exponent + 1;
+      *ptr++ = '.';
+      std::memcpy(ptr, digits + exponent + 1, length - exponent - 1);
+      ptr += length - exponent - 1;
+   }
+   outStream.write(buffer, ptr - buffer);
+}
+
+/// Writes \p value as "%.*e" would with \p precision, if its shortest
+/// digits are no more than that: then they are the digits printf() would
+/// round to, and the rest are zeros. This holds up to DBL_DIG digits, which
+/// are further apart than the neighbours of a normal number. Returns false
+/// otherwise.
+bool write_exponent_from_shortest(RawOutStream &outStream, double value,
+                                  size_t precision, char letter)
+{
+   if (precision + 1 > DBL_DIG) {
+      return false;
+   }
+   char buffer[48];
+   char *ptr = buffer;
+   if (std::signbit(value)) {
+      *ptr++ = '-';
+      value = -value;
+   }
+   char digits[20];
+   int length = 1;
+   int exponent = 0;
+   if (value == 0) {
+      digits[0] = '0';
+   } else {
+      if (value < DBL_MIN) {
+         return false;
+      }
+      int decimalExponent;
+      length = shortest_digits(value, digits, decimalExponent);
+      if (static_cast<size_t>(length) > precision + 1) {
+         return false;
+      }
+      exponent = length + decimalExponent - 1;
+   }
+   *ptr++ = digits[0];
+   if (precision) {
+      *ptr++ = '.';
+      std::memcpy(ptr, digits + 1, length - 1);
+      ptr += length - 1;
+      std::memset(ptr, '0', precision + 1 - length);
+      ptr += precision + 1 - length;
+   }
+   *ptr++ = letter;
+   ptr = format_exponent(exponent, ptr);
+   outStream.write(buffer, ptr - buffer);
+   return true;
+}
+
 } // anonymous namespace
 
 void write_integer(RawOutStream &outStream, unsigned int N, size_t minDigits,
@@ -163,17 +635,22 @@ void write_hex(RawOutStream &outStream, uint64_t N, HexPrintStyle style,
    unsigned numChars =
          std::max(static_cast<unsigned>(w), std::max(1u, nibbles) + prefixChars);
 
+   const char *digitPairs = upper ? sg_hexPairsUpper : sg_hexPairsLower;
    char numberBuffer[kMaxWidth];
-   ::memset(numberBuffer, '0', basic::array_lengthof(numberBuffer));
-   if (prefix) {
-      numberBuffer[1] = 'x';
-   }
    char *endPtr = numberBuffer + numChars;
    char *curPtr = endPtr;
-   while (N) {
-      unsigned char x = static_cast<unsigned char>(N) % 16;
-      *--curPtr = basic::hexdigit(x, !upper);
-      N /= 16;
+   // A byte at a time, then the odd nibble.
+   for (; nibbles >= 2; nibbles -= 2) {
+      curPtr -= 2;
+      std::memcpy(curPtr, digitPairs + static_cast<uint8_t>(N) * 2, 2);
+      N >>= 8;
+   }
+   if (nibbles) {
+      *--curPtr = digitPairs[static_cast<uint8_t>(N) * 2 + 1];
+   }
+   std::memset(numberBuffer, '0', curPtr - numberBuffer);
+   if (prefix) {
+      numberBuffer[1] = 'x';
    }
    outStream.write(numberBuffer, numChars);
 }
@@ -200,6 +677,10 @@ void write_double(RawOutStream &outStream, double N, FloatStyle style,
       letter = 'f';
    }
 
+   if (letter != 'f' && write_exponent_from_shortest(outStream, N, prec, letter)) {
+      return;
+   }
+
    SmallString<8> spec;
    RawSvectorOutStream out(spec);
    out << "%." << prec << letter;
@@ -268,6 +749,16 @@ void write_double(RawOutStream &outStream, double N, FloatStyle style,
    }
 }
 
+void write_shortest(RawOutStream &outStream, double value)
+{
+   write_shortest_impl(outStream, value);
+}
+
+void write_shortest(RawOutStream &outStream, float value)
+{
+   write_shortest_impl(outStream, value);
+}
+
 bool is_prefixed_hex_style(HexPrintStyle style)
 {
    return (style == HexPrintStyle::PrefixLower || style == HexPrintStyle::PrefixUpper);
@@ -12,9 +12,14 @@
 #include "polar/utils/Parallel.h"
 
 #include <atomic>
+#include <memory>
 #include <stack>
 #include <thread>
 
+#ifdef POLAR_OS_UNIX
+#include <unistd.h>
+#endif
+
 namespace polar {
 namespace utils {
 namespace parallel {
@@ -120,10 +125,31 @@ private:
    parallel::internal::Latch m_done;
 };
 
+/// \brief Stops the default executor at exit, in the process that started it
+///   only. A forked child has none of the threads of the pool, but its copy of
+///   the condition variable still counts them as waiting, so destroying the
+///   executor there would block forever.
+struct ExecutorDeleter
+{
+#ifdef POLAR_OS_UNIX
+   pid_t m_ownerPid = ::getpid();
+#endif
+
+   void operator()(ThreadPoolExecutor *exec) const
+   {
+#ifdef POLAR_OS_UNIX
+      if (::getpid() != m_ownerPid) {
+         return;
+      }
+#endif
+      delete exec;
+   }
+};
+
 Executor *Executor::getDefaultExecutor()
 {
-   static ThreadPoolExecutor exec;
-   return &exec;
+   static std::unique_ptr<ThreadPoolExecutor, ExecutorDeleter> exec(new ThreadPoolExecutor);
+   return exec.get();
 }
 #endif
 }
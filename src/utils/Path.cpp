@@ -1147,6 +1147,17 @@ void DirectoryEntry::replaceFilename(const Twine &filename,
    m_status = status;
 }
 
+FileType DirectoryEntry::getType() const
+{
+   FileType type = m_status.getType();
+   if (type != FileType::status_error && type != FileType::type_unknown &&
+       !(type == FileType::symlink_file && m_followSymlinks)) {
+      return type;
+   }
+   OptionalError<BasicFileStatus> status = getStatus();
+   return status ? status->getType() : FileType::status_error;
+}
+
 TempFile::TempFile(StringRef name, int fd)
    : m_tmpName(name), m_fd(fd)
 {}
@@ -22,6 +22,9 @@
 #include "polar/utils/Sha1.h"
 #include "polar/utils/Host.h"
 #include "polar/basic/adt/ArrayRef.h"
+#include "MultiBufferHash.h"
+
+#include <algorithm>
 
 namespace polar {
 namespace utils {
@@ -29,10 +32,6 @@ namespace utils {
 #include <stdint.h>
 #include <string.h>
 
-#if defined(BYTE_ORDER) && defined(BIG_ENDIAN) && BYTE_ORDER == BIG_ENDIAN
-#define SHA_BIG_ENDIAN
-#endif
-
 namespace {
 static uint32_t rol(uint32_t number, int bits)
 {
@@ -111,132 +110,299 @@ void Sha1::init()
    m_internalState.m_bufferOffset = 0;
 }
 
-void Sha1::hashBlock()
+namespace {
+
+using CompressFunc = void (*)(uint32_t *state, const uint8_t *data,
+                              size_t numBlocks);
+
+void compress_blocks_portable(uint32_t *state, const uint8_t *data,
+                              size_t numBlocks)
+{
+   uint32_t buffer[16];
+   for (; numBlocks; --numBlocks, data += 64) {
+      for (int i = 0; i < 16; ++i) {
+         buffer[i] = endian::read32be(data + 4 * i);
+      }
+      uint32_t A = state[0];
+      uint32_t B = state[1];
+      uint32_t C = state[2];
+      uint32_t D = state[3];
+      uint32_t E = state[4];
+
+      // 4 rounds of 20 operations each. Loop unrolled.
+      r0(A, B, C, D, E, 0, buffer);
+      r0(E, A, B, C, D, 1, buffer);
+      r0(D, E, A, B, C, 2, buffer);
+      r0(C, D, E, A, B, 3, buffer);
+      r0(B, C, D, E, A, 4, buffer);
+      r0(A, B, C, D, E, 5, buffer);
+      r0(E, A, B, C, D, 6, buffer);
+      r0(D, E, A, B, C, 7, buffer);
+      r0(C, D, E, A, B, 8, buffer);
+      r0(B, C, D, E, A, 9, buffer);
+      r0(A, B, C, D, E, 10, buffer);
+      r0(E, A, B, C, D, 11, buffer);
+      r0(D, E, A, B, C, 12, buffer);
+      r0(C, D, E, A, B, 13, buffer);
+      r0(B, C, D, E, A, 14, buffer);
+      r0(A, B, C, D, E, 15, buffer);
+      r1(E, A, B, C, D, 16, buffer);
+      r1(D, E, A, B, C, 17, buffer);
+      r1(C, D, E, A, B, 18, buffer);
+      r1(B, C, D, E, A, 19, buffer);
+
+      r2(A, B, C, D, E, 20, buffer);
+      r2(E, A, B, C, D, 21, buffer);
+      r2(D, E, A, B, C, 22, buffer);
+      r2(C, D, E, A, B, 23, buffer);
+      r2(B, C, D, E, A, 24, buffer);
+      r2(A, B, C, D, E, 25, buffer);
+      r2(E, A, B, C, D, 26, buffer);
+      r2(D, E, A, B, C, 27, buffer);
+      r2(C, D, E, A, B, 28, buffer);
+      r2(B, C, D, E, A, 29, buffer);
+      r2(A, B, C, D, E, 30, buffer);
+      r2(E, A, B, C, D, 31, buffer);
+      r2(D, E, A, B, C, 32, buffer);
+      r2(C, D, E, A, B, 33, buffer);
+      r2(B, C, D, E, A, 34, buffer);
+      r2(A, B, C, D, E, 35, buffer);
+      r2(E, A, B, C, D, 36, buffer);
+      r2(D, E, A, B, C, 37, buffer);
+      r2(C, D, E, A, B, 38, buffer);
+      r2(B, C, D, E, A, 39, buffer);
+
+      r3(A, B, C, D, E, 40, buffer);
+      r3(E, A, B, C, D, 41, buffer);
+      r3(D, E, A, B, C, 42, buffer);
+      r3(C, D, E, A, B, 43, buffer);
+      r3(B, C, D, E, A, 44, buffer);
+      r3(A, B, C, D, E, 45, buffer);
+      r3(E, A, B, C, D, 46, buffer);
+      r3(D, E, A, B, C, 47, buffer);
+      r3(C, D, E, A, B, 48, buffer);
+      r3(B, C, D, E, A, 49, buffer);
+      r3(A, B, C, D, E, 50, buffer);
+      r3(E, A, B, C, D, 51, buffer);
+      r3(D, E, A, B, C, 52, buffer);
+      r3(C, D, E, A, B, 53, buffer);
+      r3(B, C, D, E, A, 54, buffer);
+      r3(A, B, C, D, E, 55, buffer);
+      r3(E, A, B, C, D, 56, buffer);
+      r3(D, E, A, B, C, 57, buffer);
+      r3(C, D, E, A, B, 58, buffer);
+      r3(B, C, D, E, A, 59, buffer);
+
+      r4(A, B, C, D, E, 60, buffer);
+      r4(E, A, B, C, D, 61, buffer);
+      r4(D, E, A, B, C, 62, buffer);
+      r4(C, D, E, A, B, 63, buffer);
+      r4(B, C, D, E, A, 64, buffer);
+      r4(A, B, C, D, E, 65, buffer);
+      r4(E, A, B, C, D, 66, buffer);
+      r4(D, E, A, B, C, 67, buffer);
+      r4(C, D, E, A, B, 68, buffer);
+      r4(B, C, D, E, A, 69, buffer);
+      r4(A, B, C, D, E, 70, buffer);
+      r4(E, A, B, C, D, 71, buffer);
+      r4(D, E, A, B, C, 72, buffer);
+      r4(C, D, E, A, B, 73, buffer);
+      r4(B, C, D, E, A, 74, buffer);
+      r4(A, B, C, D, E, 75, buffer);
+      r4(E, A, B, C, D, 76, buffer);
+      r4(D, E, A, B, C, 77, buffer);
+      r4(C, D, E, A, B, 78, buffer);
+      r4(B, C, D, E, A, 79, buffer);
+
+      state[0] += A;
+      state[1] += B;
+      state[2] += C;
+      state[3] += D;
+      state[4] += E;
+   }
+}
+
+#ifdef POLAR_HAVE_SHA_INTRINSICS
+/// Compress blocks with the SHA extensions. Each group of four rounds uses
+/// one message vector; the schedule for later groups is built incrementally
+/// with sha1msg1/sha1msg2 while earlier groups are still being processed.
+template <int Func>
+__attribute__((target("sha,sse4.1,ssse3")))
+inline __m128i sha1_rounds4(__m128i abcd, __m128i e)
 {
-   uint32_t A = m_internalState.m_state[0];
-   uint32_t B = m_internalState.m_state[1];
-   uint32_t C = m_internalState.m_state[2];
-   uint32_t D = m_internalState.m_state[3];
-   uint32_t E = m_internalState.m_state[4];
-
-   // 4 rounds of 20 operations each. Loop unrolled.
-   r0(A, B, C, D, E, 0, m_internalState.m_buffer.L);
-   r0(E, A, B, C, D, 1, m_internalState.m_buffer.L);
-   r0(D, E, A, B, C, 2, m_internalState.m_buffer.L);
-   r0(C, D, E, A, B, 3, m_internalState.m_buffer.L);
-   r0(B, C, D, E, A, 4, m_internalState.m_buffer.L);
-   r0(A, B, C, D, E, 5, m_internalState.m_buffer.L);
-   r0(E, A, B, C, D, 6, m_internalState.m_buffer.L);
-   r0(D, E, A, B, C, 7, m_internalState.m_buffer.L);
-   r0(C, D, E, A, B, 8, m_internalState.m_buffer.L);
-   r0(B, C, D, E, A, 9, m_internalState.m_buffer.L);
-   r0(A, B, C, D, E, 10, m_internalState.m_buffer.L);
-   r0(E, A, B, C, D, 11, m_internalState.m_buffer.L);
-   r0(D, E, A, B, C, 12, m_internalState.m_buffer.L);
-   r0(C, D, E, A, B, 13, m_internalState.m_buffer.L);
-   r0(B, C, D, E, A, 14, m_internalState.m_buffer.L);
-   r0(A, B, C, D, E, 15, m_internalState.m_buffer.L);
-   r1(E, A, B, C, D, 16, m_internalState.m_buffer.L);
-   r1(D, E, A, B, C, 17, m_internalState.m_buffer.L);
-   r1(C, D, E, A, B, 18, m_internalState.m_buffer.L);
-   r1(B, C, D, E, A, 19, m_internalState.m_buffer.L);
-
-   r2(A, B, C, D, E, 20, m_internalState.m_buffer.L);
-   r2(E, A, B, C, D, 21, m_internalState.m_buffer.L);
-   r2(D, E, A, B, C, 22, m_internalState.m_buffer.L);
-   r2(C, D, E, A, B, 23, m_internalState.m_buffer.L);
-   r2(B, C, D, E, A, 24, m_internalState.m_buffer.L);
-   r2(A, B, C, D, E, 25, m_internalState.m_buffer.L);
-   r2(E, A, B, C, D, 26, m_internalState.m_buffer.L);
-   r2(D, E, A, B, C, 27, m_internalState.m_buffer.L);
-   r2(C, D, E, A, B, 28, m_internalState.m_buffer.L);
-   r2(B, C, D, E, A, 29, m_internalState.m_buffer.L);
-   r2(A, B, C, D, E, 30, m_internalState.m_buffer.L);
-   r2(E, A, B, C, D, 31, m_internalState.m_buffer.L);
-   r2(D, E, A, B, C, 32, m_internalState.m_buffer.L);
-   r2(C, D, E, A, B, 33, m_internalState.m_buffer.L);
-   r2(B, C, D, E, A, 34, m_internalState.m_buffer.L);
-   r2(A, B, C, D, E, 35, m_internalState.m_buffer.L);
-   r2(E, A, B, C, D, 36, m_internalState.m_buffer.L);
-   r2(D, E, A, B, C, 37, m_internalState.m_buffer.L);
-   r2(C, D, E, A, B, 38, m_internalState.m_buffer.L);
-   r2(B, C, D, E, A, 39, m_internalState.m_buffer.L);
-
-   r3(A, B, C, D, E, 40, m_internalState.m_buffer.L);
-   r3(E, A, B, C, D, 41, m_internalState.m_buffer.L);
-   r3(D, E, A, B, C, 42, m_internalState.m_buffer.L);
-   r3(C, D, E, A, B, 43, m_internalState.m_buffer.L);
-   r3(B, C, D, E, A, 44, m_internalState.m_buffer.L);
-   r3(A, B, C, D, E, 45, m_internalState.m_buffer.L);
-   r3(E, A, B, C, D, 46, m_internalState.m_buffer.L);
-   r3(D, E, A, B, C, 47, m_internalState.m_buffer.L);
-   r3(C, D, E, A, B, 48, m_internalState.m_buffer.L);
-   r3(B, C, D, E, A, 49, m_internalState.m_buffer.L);
-   r3(A, B, C, D, E, 50, m_internalState.m_buffer.L);
-   r3(E, A, B, C, D, 51, m_internalState.m_buffer.L);
-   r3(D, E, A, B, C, 52, m_internalState.m_buffer.L);
-   r3(C, D, E, A, B, 53, m_internalState.m_buffer.L);
-   r3(B, C, D, E, A, 54, m_internalState.m_buffer.L);
-   r3(A, B, C, D, E, 55, m_internalState.m_buffer.L);
-   r3(E, A, B, C, D, 56, m_internalState.m_buffer.L);
-   r3(D, E, A, B, C, 57, m_internalState.m_buffer.L);
-   r3(C, D, E, A, B, 58, m_internalState.m_buffer.L);
-   r3(B, C, D, E, A, 59, m_internalState.m_buffer.L);
-
-   r4(A, B, C, D, E, 60, m_internalState.m_buffer.L);
-   r4(E, A, B, C, D, 61, m_internalState.m_buffer.L);
-   r4(D, E, A, B, C, 62, m_internalState.m_buffer.L);
-   r4(C, D, E, A, B, 63, m_internalState.m_buffer.L);
-   r4(B, C, D, E, A, 64, m_internalState.m_buffer.L);
-   r4(A, B, C, D, E, 65, m_internalState.m_buffer.L);
-   r4(E, A, B, C, D, 66, m_internalState.m_buffer.L);
-   r4(D, E, A, B, C, 67, m_internalState.m_buffer.L);
-   r4(C, D, E, A, B, 68, m_internalState.m_buffer.L);
-   r4(B, C, D, E, A, 69, m_internalState.m_buffer.L);
-   r4(A, B, C, D, E, 70, m_internalState.m_buffer.L);
-   r4(E, A, B, C, D, 71, m_internalState.m_buffer.L);
-   r4(D, E, A, B, C, 72, m_internalState.m_buffer.L);
-   r4(C, D, E, A, B, 73, m_internalState.m_buffer.L);
-   r4(B, C, D, E, A, 74, m_internalState.m_buffer.L);
-   r4(A, B, C, D, E, 75, m_internalState.m_buffer.L);
-   r4(E, A, B, C, D, 76, m_internalState.m_buffer.L);
-   r4(D, E, A, B, C, 77, m_internalState.m_buffer.L);
-   r4(C, D, E, A, B, 78, m_internalState.m_buffer.L);
-   r4(B, C, D, E, A, 79, m_internalState.m_buffer.L);
-
-   m_internalState.m_state[0] += A;
-   m_internalState.m_state[1] += B;
-   m_internalState.m_state[2] += C;
-   m_internalState.m_state[3] += D;
-   m_internalState.m_state[4] += E;
+   return _mm_sha1rnds4_epu32(abcd, e, Func);
 }
 
-void Sha1::addUncounted(uint8_t data)
+__attribute__((target("sha,sse4.1,ssse3")))
+void compress_blocks_sha_ni(uint32_t *state, const uint8_t *data,
+                            size_t numBlocks)
 {
-#ifdef SHA_BIG_ENDIAN
-   m_internalState.m_buffer.C[m_internalState.m_bufferOffset] = data;
-#else
-   m_internalState.m_buffer.C[m_internalState.m_bufferOffset ^ 3] = data;
+   const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+   __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+   __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+   __m128i e1;
+   __m128i msg[4];
+
+   for (; numBlocks; --numBlocks, data += 64) {
+      __m128i abcdSave = abcd;
+      __m128i e0Save = e0;
+      // Fully unrolled, the message vectors stay in registers.
+#pragma GCC unroll 20
+      for (int group = 0; group < 20; ++group) {
+         __m128i &current = msg[group & 3];
+         if (group < 4) {
+            current = _mm_shuffle_epi8(
+                     _mm_loadu_si128((const __m128i *)(data + 16 * group)), mask);
+         }
+         __m128i &e = (group & 1) ? e1 : e0;
+         __m128i &next = (group & 1) ? e0 : e1;
+         if (group == 0) {
+            e = _mm_add_epi32(e, current);
+         } else {
+            e = _mm_sha1nexte_epu32(e, current);
+         }
+         next = abcd;
+         switch (group / 5) {
+         case 0: abcd = sha1_rounds4<0>(abcd, e); break;
+         case 1: abcd = sha1_rounds4<1>(abcd, e); break;
+         case 2: abcd = sha1_rounds4<2>(abcd, e); break;
+         default: abcd = sha1_rounds4<3>(abcd, e); break;
+         }
+         // Message schedule for the groups that follow.
+         if (group >= 3 && group <= 18) {
+            msg[(group + 1) & 3] = _mm_sha1msg2_epu32(msg[(group + 1) & 3], current);
+         }
+         if (group >= 2 && group <= 17) {
+            msg[(group + 2) & 3] = _mm_xor_si128(msg[(group + 2) & 3], current);
+         }
+         if (group >= 1 && group <= 16) {
+            msg[(group + 3) & 3] = _mm_sha1msg1_epu32(msg[(group + 3) & 3], current);
+         }
+      }
+      e0 = _mm_sha1nexte_epu32(e0, e0Save);
+      abcd = _mm_add_epi32(abcd, abcdSave);
+   }
+   _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+   state[4] = _mm_extract_epi32(e0, 3);
+}
 #endif
 
-   m_internalState.m_bufferOffset++;
-   if (m_internalState.m_bufferOffset == BLOCK_LENGTH) {
-      hashBlock();
-      m_internalState.m_bufferOffset = 0;
+#ifdef POLAR_HAVE_MULTI_BUFFER_HASH
+/// Four-lane SHA-1 compression used by Sha1::hashBatch.
+struct Sha1LaneKernel
+{
+   enum { STATE_WORDS = 5 };
+   static const uint32_t sm_iv[STATE_WORDS];
+
+   static void compress(internal::LaneVector *state,
+                        const uint8_t *const blocks[internal::MULTI_BUFFER_LANES])
+   {
+      using internal::LaneVector;
+      using internal::lane_rotl;
+      LaneVector w[16];
+      for (unsigned i = 0; i < 16; ++i) {
+         w[i] = internal::lane_load_be(blocks, i);
+      }
+      LaneVector a = state[0];
+      LaneVector b = state[1];
+      LaneVector c = state[2];
+      LaneVector d = state[3];
+      LaneVector e = state[4];
+      for (unsigned i = 0; i < 80; ++i) {
+         if (i >= 16) {
+            w[i & 15] = lane_rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^
+                  w[(i + 2) & 15] ^ w[i & 15], 1);
+         }
+         LaneVector f;
+         uint32_t k;
+         if (i < 20) {
+            f = ((b & (c ^ d)) ^ d);
+            k = Sha1_K0;
+         } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = Sha1_K20;
+         } else if (i < 60) {
+            f = ((b | c) & d) | (b & c);
+            k = Sha1_K40;
+         } else {
+            f = b ^ c ^ d;
+            k = Sha1_K60;
+         }
+         LaneVector temp = lane_rotl(a, 5) + f + e + k + w[i & 15];
+         e = d;
+         d = c;
+         c = lane_rotl(b, 30);
+         b = a;
+         a = temp;
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
    }
+};
+
+const uint32_t Sha1LaneKernel::sm_iv[] = {SEED_0, SEED_1, SEED_2, SEED_3, SEED_4};
+#endif
+
+Sha1::Implementation sg_implementation = Sha1::Implementation::Host;
+
+bool use_sha_extensions()
+{
+   return sg_implementation == Sha1::Implementation::Host &&
+         internal::host_has_sha_extensions();
+}
+
+CompressFunc get_compress_func()
+{
+#ifdef POLAR_HAVE_SHA_INTRINSICS
+   return use_sha_extensions() ? compress_blocks_sha_ni : compress_blocks_portable;
+#else
+   return compress_blocks_portable;
+#endif
 }
 
-void Sha1::writebyte(uint8_t data)
+} // anonymous namespace
+
+void Sha1::addUncounted(uint8_t data)
 {
-   ++m_internalState.m_byteCount;
-   addUncounted(data);
+   m_internalState.m_buffer[m_internalState.m_bufferOffset++] = data;
+   if (m_internalState.m_bufferOffset == BLOCK_LENGTH) {
+      get_compress_func()(m_internalState.m_state, m_internalState.m_buffer, 1);
+      m_internalState.m_bufferOffset = 0;
+   }
 }
 
 void Sha1::update(ArrayRef<uint8_t> data)
 {
-   for (auto &c : data) {
-      writebyte(c);
+   const uint8_t *ptr = data.getData();
+   size_t size = data.getSize();
+   CompressFunc compress = get_compress_func();
+   m_internalState.m_byteCount += size;
+
+   // Top up a partially filled block first.
+   if (m_internalState.m_bufferOffset) {
+      size_t count = std::min<size_t>(size, BLOCK_LENGTH - m_internalState.m_bufferOffset);
+      memcpy(m_internalState.m_buffer + m_internalState.m_bufferOffset, ptr, count);
+      m_internalState.m_bufferOffset += count;
+      ptr += count;
+      size -= count;
+      if (m_internalState.m_bufferOffset < BLOCK_LENGTH) {
+         return;
+      }
+      compress(m_internalState.m_state, m_internalState.m_buffer, 1);
+      m_internalState.m_bufferOffset = 0;
    }
+   // Compress whole blocks straight out of the caller's buffer.
+   if (size >= BLOCK_LENGTH) {
+      size_t numBlocks = size / BLOCK_LENGTH;
+      compress(m_internalState.m_state, ptr, numBlocks);
+      ptr += numBlocks * BLOCK_LENGTH;
+      size -= numBlocks * BLOCK_LENGTH;
+   }
+   memcpy(m_internalState.m_buffer, ptr, size);
+   m_internalState.m_bufferOffset = size;
 }
 
 void Sha1::pad()
@@ -248,16 +414,11 @@ void Sha1::pad()
    while (m_internalState.m_bufferOffset != 56) {
       addUncounted(0x00);
    }
-   // Append length in the last 8 bytes
-   addUncounted(0); // We're only using 32 bit lengths
-   addUncounted(0); // But SHA-1 supports 64 bit lengths
-   addUncounted(0); // So zero pad the top bits
-   addUncounted(m_internalState.m_byteCount >> 29); // Shifting to multiply by 8
-   addUncounted(m_internalState.m_byteCount >>
-                21); // as SHA-1 supports bitstreams as well as
-   addUncounted(m_internalState.m_byteCount >> 13); // byte.
-   addUncounted(m_internalState.m_byteCount >> 5);
-   addUncounted(m_internalState.m_byteCount << 3);
+   // Append the 64-bit length in bits in the last 8 bytes
+   uint64_t bitCount = m_internalState.m_byteCount << 3;
+   for (int shift = 56; shift >= 0; shift -= 8) {
+      addUncounted(uint8_t(bitCount >> shift));
+   }
 }
 
 StringRef Sha1::final()
@@ -265,20 +426,10 @@ StringRef Sha1::final()
    // Pad to complete the last block
    pad();
 
-#ifdef SHA_BIG_ENDIAN
-   // Just copy the current state
+   // The digest is the state in big-endian byte order
    for (int i = 0; i < 5; i++) {
-      m_hashResult[i] = m_internalState.m_state[i];
+      endian::write32be(&m_hashResult[i], m_internalState.m_state[i]);
    }
-#else
-   // Swap byte order back
-   for (int i = 0; i < 5; i++) {
-      m_hashResult[i] = (((m_internalState.m_state[i]) << 24) & 0xff000000) |
-            (((m_internalState.m_state[i]) << 8) & 0x00ff0000) |
-            (((m_internalState.m_state[i]) >> 8) & 0x0000ff00) |
-            (((m_internalState.m_state[i]) >> 24) & 0x000000ff);
-   }
-#endif
 
    // Return pointer to hash (20 characters)
    return StringRef((char *)m_hashResult, HASH_LENGTH);
@@ -304,5 +455,43 @@ std::array<uint8_t, 20> Sha1::hash(ArrayRef<uint8_t> data)
    return array;
 }
 
+std::vector<std::array<uint8_t, 20>>
+Sha1::hashBatch(ArrayRef<ArrayRef<uint8_t>> data)
+{
+   std::vector<std::array<uint8_t, 20>> results(data.getSize());
+#ifdef POLAR_HAVE_MULTI_BUFFER_HASH
+   // A single SHA-NI stream outruns four interleaved SSE lanes, so only fall
+   // back to lane interleaving when the extensions are missing.
+   if (sg_implementation == Implementation::MultiBuffer ||
+       (sg_implementation == Implementation::Host &&
+        !internal::host_has_sha_extensions())) {
+      static_assert(sizeof(std::array<uint8_t, 20>) == 20,
+                    "digests must be densely packed");
+      internal::hash_multi_buffer<Sha1LaneKernel>(data, results.data()->data());
+      return results;
+   }
+#endif
+   for (size_t i = 0, e = data.getSize(); i != e; ++i) {
+      results[i] = hash(data[i]);
+   }
+   return results;
+}
+
+bool Sha1::hasHardwareAcceleration()
+{
+   return use_sha_extensions();
+}
+
+bool Sha1::setImplementation(Implementation impl)
+{
+#ifndef POLAR_HAVE_MULTI_BUFFER_HASH
+   if (impl == Implementation::MultiBuffer) {
+      return false;
+   }
+#endif
+   sg_implementation = impl;
+   return true;
+}
+
 } // utils
 } // polar
@@ -0,0 +1,352 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/Sha256.h"
+#include "polar/utils/Endian.h"
+#include "MultiBufferHash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace polar {
+namespace utils {
+
+namespace {
+
+const uint32_t sg_roundConstants[64] = {
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+   0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+   0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+   0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+   0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+   0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+   0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+   0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+   0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t sg_initialState[8] = {
+   0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t rotr(uint32_t value, int bits)
+{
+   return (value >> bits) | (value << (32 - bits));
+}
+
+using CompressFunc = void (*)(uint32_t *state, const uint8_t *data,
+                              size_t numBlocks);
+
+void compress_blocks_portable(uint32_t *state, const uint8_t *data,
+                              size_t numBlocks)
+{
+   uint32_t w[64];
+   for (; numBlocks; --numBlocks, data += 64) {
+      for (int i = 0; i < 16; ++i) {
+         w[i] = endian::read32be(data + 4 * i);
+      }
+      for (int i = 16; i < 64; ++i) {
+         uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+         uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+         w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+      uint32_t a = state[0];
+      uint32_t b = state[1];
+      uint32_t c = state[2];
+      uint32_t d = state[3];
+      uint32_t e = state[4];
+      uint32_t f = state[5];
+      uint32_t g = state[6];
+      uint32_t h = state[7];
+      for (int i = 0; i < 64; ++i) {
+         uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+         uint32_t ch = (e & f) ^ (~e & g);
+         uint32_t temp1 = h + s1 + ch + sg_roundConstants[i] + w[i];
+         uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+         uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+         uint32_t temp2 = s0 + maj;
+         h = g;
+         g = f;
+         f = e;
+         e = d + temp1;
+         d = c;
+         c = b;
+         b = a;
+         a = temp1 + temp2;
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+   }
+}
+
+#ifdef POLAR_HAVE_SHA_INTRINSICS
+/// Compress blocks with the SHA extensions. The state is kept as the ABEF/CDGH
+/// register pair sha256rnds2 expects; each group of four rounds consumes one
+/// message vector and extends the schedule with sha256msg1/sha256msg2.
+__attribute__((target("sha,sse4.1,ssse3")))
+void compress_blocks_sha_ni(uint32_t *state, const uint8_t *data,
+                            size_t numBlocks)
+{
+   const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+   __m128i temp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+   __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+   __m128i state0 = _mm_alignr_epi8(temp, state1, 8);
+   state1 = _mm_blend_epi16(state1, temp, 0xF0);
+   __m128i msg[4];
+
+   for (; numBlocks; --numBlocks, data += 64) {
+      __m128i abefSave = state0;
+      __m128i cdghSave = state1;
+      // Fully unrolled, the message vectors stay in registers.
+#pragma GCC unroll 16
+      for (int group = 0; group < 16; ++group) {
+         __m128i &current = msg[group & 3];
+         if (group < 4) {
+            current = _mm_shuffle_epi8(
+                     _mm_loadu_si128((const __m128i *)(data + 16 * group)), mask);
+         }
+         __m128i roundInput = _mm_add_epi32(
+                  current, _mm_loadu_si128((const __m128i *)&sg_roundConstants[4 * group]));
+         state1 = _mm_sha256rnds2_epu32(state1, state0, roundInput);
+         if (group >= 3 && group <= 14) {
+            __m128i &next = msg[(group + 1) & 3];
+            next = _mm_add_epi32(next, _mm_alignr_epi8(current, msg[(group + 3) & 3], 4));
+            next = _mm_sha256msg2_epu32(next, current);
+         }
+         state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(roundInput, 0x0E));
+         if (group >= 1 && group <= 12) {
+            msg[(group + 3) & 3] = _mm_sha256msg1_epu32(msg[(group + 3) & 3], current);
+         }
+      }
+      state0 = _mm_add_epi32(state0, abefSave);
+      state1 = _mm_add_epi32(state1, cdghSave);
+   }
+   temp = _mm_shuffle_epi32(state0, 0x1B);
+   state1 = _mm_shuffle_epi32(state1, 0xB1);
+   state0 = _mm_blend_epi16(temp, state1, 0xF0);
+   state1 = _mm_alignr_epi8(state1, temp, 8);
+   _mm_storeu_si128((__m128i *)&state[0], state0);
+   _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+#endif
+
+#ifdef POLAR_HAVE_MULTI_BUFFER_HASH
+/// Four-lane SHA-256 compression used by Sha256::hashBatch.
+struct Sha256LaneKernel
+{
+   enum { STATE_WORDS = 8 };
+   static const uint32_t *const sm_iv;
+
+   static void compress(internal::LaneVector *state,
+                        const uint8_t *const blocks[internal::MULTI_BUFFER_LANES])
+   {
+      using internal::LaneVector;
+      using internal::lane_rotr;
+      LaneVector w[16];
+      for (unsigned i = 0; i < 16; ++i) {
+         w[i] = internal::lane_load_be(blocks, i);
+      }
+      LaneVector a = state[0];
+      LaneVector b = state[1];
+      LaneVector c = state[2];
+      LaneVector d = state[3];
+      LaneVector e = state[4];
+      LaneVector f = state[5];
+      LaneVector g = state[6];
+      LaneVector h = state[7];
+      for (unsigned i = 0; i < 64; ++i) {
+         if (i >= 16) {
+            LaneVector w15 = w[(i + 1) & 15];
+            LaneVector w2 = w[(i + 14) & 15];
+            LaneVector s0 = lane_rotr(w15, 7) ^ lane_rotr(w15, 18) ^ (w15 >> 3);
+            LaneVector s1 = lane_rotr(w2, 17) ^ lane_rotr(w2, 19) ^ (w2 >> 10);
+            w[i & 15] += s0 + w[(i + 9) & 15] + s1;
+         }
+         LaneVector s1 = lane_rotr(e, 6) ^ lane_rotr(e, 11) ^ lane_rotr(e, 25);
+         LaneVector ch = (e & f) ^ (~e & g);
+         LaneVector temp1 = h + s1 + ch + sg_roundConstants[i] + w[i & 15];
+         LaneVector s0 = lane_rotr(a, 2) ^ lane_rotr(a, 13) ^ lane_rotr(a, 22);
+         LaneVector maj = (a & b) ^ (a & c) ^ (b & c);
+         h = g;
+         g = f;
+         f = e;
+         e = d + temp1;
+         d = c;
+         c = b;
+         b = a;
+         a = temp1 + s0 + maj;
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+   }
+};
+
+const uint32_t *const Sha256LaneKernel::sm_iv = sg_initialState;
+#endif
+
+Sha256::Implementation sg_implementation = Sha256::Implementation::Host;
+
+bool use_sha_extensions()
+{
+   return sg_implementation == Sha256::Implementation::Host &&
+         internal::host_has_sha_extensions();
+}
+
+CompressFunc get_compress_func()
+{
+#ifdef POLAR_HAVE_SHA_INTRINSICS
+   return use_sha_extensions() ? compress_blocks_sha_ni : compress_blocks_portable;
+#else
+   return compress_blocks_portable;
+#endif
+}
+
+} // anonymous namespace
+
+void Sha256::init()
+{
+   std::memcpy(m_internalState.m_state, sg_initialState, sizeof(sg_initialState));
+   m_internalState.m_byteCount = 0;
+   m_internalState.m_bufferOffset = 0;
+}
+
+void Sha256::update(ArrayRef<uint8_t> data)
+{
+   const uint8_t *ptr = data.getData();
+   size_t size = data.getSize();
+   CompressFunc compress = get_compress_func();
+   m_internalState.m_byteCount += size;
+
+   // Top up a partially filled block first.
+   if (m_internalState.m_bufferOffset) {
+      size_t count = std::min<size_t>(size, BLOCK_LENGTH - m_internalState.m_bufferOffset);
+      std::memcpy(m_internalState.m_buffer + m_internalState.m_bufferOffset, ptr, count);
+      m_internalState.m_bufferOffset += count;
+      ptr += count;
+      size -= count;
+      if (m_internalState.m_bufferOffset < BLOCK_LENGTH) {
+         return;
+      }
+      compress(m_internalState.m_state, m_internalState.m_buffer, 1);
+      m_internalState.m_bufferOffset = 0;
+   }
+   // Compress whole blocks straight out of the caller's buffer.
+   if (size >= BLOCK_LENGTH) {
+      size_t numBlocks = size / BLOCK_LENGTH;
+      compress(m_internalState.m_state, ptr, numBlocks);
+      ptr += numBlocks * BLOCK_LENGTH;
+      size -= numBlocks * BLOCK_LENGTH;
+   }
+   std::memcpy(m_internalState.m_buffer, ptr, size);
+   m_internalState.m_bufferOffset = size;
+}
+
+void Sha256::pad()
+{
+   // Pad with 0x80 followed by 0x00 until 8 bytes are left in the block, then
+   // append the 64-bit message length in bits (fips180-4 5.1.1).
+   CompressFunc compress = get_compress_func();
+   uint8_t *buffer = m_internalState.m_buffer;
+   size_t offset = m_internalState.m_bufferOffset;
+   buffer[offset++] = 0x80;
+   if (offset > BLOCK_LENGTH - 8) {
+      std::memset(buffer + offset, 0, BLOCK_LENGTH - offset);
+      compress(m_internalState.m_state, buffer, 1);
+      offset = 0;
+   }
+   std::memset(buffer + offset, 0, BLOCK_LENGTH - 8 - offset);
+   endian::write64be(buffer + BLOCK_LENGTH - 8, m_internalState.m_byteCount << 3);
+   compress(m_internalState.m_state, buffer, 1);
+   m_internalState.m_bufferOffset = 0;
+}
+
+StringRef Sha256::final()
+{
+   pad();
+   for (int i = 0; i < 8; i++) {
+      endian::write32be(&m_hashResult[i], m_internalState.m_state[i]);
+   }
+   return StringRef((char *)m_hashResult, HASH_LENGTH);
+}
+
+StringRef Sha256::result()
+{
+   auto stateToRestore = m_internalState;
+   auto hash = final();
+   m_internalState = stateToRestore;
+   return hash;
+}
+
+std::array<uint8_t, 32> Sha256::hash(ArrayRef<uint8_t> data)
+{
+   Sha256 hash;
+   hash.update(data);
+   StringRef str = hash.final();
+   std::array<uint8_t, 32> array;
+   std::memcpy(array.data(), str.getData(), str.getSize());
+   return array;
+}
+
+std::vector<std::array<uint8_t, 32>>
+Sha256::hashBatch(ArrayRef<ArrayRef<uint8_t>> data)
+{
+   std::vector<std::array<uint8_t, 32>> results(data.getSize());
+#ifdef POLAR_HAVE_MULTI_BUFFER_HASH
+   // A single SHA-NI stream outruns four interleaved SSE lanes, so only fall
+   // back to lane interleaving when the extensions are missing.
+   if (sg_implementation == Implementation::MultiBuffer ||
+       (sg_implementation == Implementation::Host &&
+        !internal::host_has_sha_extensions())) {
+      static_assert(sizeof(std::array<uint8_t, 32>) == 32,
+                    "digests must be densely packed");
+      internal::hash_multi_buffer<Sha256LaneKernel>(data, results.data()->data());
+      return results;
+   }
+#endif
+   for (size_t i = 0, e = data.getSize(); i != e; ++i) {
+      results[i] = hash(data[i]);
+   }
+   return results;
+}
+
+bool Sha256::hasHardwareAcceleration()
+{
+   return use_sha_extensions();
+}
+
+bool Sha256::setImplementation(Implementation impl)
+{
+#ifndef POLAR_HAVE_MULTI_BUFFER_HASH
+   if (impl == Implementation::MultiBuffer) {
+      return false;
+   }
+#endif
+   sg_implementation = impl;
+   return true;
+}
+
+} // utils
+} // polar
@@ -22,6 +22,8 @@
 #include "polar/basic/adt/SmallVector.h"
 #include "polar/basic/adt/StringExtras.h"
 #include "polar/utils/MemoryBuffer.h"
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -42,6 +44,46 @@ bool is_literal_regex(const StringRef str)
    // regular expression specification.
    return str.findFirstOf(sg_regexMetachars) == StringRef::npos;
 }
+
+bool is_glob_regex(const StringRef str)
+{
+   // Only '*' of all metacharacters, which insert() turns into ".*".
+   for (char c : str) {
+      if (c != '*' && strchr(sg_regexMetachars, c)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/// Matches \p query against \p glob where '*' stands for any sequence of
+/// characters, by backtracking to the most recent '*' on a mismatch.
+bool glob_match(StringRef glob, StringRef query)
+{
+   size_t globPos = 0;
+   size_t queryPos = 0;
+   size_t starPos = StringRef::npos;
+   size_t starQueryPos = 0;
+   while (queryPos < query.size()) {
+      if (globPos < glob.size() && glob[globPos] == '*') {
+         starPos = globPos++;
+         starQueryPos = queryPos;
+      } else if (globPos < glob.size() && glob[globPos] == query[queryPos]) {
+         ++globPos;
+         ++queryPos;
+      } else if (starPos != StringRef::npos) {
+         globPos = starPos + 1;
+         queryPos = ++starQueryPos;
+      } else {
+         return false;
+      }
+   }
+   while (globPos < glob.size() && glob[globPos] == '*') {
+      ++globPos;
+   }
+   return globPos == glob.size();
+}
+
 } // anonymous namespace
 
 bool SpecialCaseList::Matcher::insert(std::string regexp,
@@ -56,7 +98,17 @@ bool SpecialCaseList::Matcher::insert(std::string regexp,
       m_strings[regexp] = lineNumber;
       return true;
    }
-   m_trigrams.insert(regexp);
+   // Both prefilters work from the same runs: the trigram index needs all of
+   // them, the automaton looks for the longest.
+   std::vector<std::string> runs;
+   bool hasRuns = get_required_regex_runs(regexp, runs);
+   std::string literal;
+   for (const std::string &run : runs) {
+      if (run.size() > literal.size()) {
+         literal = run;
+      }
+   }
+   std::string glob = is_glob_regex(regexp) ? regexp : std::string();
 
    // Replace * with .*
    for (size_t pos = 0; (pos = regexp.find('*', pos)) != std::string::npos;
@@ -69,8 +121,21 @@ bool SpecialCaseList::Matcher::insert(std::string regexp,
    try {
       // Check that the regexp is valid.
       std::regex checkRE(regexp);
-      m_regExes.emplace_back(
-               std::make_pair(std::make_unique<std::regex>(std::move(checkRE)), lineNumber));
+      unsigned index = m_regExes.size();
+      m_regExes.push_back({std::make_unique<std::regex>(std::move(checkRE)), lineNumber,
+                           std::move(glob)});
+      // Keep rule ids of the trigram index equal to indexes of m_regExes.
+      if (hasRuns) {
+         m_trigrams.insertRuns(runs);
+      } else {
+         m_trigrams.insertUnindexed();
+      }
+      if (literal.empty()) {
+         m_unfiltered.push_back(index);
+      } else {
+         m_factors.insert(literal, index);
+      }
+      m_compiled = false;
       return true;
    } catch (const std::regex_error& e) {
       reError = e.what();
@@ -78,18 +143,55 @@ bool SpecialCaseList::Matcher::insert(std::string regexp,
    }
 }
 
+void SpecialCaseList::Matcher::compile()
+{
+   m_factors.build();
+   m_compiled = true;
+}
+
+bool SpecialCaseList::Matcher::matches(const RegexEntry &entry, StringRef query) const
+{
+   // '.' does not match line terminators, leave those queries to std::regex.
+   if (!entry.m_glob.empty() && query.findFirstOf("\r\n") == StringRef::npos) {
+      return glob_match(entry.m_glob, query);
+   }
+   return std::regex_match(query.begin(), query.end(), *entry.m_regex);
+}
+
 unsigned SpecialCaseList::Matcher::match(StringRef query) const
 {
    auto iter = m_strings.find(query);
    if (iter != m_strings.end()) {
       return iter->m_second;
    }
-   if (m_trigrams.isDefinitelyOut(query)) {
-      return false;
+   // Rules whose required trigrams all occur in the query, in index order.
+   SmallVector<unsigned, 16> candidates;
+   m_trigrams.getCandidates(query, candidates);
+   if (candidates.empty()) {
+      return 0;
+   }
+   if (!m_compiled) {
+      for (unsigned index : candidates) {
+         if (matches(m_regExes[index], query)) {
+            return m_regExes[index].m_lineNumber;
+         }
+      }
+      return 0;
    }
-   for (auto& regExKV : m_regExes) {
-      if (std::regex_match(query.getStr(), *regExKV.first)) {
-         return regExKV.second;
+   // A rule must also be found by the automaton, unless it has no required
+   // literal. The first matching rule in insertion order wins.
+   SmallVector<unsigned, 16> factors;
+   m_factors.search(query, [&](unsigned index) {
+      factors.push_back(index);
+   });
+   std::sort(factors.begin(), factors.end());
+   for (unsigned index : candidates) {
+      if (!std::binary_search(factors.begin(), factors.end(), index) &&
+          !std::binary_search(m_unfiltered.begin(), m_unfiltered.end(), index)) {
+         continue;
+      }
+      if (matches(m_regExes[index], query)) {
+         return m_regExes[index].m_lineNumber;
       }
    }
    return 0;
@@ -143,6 +245,7 @@ bool SpecialCaseList::createInternal(const std::vector<std::string> &paths,
          return false;
       }
    }
+   compileMatchers();
    return true;
 }
 
@@ -153,9 +256,22 @@ bool SpecialCaseList::createInternal(const MemoryBuffer *memoryBuffer,
    if (!parse(memoryBuffer, m_sections, error)) {
       return false;
    }
+   compileMatchers();
    return true;
 }
 
+void SpecialCaseList::compileMatchers()
+{
+   for (Section &section : m_sections) {
+      section.m_sectionMatcher->compile();
+      for (auto &prefix : section.m_entries) {
+         for (auto &category : prefix.getValue()) {
+            category.getValue().compile();
+         }
+      }
+   }
+}
+
 bool SpecialCaseList::parse(const MemoryBuffer *memoryBuffer,
                             StringMap<size_t> &sectionsMap,
                             std::string &error)
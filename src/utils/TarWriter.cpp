@@ -10,10 +10,19 @@
 // Created by softboy on 2018/07/15.
 
 #include "polar/utils/TarWriter.h"
+#include "polar/basic/adt/ArrayRef.h"
 #include "polar/basic/adt/StringRef.h"
+#include "polar/utils/Compression.h"
 #include "polar/utils/FileSystem.h"
 #include "polar/utils/MathExtras.h"
 #include "polar/utils/Path.h"
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+
+#ifdef POLAR_ON_UNIX
+#include <unistd.h>
+#endif
 
 namespace polar {
 namespace utils {
@@ -93,25 +102,6 @@ void compute_checksum(UstarHeader &header)
    snprintf(header.Checksum, sizeof(header.Checksum), "%06o", chksum);
 }
 
-// Create a tar header and write it to a given output stream.
-void write_pax_header(RawFdOutStream &outstream, StringRef path)
-{
-   // A PAX header consists of a 512-byte header followed
-   // by key-value strings. First, create key-value strings.
-   std::string paxAttr = format_pax("path", path);
-
-   // Create a 512-byte header.
-   UstarHeader header = make_ustar_header();
-   snprintf(header.Size, sizeof(header.Size), "%011zo", paxAttr.size());
-   header.TypeFlag = 'x'; // PAX magic
-   compute_checksum(header);
-
-   // Write them down.
-   outstream << StringRef(reinterpret_cast<char *>(&header), sizeof(header));
-   outstream << paxAttr;
-   pad(outstream);
-}
-
 // path fits in a Ustar header if
 //
 // - path is less than 100 characters long, or
@@ -140,37 +130,150 @@ bool split_ustar(StringRef path, StringRef &prefix, StringRef &name)
    return true;
 }
 
-// The PAX header is an extended format, so a PAX header needs
-// to be followed by a "real" header.
-void write_ustar_header(RawFdOutStream &outstream, StringRef prefix,
-                             StringRef name, size_t Size)
+// Creates the tar headers of a member, a PAX header followed by a Ustar
+// header if the path does not fit in the latter.
+std::string make_headers(StringRef path, uint64_t size)
 {
+   std::string headers;
+   StringRef prefix;
+   StringRef name;
+   if (!split_ustar(path, prefix, name)) {
+      // A PAX header consists of a 512-byte header followed
+      // by key-value strings. First, create key-value strings.
+      std::string paxAttr = format_pax("path", path);
+
+      // Create a 512-byte header.
+      UstarHeader header = make_ustar_header();
+      snprintf(header.Size, sizeof(header.Size), "%011zo", paxAttr.size());
+      header.TypeFlag = 'x'; // PAX magic
+      compute_checksum(header);
+
+      headers.append(reinterpret_cast<char *>(&header), sizeof(header));
+      headers += paxAttr;
+      headers.resize(align_to(headers.size(), sg_blockSize), '\0');
+      prefix = "";
+      name = "";
+   }
+   // The PAX header is an extended format, so a PAX header needs
+   // to be followed by a "real" header.
    UstarHeader header = make_ustar_header();
    memcpy(header.name, name.getData(), name.size());
    memcpy(header.Mode, "0000664", 8);
-   snprintf(header.Size, sizeof(header.Size), "%011zo", Size);
+   snprintf(header.Size, sizeof(header.Size), "%011llo", (unsigned long long)size);
    memcpy(header.prefix, prefix.getData(), prefix.size());
    compute_checksum(header);
-   outstream << StringRef(reinterpret_cast<char *>(&header), sizeof(header));
+   headers.append(reinterpret_cast<char *>(&header), sizeof(header));
+   return headers;
+}
+
+// Returns the data of the tar member at the start of \p member, past its
+// headers.
+bool find_member_data(StringRef member, StringRef &data)
+{
+   uint64_t dataOffset = 0;
+   for (;;) {
+      if (member.size() < dataOffset + sg_blockSize) {
+         return false;
+      }
+      const UstarHeader *header =
+            reinterpret_cast<const UstarHeader *>(member.getData() + dataOffset);
+      unsigned long long size;
+      if (StringRef(header->Size, sizeof(header->Size) - 1).trim(StringRef(" \0", 2))
+          .getAsInteger(8, size)) {
+         return false;
+      }
+      dataOffset += sg_blockSize;
+      if (header->TypeFlag == 'x') {
+         dataOffset += align_to(size, sg_blockSize);
+         continue;
+      }
+      if (member.size() < dataOffset + size) {
+         return false;
+      }
+      data = member.substr(dataOffset, size);
+      return true;
+   }
+}
+
+// Zeros to pad members and to end archives with.
+const char sg_zeros[sg_blockSize * 2] = {};
+
+// The member holding the index of an IndexedGzip archive, at the top of the
+// base directory.
+const char sg_indexName[] = ".polar-tar-index";
+const char sg_indexMagic[] = "polar-tar-index 1\n";
+
+// IndexedGzip archives end with an empty gzip member which points to the
+// index in an extra field of its header: the offset and size of the gzip
+// member of the index, and the size of that member decompressed, as 16 hex
+// digits each, followed by a magic string.
+const char sg_footerMagic[] = "TARIDX";
+enum
+{
+   FooterPayloadSize = 16 * 3 + sizeof(sg_footerMagic) - 1,
+   FooterSize = 10 + 2 + 4 + FooterPayloadSize + 2 + 8
+};
+
+std::string make_footer(uint64_t indexOffset, uint64_t indexCompressedSize,
+                        uint64_t indexSize)
+{
+   std::string footer;
+   // ID1, ID2, CM = deflate, FLG = FEXTRA, MTIME, XFL, OS = unknown.
+   footer.append("\x1f\x8b\x08\x04\0\0\0\0\0\xff", 10);
+   footer += char((4 + FooterPayloadSize) & 0xff);
+   footer += char((4 + FooterPayloadSize) >> 8);
+   // Subfield "PT" and its length.
+   footer += "PT";
+   footer += char(FooterPayloadSize & 0xff);
+   footer += char(FooterPayloadSize >> 8);
+   for (uint64_t value : {indexOffset, indexCompressedSize, indexSize}) {
+      char digits[17];
+      snprintf(digits, sizeof(digits), "%016llx", (unsigned long long)value);
+      footer.append(digits, 16);
+   }
+   footer += sg_footerMagic;
+   // An empty final deflate block, then the CRC and size of nothing.
+   footer.append("\x03\0\0\0\0\0\0\0\0\0", 10);
+   assert(footer.size() == FooterSize);
+   return footer;
+}
+
+Error make_format_error(const Twine &message)
+{
+   return make_error<StringError>(message, inconvertible_error_code());
 }
 
 } // anonymous namespace
 
 // Creates a TarWriter instance and returns it.
 Expected<std::unique_ptr<TarWriter>> TarWriter::create(StringRef outputPath,
-                                                       StringRef baseDir)
+                                                       StringRef baseDir,
+                                                       Format format)
 {
+   if (format == IndexedGzip && !zlib::is_available()) {
+      return make_error<StringError>("cannot create " + outputPath +
+                                     ": zlib is unavailable",
+                                     inconvertible_error_code());
+   }
    int fd;
    if (std::error_code errorCode = fs::open_file_for_write(outputPath, fd, fs::F_None)) {
       return make_error<StringError>("cannot open " + outputPath, errorCode);
    }
-   return std::unique_ptr<TarWriter>(new TarWriter(fd, baseDir));
+   return std::unique_ptr<TarWriter>(new TarWriter(fd, baseDir, format));
 }
 
-TarWriter::TarWriter(int fd, StringRef baseDir)
-   : m_outstream(fd, /*shouldClose=*/true, /*unbuffered=*/false), m_baseDir(baseDir)
+TarWriter::TarWriter(int fd, StringRef baseDir, Format format)
+   : m_fd(fd),
+     m_outstream(fd, /*shouldClose=*/true, /*unbuffered=*/false),
+     m_baseDir(baseDir),
+     m_format(format)
 {}
 
+TarWriter::~TarWriter()
+{
+   consume_error(finish());
+}
+
 // Append a given file to an archive.
 void TarWriter::append(StringRef path, StringRef data)
 {
@@ -182,27 +285,325 @@ void TarWriter::append(StringRef path, StringRef data)
       return;
    }
 
-   StringRef prefix;
-   StringRef name;
-   if (split_ustar(fullpath, prefix, name)) {
-      write_ustar_header(m_outstream, prefix, name, data.size());
-   } else {
-      write_pax_header(m_outstream, fullpath);
-      write_ustar_header(m_outstream, "", "", data.size());
+   if (m_format == IndexedGzip) {
+      queueMember(fs::path::convert_to_slash(path), make_headers(fullpath, data.size()),
+                  MemoryBuffer::getMemBufferCopy(data, fullpath));
+      return;
    }
 
+   m_outstream << make_headers(fullpath, data.size());
    m_outstream << data;
    pad(m_outstream);
+   writeTerminator();
+}
 
+Error TarWriter::appendFile(StringRef path, StringRef filePath)
+{
+   std::string fullpath = m_baseDir + "/" + fs::path::convert_to_slash(path);
+   if (m_files.count(fullpath)) {
+      return Error::getSuccess();
+   }
+
+   if (m_format == IndexedGzip) {
+      // Compression runs on the mapped file.
+      OptionalError<std::unique_ptr<MemoryBuffer>> buffer =
+            MemoryBuffer::getFile(filePath, -1, /*RequiresNullTerminator=*/false);
+      if (!buffer) {
+         return make_error<StringError>("cannot open " + filePath, buffer.getError());
+      }
+      m_files.insert(fullpath);
+      size_t size = (*buffer)->getBufferSize();
+      queueMember(fs::path::convert_to_slash(path), make_headers(fullpath, size),
+                  std::move(*buffer));
+      return Error::getSuccess();
+   }
+
+   int inputFd;
+   if (std::error_code errorCode = fs::open_file_for_read(filePath, inputFd)) {
+      return make_error<StringError>("cannot open " + filePath, errorCode);
+   }
+   fs::FileStatus status;
+   if (std::error_code errorCode = fs::status(inputFd, status)) {
+      ::close(inputFd);
+      return make_error<StringError>("cannot stat " + filePath, errorCode);
+   }
+   m_files.insert(fullpath);
+   uint64_t size = status.getSize();
+   m_outstream << make_headers(fullpath, size);
+   m_outstream.flush();
+
+   uint64_t start = m_outstream.tell();
+   uint64_t copied = 0;
+#if defined(__linux__)
+   // Let the kernel copy the data, without a round trip through user space,
+   // and by sharing extents on file systems that can.
+   while (copied < size) {
+      loff_t outputOffset = start + copied;
+      ssize_t count = ::copy_file_range(inputFd, nullptr, m_fd, &outputOffset,
+                                        size - copied, 0);
+      if (count < 0 && errno == EINTR) {
+         continue;
+      }
+      if (count <= 0) {
+         // Unsupported across these file systems, or the file shrank.
+         break;
+      }
+      copied += count;
+   }
+   if (copied) {
+      m_outstream.seek(start + copied);
+   }
+#endif
+   char buffer[64 * 1024];
+   while (copied < size) {
+      ssize_t count = ::read(inputFd, buffer, std::min<uint64_t>(sizeof(buffer), size - copied));
+      if (count < 0 && errno == EINTR) {
+         continue;
+      }
+      if (count <= 0) {
+         break;
+      }
+      m_outstream.write(buffer, count);
+      copied += count;
+   }
+   ::close(inputFd);
+
+   Error result = Error::getSuccess();
+   if (copied < size) {
+      // Keep the archive well formed, but report the truncation.
+      for (uint64_t left = size - copied; left; ) {
+         unsigned count = std::min<uint64_t>(left, sizeof(sg_zeros));
+         m_outstream.write(sg_zeros, count);
+         left -= count;
+      }
+      result = make_error<StringError>(filePath + " shrank while being archived",
+                                       inconvertible_error_code());
+   }
+   pad(m_outstream);
+   writeTerminator();
+   return result;
+}
+
+void TarWriter::writeTerminator()
+{
    // POSIX requires tar archives end with two null blocks.
    // Here, we write the terminator and then seek back, so that
    // the file being output is terminated correctly at any moment.
    uint64_t pos = m_outstream.tell();
-   m_outstream << std::string(sg_blockSize * 2, '\0');
+   m_outstream.write(sg_zeros, sizeof(sg_zeros));
    m_outstream.seek(pos);
    m_outstream.flush();
 }
 
+void TarWriter::queueMember(std::string relativePath, std::string headers,
+                            std::unique_ptr<MemoryBuffer> data)
+{
+   PendingMember *member = new PendingMember();
+   member->m_entry.m_path = std::move(relativePath);
+   member->m_entry.m_dataOffset = headers.size();
+   member->m_entry.m_dataSize = data->getBufferSize();
+   {
+      std::lock_guard<std::mutex> locker(m_mutex);
+      m_pending.emplace_back(member);
+   }
+   std::shared_ptr<MemoryBuffer> sharedData(std::move(data));
+   m_tasks.spawn([this, member, headers = std::move(headers), sharedData]() {
+      StringRef data = sharedData->getBuffer();
+      StringRef padding(sg_zeros, align_to(data.size(), sg_blockSize) - data.size());
+      StringRef pieces[] = {headers, data, padding};
+      Error error = zlib::compress_gzip(pieces, member->m_compressed);
+      std::lock_guard<std::mutex> locker(m_mutex);
+      if (error) {
+         member->m_errorMessage = "cannot compress " + member->m_entry.m_path + ": " +
+               to_string(std::move(error));
+      }
+      member->m_done = true;
+      m_memberDone.notify_all();
+   });
+   // Bound the memory held by compressed members waiting for their turn.
+   writeCompressedMembers(4 * std::max(1u, std::thread::hardware_concurrency()));
+}
+
+void TarWriter::writeCompressedMembers(size_t maxPending)
+{
+   std::unique_lock<std::mutex> locker(m_mutex);
+   for (;;) {
+      // Members are written in order, as soon as they and those before them
+      // are compressed.
+      while (!m_pending.empty() && m_pending.front()->m_done) {
+         std::unique_ptr<PendingMember> member = std::move(m_pending.front());
+         m_pending.pop_front();
+         locker.unlock();
+         if (member->m_errorMessage.empty()) {
+            member->m_entry.m_offset = m_outstream.tell();
+            member->m_entry.m_compressedSize = member->m_compressed.size();
+            m_outstream.write(member->m_compressed.getData(), member->m_compressed.size());
+            m_index.push_back(std::move(member->m_entry));
+         } else if (m_errorMessage.empty()) {
+            m_errorMessage = std::move(member->m_errorMessage);
+         }
+         locker.lock();
+      }
+      if (m_pending.size() <= maxPending) {
+         return;
+      }
+      m_memberDone.wait(locker);
+   }
+}
+
+Error TarWriter::finish()
+{
+   if (m_finished) {
+      return Error::getSuccess();
+   }
+   m_finished = true;
+   if (m_format == IndexedGzip) {
+      writeCompressedMembers(0);
+      m_tasks.sync();
+
+      std::string index = sg_indexMagic;
+      for (const internal::TarIndexEntry &entry : m_index) {
+         index += (Twine(entry.m_offset) + " " + Twine(entry.m_compressedSize) + " " +
+                   Twine(entry.m_dataOffset) + " " + Twine(entry.m_dataSize) + " " +
+                   Twine(entry.m_path.size()) + " " + entry.m_path + "\n").getStr();
+      }
+      std::string headers = make_headers(m_baseDir + "/" + sg_indexName, index.size());
+      StringRef padding(sg_zeros, align_to(index.size(), sg_blockSize) - index.size());
+      StringRef pieces[] = {headers, index, padding};
+      SmallVector<char, 0> compressed;
+      if (Error error = zlib::compress_gzip(pieces, compressed)) {
+         return error;
+      }
+      uint64_t indexOffset = m_outstream.tell();
+      m_outstream.write(compressed.getData(), compressed.size());
+      uint64_t indexSize = headers.size() + index.size() + padding.size();
+      uint64_t indexCompressedSize = compressed.size();
+
+      if (Error error = zlib::compress_gzip(StringRef(sg_zeros, sizeof(sg_zeros)),
+                                            compressed)) {
+         return error;
+      }
+      m_outstream.write(compressed.getData(), compressed.size());
+      m_outstream << make_footer(indexOffset, indexCompressedSize, indexSize);
+   }
+   m_outstream.flush();
+   if (m_outstream.hasError()) {
+      std::error_code errorCode = m_outstream.getErrorCode();
+      m_outstream.clearError();
+      return error_code_to_error(errorCode);
+   }
+   if (!m_errorMessage.empty()) {
+      return make_error<StringError>(m_errorMessage, inconvertible_error_code());
+   }
+   return Error::getSuccess();
+}
+
+Expected<std::unique_ptr<IndexedTarReader>>
+IndexedTarReader::create(StringRef archivePath)
+{
+   OptionalError<std::unique_ptr<MemoryBuffer>> buffer =
+         MemoryBuffer::getFile(archivePath, -1, /*RequiresNullTerminator=*/false);
+   if (!buffer) {
+      return make_error<StringError>("cannot open " + archivePath, buffer.getError());
+   }
+   std::unique_ptr<IndexedTarReader> reader(new IndexedTarReader(std::move(*buffer)));
+   if (Error error = reader->readIndex()) {
+      return make_error<StringError>(archivePath + ": " + to_string(std::move(error)),
+                                     inconvertible_error_code());
+   }
+   return reader;
+}
+
+Error IndexedTarReader::readIndex()
+{
+   StringRef archive = m_archive->getBuffer();
+   if (!zlib::is_available()) {
+      return make_format_error("zlib is unavailable");
+   }
+   if (archive.size() < FooterSize) {
+      return make_format_error("not an indexed tar archive");
+   }
+   StringRef footer = archive.substr(archive.size() - FooterSize);
+   uint64_t values[3];
+   for (unsigned i = 0; i != 3; ++i) {
+      if (footer.substr(16 + 16 * i, 16).getAsInteger(16, values[i])) {
+         return make_format_error("not an indexed tar archive");
+      }
+   }
+   uint64_t indexOffset = values[0];
+   uint64_t indexCompressedSize = values[1];
+   uint64_t indexSize = values[2];
+   if (footer != make_footer(indexOffset, indexCompressedSize, indexSize) ||
+       indexOffset > archive.size() - FooterSize ||
+       indexCompressedSize > archive.size() - FooterSize - indexOffset) {
+      return make_format_error("not an indexed tar archive");
+   }
+
+   std::string member(indexSize, '\0');
+   if (Error error = zlib::uncompress_gzip(archive.substr(indexOffset, indexCompressedSize),
+                                           &member[0], indexSize)) {
+      return error;
+   }
+   StringRef index;
+   if (!find_member_data(member, index) || !index.startsWith(sg_indexMagic)) {
+      return make_format_error("malformed index");
+   }
+   index = index.substr(strlen(sg_indexMagic));
+   while (!index.empty()) {
+      internal::TarIndexEntry entry;
+      uint64_t pathSize;
+      StringRef field;
+      bool malformed = false;
+      for (uint64_t *value : {&entry.m_offset, &entry.m_compressedSize, &entry.m_dataOffset,
+                              &entry.m_dataSize, &pathSize}) {
+         std::tie(field, index) = index.split(' ');
+         malformed |= field.getAsInteger(10, *value);
+      }
+      if (malformed || index.size() <= pathSize || index[pathSize] != '\n' ||
+          entry.m_offset > indexOffset ||
+          entry.m_compressedSize > indexOffset - entry.m_offset) {
+         return make_format_error("malformed index");
+      }
+      entry.m_path = index.substr(0, pathSize).getStr();
+      index = index.substr(pathSize + 1);
+      m_lookup[entry.m_path] = m_entries.size();
+      m_entries.push_back(std::move(entry));
+   }
+   return Error::getSuccess();
+}
+
+std::vector<StringRef> IndexedTarReader::getMemberPaths() const
+{
+   std::vector<StringRef> paths;
+   paths.reserve(m_entries.size());
+   for (const internal::TarIndexEntry &entry : m_entries) {
+      paths.push_back(entry.m_path);
+   }
+   return paths;
+}
+
+Expected<std::unique_ptr<MemoryBuffer>> IndexedTarReader::read(StringRef path) const
+{
+   auto iter = m_lookup.find(path);
+   if (iter == m_lookup.end()) {
+      return make_error<StringError>("no member " + path,
+                                     std::make_error_code(std::errc::no_such_file_or_directory));
+   }
+   const internal::TarIndexEntry &entry = m_entries[iter->getValue()];
+   uint64_t memberSize = entry.m_dataOffset + align_to(entry.m_dataSize, sg_blockSize);
+   std::unique_ptr<WritableMemoryBuffer> member =
+         WritableMemoryBuffer::getNewUninitMemBuffer(memberSize, path);
+   if (!member) {
+      return make_error<StringError>("cannot allocate " + path,
+                                     std::make_error_code(std::errc::not_enough_memory));
+   }
+   StringRef compressed = m_archive->getBuffer().substr(entry.m_offset, entry.m_compressedSize);
+   if (Error error = zlib::uncompress_gzip(compressed, member->getBufferStart(), memberSize)) {
+      return error;
+   }
+   return MemoryBuffer::getMemBufferCopy(
+            StringRef(member->getBufferStart() + entry.m_dataOffset, entry.m_dataSize), path);
+}
+
 } // utils
 } // polar
-
@@ -12,6 +12,8 @@
 #include "polar/utils/TrigramIndex.h"
 #include "polar/basic/adt/SmallVector.h"
 
+#include <algorithm>
+#include <cctype>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -19,76 +21,180 @@
 namespace polar {
 namespace utils {
 
-static const char sg_regexAdvancedMetachars[] = "()^$|+?[]\\{}";
-
-static bool is_advanced_metachar(unsigned c)
+bool get_required_regex_runs(StringRef regex, std::vector<std::string> &runs)
 {
-   return strchr(sg_regexAdvancedMetachars, c) != nullptr;
+   std::string current;
+   auto endRun = [&]() {
+      if (!current.empty()) {
+         runs.push_back(std::move(current));
+         current.clear();
+      }
+   };
+   auto skipBrackets = [&](size_t pos) {
+      ++pos;
+      if (pos < regex.size() && regex[pos] == '^') {
+         ++pos;
+      }
+      if (pos < regex.size() && regex[pos] == ']') {
+         ++pos;
+      }
+      while (pos < regex.size() && regex[pos] != ']') {
+         pos += regex[pos] == '\\' ? 2 : 1;
+      }
+      return pos;
+   };
+   for (size_t pos = 0; pos < regex.size(); ++pos) {
+      char c = regex[pos];
+      switch (c) {
+      case '|':
+         return false;
+      case '(': {
+         unsigned depth = 1;
+         while (++pos < regex.size() && depth) {
+            if (regex[pos] == '\\') {
+               if (pos + 1 < regex.size() && regex[pos + 1] >= '1' && regex[pos + 1] <= '9') {
+                  return false;
+               }
+               ++pos;
+            } else if (regex[pos] == '[') {
+               pos = skipBrackets(pos);
+            } else if (regex[pos] == '(') {
+               ++depth;
+            } else if (regex[pos] == ')') {
+               --depth;
+            }
+         }
+         --pos;
+         endRun();
+         break;
+      }
+      case '[':
+         pos = skipBrackets(pos);
+         endRun();
+         break;
+      case '?':
+      case '{':
+         if (!current.empty()) {
+            current.pop_back();
+         }
+         endRun();
+         if (c == '{') {
+            pos = std::min(regex.find('}', pos), regex.size());
+         }
+         break;
+      case '*':
+      case '+':
+      case '.':
+      case '^':
+      case '$':
+      case ')':
+      case ']':
+      case '}':
+         endRun();
+         break;
+      case '\\':
+         // Regular expressions allow escaping symbols by preceding it with '\'.
+         if (++pos == regex.size()) {
+            break;
+         }
+         if (regex[pos] >= '1' && regex[pos] <= '9') {
+            return false;
+         }
+         if (regex[pos] == '*') {
+            // Still a wildcard once SpecialCaseList rewrites it.
+            endRun();
+            break;
+         }
+         if (std::isalnum(static_cast<unsigned char>(regex[pos]))) {
+            // Character classes such as \d or \w, assertions such as \b and
+            // numeric escapes do not stand for their letter. End the run and
+            // skip the arguments of the numeric escapes.
+            switch (regex[pos]) {
+            case 'x':
+               pos += 2;
+               break;
+            case 'u':
+               pos += 4;
+               break;
+            case 'c':
+               pos += 1;
+               break;
+            default:
+               while (pos + 1 < regex.size() && std::isdigit(static_cast<unsigned char>(regex[pos + 1]))) {
+                  ++pos;
+               }
+            }
+            endRun();
+            break;
+         }
+         current += regex[pos];
+         break;
+      default:
+         current += c;
+      }
+   }
+   endRun();
+   return true;
 }
 
+
 void TrigramIndex::insert(std::string regex)
 {
-   if (m_defeated) {
+   std::vector<std::string> runs;
+   if (!get_required_regex_runs(regex, runs)) {
+      // This is a more complicated regex than we can handle here.
+      insertUnindexed();
       return;
    }
+   insertRuns(runs);
+}
+
+void TrigramIndex::insertRuns(const std::vector<std::string> &runs)
+{
+   unsigned ruleId = m_counts.size();
    std::set<unsigned> was;
    unsigned cnt = 0;
-   unsigned trigram = 0;
-   unsigned length = 0;
-   bool escaped = false;
-   for (unsigned c : regex) {
-      if (!escaped) {
-         // Regular expressions allow escaping symbols by preceding it with '\'.
-         if (c == '\\') {
-            escaped = true;
+   for (const std::string &run : runs) {
+      unsigned trigram = 0;
+      unsigned length = 0;
+      for (unsigned char c : run) {
+         trigram = ((trigram << 8) + c) & 0xFFFFFF;
+         length++;
+         if (length < 3) {
             continue;
          }
-         if (is_advanced_metachar(c)) {
-            // This is a more complicated regex than we can handle here.
-            m_defeated = true;
-            return;
-         }
-         if (c == '.' || c == '*') {
-            trigram = 0;
-            length = 0;
+         // We don't want the index to grow too much for the popular trigrams,
+         // as they are weak signals. It's ok to still require them for the
+         // rules we have already processed. It's just a small additional
+         // computational cost.
+         auto &rules = m_index[trigram];
+         if (rules.size() >= 4 && rules.back() != ruleId) {
             continue;
          }
-      }
-      if (escaped && c >= '1' && c <= '9') {
-         m_defeated = true;
-         return;
-      }
-      // We have already handled escaping and can reset the flag.
-      escaped = false;
-      trigram = ((trigram << 8) + c) & 0xFFFFFF;
-      length++;
-      if (length < 3) {
-         continue;
-      }
-      // We don't want the index to grow too much for the popular trigrams,
-      // as they are weak signals. It's ok to still require them for the
-      // rules we have already processed. It's just a small additional
-      // computational cost.
-      if (m_index[trigram].size() >= 4) {
-         continue;
-      }
-
-      cnt++;
-      if (!was.count(trigram)) {
-         // Adding the current rule to the index.
-         m_index[trigram].push_back(m_counts.size());
-         was.insert(trigram);
+         cnt++;
+         if (!was.count(trigram)) {
+            // Adding the current rule to the index.
+            rules.push_back(ruleId);
+            was.insert(trigram);
+         }
       }
    }
    if (!cnt) {
       // This rule does not have remarkable trigrams to rely on.
       // We have to always call the full regex chain.
-      m_defeated = true;
+      insertUnindexed();
       return;
    }
    m_counts.push_back(cnt);
 }
 
+void TrigramIndex::insertUnindexed()
+{
+   m_unindexed.push_back(m_counts.size());
+   m_counts.push_back(0);
+   m_defeated = true;
+}
+
 bool TrigramIndex::isDefinitelyOut(StringRef query) const
 {
    if (m_defeated) {
@@ -97,7 +203,7 @@ bool TrigramIndex::isDefinitelyOut(StringRef query) const
    std::vector<unsigned> curCounts(m_counts.size());
    unsigned trigram = 0;
    for (size_t index = 0; index < query.size(); index++) {
-      trigram = ((trigram << 8) + query[index]) & 0xFFFFFF;
+      trigram = ((trigram << 8) + static_cast<unsigned char>(query[index])) & 0xFFFFFF;
       if (index < 2) {
          continue;
       }
@@ -106,7 +212,7 @@ bool TrigramIndex::isDefinitelyOut(StringRef query) const
          continue;
       }
 
-      for (size_t j : iter->second) {
+      for (unsigned j : iter->second) {
          curCounts[j]++;
          // If we have reached a desired limit, we have to look at the query
          // more closely by running a full regex.
@@ -118,6 +224,32 @@ bool TrigramIndex::isDefinitelyOut(StringRef query) const
    return true;
 }
 
+void TrigramIndex::getCandidates(StringRef query, SmallVectorImpl<unsigned> &candidates) const
+{
+   size_t start = candidates.size();
+   if (query.size() >= 3 && !m_index.empty()) {
+      std::vector<unsigned> curCounts(m_counts.size());
+      unsigned trigram = 0;
+      for (size_t index = 0; index < query.size(); index++) {
+         trigram = ((trigram << 8) + static_cast<unsigned char>(query[index])) & 0xFFFFFF;
+         if (index < 2) {
+            continue;
+         }
+         const auto &iter = m_index.find(trigram);
+         if (iter == m_index.end()) {
+            continue;
+         }
+         for (unsigned j : iter->second) {
+            // Report every rule once, when it reaches its limit.
+            if (++curCounts[j] == m_counts[j]) {
+               candidates.push_back(j);
+            }
+         }
+      }
+   }
+   candidates.append(m_unindexed.begin(), m_unindexed.end());
+   std::sort(candidates.begin() + start, candidates.end());
+}
 
 } // utils
 } // polar
@@ -200,6 +200,42 @@ Memory::protectMappedMemory(const MemoryBlock &block, unsigned flags)
    return std::error_code();
 }
 
+std::error_code
+Memory::adviseMappedMemory(const void *addr, size_t len, AccessAdvice advice)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(POSIX_MADV_WILLNEED)
+   static const size_t pageSize = Process::getPageSize();
+   if (addr == nullptr || len == 0) {
+      return std::error_code();
+   }
+   int posixAdvice = POSIX_MADV_NORMAL;
+   switch (advice) {
+   case MA_NORMAL:
+      posixAdvice = POSIX_MADV_NORMAL;
+      break;
+   case MA_RANDOM:
+      posixAdvice = POSIX_MADV_RANDOM;
+      break;
+   case MA_SEQUENTIAL:
+      posixAdvice = POSIX_MADV_SEQUENTIAL;
+      break;
+   case MA_WILL_NEED:
+      posixAdvice = POSIX_MADV_WILLNEED;
+      break;
+   case MA_DONT_NEED:
+      posixAdvice = POSIX_MADV_DONTNEED;
+      break;
+   }
+   uintptr_t start = reinterpret_cast<uintptr_t>(addr) & ~uintptr_t(pageSize - 1);
+   uintptr_t end = polar::utils::align_addr((const uint8_t *)addr + len, pageSize);
+   // posix_madvise reports failures through its result, not errno.
+   if (int result = ::posix_madvise((void *)start, end - start, posixAdvice)) {
+      return std::error_code(result, std::generic_category());
+   }
+#endif
+   return std::error_code();
+}
+
 /// invalidateInstructionCache - Before the JIT can run a block of code
 /// that has been emitted it must invalidate the instruction cache on some
 /// platforms.
@@ -45,6 +45,10 @@
 #include <dirent.h>
 #include <pwd.h>
 
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
+
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
 #include <sys/attr.h>
@@ -698,7 +702,7 @@ std::error_code MappedFileRegion::init(int fd, uint64_t offset,
 
 MappedFileRegion::MappedFileRegion(int fd, MapMode mode, size_t length,
                                    uint64_t offset, std::error_code &errorCode)
-   : m_size(length), m_mapping(), m_fd(fd), m_mode(mode)
+   : m_size(length), m_mapping(), m_fd(fd), m_offset(offset), m_mode(mode)
 {
    (void)fd;
    (void)mode;
@@ -738,7 +742,173 @@ int MappedFileRegion::getAlignment()
    return Process::getPageSize();
 }
 
+std::error_code MappedFileRegion::resize(size_t length)
+{
+   assert(m_mapping && "Mapping failed but used anyway!");
+   assert(length != 0);
+#if defined(__linux__)
+   // Let the kernel move the page tables rather than map the file anew.
+   void *mapping = ::mremap(m_mapping, m_size, length, MREMAP_MAYMOVE);
+   if (mapping == MAP_FAILED) {
+      return std::error_code(errno, std::generic_category());
+   }
+   m_mapping = mapping;
+   m_size = length;
+#else
+   void *oldMapping = m_mapping;
+   size_t oldSize = m_size;
+   m_size = length;
+   if (std::error_code errorCode = init(m_fd, m_offset, m_mode)) {
+      m_mapping = oldMapping;
+      m_size = oldSize;
+      return errorCode;
+   }
+   ::munmap(oldMapping, oldSize);
+#endif
+   return std::error_code();
+}
+
+std::error_code MappedFileRegion::writeBack(size_t offset, size_t length)
+{
+   assert(m_mapping && "Mapping failed but used anyway!");
+   assert(offset <= m_size && length <= m_size - offset);
+   if (m_mode != readwrite || length == 0) {
+      return std::error_code();
+   }
+#if defined(__linux__)
+   // msync(MS_ASYNC) does nothing on Linux, where pages of shared mappings
+   // are dirtied in the page cache, and written back from there.
+   if (::sync_file_range(m_fd, m_offset + offset, length, SYNC_FILE_RANGE_WRITE) == -1) {
+      return std::error_code(errno, std::generic_category());
+   }
+#else
+   size_t pageMask = Process::getPageSize() - 1;
+   size_t begin = offset & ~pageMask;
+   if (::msync(reinterpret_cast<char *>(m_mapping) + begin, offset + length - begin,
+               MS_ASYNC) == -1) {
+      return std::error_code(errno, std::generic_category());
+   }
+#endif
+   return std::error_code();
+}
+
+namespace {
+
+FileType direntry_type(const dirent *entry)
+{
+#ifdef DT_UNKNOWN
+   switch (entry->d_type) {
+   case DT_REG:
+      return FileType::regular_file;
+   case DT_DIR:
+      return FileType::directory_file;
+   case DT_LNK:
+      return FileType::symlink_file;
+   case DT_BLK:
+      return FileType::block_file;
+   case DT_CHR:
+      return FileType::character_file;
+   case DT_FIFO:
+      return FileType::fifo_file;
+   case DT_SOCK:
+      return FileType::socket_file;
+   default:
+      break;
+   }
+#endif
+   return FileType::type_unknown;
+}
+
+/// Stats \p name relative to the directory \p dirFd, which spares resolving
+/// the whole path again.
+std::error_code status_at(int dirFd, const char *name, bool follow, FileStatus &result)
+{
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+   // Don't force network file systems to synchronize attributes.
+   struct statx extStatus;
+   int flags = AT_STATX_DONT_SYNC | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+   if (::statx(dirFd, name, flags, STATX_BASIC_STATS, &extStatus) == 0) {
+      struct stat status = {};
+      status.st_mode = extStatus.stx_mode;
+      status.st_dev = makedev(extStatus.stx_dev_major, extStatus.stx_dev_minor);
+      status.st_nlink = extStatus.stx_nlink;
+      status.st_ino = extStatus.stx_ino;
+      status.st_atime = extStatus.stx_atime.tv_sec;
+      status.st_mtime = extStatus.stx_mtime.tv_sec;
+      status.st_uid = extStatus.stx_uid;
+      status.st_gid = extStatus.stx_gid;
+      status.st_size = extStatus.stx_size;
+      return fill_status(0, status, result);
+   }
+   if (errno != ENOSYS) {
+      return fill_status(-1, {}, result);
+   }
+#endif
+   struct stat status;
+   int statRet = ::fstatat(dirFd, name, &status, follow ? 0 : AT_SYMLINK_NOFOLLOW);
+   return fill_status(statRet, status, result);
+}
+
+} // anonymous namespace
+
 namespace internal {
+
+std::error_code list_directory(StringRef path, bool followSymlinks, bool needStatus,
+                               std::vector<ListedEntry> &entries, FileStatus *dirStatus)
+{
+   SmallString<128> pathNull(path);
+   int openFlags = O_RDONLY | O_DIRECTORY;
+#ifdef O_CLOEXEC
+   openFlags |= O_CLOEXEC;
+#endif
+   int dirFd = ::open(pathNull.getCStr(), openFlags);
+   if (dirFd < 0) {
+      return std::error_code(errno, std::generic_category());
+   }
+   if (dirStatus) {
+      if (std::error_code errorCode = status(dirFd, *dirStatus)) {
+         ::close(dirFd);
+         return errorCode;
+      }
+   }
+   DIR *directory = ::fdopendir(dirFd);
+   if (!directory) {
+      std::error_code errorCode(errno, std::generic_category());
+      ::close(dirFd);
+      return errorCode;
+   }
+   std::error_code errorCode;
+   for (;;) {
+      errno = 0;
+      dirent *curDir = ::readdir(directory);
+      if (!curDir) {
+         if (errno != 0) {
+            errorCode = std::error_code(errno, std::generic_category());
+         }
+         break;
+      }
+      StringRef name(curDir->d_name);
+      if (name == "." || name == "..") {
+         continue;
+      }
+      entries.emplace_back();
+      ListedEntry &entry = entries.back();
+      entry.m_name = name.getStr();
+      entry.m_type = direntry_type(curDir);
+      if (needStatus || entry.m_type == FileType::type_unknown ||
+          (followSymlinks && entry.m_type == FileType::symlink_file)) {
+         // A dangling link keeps the type it was listed with.
+         if (!status_at(dirFd, curDir->d_name, followSymlinks, entry.m_status)) {
+            entry.m_type = entry.m_status.getType();
+            entry.m_hasStatus = true;
+         }
+      }
+   }
+   // Also closes dirFd.
+   ::closedir(directory);
+   return errorCode;
+}
+
 std::error_code directory_iterator_construct(internal::DirIterState &iter,
                                              StringRef path,
                                              bool followSymlinks)
@@ -777,7 +947,7 @@ std::error_code directory_iterator_increment(DirIterState &iter)
           (name.getSize() == 2 && name[0] == '.' && name[1] == '.')) {
          return directory_iterator_increment(iter);
       }
-      iter.m_currentEntry.replaceFilename(name);
+      iter.m_currentEntry.replaceFilename(name, BasicFileStatus(direntry_type(curDir)));
    } else {
       return DirectoryIterator_destruct(iter);
    }
@@ -0,0 +1,832 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/yaml/YamlBinaryIO.h"
+#include "polar/basic/adt/Twine.h"
+#include "polar/utils/Endian.h"
+#include "polar/utils/ErrorCode.h"
+#include "polar/utils/ErrorHandling.h"
+#include "polar/utils/Leb128.h"
+#include <cassert>
+#include <cstring>
+
+namespace polar {
+namespace yaml {
+
+using polar::utils::decode_uleb128;
+using polar::utils::encode_uleb128;
+using polar::utils::report_fatal_error;
+
+namespace {
+
+enum ValueKind : uint8_t
+{
+   Scalar = 1,
+   Enum,
+   BitSet,
+   Sequence,
+   Mapping,
+   TaggedMapping
+};
+
+static const char sg_magic[] = "PYB\x01";
+
+enum
+{
+   MagicSize = 4,
+   /// The offset of the string table, then the magic again.
+   TrailerSize = 8 + MagicSize,
+   /// How deep skipValue() follows nested sequences before it gives up on
+   /// the input, rather than on the stack.
+   MaxNestingDepth = 1024
+};
+
+/// Reads a ULEB128 at \p ptr, which must end before \p end.
+bool read_uleb(const uint8_t *&ptr, const uint8_t *end, uint64_t &value)
+{
+   if (ptr >= end) {
+      return false;
+   }
+   unsigned size;
+   const char *error;
+   value = decode_uleb128(ptr, &size, end, &error);
+   if (error) {
+      return false;
+   }
+   ptr += size;
+   return true;
+}
+
+} // anonymous namespace
+
+//===----------------------------------------------------------------------===//
+//  BinaryOutput
+//===----------------------------------------------------------------------===//
+
+BinaryOutput::BinaryOutput(RawOutStream &out, void *context)
+   : IO(context),
+     m_out(out)
+{}
+
+BinaryOutput::~BinaryOutput()
+{}
+
+bool BinaryOutput::outputting()
+{
+   return true;
+}
+
+void BinaryOutput::writeKind(uint8_t kind)
+{
+   m_document.push_back(kind);
+}
+
+void BinaryOutput::writeUleb(uint64_t value)
+{
+   uint8_t buffer[16];
+   unsigned size = encode_uleb128(value, buffer);
+   m_document.append(buffer, buffer + size);
+}
+
+void BinaryOutput::insertUleb(size_t offset, uint64_t value)
+{
+   // Offsets of enclosing values are before this one, and stay right.
+   uint8_t buffer[16];
+   unsigned size = encode_uleb128(value, buffer);
+   m_document.insert(m_document.begin() + offset, buffer, buffer + size);
+}
+
+unsigned BinaryOutput::intern(StringRef str)
+{
+   auto result = m_stringIndex.insert(std::make_pair(str, unsigned(m_strings.size())));
+   if (result.second) {
+      m_strings.push_back(result.first->getKey());
+   }
+   return result.first->getValue();
+}
+
+bool BinaryOutput::mapTag(StringRef tag, bool use)
+{
+   if (use) {
+      size_t start = m_mappings.back();
+      assert(m_document.size() == start + 1 && "tags go before the keys");
+      m_document[start] = TaggedMapping;
+      writeUleb(intern(tag));
+   }
+   return use;
+}
+
+void BinaryOutput::beginMapping()
+{
+   m_mappings.push_back(m_document.size());
+   writeKind(Mapping);
+}
+
+void BinaryOutput::endMapping()
+{
+   writeUleb(0);
+   m_mappings.pop_back();
+}
+
+std::vector<StringRef> BinaryOutput::getKeys()
+{
+   report_fatal_error("invalid call");
+}
+
+bool BinaryOutput::preflightKey(const char *key, bool required, bool sameAsDefault,
+                                bool &useDefault, void *&)
+{
+   useDefault = false;
+   if (required || !sameAsDefault) {
+      writeUleb(intern(key) + 1);
+      m_entryValues.push_back(m_document.size());
+      return true;
+   }
+   return false;
+}
+
+void BinaryOutput::postflightKey(void *)
+{
+   size_t start = m_entryValues.popBackValue();
+   insertUleb(start, m_document.size() - start);
+}
+
+void BinaryOutput::beginFlowMapping()
+{
+   beginMapping();
+}
+
+void BinaryOutput::endFlowMapping()
+{
+   endMapping();
+}
+
+void BinaryOutput::beginDocuments()
+{
+   assert(m_offset == 0 && "one document list per BinaryOutput");
+   m_out.write(sg_magic, MagicSize);
+   m_offset = MagicSize;
+}
+
+bool BinaryOutput::preflightDocument(unsigned)
+{
+   return true;
+}
+
+void BinaryOutput::postflightDocument()
+{
+   m_out.write(reinterpret_cast<const char *>(m_document.getData()), m_document.size());
+   m_offset += m_document.size();
+   m_document.clear();
+}
+
+void BinaryOutput::endDocuments()
+{
+   writeUleb(m_strings.size());
+   for (StringRef str : m_strings) {
+      writeUleb(str.size());
+      m_document.append(str.begin(), str.end());
+   }
+   uint8_t trailer[TrailerSize];
+   polar::utils::endian::write64le(trailer, m_offset);
+   std::memcpy(trailer + 8, sg_magic, MagicSize);
+   m_document.append(trailer, trailer + TrailerSize);
+   postflightDocument();
+}
+
+unsigned BinaryOutput::beginSequence()
+{
+   writeKind(Sequence);
+   m_sequences.push_back(std::make_pair(m_document.size(), 0u));
+   return 0;
+}
+
+void BinaryOutput::endSequence()
+{
+   std::pair<size_t, unsigned> sequence = m_sequences.popBackValue();
+   insertUleb(sequence.first, sequence.second);
+}
+
+bool BinaryOutput::preflightElement(unsigned, void *&)
+{
+   ++m_sequences.back().second;
+   return true;
+}
+
+void BinaryOutput::postflightElement(void *)
+{
+}
+
+unsigned BinaryOutput::beginFlowSequence()
+{
+   return beginSequence();
+}
+
+bool BinaryOutput::preflightFlowElement(unsigned index, void *&saveInfo)
+{
+   return preflightElement(index, saveInfo);
+}
+
+void BinaryOutput::postflightFlowElement(void *)
+{
+}
+
+void BinaryOutput::endFlowSequence()
+{
+   endSequence();
+}
+
+void BinaryOutput::beginEnumScalar()
+{
+   m_enumerationMatchFound = false;
+}
+
+bool BinaryOutput::matchEnumScalar(const char *str, bool match)
+{
+   if (match && !m_enumerationMatchFound) {
+      writeKind(Enum);
+      writeUleb(intern(str));
+      m_enumerationMatchFound = true;
+   }
+   return false;
+}
+
+bool BinaryOutput::matchEnumFallback()
+{
+   if (m_enumerationMatchFound) {
+      return false;
+   }
+   m_enumerationMatchFound = true;
+   return true;
+}
+
+void BinaryOutput::endEnumScalar()
+{
+   if (!m_enumerationMatchFound) {
+      polar_unreachable("bad runtime enum value");
+   }
+}
+
+bool BinaryOutput::beginBitSetScalar(bool &doClear)
+{
+   m_bitValues.clear();
+   doClear = false;
+   return true;
+}
+
+bool BinaryOutput::bitSetMatch(const char *str, bool matches)
+{
+   if (matches) {
+      m_bitValues.push_back(intern(str));
+   }
+   return false;
+}
+
+void BinaryOutput::endBitSetScalar()
+{
+   writeKind(BitSet);
+   writeUleb(m_bitValues.size());
+   for (unsigned index : m_bitValues) {
+      writeUleb(index);
+   }
+}
+
+void BinaryOutput::scalarString(StringRef &str, QuotingType)
+{
+   writeKind(Scalar);
+   writeUleb(str.size());
+   m_document.append(str.begin(), str.end());
+}
+
+void BinaryOutput::blockScalarString(StringRef &str)
+{
+   scalarString(str, QuotingType::None);
+}
+
+void BinaryOutput::setError(const Twine &)
+{
+}
+
+bool BinaryOutput::canElideEmptySequence()
+{
+   // There is no layout to get wrong, unlike with Output.
+   return true;
+}
+
+//===----------------------------------------------------------------------===//
+//  BinaryInput
+//===----------------------------------------------------------------------===//
+
+BinaryInput::BinaryInput(StringRef inputContent, void *context)
+   : IO(context),
+     m_input(inputContent)
+{
+   readHeader();
+}
+
+BinaryInput::BinaryInput(MemoryBufferRef input, void *context)
+   : IO(context),
+     m_input(input.getBuffer())
+{
+   readHeader();
+}
+
+BinaryInput::~BinaryInput()
+{}
+
+bool BinaryInput::isBinaryInput(StringRef input)
+{
+   return input.startsWith(StringRef(sg_magic, MagicSize));
+}
+
+void BinaryInput::readHeader()
+{
+   StringRef magic(sg_magic, MagicSize);
+   if (m_input.size() < MagicSize + TrailerSize || !m_input.startsWith(magic) ||
+       !m_input.endsWith(magic)) {
+      setMalformed();
+      return;
+   }
+   const uint8_t *begin = reinterpret_cast<const uint8_t *>(m_input.getData());
+   const uint8_t *end = begin + m_input.size() - TrailerSize;
+   uint64_t stringsOffset = polar::utils::endian::read64le(end);
+   if (stringsOffset < MagicSize || stringsOffset > uint64_t(end - begin)) {
+      setMalformed();
+      return;
+   }
+   m_end = begin + stringsOffset;
+   m_nextDocument = begin + MagicSize;
+   // The string table is small next to the documents, and read whole.
+   const uint8_t *ptr = m_end;
+   uint64_t numStrings;
+   if (!read_uleb(ptr, end, numStrings) || numStrings > uint64_t(end - ptr)) {
+      setMalformed();
+      return;
+   }
+   m_strings.reserve(numStrings);
+   for (uint64_t i = 0; i != numStrings; ++i) {
+      uint64_t size;
+      if (!read_uleb(ptr, end, size) || size > uint64_t(end - ptr)) {
+         setMalformed();
+         return;
+      }
+      m_strings.push_back(StringRef(reinterpret_cast<const char *>(ptr), size));
+      ptr += size;
+   }
+}
+
+uint8_t BinaryInput::readKind(const uint8_t *&ptr)
+{
+   if (!ptr || ptr >= m_end) {
+      return 0;
+   }
+   return *ptr++;
+}
+
+bool BinaryInput::readUleb(const uint8_t *&ptr, uint64_t &value)
+{
+   if (!read_uleb(ptr, m_end, value)) {
+      setMalformed();
+      return false;
+   }
+   return true;
+}
+
+bool BinaryInput::readString(const uint8_t *&ptr, unsigned &index)
+{
+   uint64_t value;
+   if (!readUleb(ptr, value)) {
+      return false;
+   }
+   if (value >= m_strings.size()) {
+      setMalformed();
+      return false;
+   }
+   index = value;
+   return true;
+}
+
+const uint8_t *BinaryInput::skipValue(const uint8_t *ptr, unsigned depth)
+{
+   uint64_t value;
+   switch (readKind(ptr)) {
+   case Scalar:
+      if (!readUleb(ptr, value)) {
+         return nullptr;
+      }
+      if (value > uint64_t(m_end - ptr)) {
+         break;
+      }
+      return ptr + value;
+   case Enum:
+      return readUleb(ptr, value) ? ptr : nullptr;
+   case BitSet: {
+      uint64_t count;
+      if (!readUleb(ptr, count)) {
+         return nullptr;
+      }
+      for (uint64_t i = 0; i != count; ++i) {
+         if (!readUleb(ptr, value)) {
+            return nullptr;
+         }
+      }
+      return ptr;
+   }
+   case Sequence: {
+      uint64_t count;
+      if (!readUleb(ptr, count)) {
+         return nullptr;
+      }
+      if (depth == MaxNestingDepth) {
+         break;
+      }
+      for (uint64_t i = 0; i != count && ptr; ++i) {
+         ptr = skipValue(ptr, depth + 1);
+      }
+      return ptr;
+   }
+   case TaggedMapping:
+      if (!readUleb(ptr, value)) {
+         return nullptr;
+      }
+      POLAR_FALLTHROUGH;
+   case Mapping:
+      for (;;) {
+         if (!readUleb(ptr, value)) {
+            return nullptr;
+         }
+         if (value == 0) {
+            return ptr;
+         }
+         if (!readUleb(ptr, value)) {
+            return nullptr;
+         }
+         if (value > uint64_t(m_end - ptr)) {
+            break;
+         }
+         ptr += value;
+      }
+      break;
+   default:
+      break;
+   }
+   setMalformed();
+   return nullptr;
+}
+
+void BinaryInput::setMalformed()
+{
+   setError("malformed binary YAML");
+}
+
+std::error_code BinaryInput::getError()
+{
+   return m_errorCode;
+}
+
+bool BinaryInput::outputting()
+{
+   return false;
+}
+
+bool BinaryInput::setCurrentDocument()
+{
+   if (m_errorCode || !m_nextDocument || m_nextDocument >= m_end) {
+      return false;
+   }
+   m_currentNode = m_nextDocument;
+   return true;
+}
+
+bool BinaryInput::nextDocument()
+{
+   m_nextDocument = skipValue(m_currentNode);
+   return m_nextDocument && m_nextDocument < m_end;
+}
+
+bool BinaryInput::mapTag(StringRef tag, bool defaultValue)
+{
+   unsigned foundTag = m_mappings.back().m_tag;
+   if (foundTag == ~0U) {
+      // If no tag found and 'tag' is the default, say it was found.
+      return defaultValue;
+   }
+   return tag == m_strings[foundTag];
+}
+
+void BinaryInput::beginMapping()
+{
+   MappingFrame mapping{m_currentNode, ~0U, m_entries.size(), m_entries.size(), false};
+   const uint8_t *ptr = m_currentNode;
+   uint8_t kind = m_errorCode ? 0 : readKind(ptr);
+   if (kind == Mapping || (kind == TaggedMapping && readString(ptr, mapping.m_tag))) {
+      mapping.m_isMapping = true;
+      // The entries are listed, the values left for when they are asked for.
+      for (;;) {
+         uint64_t key;
+         uint64_t size;
+         if (!readUleb(ptr, key) || key == 0) {
+            break;
+         }
+         if (key > m_strings.size() || !readUleb(ptr, size) || size > uint64_t(m_end - ptr)) {
+            setMalformed();
+            break;
+         }
+         m_entries.push_back(Entry{unsigned(key - 1), ptr, false});
+         ptr += size;
+      }
+   }
+   m_mappings.push_back(mapping);
+}
+
+std::vector<StringRef> BinaryInput::getKeys()
+{
+   std::vector<StringRef> ret;
+   const MappingFrame &mapping = m_mappings.back();
+   if (!mapping.m_isMapping) {
+      setError("not a mapping");
+      return ret;
+   }
+   for (size_t i = mapping.m_firstEntry; i != m_entries.size(); ++i) {
+      ret.push_back(m_strings[m_entries[i].m_key]);
+   }
+   return ret;
+}
+
+bool BinaryInput::preflightKey(const char *key, bool required, bool, bool &useDefault,
+                               void *&saveInfo)
+{
+   useDefault = false;
+   if (m_errorCode) {
+      return false;
+   }
+   MappingFrame &mapping = m_mappings.back();
+   if (!mapping.m_isMapping) {
+      if (required || m_currentNode) {
+         setError(m_currentNode ? "not a mapping" : "missing document");
+      }
+      return false;
+   }
+   StringRef keyStr(key);
+   size_t first = mapping.m_firstEntry;
+   size_t end = m_entries.size();
+   size_t index = mapping.m_nextEntry;
+   for (size_t i = first; i != end; ++i) {
+      if (index == end) {
+         index = first;
+      }
+      Entry &entry = m_entries[index++];
+      if (m_strings[entry.m_key] == keyStr) {
+         entry.m_used = true;
+         mapping.m_nextEntry = index;
+         saveInfo = const_cast<uint8_t *>(m_currentNode);
+         m_currentNode = entry.m_value;
+         return true;
+      }
+   }
+   if (required) {
+      setError(Twine("missing required key '") + key + "'");
+   } else {
+      useDefault = true;
+   }
+   return false;
+}
+
+void BinaryInput::postflightKey(void *saveInfo)
+{
+   m_currentNode = reinterpret_cast<const uint8_t *>(saveInfo);
+}
+
+void BinaryInput::endMapping()
+{
+   MappingFrame mapping = m_mappings.popBackValue();
+   if (!m_errorCode && mapping.m_isMapping) {
+      for (size_t i = mapping.m_firstEntry; i != m_entries.size(); ++i) {
+         if (!m_entries[i].m_used) {
+            setError(Twine("unknown key '") + m_strings[m_entries[i].m_key] + "'");
+            break;
+         }
+      }
+   }
+   m_entries.resize(mapping.m_firstEntry);
+}
+
+void BinaryInput::beginFlowMapping()
+{
+   beginMapping();
+}
+
+void BinaryInput::endFlowMapping()
+{
+   endMapping();
+}
+
+unsigned BinaryInput::beginSequence()
+{
+   SequenceFrame sequence{m_currentNode, nullptr, 0};
+   const uint8_t *ptr = m_currentNode;
+   uint8_t kind = m_errorCode ? 0 : readKind(ptr);
+   uint64_t size;
+   if (kind == Sequence) {
+      // Every element takes a byte at least.
+      if (readUleb(ptr, size) && size <= uint64_t(m_end - ptr)) {
+         sequence.m_nextElement = ptr;
+         sequence.m_size = size;
+      } else {
+         setMalformed();
+      }
+   } else if (!m_errorCode && m_currentNode) {
+      setError("not a sequence");
+   }
+   m_sequences.push_back(sequence);
+   return sequence.m_size;
+}
+
+void BinaryInput::endSequence()
+{
+   m_sequences.pop_back();
+}
+
+bool BinaryInput::preflightElement(unsigned, void *&saveInfo)
+{
+   if (m_errorCode) {
+      return false;
+   }
+   const SequenceFrame &sequence = m_sequences.back();
+   if (!sequence.m_nextElement) {
+      return false;
+   }
+   saveInfo = const_cast<uint8_t *>(m_currentNode);
+   m_currentNode = sequence.m_nextElement;
+   return true;
+}
+
+void BinaryInput::postflightElement(void *saveInfo)
+{
+   m_sequences.back().m_nextElement = skipValue(m_currentNode);
+   m_currentNode = reinterpret_cast<const uint8_t *>(saveInfo);
+}
+
+unsigned BinaryInput::beginFlowSequence()
+{
+   return beginSequence();
+}
+
+bool BinaryInput::preflightFlowElement(unsigned index, void *&saveInfo)
+{
+   return preflightElement(index, saveInfo);
+}
+
+void BinaryInput::postflightFlowElement(void *saveInfo)
+{
+   postflightElement(saveInfo);
+}
+
+void BinaryInput::endFlowSequence()
+{
+   endSequence();
+}
+
+void BinaryInput::beginEnumScalar()
+{
+   m_scalarMatchFound = false;
+}
+
+bool BinaryInput::matchEnumScalar(const char *str, bool)
+{
+   if (m_scalarMatchFound || m_errorCode) {
+      return false;
+   }
+   const uint8_t *ptr = m_currentNode;
+   uint8_t kind = readKind(ptr);
+   StringRef value;
+   unsigned index;
+   if (kind == Enum && readString(ptr, index)) {
+      value = m_strings[index];
+   } else if (kind == Scalar) {
+      scalarString(value, QuotingType::None);
+   } else {
+      return false;
+   }
+   if (value.equals(str)) {
+      m_scalarMatchFound = true;
+      return true;
+   }
+   return false;
+}
+
+bool BinaryInput::matchEnumFallback()
+{
+   if (m_scalarMatchFound) {
+      return false;
+   }
+   m_scalarMatchFound = true;
+   return true;
+}
+
+void BinaryInput::endEnumScalar()
+{
+   if (!m_scalarMatchFound) {
+      setError("unknown enumerated scalar");
+   }
+}
+
+bool BinaryInput::beginBitSetScalar(bool &doClear)
+{
+   m_bitValues.clear();
+   const uint8_t *ptr = m_currentNode;
+   uint64_t count;
+   if (m_errorCode) {
+      // Nothing to read.
+   } else if (readKind(ptr) == BitSet && readUleb(ptr, count)) {
+      for (uint64_t i = 0; i != count; ++i) {
+         unsigned index;
+         if (!readString(ptr, index)) {
+            break;
+         }
+         m_bitValues.push_back(std::make_pair(index, false));
+      }
+   } else {
+      setError("expected sequence of bit values");
+   }
+   doClear = true;
+   return true;
+}
+
+bool BinaryInput::bitSetMatch(const char *str, bool)
+{
+   if (m_errorCode) {
+      return false;
+   }
+   for (std::pair<unsigned, bool> &bitValue : m_bitValues) {
+      if (m_strings[bitValue.first].equals(str)) {
+         bitValue.second = true;
+         return true;
+      }
+   }
+   return false;
+}
+
+void BinaryInput::endBitSetScalar()
+{
+   if (m_errorCode) {
+      return;
+   }
+   for (const std::pair<unsigned, bool> &bitValue : m_bitValues) {
+      if (!bitValue.second) {
+         setError("unknown bit value");
+         return;
+      }
+   }
+}
+
+void BinaryInput::scalarString(StringRef &str, QuotingType)
+{
+   const uint8_t *ptr = m_currentNode;
+   uint64_t size;
+   if (m_errorCode) {
+      return;
+   }
+   if (readKind(ptr) != Scalar) {
+      setError("unexpected scalar");
+      return;
+   }
+   if (!readUleb(ptr, size)) {
+      return;
+   }
+   if (size > uint64_t(m_end - ptr)) {
+      setMalformed();
+      return;
+   }
+   str = StringRef(reinterpret_cast<const char *>(ptr), size);
+}
+
+void BinaryInput::blockScalarString(StringRef &str)
+{
+   scalarString(str, QuotingType::None);
+}
+
+void BinaryInput::setError(const Twine &message)
+{
+   // The first error is the one to tell about, later ones follow from it.
+   if (!m_errorCode) {
+      m_errorMessage = message.getStr();
+   }
+   m_errorCode = make_error_code(ErrorCode::invalid_argument);
+}
+
+bool BinaryInput::canElideEmptySequence()
+{
+   return false;
+}
+
+} // yaml
+} // polar
@@ -0,0 +1,161 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/yaml/YamlFlatDocument.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/basic/adt/SmallVector.h"
+#include "polar/utils/Casting.h"
+#include <algorithm>
+
+namespace polar {
+namespace yaml {
+
+using polar::basic::SmallString;
+using polar::basic::SmallVector;
+using polar::utils::dyn_cast;
+using polar::utils::isa;
+using polar::utils::dyn_cast_or_null;
+
+namespace {
+
+/// Mappings with more entries than this are searched through a sorted index.
+enum { MaxLinearLookup = 8 };
+
+} // anonymous namespace
+
+void FlatDocument::clear()
+{
+   m_nodes.clear();
+   m_entries.clear();
+   m_sortedEntries.clear();
+   m_allocator.reset();
+   m_failed = false;
+}
+
+bool FlatDocument::build(Node *root, ErrorHandler onError)
+{
+   clear();
+   buildNode(root, onError);
+   return !m_failed;
+}
+
+uint32_t FlatDocument::buildNode(Node *node, ErrorHandler onError)
+{
+   uint32_t index = m_nodes.size();
+   m_nodes.emplace_back();
+   m_nodes[index].m_node = node;
+   SmallString<128> storage;
+   if (ScalarNode *scalar = dyn_cast<ScalarNode>(node)) {
+      StringRef value = scalar->getValue(storage);
+      if (!storage.empty()) {
+         value = storage.getStr().copy(getStringAllocator());
+      }
+      m_nodes[index].m_kind = NodeKind::Scalar;
+      m_nodes[index].m_value = value;
+      return index;
+   }
+   if (BlockScalarNode *blockScalar = dyn_cast<BlockScalarNode>(node)) {
+      // The value of a block scalar is kept by its Document, which can go
+      // before this one.
+      m_nodes[index].m_kind = NodeKind::Scalar;
+      m_nodes[index].m_value = blockScalar->getValue().copy(getStringAllocator());
+      return index;
+   }
+   if (isa<NullNode>(node)) {
+      return index;
+   }
+   // The entries of nested collections go first, so those of this one are
+   // gathered here and appended together.
+   SmallVector<Entry, 8> entries;
+   if (SequenceNode *sequence = dyn_cast<SequenceNode>(node)) {
+      m_nodes[index].m_kind = NodeKind::Sequence;
+      for (Node &element : *sequence) {
+         uint32_t value = buildNode(&element, onError);
+         if (m_failed) {
+            break;
+         }
+         entries.push_back(Entry{StringRef(), value});
+      }
+   } else if (MappingNode *mapping = dyn_cast<MappingNode>(node)) {
+      m_nodes[index].m_kind = NodeKind::Mapping;
+      for (KeyValueNode &pair : *mapping) {
+         ScalarNode *keyNode = dyn_cast_or_null<ScalarNode>(pair.getKey());
+         Node *valueNode = pair.getValue();
+         if (!keyNode || !valueNode) {
+            if (!keyNode) {
+               onError(pair.getKey(), "Map key must be a scalar");
+            }
+            if (!valueNode) {
+               onError(pair.getKey(), "Map value must not be empty");
+            }
+            m_failed = true;
+            break;
+         }
+         storage.clear();
+         StringRef key = keyNode->getValue(storage);
+         if (!storage.empty()) {
+            key = storage.getStr().copy(m_allocator);
+         }
+         uint32_t value = buildNode(valueNode, onError);
+         if (m_failed) {
+            break;
+         }
+         entries.push_back(Entry{key, value});
+      }
+   } else {
+      onError(node, "unknown node kind");
+      m_failed = true;
+      return index;
+   }
+   uint32_t firstEntry = m_entries.size();
+   m_entries.insert(m_entries.end(), entries.begin(), entries.end());
+   FlatNode &flatNode = m_nodes[index];
+   flatNode.m_firstEntry = firstEntry;
+   flatNode.m_numEntries = entries.size();
+   if (flatNode.m_kind == NodeKind::Mapping && entries.size() > MaxLinearLookup) {
+      flatNode.m_firstIndex = m_sortedEntries.size();
+      for (uint32_t i = 0; i != entries.size(); ++i) {
+         m_sortedEntries.push_back(firstEntry + i);
+      }
+      std::sort(m_sortedEntries.begin() + flatNode.m_firstIndex, m_sortedEntries.end(),
+                [this](uint32_t lhs, uint32_t rhs) {
+         int order = m_entries[lhs].m_key.compare(m_entries[rhs].m_key);
+         return order < 0 || (order == 0 && lhs < rhs);
+      });
+   }
+   return index;
+}
+
+const FlatDocument::Entry *FlatDocument::lookup(const FlatNode &mapping, StringRef key) const
+{
+   ArrayRef<Entry> entries = getEntries(mapping);
+   if (mapping.m_firstIndex == ~0U) {
+      for (size_t i = entries.getSize(); i != 0; --i) {
+         if (entries[i - 1].m_key == key) {
+            return &entries[i - 1];
+         }
+      }
+      return nullptr;
+   }
+   const uint32_t *begin = m_sortedEntries.data() + mapping.m_firstIndex;
+   const uint32_t *end = begin + mapping.m_numEntries;
+   // The last entry with the key is the one before the first greater key.
+   const uint32_t *iter = std::upper_bound(begin, end, key, [this](StringRef key, uint32_t entry) {
+      return key.compare(m_entries[entry].m_key) < 0;
+   });
+   if (iter == begin || m_entries[iter[-1]].m_key != key) {
+      return nullptr;
+   }
+   return &m_entries[iter[-1]];
+}
+
+} // yaml
+} // polar
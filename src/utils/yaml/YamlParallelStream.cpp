@@ -0,0 +1,224 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/yaml/YamlParallelStream.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace polar {
+namespace yaml {
+
+using polar::utils::MemoryBuffer;
+using polar::utils::SMDiagnostic;
+
+namespace {
+
+/// Pieces are parsed in tasks of about this many bytes.
+enum { BatchSize = 64 * 1024 };
+
+void ignore_diagnostic(const SMDiagnostic &, void *)
+{
+}
+
+/// Returns true if \p line is the document marker \p marker, alone or
+/// followed by a blank.
+bool is_marker_line(StringRef line, StringRef marker)
+{
+   return line.startsWith(marker) &&
+         (line.size() == marker.size() || line[marker.size()] == ' ' ||
+          line[marker.size()] == '\t' || line[marker.size()] == '\r');
+}
+
+} // anonymous namespace
+
+struct ParallelStream::Piece
+{
+   SourceMgr m_srcMgr;
+   std::unique_ptr<Stream> m_stream;
+   std::unique_ptr<FlatDocument> m_document;
+   /// Set under the mutex once the piece is parsed, or skipped.
+   bool m_done = false;
+   /// Whether the piece is one document, free of errors.
+   bool m_parsed = false;
+   /// Whether the document ends in a collection or an empty node, which a
+   /// "---" line ends for sure.
+   bool m_endsCleanly = false;
+};
+
+ParallelStream::ParallelStream(StringRef input, SourceMgr &sm, bool showColors)
+   : ParallelStream(MemoryBufferRef(input, "YAML"), sm, showColors)
+{}
+
+ParallelStream::ParallelStream(MemoryBufferRef inputBuffer, SourceMgr &sm, bool showColors)
+   : m_input(inputBuffer),
+     m_srcMgr(sm),
+     m_showColors(showColors)
+{
+   // Diagnostics are reported against the first buffer holding them, so with
+   // the whole input first, those of a Stream over its tail land on the
+   // right lines.
+   m_srcMgr.addNewSourceBuffer(MemoryBuffer::getMemBuffer(inputBuffer, false), SMLocation());
+   findPieces();
+   size_t numPieces = m_starts.size();
+   if (numPieces == 1) {
+      return;
+   }
+   m_pieces.reset(new Piece[numPieces]);
+   size_t begin = 0;
+   for (size_t i = 1; i <= numPieces; ++i) {
+      size_t end = i == numPieces ? m_input.getBufferSize() : m_starts[i];
+      if (i == numPieces || end - m_starts[begin] >= BatchSize) {
+         m_batchStarts.push_back(begin);
+         begin = i;
+      }
+   }
+   m_batchStarts.push_back(numPieces);
+   // Parsing runs ahead of the consumer by a few batches per thread only, so
+   // that the documents waiting to be handed out stay few.
+   unsigned ahead = std::max(2u, 2 * std::thread::hardware_concurrency());
+   for (unsigned i = 0; i != ahead; ++i) {
+      spawnBatch();
+   }
+}
+
+void ParallelStream::spawnBatch()
+{
+   if (m_numSpawned + 1 >= m_batchStarts.size()) {
+      return;
+   }
+   size_t begin = m_batchStarts[m_numSpawned];
+   size_t end = m_batchStarts[m_numSpawned + 1];
+   ++m_numSpawned;
+   m_tasks.spawn([this, begin, end] {
+      parsePieces(begin, end);
+   });
+}
+
+ParallelStream::~ParallelStream()
+{
+   m_cancelled = true;
+   m_tasks.sync();
+}
+
+void ParallelStream::findPieces()
+{
+   StringRef input = m_input.getBuffer();
+   m_starts.push_back(0);
+   // Comments before the first "---" belong to its document.
+   bool hasContent = false;
+   size_t lineStart = 0;
+   if (input.startsWith("\xEF\xBB\xBF")) {
+      lineStart = 3;
+   }
+   while (lineStart < input.size()) {
+      const void *newline = std::memchr(input.getData() + lineStart, '\n',
+                                        input.size() - lineStart);
+      size_t lineEnd = newline ? static_cast<const char *>(newline) - input.getData()
+                               : input.size();
+      StringRef line = input.slice(lineStart, lineEnd);
+      if (is_marker_line(line, "---")) {
+         if (hasContent) {
+            m_starts.push_back(lineStart);
+         }
+         hasContent = true;
+      } else if (line.startsWith("%") || is_marker_line(line, "...")) {
+         // Directives and document ends are left to the in-order parse.
+         m_starts.resize(1);
+         return;
+      } else if (!hasContent) {
+         StringRef content = line.ltrim(" \t\r");
+         hasContent = !content.empty() && content.front() != '#';
+      }
+      lineStart = lineEnd + 1;
+   }
+}
+
+void ParallelStream::parsePieces(size_t begin, size_t end)
+{
+   for (size_t i = begin; i != end; ++i) {
+      Piece &piece = m_pieces[i];
+      if (!m_cancelled.load(std::memory_order_relaxed)) {
+         size_t pieceEnd = i + 1 == m_starts.size() ? m_input.getBufferSize() : m_starts[i + 1];
+         StringRef text = m_input.getBuffer().slice(m_starts[i], pieceEnd);
+         // Errors are reported by the in-order parse, if it comes to that.
+         piece.m_srcMgr.setDiagHandler(ignore_diagnostic);
+         piece.m_stream.reset(new Stream(text, piece.m_srcMgr, false));
+         piece.m_document.reset(new FlatDocument);
+         Document &document = *piece.m_stream->begin();
+         Node *root = document.getRoot();
+         piece.m_parsed = root &&
+               piece.m_document->build(root, [](Node *, const Twine &) {}) &&
+               !document.skip() && !piece.m_stream->failed();
+         piece.m_endsCleanly = piece.m_parsed &&
+               piece.m_document->getRoot()->getKind() != FlatDocument::NodeKind::Scalar;
+      }
+      {
+         std::lock_guard<std::mutex> locker(m_mutex);
+         piece.m_done = true;
+      }
+      m_pieceParsed.notify_all();
+   }
+}
+
+bool ParallelStream::forEachDocument(FunctionRef<void(const FlatDocument &)> callback)
+{
+   size_t numPieces = m_starts.size();
+   if (numPieces == 1) {
+      return parseInOrder(0, callback);
+   }
+   for (size_t i = 0; i != numPieces; ++i) {
+      Piece &piece = m_pieces[i];
+      {
+         std::unique_lock<std::mutex> locker(m_mutex);
+         m_pieceParsed.wait(locker, [&piece] { return piece.m_done; });
+      }
+      if (!piece.m_parsed || (i + 1 != numPieces && !piece.m_endsCleanly)) {
+         m_cancelled = true;
+         return parseInOrder(i, callback);
+      }
+      callback(*piece.m_document);
+      piece.m_document.reset();
+      piece.m_stream.reset();
+      if (std::binary_search(m_batchStarts.begin(), m_batchStarts.end(), i + 1)) {
+         spawnBatch();
+      }
+   }
+   return true;
+}
+
+bool ParallelStream::parseInOrder(size_t begin, FunctionRef<void(const FlatDocument &)> callback)
+{
+   Stream stream(m_input.getBuffer().substr(m_starts[begin]), m_srcMgr, m_showColors);
+   FlatDocument flatDocument;
+   for (Document &document : stream) {
+      Node *root = document.getRoot();
+      if (!root || !flatDocument.build(root, [&stream](Node *node, const Twine &msg) {
+                     stream.printError(node, msg);
+                  }) || stream.failed()) {
+         m_failed = true;
+         return false;
+      }
+      callback(flatDocument);
+   }
+   m_failed = stream.failed();
+   return !m_failed;
+}
+
+void ParallelStream::printError(Node *node, const Twine &msg)
+{
+   SMRange range = node->getSourceRange();
+   m_srcMgr.printMessage(range.m_start, SourceMgr::DK_Error, msg, range, std::nullopt,
+                         m_showColors);
+}
+
+} // yaml
+} // polar
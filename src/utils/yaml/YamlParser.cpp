@@ -18,6 +18,7 @@
 #include "polar/basic/adt/StringRef.h"
 #include "polar/basic/adt/Twine.h"
 #include "polar/utils/ErrorHandling.h"
+#include "polar/utils/MathExtras.h"
 #include "polar/utils/MemoryBuffer.h"
 #include "polar/utils/SourceLocation.h"
 #include "polar/utils/SourceMgr.h"
@@ -26,12 +27,17 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <string>
 #include <system_error>
 #include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace polar {
 namespace yaml {
 
@@ -42,6 +48,8 @@ using polar::basic::SmallString;
 using polar::utils::MemoryBuffer;
 using polar::basic::utohexstr;
 using polar::utils::report_fatal_error;
+using polar::utils::count_trailing_zeros;
+using polar::utils::ZeroBehavior;
 
 enum UnicodeEncodingForm
 {
@@ -806,8 +814,10 @@ void Scanner::init(MemoryBufferRef buffer)
    m_isStartOfStream = true;
    m_isSimpleKeyAllowed = true;
    m_failed = false;
+   // The input may be part of a larger buffer, see ParallelStream, so it is
+   // never read at m_end.
    std::unique_ptr<MemoryBuffer> inputBufferOwner =
-         MemoryBuffer::getMemBuffer(buffer);
+         MemoryBuffer::getMemBuffer(buffer, /*RequiresNullTerminator=*/false);
    m_sourceMgr.addNewSourceBuffer(std::move(inputBufferOwner), SMLocation());
 }
 
@@ -955,6 +965,73 @@ void Scanner::advanceWhile(SkipWhileFunc func)
    m_current = finalValue;
 }
 
+/// Returns the first byte from \p position on which is neither printable
+/// ASCII nor, if \p allowTab, a tab, or which is one of \p stops; \p end if
+/// there is none. Such runs make up most of the scalars and comments of a
+/// document, so they are classified 16 bytes at a time where SSE2 is
+/// available, and every byte past them is left to the code point checks.
+static StringRef::iterator find_ascii_run_end(StringRef::iterator position,
+                                              StringRef::iterator end,
+                                              StringRef stops, bool allowTab)
+{
+#if defined(__SSE2__)
+   const __m128i control = _mm_set1_epi8(0x1F);
+   const __m128i del = _mm_set1_epi8(0x7F);
+   const __m128i tab = _mm_set1_epi8('\t');
+   while (end - position >= 16) {
+      __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(position));
+      // Bytes from 0x80 on compare as negative, so they fail with the control
+      // characters.
+      __m128i accepted = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, del),
+                                          _mm_cmpgt_epi8(bytes, control));
+      if (allowTab) {
+         accepted = _mm_or_si128(accepted, _mm_cmpeq_epi8(bytes, tab));
+      }
+      for (char stop : stops) {
+         accepted = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(stop)), accepted);
+      }
+      uint32_t rejected = ~uint32_t(_mm_movemask_epi8(accepted)) & 0xFFFF;
+      if (rejected) {
+         return position + count_trailing_zeros(rejected, ZeroBehavior::Undefined);
+      }
+      position += 16;
+   }
+#endif
+   for (; position != end; ++position) {
+      char c = *position;
+      if (!((c >= 0x20 && c <= 0x7E) || (allowTab && c == '\t'))
+          || stops.find(c) != StringRef::npos) {
+         break;
+      }
+   }
+   return position;
+}
+
+/// Returns the first byte from \p position on which is neither a space nor,
+/// if \p allowTab, a tab; \p end if there is none.
+static StringRef::iterator find_blank_run_end(StringRef::iterator position,
+                                              StringRef::iterator end, bool allowTab)
+{
+#if defined(__SSE2__)
+   const __m128i space = _mm_set1_epi8(' ');
+   const __m128i tab = _mm_set1_epi8(allowTab ? '\t' : ' ');
+   while (end - position >= 16) {
+      __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(position));
+      __m128i accepted = _mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+                                      _mm_cmpeq_epi8(bytes, tab));
+      uint32_t rejected = ~uint32_t(_mm_movemask_epi8(accepted)) & 0xFFFF;
+      if (rejected) {
+         return position + count_trailing_zeros(rejected, ZeroBehavior::Undefined);
+      }
+      position += 16;
+   }
+#endif
+   while (position != end && (*position == ' ' || (allowTab && *position == '\t'))) {
+      ++position;
+   }
+   return position;
+}
+
 static bool is_ns_hex_digit(const char c)
 {
    return    (c >= '0' && c <= '9')
@@ -1110,9 +1187,12 @@ bool Scanner::rollIndent(int toColumn,
 }
 
 void Scanner::skipComment() {
-   if (*m_current != '#')
+   if (m_current == m_end || *m_current != '#')
       return;
    while (true) {
+      StringRef::iterator runEnd = find_ascii_run_end(m_current, m_end, StringRef(), true);
+      m_column += runEnd - m_current;
+      m_current = runEnd;
       // This may skip more than one byte, thus m_column is only incremented
       // for code points.
       StringRef::iterator iter = skipNbChar(m_current);
@@ -1126,9 +1206,9 @@ void Scanner::skipComment() {
 
 void Scanner::scanToNextToken() {
    while (true) {
-      while (*m_current == ' ' || *m_current == '\t') {
-         skip(1);
-      }
+      StringRef::iterator blankEnd = find_blank_run_end(m_current, m_end, true);
+      m_column += blankEnd - m_current;
+      m_current = blankEnd;
 
       skipComment();
 
@@ -1353,9 +1433,8 @@ bool Scanner::scanFlowScalar(bool isDoubleQuoted)
    if (isDoubleQuoted) {
       do {
          ++m_current;
-         while (m_current != m_end && *m_current != '"') {
-            ++m_current;
-         }
+         const void *quote = std::memchr(m_current, '"', m_end - m_current);
+         m_current = quote ? static_cast<StringRef::iterator>(quote) : m_end;
          // Repeat until the previous character was not a '\' or was an escaped
          // backslash.
       } while (m_current != m_end
@@ -1364,11 +1443,18 @@ bool Scanner::scanFlowScalar(bool isDoubleQuoted)
    } else {
       skip(1);
       while (true) {
+         // Runs of plain ASCII stop short of the last byte, which ends the
+         // scan below.
+         if (m_current != m_end) {
+            StringRef::iterator runEnd = find_ascii_run_end(m_current, m_end - 1, "'", true);
+            m_column += runEnd - m_current;
+            m_current = runEnd;
+         }
          // Skip a ' followed by another '.
          if (m_current + 1 < m_end && *m_current == '\'' && *(m_current + 1) == '\'') {
             skip(2);
             continue;
-         } else if (*m_current == '\'')
+         } else if (m_current != m_end && *m_current == '\'')
             break;
          StringRef::iterator i = skipNbChar(m_current);
          if (i == m_current) {
@@ -1412,12 +1498,23 @@ bool Scanner::scanPlainScalar()
    assert(m_indent >= -1 && "m_indent must be >= -1 !");
    unsigned indent = static_cast<unsigned>(m_indent + 1);
    while (true) {
-      if (*m_current == '#')
+      if (m_current == m_end || *m_current == '#')
          break;
 
-      while (!isBlankOrBreak(m_current)) {
+      while (m_current != m_end && !isBlankOrBreak(m_current)) {
+         // Bytes which can neither end the scalar nor be in error come in
+         // runs.
+         StringRef::iterator runEnd = find_ascii_run_end(m_current, m_end,
+                                                         m_flowLevel ? " :,?[]{}" : " :",
+                                                         false);
+         if (runEnd != m_current) {
+            m_column += runEnd - m_current;
+            m_current = runEnd;
+            continue;
+         }
          if (  m_flowLevel && *m_current == ':'
-               && !(isBlankOrBreak(m_current + 1) || *(m_current + 1) == ',')) {
+               && !(isBlankOrBreak(m_current + 1) ||
+                    (m_current + 1 != m_end && *(m_current + 1) == ','))) {
             setError("Found unexpected ':' while scanning a plain scalar", m_current);
             return false;
          }
@@ -1446,6 +1543,13 @@ bool Scanner::scanPlainScalar()
       // Eat blanks.
       StringRef::iterator temp = m_current;
       while (isBlankOrBreak(temp)) {
+         // Spaces are never invalid indentation.
+         StringRef::iterator spaceEnd = find_blank_run_end(temp, m_end, false);
+         if (spaceEnd != temp) {
+            m_column += spaceEnd - temp;
+            temp = spaceEnd;
+            continue;
+         }
          StringRef::iterator i = skipSWhite(temp);
          if (i != temp) {
             if (leadingBlanks && (m_column < indent) && *temp == '\t') {
@@ -1490,7 +1594,7 @@ bool Scanner::scanAliasOrAnchor(bool isAlias)
    StringRef::iterator start = m_current;
    unsigned colStart = m_column;
    skip(1);
-   while(true) {
+   while(m_current != m_end) {
       if (   *m_current == '[' || *m_current == ']'
              || *m_current == '{' || *m_current == '}'
              || *m_current == ','
@@ -1704,6 +1808,8 @@ bool Scanner::scanBlockScalar(bool isLiteral)
       }
       // Parse the current line.
       auto lineStart = m_current;
+      m_current = find_ascii_run_end(m_current, m_end, StringRef(), true);
+      m_column += m_current - lineStart;
       advanceWhile(&Scanner::skipNbChar);
       if (lineStart != m_current) {
          str.append(lineBreaks, '\n');
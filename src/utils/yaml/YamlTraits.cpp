@@ -20,6 +20,7 @@
 #include "polar/utils/Format.h"
 #include "polar/utils/LineIterator.h"
 #include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/NativeFormatting.h"
 #include "polar/utils/Unicode.h"
 #include "polar/utils/yaml/YamlParser.h"
 #include "polar/utils/RawOutStream.h"
@@ -42,7 +43,9 @@ using polar::utils::isa;
 using polar::utils::dyn_cast_or_null;
 using polar::utils::dyn_cast;
 using polar::utils::report_fatal_error;
-using polar::utils::format;
+using polar::utils::HexPrintStyle;
+using polar::utils::write_hex;
+using polar::utils::write_shortest;
 using polar::basic::is_contained;
 using polar::utils::format_hex_no_prefix;
 using polar::basic::get_as_unsigned_integer;
@@ -101,21 +104,16 @@ std::error_code Input::getError()
    return m_errorCode;
 }
 
-// Pin the vtables to this file.
-void Input::HNode::anchor()
-{}
-
-void Input::EmptyHNode::anchor()
-{}
+namespace {
 
-void Input::ScalarHNode::anchor()
-{}
+using NodeKind = FlatDocument::NodeKind;
 
-void Input::MapHNode::anchor()
-{}
+bool is_kind(const FlatDocument::FlatNode *node, NodeKind kind)
+{
+   return node && node->getKind() == kind;
+}
 
-void Input::SequenceHNode::anchor()
-{}
+} // anonymous namespace
 
 bool Input::outputting()
 {
@@ -137,8 +135,11 @@ bool Input::setCurrentDocument()
          ++m_docIterator;
          return setCurrentDocument();
       }
-      m_topNode = this->createHNodes(node);
-      m_currentNode = m_topNode.get();
+      m_document.build(node, [this](Node *errorNode, const Twine &message) {
+         setError(errorNode, message);
+      });
+      m_keysUsed.assign(m_document.getNumEntries(), false);
+      m_currentNode = m_document.getRoot();
       return true;
    }
    return false;
@@ -151,12 +152,12 @@ bool Input::nextDocument()
 
 const Node *Input::getCurrentNode() const
 {
-   return m_currentNode ? m_currentNode->m_node : nullptr;
+   return m_currentNode ? m_currentNode->getNode() : nullptr;
 }
 
 bool Input::mapTag(StringRef tag, bool defaultValue)
 {
-   std::string foundTag = m_currentNode->m_node->getVerbatimTag();
+   std::string foundTag = m_currentNode->getNode()->getVerbatimTag();
    if (foundTag.empty()) {
       // If no tag found and 'tag' is the default, say it was found.
       return defaultValue;
@@ -169,22 +170,25 @@ void Input::beginMapping() {
    if (m_errorCode)
       return;
    // m_currentNode can be null if the document is empty.
-   MapHNode *mapNode = dyn_cast_or_null<MapHNode>(m_currentNode);
-   if (mapNode) {
-      mapNode->m_validKeys.clear();
+   if (is_kind(m_currentNode, NodeKind::Mapping)) {
+      for (const FlatDocument::Entry &entry : m_document.getEntries(*m_currentNode)) {
+         m_keysUsed[m_document.getEntryIndex(entry)] = false;
+      }
    }
 }
 
 std::vector<StringRef> Input::getKeys()
 {
-   MapHNode *mapNode = dyn_cast<MapHNode>(m_currentNode);
    std::vector<StringRef> ret;
-   if (!mapNode) {
+   if (!is_kind(m_currentNode, NodeKind::Mapping)) {
       setError(m_currentNode, "not a mapping");
       return ret;
    }
-   for (auto &map : mapNode->m_mapping) {
-      ret.push_back(map.first());
+   for (const FlatDocument::Entry &entry : m_document.getEntries(*m_currentNode)) {
+      // A repeated key stands for its last entry.
+      if (m_document.lookup(*m_currentNode, entry.m_key) == &entry) {
+         ret.push_back(entry.m_key);
+      }
    }
    return ret;
 }
@@ -206,16 +210,14 @@ bool Input::preflightKey(const char *key, bool required, bool, bool &useDefault,
       return false;
    }
 
-   MapHNode *mapNode = dyn_cast<MapHNode>(m_currentNode);
-   if (!mapNode) {
-      if (required || !isa<EmptyHNode>(m_currentNode)) {
+   if (!is_kind(m_currentNode, NodeKind::Mapping)) {
+      if (required || !is_kind(m_currentNode, NodeKind::Empty)) {
          setError(m_currentNode, "not a mapping");
       }
       return false;
    }
-   mapNode->m_validKeys.push_back(key);
-   HNode *value = mapNode->m_mapping[key].get();
-   if (!value) {
+   const FlatDocument::Entry *entry = m_document.lookup(*m_currentNode, key);
+   if (!entry) {
       if (required) {
          setError(m_currentNode, Twine("missing required key '") + key + "'");
       } else {
@@ -223,14 +225,15 @@ bool Input::preflightKey(const char *key, bool required, bool, bool &useDefault,
       }
       return false;
    }
-   saveInfo = m_currentNode;
-   m_currentNode = value;
+   m_keysUsed[m_document.getEntryIndex(*entry)] = true;
+   saveInfo = const_cast<FlatNode *>(m_currentNode);
+   m_currentNode = &m_document.getValue(*entry);
    return true;
 }
 
 void Input::postflightKey(void *saveInfo)
 {
-   m_currentNode = reinterpret_cast<HNode *>(saveInfo);
+   m_currentNode = reinterpret_cast<const FlatNode *>(saveInfo);
 }
 
 void Input::endMapping()
@@ -238,14 +241,16 @@ void Input::endMapping()
    if (m_errorCode)
       return;
    // m_currentNode can be null if the document is empty.
-   MapHNode *mapNode = dyn_cast_or_null<MapHNode>(m_currentNode);
-   if (!mapNode) {
+   if (!is_kind(m_currentNode, NodeKind::Mapping)) {
       return;
    }
 
-   for (const auto &mapItem : mapNode->m_mapping) {
-      if (!is_contained(mapNode->m_validKeys, mapItem.first())) {
-         setError(mapItem.m_second.get(), Twine("unknown key '") + mapItem.first() + "'");
+   for (const FlatDocument::Entry &entry : m_document.getEntries(*m_currentNode)) {
+      // Lookups find the last entry of a repeated key, so that is the one
+      // marked.
+      const FlatDocument::Entry *last = m_document.lookup(*m_currentNode, entry.m_key);
+      if (!m_keysUsed[m_document.getEntryIndex(*last)]) {
+         setError(&m_document.getValue(*last), Twine("unknown key '") + entry.m_key + "'");
          break;
       }
    }
@@ -263,19 +268,19 @@ void Input::endFlowMapping()
 
 unsigned Input::beginSequence()
 {
-   if (SequenceHNode *sequence = dyn_cast<SequenceHNode>(m_currentNode)) {
-      return sequence->m_entries.size();
+   if (is_kind(m_currentNode, NodeKind::Sequence)) {
+      return m_currentNode->getSize();
    }
-   if (isa<EmptyHNode>(m_currentNode)) {
+   if (is_kind(m_currentNode, NodeKind::Empty)) {
       return 0;
    }
    // Treat case where there's a scalar "null" value as an empty sequence.
-   if (ScalarHNode *sn = dyn_cast<ScalarHNode>(m_currentNode)) {
-      if (is_null(sn->value())) {
+   if (is_kind(m_currentNode, NodeKind::Scalar)) {
+      if (is_null(m_currentNode->getValue())) {
          return 0;
       }
    }
-   // Any other type of HNode is an error.
+   // Any other type of node is an error.
    setError(m_currentNode, "not a sequence");
    return 0;
 }
@@ -289,9 +294,9 @@ bool Input::preflightElement(unsigned index, void *&saveInfo)
    if (m_errorCode) {
       return false;
    }
-   if (SequenceHNode *sequence = dyn_cast<SequenceHNode>(m_currentNode)) {
-      saveInfo = m_currentNode;
-      m_currentNode = sequence->m_entries[index].get();
+   if (is_kind(m_currentNode, NodeKind::Sequence)) {
+      saveInfo = const_cast<FlatNode *>(m_currentNode);
+      m_currentNode = &m_document.getValue(m_document.getEntries(*m_currentNode)[index]);
       return true;
    }
    return false;
@@ -299,7 +304,7 @@ bool Input::preflightElement(unsigned index, void *&saveInfo)
 
 void Input::postflightElement(void *saveInfo)
 {
-   m_currentNode = reinterpret_cast<HNode *>(saveInfo);
+   m_currentNode = reinterpret_cast<const FlatNode *>(saveInfo);
 }
 
 unsigned Input::beginFlowSequence()
@@ -309,21 +314,12 @@ unsigned Input::beginFlowSequence()
 
 bool Input::preflightFlowElement(unsigned index, void *&saveInfo)
 {
-   if (m_errorCode) {
-      return false;
-   }
-
-   if (SequenceHNode *sequence = dyn_cast<SequenceHNode>(m_currentNode)) {
-      saveInfo = m_currentNode;
-      m_currentNode = sequence->m_entries[index].get();
-      return true;
-   }
-   return false;
+   return preflightElement(index, saveInfo);
 }
 
 void Input::postflightFlowElement(void *saveInfo)
 {
-   m_currentNode = reinterpret_cast<HNode *>(saveInfo);
+   m_currentNode = reinterpret_cast<const FlatNode *>(saveInfo);
 }
 
 void Input::endFlowSequence() {
@@ -340,8 +336,8 @@ bool Input::matchEnumScalar(const char *str, bool)
       return false;
    }
 
-   if (ScalarHNode *sn = dyn_cast<ScalarHNode>(m_currentNode)) {
-      if (sn->value().equals(str)) {
+   if (is_kind(m_currentNode, NodeKind::Scalar)) {
+      if (m_currentNode->getValue().equals(str)) {
          m_scalarMatchFound = true;
          return true;
       }
@@ -368,8 +364,8 @@ void Input::endEnumScalar()
 bool Input::beginBitSetScalar(bool &doClear)
 {
    m_bitValuesUsed.clear();
-   if (SequenceHNode *sequence = dyn_cast<SequenceHNode>(m_currentNode)) {
-      m_bitValuesUsed.insert(m_bitValuesUsed.begin(), sequence->m_entries.size(), false);
+   if (is_kind(m_currentNode, NodeKind::Sequence)) {
+      m_bitValuesUsed.insert(m_bitValuesUsed.begin(), m_currentNode->getSize(), false);
    } else {
       setError(m_currentNode, "expected sequence of bit values");
    }
@@ -381,11 +377,12 @@ bool Input::bitSetMatch(const char *str, bool)
 {
    if (m_errorCode)
       return false;
-   if (SequenceHNode *sequence = dyn_cast<SequenceHNode>(m_currentNode)) {
+   if (is_kind(m_currentNode, NodeKind::Sequence)) {
       unsigned index = 0;
-      for (auto &node : sequence->m_entries) {
-         if (ScalarHNode *sn = dyn_cast<ScalarHNode>(node.get())) {
-            if (sn->value().equals(str)) {
+      for (const FlatDocument::Entry &entry : m_document.getEntries(*m_currentNode)) {
+         const FlatNode &node = m_document.getValue(entry);
+         if (node.getKind() == NodeKind::Scalar) {
+            if (node.getValue().equals(str)) {
                m_bitValuesUsed[index] = true;
                return true;
             }
@@ -406,11 +403,12 @@ void Input::endBitSetScalar()
       return;
    }
 
-   if (SequenceHNode *sequence = dyn_cast<SequenceHNode>(m_currentNode)) {
-      assert(m_bitValuesUsed.size() == sequence->m_entries.size());
-      for (unsigned i = 0; i < sequence->m_entries.size(); ++i) {
+   if (is_kind(m_currentNode, NodeKind::Sequence)) {
+      ArrayRef<FlatDocument::Entry> entries = m_document.getEntries(*m_currentNode);
+      assert(m_bitValuesUsed.size() == entries.getSize());
+      for (unsigned i = 0; i < entries.getSize(); ++i) {
          if (!m_bitValuesUsed[i]) {
-            setError(sequence->m_entries[i].get(), "unknown bit value");
+            setError(&m_document.getValue(entries[i]), "unknown bit value");
             return;
          }
       }
@@ -419,8 +417,8 @@ void Input::endBitSetScalar()
 
 void Input::scalarString(StringRef &str, QuotingType)
 {
-   if (ScalarHNode *sn = dyn_cast<ScalarHNode>(m_currentNode)) {
-      str = sn->value();
+   if (is_kind(m_currentNode, NodeKind::Scalar)) {
+      str = m_currentNode->getValue();
    } else {
       setError(m_currentNode, "unexpected scalar");
    }
@@ -431,10 +429,10 @@ void Input::blockScalarString(StringRef &str)
    scalarString(str, QuotingType::None);
 }
 
-void Input::setError(HNode *hnode, const Twine &message)
+void Input::setError(const FlatNode *node, const Twine &message)
 {
-   assert(hnode && "HNode must not be NULL");
-   this->setError(hnode->m_node, message);
+   assert(node && "FlatNode must not be NULL");
+   this->setError(node->getNode(), message);
 }
 
 void Input::setError(Node *node, const Twine &message)
@@ -443,64 +441,6 @@ void Input::setError(Node *node, const Twine &message)
    m_errorCode = make_error_code(ErrorCode::invalid_argument);
 }
 
-std::unique_ptr<Input::HNode> Input::createHNodes(Node *node)
-{
-   SmallString<128> stringStorage;
-   if (ScalarNode *sn = dyn_cast<ScalarNode>(node)) {
-      StringRef keyStr = sn->getValue(stringStorage);
-      if (!stringStorage.empty()) {
-         // Copy string to permanent storage
-         keyStr = stringStorage.getStr().copy(m_stringAllocator);
-      }
-      return std::make_unique<ScalarHNode>(node, keyStr);
-   } else if (BlockScalarNode *bsn = dyn_cast<BlockScalarNode>(node)) {
-      StringRef valueCopy = bsn->getValue().copy(m_stringAllocator);
-      return std::make_unique<ScalarHNode>(node, valueCopy);
-   } else if (SequenceNode *sequence = dyn_cast<SequenceNode>(node)) {
-      auto sequenceHNode = std::make_unique<SequenceHNode>(node);
-      for (Node &sn : *sequence) {
-         auto Entry = this->createHNodes(&sn);
-         if (m_errorCode) {
-            break;
-         }
-         sequenceHNode->m_entries.push_back(std::move(Entry));
-      }
-      return std::move(sequenceHNode);
-   } else if (MappingNode *Map = dyn_cast<MappingNode>(node)) {
-      auto mapHNode = std::make_unique<MapHNode>(node);
-      for (KeyValueNode &kvn : *Map) {
-         Node *KeyNode = kvn.getKey();
-         ScalarNode *key = dyn_cast<ScalarNode>(KeyNode);
-         Node *value = kvn.getValue();
-         if (!key || !value) {
-            if (!key) {
-               setError(KeyNode, "Map key must be a scalar");
-            }
-            if (!value) {
-               setError(KeyNode, "Map value must not be empty");
-            }
-            break;
-         }
-         stringStorage.clear();
-         StringRef keyStr = key->getValue(stringStorage);
-         if (!stringStorage.empty()) {
-            // Copy string to permanent storage
-            keyStr = stringStorage.getStr().copy(m_stringAllocator);
-         }
-         auto ValueHNode = this->createHNodes(value);
-         if (m_errorCode)
-            break;
-         mapHNode->m_mapping[keyStr] = std::move(ValueHNode);
-      }
-      return std::move(mapHNode);
-   } else if (isa<NullNode>(node)) {
-      return std::make_unique<EmptyHNode>(node);
-   } else {
-      setError(node, "unknown node kind");
-      return nullptr;
-   }
-}
-
 void Input::setError(const Twine &Message) {
    this->setError(m_currentNode, Message);
 }
@@ -517,8 +457,22 @@ Output::Output(RawOutStream &out, void *context, int wrapColumn)
    : IO(context), m_out(out), m_wrapColumn(wrapColumn)
 {}
 
+Output::Output(RawFdOutStream &out, void *context, int wrapColumn)
+   : Output(static_cast<RawOutStream &>(out), context, wrapColumn)
+{
+   size_t bufferSize = out.getBufferSize();
+   if (bufferSize != 0 && bufferSize < FdBufferSize) {
+      m_savedBufferSize = bufferSize;
+      out.setBufferSize(FdBufferSize);
+   }
+}
+
 Output::~Output()
-{}
+{
+   if (m_savedBufferSize != 0) {
+      m_out.setBufferSize(m_savedBufferSize);
+   }
+}
 
 bool Output::outputting()
 {
@@ -678,12 +632,8 @@ bool Output::preflightFlowElement(unsigned, void *&)
    }
 
    if (m_wrapColumn && m_column > m_wrapColumn) {
-      output("\n");
-      for (int i = 0; i < m_columnAtFlowStart; ++i) {
-         output(" ");
-      }
-      m_column = m_columnAtFlowStart;
-      output("  ");
+      outputNewLine();
+      outputIndent(m_columnAtFlowStart + 2);
    }
    return true;
 }
@@ -822,9 +772,7 @@ void Output::blockScalarString(StringRef &str)
    unsigned indent = m_stateStack.empty() ? 1 : m_stateStack.getSize();
    auto buffer = MemoryBuffer::getMemBuffer(str, "", false);
    for (LineIterator lines(*buffer, false); !lines.isAtEnd(); ++lines) {
-      for (unsigned index = 0; index < indent; ++index) {
-         output("  ");
-      }
+      outputIndent(2 * indent);
       output(*lines);
       outputNewLine();
    }
@@ -896,13 +844,16 @@ void Output::newLineCheck()
       outputDash = true;
    }
 
-   for (unsigned i = 0; i < indent; ++i) {
-      output("  ");
-   }
+   outputIndent(2 * indent);
    if (outputDash) {
       output("- ");
    }
+}
 
+void Output::outputIndent(unsigned numSpaces)
+{
+   m_column += numSpaces;
+   m_out.indent(numSpaces);
 }
 
 void Output::paddedKey(StringRef key)
@@ -924,12 +875,8 @@ void Output::flowKey(StringRef key)
    }
 
    if (m_wrapColumn && m_column > m_wrapColumn) {
-      output("\n");
-      for (int index = 0; index < m_columnAtMapFlowStart; ++index) {
-         output(" ");
-      }
-      m_column = m_columnAtMapFlowStart;
-      output("  ");
+      outputNewLine();
+      outputIndent(m_columnAtMapFlowStart + 2);
    }
    output(key);
    output(": ");
@@ -1134,7 +1081,7 @@ StringRef ScalarTraits<int64_t>::input(StringRef scalar, void *, int64_t &value)
 
 void ScalarTraits<double>::output(const double &value, void *, RawOutStream &out)
 {
-   out << format("%g", value);
+   write_shortest(out, value);
 }
 
 StringRef ScalarTraits<double>::input(StringRef scalar, void *, double &value)
@@ -1147,7 +1094,7 @@ StringRef ScalarTraits<double>::input(StringRef scalar, void *, double &value)
 
 void ScalarTraits<float>::output(const float &value, void *, RawOutStream &out)
 {
-   out << format("%g", value);
+   write_shortest(out, value);
 }
 
 StringRef ScalarTraits<float>::input(StringRef scalar, void *, float &value)
@@ -1161,7 +1108,7 @@ StringRef ScalarTraits<float>::input(StringRef scalar, void *, float &value)
 void ScalarTraits<Hex8>::output(const Hex8 &value, void *, RawOutStream &out)
 {
    uint8_t num = value;
-   out << format("0x%02X", num);
+   write_hex(out, num, HexPrintStyle::PrefixUpper, 4);
 }
 
 StringRef ScalarTraits<Hex8>::input(StringRef scalar, void *, Hex8 &value) {
@@ -1179,7 +1126,7 @@ StringRef ScalarTraits<Hex8>::input(StringRef scalar, void *, Hex8 &value) {
 void ScalarTraits<Hex16>::output(const Hex16 &value, void *, RawOutStream &out)
 {
    uint16_t num = value;
-   out << format("0x%04X", num);
+   write_hex(out, num, HexPrintStyle::PrefixUpper, 6);
 }
 
 StringRef ScalarTraits<Hex16>::input(StringRef scalar, void *, Hex16 &value)
@@ -1198,7 +1145,7 @@ StringRef ScalarTraits<Hex16>::input(StringRef scalar, void *, Hex16 &value)
 void ScalarTraits<Hex32>::output(const Hex32 &value, void *, RawOutStream &out)
 {
    uint32_t num = value;
-   out << format("0x%08X", num);
+   write_hex(out, num, HexPrintStyle::PrefixUpper, 10);
 }
 
 StringRef ScalarTraits<Hex32>::input(StringRef scalar, void *, Hex32 &value)
@@ -1217,7 +1164,7 @@ StringRef ScalarTraits<Hex32>::input(StringRef scalar, void *, Hex32 &value)
 void ScalarTraits<Hex64>::output(const Hex64 &value, void *, RawOutStream &out)
 {
    uint64_t num = value;
-   out << format("0x%016llX", num);
+   write_hex(out, num, HexPrintStyle::PrefixUpper, 18);
 }
 
 StringRef ScalarTraits<Hex64>::input(StringRef scalar, void *, Hex64 &value)
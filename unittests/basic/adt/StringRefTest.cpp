@@ -17,6 +17,7 @@
 #include "polar/utils/Allocator.h"
 #include "polar/utils/RawOutStream.h"
 #include "gtest/gtest.h"
+#include <cstdlib>
 
 using namespace polar::basic;
 using namespace polar::utils;
@@ -885,6 +886,12 @@ struct GetDoubleStrings {
 {"1.8e308", false, true, std::numeric_limits<double>::infinity()},
 {"0x0.0000000000001P-1023", false, true, 0.0},
 {"0x0.0000000000001P-1023", true, false, 0.0},
+{"1e23", true, false, 1e23},
+{"-.5e1", true, false, -5.0},
+{"9007199254740993", true, false, 9007199254740992.0},
+{"2.2250738585072011e-308", true, false, 2.2250738585072011e-308},
+{"1.7976931348623158e308", true, false, std::numeric_limits<double>::max()},
+{"4.9406564584124654e-324", true, false, std::numeric_limits<double>::denorm_min()},
 };
 
 TEST(StringRefTest, testGetAsDouble)
@@ -899,6 +906,60 @@ TEST(StringRefTest, testGetAsDouble)
    }
 }
 
+TEST(StringRefTest, testTryParseDecimalFloat)
+{
+   // Whatever the fast path takes, it rounds as strtod() and strtof() do.
+   const char *Numbers[] = {
+      "0", "-0", "1", "+1.5", ".25", "7.", "0.1", "3.14159265358979323",
+      "1e23", "8.589973e9", "2.2250738585072014e-308", "1.7976931348623157e308",
+      "9007199254740993", "9007199254740995", "0.000000000000000000000000000001",
+      "123456789012345678e-40", "3.4028235e38", "1.17549435e-38", "16777217",
+      "4.35e-10", "0.00093", "-0.0005", "1234567890123456789"
+   };
+   for (const char *Number : Numbers) {
+      double D;
+      if (try_parse_decimal_float(Number, D)) {
+         EXPECT_EQ(std::strtod(Number, nullptr), D) << Number;
+      }
+      float F;
+      if (try_parse_decimal_float(Number, F)) {
+         EXPECT_EQ(std::strtof(Number, nullptr), F) << Number;
+      }
+   }
+   double D = 0;
+   EXPECT_TRUE(try_parse_decimal_float("-12.5e-1", D));
+   EXPECT_EQ(-1.25, D);
+
+   // Other forms, and cases left to the general parsers.
+   const char *Others[] = {
+      "", "-", ".", "e1", "1e", "1e+", " 1", "1 ", "inf", "nan", "0x10",
+      "1.2.3", "--1", "1e100000", "1e400", "4.9e-324", "12345678901234567890"
+   };
+   for (const char *Other : Others) {
+      EXPECT_FALSE(try_parse_decimal_float(Other, D)) << Other;
+   }
+}
+
+TEST(StringRefTest, testGetAsIntegerLongRuns)
+{
+   unsigned long long U64;
+   EXPECT_FALSE(StringRef("12345678901234567890").getAsInteger(10, U64));
+   EXPECT_EQ(12345678901234567890ULL, U64);
+   EXPECT_FALSE(StringRef("000000000000000000000000042").getAsInteger(10, U64));
+   EXPECT_EQ(42ULL, U64);
+   EXPECT_FALSE(StringRef("18446744073709551615").getAsInteger(10, U64));
+   EXPECT_EQ(18446744073709551615ULL, U64);
+   EXPECT_TRUE(StringRef("18446744073709551616").getAsInteger(10, U64));
+   EXPECT_TRUE(StringRef("1234567890123a").getAsInteger(10, U64));
+   int64_t S64;
+   EXPECT_FALSE(StringRef("-9223372036854775808").getAsInteger(10, S64));
+   EXPECT_EQ(INT64_MIN, S64);
+   StringRef Str("98765432101234abc");
+   EXPECT_FALSE(Str.consumeInteger(10, U64));
+   EXPECT_EQ(98765432101234ULL, U64);
+   EXPECT_EQ("abc", Str);
+}
+
 static const char *join_input[] = { "a", "b", "c" };
 static const char join_result1[] = "a";
 static const char join_result2[] = "a:b:c";
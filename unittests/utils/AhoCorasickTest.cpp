@@ -0,0 +1,89 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/AhoCorasick.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::utils;
+
+namespace {
+
+std::vector<unsigned> search_all(const AhoCorasick &automaton, StringRef text)
+{
+   std::vector<unsigned> ids;
+   automaton.search(text, [&](unsigned id) {
+      ids.push_back(id);
+   });
+   std::sort(ids.begin(), ids.end());
+   return ids;
+}
+
+TEST(AhoCorasickTest, testEmpty)
+{
+   AhoCorasick automaton;
+   automaton.insert("", 7);
+   automaton.build();
+   EXPECT_TRUE(automaton.isEmpty());
+   EXPECT_TRUE(search_all(automaton, "anything").empty());
+}
+
+TEST(AhoCorasickTest, testOverlappingLiterals)
+{
+   AhoCorasick automaton;
+   automaton.insert("he", 0);
+   automaton.insert("she", 1);
+   automaton.insert("his", 2);
+   automaton.insert("hers", 3);
+   automaton.insert("she", 4);
+   automaton.build();
+   EXPECT_EQ((std::vector<unsigned>{0, 0, 1, 3, 4}), search_all(automaton, "ushers he"));
+   EXPECT_EQ((std::vector<unsigned>{2}), search_all(automaton, "this"));
+   EXPECT_TRUE(search_all(automaton, "hi s").empty());
+   EXPECT_TRUE(search_all(automaton, "").empty());
+}
+
+TEST(AhoCorasickTest, testAgainstNaiveSearch)
+{
+   std::vector<std::string> literals;
+   for (unsigned i = 0; i < 200; ++i) {
+      std::string literal;
+      for (unsigned j = i; literal.size() < 1 + i % 5; j = j * 7 + 3) {
+         literal += char('a' + j % 4);
+      }
+      literals.push_back(literal);
+   }
+   literals.push_back(std::string("\xff\x00\x80", 3));
+   AhoCorasick automaton;
+   for (unsigned i = 0; i < literals.size(); ++i) {
+      automaton.insert(literals[i], i);
+   }
+   automaton.build();
+   std::string text;
+   for (unsigned i = 0; i < 500; ++i) {
+      text += char('a' + (i * i + i / 3) % 5);
+   }
+   text += std::string("x\xff\x00\x80y", 5);
+   std::vector<unsigned> expected;
+   for (unsigned i = 0; i < literals.size(); ++i) {
+      for (size_t pos = text.find(literals[i]); pos != std::string::npos;
+           pos = text.find(literals[i], pos + 1)) {
+         expected.push_back(i);
+      }
+   }
+   std::sort(expected.begin(), expected.end());
+   EXPECT_EQ(expected, search_all(automaton, text));
+}
+
+} // anonymous namespace
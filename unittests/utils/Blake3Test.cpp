@@ -0,0 +1,82 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/Blake3.h"
+#include "polar/basic/adt/StringExtras.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+namespace {
+
+/// The input pattern used by the official BLAKE3 test vectors.
+std::vector<uint8_t> make_input(size_t length)
+{
+   std::vector<uint8_t> input(length);
+   for (size_t i = 0; i < length; ++i) {
+      input[i] = i % 251;
+   }
+   return input;
+}
+
+TEST(Blake3Test, testKnownVectors)
+{
+   struct {
+      size_t length;
+      const char *digest;
+   } vectors[] = {
+      {0, "AF1349B9F5F9A1A6A0404DEA36DCC9499BCB25C9ADC112B7CC9A93CAE41F3262"},
+      {1, "2D3ADEDFF11B61F14C886E35AFA036736DCD87A74D27B5C1510225D0F592E213"},
+      {1023, "10108970EEDA3EB932BAAC1428C7A2163B0E924C9A9E25B35BBA72B28F70BD11"},
+      {1024, "42214739F095A406F3FC83DEB889744AC00DF831C10DAA55189B5D121C855AF7"},
+      {1025, "D00278AE47EB27B34FAECF67B4FE263F82D5412916C1FFD97C8CB7FB814B8444"},
+      {2048, "E776B6028C7CD22A4D0BA182A8BF62205D2EF576467E838ED6F2529B85FBA24A"},
+      {2049, "5F4D72F40D7A5F82B15CA2B2E44B1DE3C2EF86C426C95C1AF0B6879522563030"},
+   };
+   for (const auto &vector : vectors) {
+      std::vector<uint8_t> input = make_input(vector.length);
+      EXPECT_EQ(vector.digest, to_hex(ArrayRef<uint8_t>(Blake3::hash(input))))
+            << "length " << vector.length;
+   }
+   Blake3 hash;
+   hash.update("abc");
+   EXPECT_EQ("6437B3AC38465133FFB63B75273A8DB548C558465D79DB03FD359C6CD5BD9D85",
+             to_hex(hash.final()));
+}
+
+TEST(Blake3Test, testParallelSubtrees)
+{
+   // Large enough for the subtree hashing to be spread over the thread pool.
+   std::vector<uint8_t> input = make_input((1 << 20) + 5);
+   ASSERT_GT(input.size(), Blake3::getParallelThreshold());
+   EXPECT_EQ("E7D3A085AAE37615EB1535109C71EAE66A4D65D741E7D6B3268608C5A509EC4E",
+             to_hex(ArrayRef<uint8_t>(Blake3::hash(input))));
+}
+
+TEST(Blake3Test, testIncremental)
+{
+   std::vector<uint8_t> input = make_input(200000);
+   std::string expected = to_hex(ArrayRef<uint8_t>(Blake3::hash(input)));
+   Blake3 hash;
+   for (size_t pos = 0, step = 1; pos < input.size(); pos += step, step = step * 3 + 1) {
+      hash.update(ArrayRef<uint8_t>(input).slice(pos, std::min(step, input.size() - pos)));
+   }
+   EXPECT_EQ(expected, to_hex(hash.result()));
+   // Finalizing does not consume the state.
+   EXPECT_EQ(expected, to_hex(hash.final()));
+}
+
+} // anonymous namespace
@@ -10,8 +10,16 @@
 // Created by softboy on 2018/07/12.
 
 #include "polar/utils/CachePruning.h"
+#include "polar/basic/adt/SmallString.h"
 #include "polar/utils/ErrorType.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/LockFileMgr.h"
+#include "polar/utils/Path.h"
+#include "polar/utils/RawOutStream.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using namespace polar::basic;
 using namespace polar::utils;
@@ -84,6 +92,25 @@ TEST(CachePruningPolicyParserTest, testMultiple)
    EXPECT_EQ(50u, P->m_maxSizePercentageOfAvailableSpace);
 }
 
+TEST(CachePruningPolicyParserTest, testIndex)
+{
+   auto P = parse_cache_pruning_policy("");
+   ASSERT_TRUE(bool(P));
+   EXPECT_FALSE(P->m_useIndex);
+   P = parse_cache_pruning_policy("index=1");
+   ASSERT_TRUE(bool(P));
+   EXPECT_TRUE(P->m_useIndex);
+   P = parse_cache_pruning_policy("cache_size=50%:index=true");
+   ASSERT_TRUE(bool(P));
+   EXPECT_TRUE(P->m_useIndex);
+   EXPECT_EQ(50u, P->m_maxSizePercentageOfAvailableSpace);
+   P = parse_cache_pruning_policy("index=false");
+   ASSERT_TRUE(bool(P));
+   EXPECT_FALSE(P->m_useIndex);
+   EXPECT_EQ("'yes' must be 0, 1, true or false",
+             to_string(parse_cache_pruning_policy("index=yes").takeError()));
+}
+
 TEST(CachePruningPolicyParserTest, testErrors)
 {
    EXPECT_EQ("duration must not be empty",
@@ -108,4 +135,226 @@ TEST(CachePruningPolicyParserTest, testErrors)
              to_string(parse_cache_pruning_policy("foo=bar").takeError()));
 }
 
+class CachePruningIndexTest : public ::testing::Test
+{
+protected:
+   SmallString<128> CacheDir;
+   std::chrono::system_clock::time_point Now = std::chrono::system_clock::now();
+
+   void SetUp() override
+   {
+      ASSERT_FALSE(polar::fs::create_unique_directory("cache-pruning-test", CacheDir));
+   }
+
+   void TearDown() override
+   {
+      ASSERT_FALSE(polar::fs::remove_directories(CacheDir.getStr()));
+   }
+
+   void addFile(StringRef Name, size_t Size, std::chrono::seconds Age, bool Record = true)
+   {
+      SmallString<128> Path(CacheDir);
+      polar::fs::path::append(Path, Name);
+      std::error_code EC;
+      RawFdOutStream OS(Path.getStr(), EC, polar::fs::F_None);
+      ASSERT_FALSE(EC);
+      OS << std::string(Size, 'x');
+      if (Record) {
+         ASSERT_FALSE(record_cache_access(CacheDir, Name, Size, Now - Age));
+      }
+   }
+
+   bool exists(StringRef Name)
+   {
+      SmallString<128> Path(CacheDir);
+      polar::fs::path::append(Path, Name);
+      return polar::fs::exists(Path);
+   }
+
+   CachePruningPolicy makePolicy()
+   {
+      CachePruningPolicy Policy;
+      Policy.m_interval = std::chrono::seconds(0);
+      Policy.m_expiration = std::chrono::seconds(0);
+      Policy.m_maxSizePercentageOfAvailableSpace = 0;
+      Policy.m_maxSizeFiles = 0;
+      Policy.m_useIndex = true;
+      return Policy;
+   }
+};
+
+TEST_F(CachePruningIndexTest, testExpiration)
+{
+   addFile("polarcache-a", 10, std::chrono::hours(2));
+   addFile("polarcache-b", 10, std::chrono::minutes(10));
+   addFile("polarcache-c", 10, std::chrono::seconds(0));
+   // Not in the index, so left alone.
+   addFile("polarcache-d", 10, std::chrono::hours(2), /*Record=*/false);
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_expiration = std::chrono::hours(1);
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_FALSE(exists("polarcache-a"));
+   EXPECT_TRUE(exists("polarcache-b"));
+   EXPECT_TRUE(exists("polarcache-c"));
+   EXPECT_TRUE(exists("polarcache-d"));
+   ASSERT_FALSE(polar::fs::remove(Twine(CacheDir) + "/polarcache-d"));
+}
+
+TEST_F(CachePruningIndexTest, testLeastRecentlyUsedFirst)
+{
+   addFile("polarcache-a", 100, std::chrono::minutes(4));
+   addFile("polarcache-b", 100, std::chrono::minutes(3));
+   addFile("polarcache-c", 100, std::chrono::minutes(2));
+   addFile("polarcache-d", 100, std::chrono::minutes(1));
+   // Using a file again makes it the most recent.
+   ASSERT_FALSE(record_cache_access(CacheDir, "polarcache-a", 100, Now));
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_maxSizePercentageOfAvailableSpace = 100;
+   Policy.m_maxSizeBytes = 250;
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_TRUE(exists("polarcache-a"));
+   EXPECT_FALSE(exists("polarcache-b"));
+   EXPECT_FALSE(exists("polarcache-c"));
+   EXPECT_TRUE(exists("polarcache-d"));
+
+   // The compacted index still knows the files left.
+   Policy = makePolicy();
+   Policy.m_maxSizeFiles = 1;
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_TRUE(exists("polarcache-a"));
+   EXPECT_FALSE(exists("polarcache-d"));
+   ASSERT_FALSE(polar::fs::remove(Twine(CacheDir) + "/polarcache-a"));
+}
+
+TEST_F(CachePruningIndexTest, testRemovalRecords)
+{
+   addFile("polarcache-a", 10, std::chrono::minutes(2));
+   addFile("polarcache-b", 10, std::chrono::minutes(1));
+   ASSERT_FALSE(polar::fs::remove(Twine(CacheDir) + "/polarcache-a"));
+   ASSERT_FALSE(record_cache_removal(CacheDir, "polarcache-a"));
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_maxSizeFiles = 1;
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_TRUE(exists("polarcache-b"));
+   ASSERT_FALSE(polar::fs::remove(Twine(CacheDir) + "/polarcache-b"));
+}
+
+TEST_F(CachePruningIndexTest, testScanWithoutIndex)
+{
+   ASSERT_FALSE(polar::fs::create_directories(Twine(CacheDir) + "/00"));
+   addFile("00/polarcache-a", 10, std::chrono::seconds(0), /*Record=*/false);
+   addFile("polarcache-b", 10, std::chrono::seconds(0), /*Record=*/false);
+   addFile("unrelated", 10, std::chrono::seconds(0), /*Record=*/false);
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_maxSizeFiles = 1;
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_NE(exists("00/polarcache-a"), exists("polarcache-b"));
+   EXPECT_TRUE(exists("unrelated"));
+   EXPECT_TRUE(exists("polarcache.index"));
+   polar::fs::remove(Twine(CacheDir) + "/00/polarcache-a");
+   polar::fs::remove(Twine(CacheDir) + "/polarcache-b");
+}
+
+TEST_F(CachePruningIndexTest, testLockedIndex)
+{
+   addFile("polarcache-a", 10, std::chrono::minutes(2));
+   addFile("polarcache-b", 10, std::chrono::minutes(1));
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_maxSizeFiles = 1;
+   {
+      // Somebody else is pruning.
+      SmallString<128> IndexPath(CacheDir);
+      polar::fs::path::append(IndexPath, "polarcache.index");
+      LockFileManager Locker(IndexPath);
+      ASSERT_EQ(LockFileManager::LFS_Owned, Locker.getState());
+      EXPECT_FALSE(prune_cache(CacheDir, Policy));
+      EXPECT_TRUE(exists("polarcache-a"));
+   }
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_FALSE(exists("polarcache-a"));
+   EXPECT_TRUE(exists("polarcache-b"));
+   ASSERT_FALSE(polar::fs::remove(Twine(CacheDir) + "/polarcache-b"));
+}
+
+TEST_F(CachePruningIndexTest, testRecordWhilePruning)
+{
+   // Records appended while the index is compacted are not lost: in the end,
+   // the index knows every file.
+   enum { NumThreads = 4, NumFiles = 100 };
+   std::atomic<bool> Done(false);
+   std::thread Pruner([&] {
+      CachePruningPolicy Policy = makePolicy();
+      Policy.m_maxSizeFiles = 1000000;
+      while (!Done) {
+         prune_cache(CacheDir, Policy);
+      }
+   });
+   std::vector<std::thread> Writers;
+   std::atomic<unsigned> Failures(0);
+   for (unsigned T = 0; T != NumThreads; ++T) {
+      Writers.emplace_back([&, T] {
+         for (unsigned I = 0; I != NumFiles; ++I) {
+            std::string Name = "polarcache-" + std::to_string(T) + "-" + std::to_string(I);
+            std::string Path = (CacheDir + "/" + Name).getStr();
+            std::error_code EC;
+            {
+               RawFdOutStream OS(Path, EC, polar::fs::F_None);
+               OS << "x";
+            }
+            if (EC || record_cache_access(CacheDir, Name, 1, Now)) {
+               ++Failures;
+            }
+         }
+      });
+   }
+   for (std::thread &Writer : Writers) {
+      Writer.join();
+   }
+   Done = true;
+   Pruner.join();
+   EXPECT_EQ(0u, Failures);
+
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_maxSizeFiles = 1;
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   unsigned Left = 0;
+   for (unsigned T = 0; T != NumThreads; ++T) {
+      for (unsigned I = 0; I != NumFiles; ++I) {
+         std::string Name = "polarcache-" + std::to_string(T) + "-" + std::to_string(I);
+         if (exists(Name)) {
+            ++Left;
+            polar::fs::remove(Twine(CacheDir) + "/" + Name);
+         }
+      }
+   }
+   EXPECT_EQ(1u, Left);
+}
+
+TEST_F(CachePruningIndexTest, testLateRecords)
+{
+   addFile("polarcache-a", 100, std::chrono::minutes(1));
+   addFile("polarcache-b", 100, std::chrono::minutes(2));
+   // A batch of older uses of a, appended late, does not make it older.
+   std::vector<CacheAccess> Accesses;
+   Accesses.push_back({"polarcache-a", 10, Now - std::chrono::minutes(3)});
+   Accesses.push_back({"polarcache-b", 100, Now});
+   ASSERT_FALSE(record_cache_accesses(CacheDir, Accesses));
+   CachePruningPolicy Policy = makePolicy();
+   Policy.m_maxSizeFiles = 1;
+   EXPECT_TRUE(prune_cache(CacheDir, Policy));
+   EXPECT_FALSE(exists("polarcache-a"));
+   EXPECT_TRUE(exists("polarcache-b"));
+   ASSERT_FALSE(polar::fs::remove(Twine(CacheDir) + "/polarcache-b"));
+}
+
+TEST_F(CachePruningIndexTest, testInvalidNames)
+{
+   EXPECT_EQ(std::errc::invalid_argument, record_cache_access(CacheDir, "unrelated", 1));
+   EXPECT_EQ(std::errc::invalid_argument,
+             record_cache_access(CacheDir, "../polarcache-a", 1));
+   CacheAccess Access = {"unrelated", 1, Now};
+   EXPECT_EQ(std::errc::invalid_argument, record_cache_accesses(CacheDir, Access));
+   EXPECT_FALSE(exists("polarcache.index"));
+}
+
 } // anonymous namespace
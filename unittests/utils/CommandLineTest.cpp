@@ -205,6 +205,55 @@ TEST(CommandLineTest, testTokenizeGNUCommandLine)
                             array_lengthof(Output));
 }
 
+TEST(CommandLineTest, testTokenizeGNUCommandLineRuns)
+{
+   const char Input[] =
+         "  plain\t-o out.o\r\nmixed\"quoted part\"tail a\\ b\\\"c last\\";
+   const char *const Output[] = {
+      "plain", "-o", "out.o", "mixedquoted parttail", "a b\"c", "last\\"};
+   testCommandLineTokenizer(cmd::tokenize_gnu_command_line, Input, Output,
+                            array_lengthof(Output));
+
+   SmallVector<const char *, 0> Actual;
+   BumpPtrAllocator A;
+   StringSaver Saver(A);
+   cmd::tokenize_gnu_command_line("a b\n\nc", Saver, Actual, /*MarkEOLs=*/true);
+   ASSERT_EQ(5u, Actual.size());
+   EXPECT_STREQ("a", Actual[0]);
+   EXPECT_STREQ("b", Actual[1]);
+   EXPECT_EQ(nullptr, Actual[2]);
+   EXPECT_STREQ("c", Actual[3]);
+   EXPECT_EQ(nullptr, Actual[4]);
+}
+
+TEST(CommandLineTest, testTokenizeGNUCommandLineLongTokens)
+{
+   // Tokens long enough to be scanned a word at a time, with delimiters and
+   // look-alikes at every position of a word.
+   std::string Input;
+   std::vector<std::string> Expected;
+   for (unsigned Length = 1; Length != 40; ++Length) {
+      std::string Token(Length, 'a' + Length % 26);
+      Input += Token;
+      Input += Length % 3 ? " " : "\t\r\n";
+      Expected.push_back(Token);
+
+      std::string Mixed(Length, 'z');
+      Mixed[Length / 2] = Length % 2 ? '#' : '!';
+      Input += Mixed + "\\ \"quoted\" -I/usr/include/\xc3\xa9t\xc3\xa9 ";
+      Expected.push_back(Mixed + " quoted");
+      Expected.push_back("-I/usr/include/\xc3\xa9t\xc3\xa9");
+   }
+   SmallVector<const char *, 0> Actual;
+   BumpPtrAllocator A;
+   StringSaver Saver(A);
+   cmd::tokenize_gnu_command_line(Input, Saver, Actual, /*MarkEOLs=*/false);
+   ASSERT_EQ(Expected.size(), Actual.size());
+   for (size_t I = 0, E = Expected.size(); I != E; ++I) {
+      EXPECT_EQ(Expected[I], Actual[I]);
+   }
+}
+
 TEST(CommandLineTest, testTokenizeWindowsCommandLine)
 {
    const char Input[] = "a\\b c\\\\d e\\\\\"f g\" h\\\"i j\\\\\\\"k \"lmn\" o pqr "
@@ -513,6 +562,60 @@ TEST(CommandLineTest, ReparseCommandLineOptions) {
    EXPECT_TRUE(TopLevelOpt);
 }
 
+TEST(CommandLineTest, testPrefixAndGroupingOptions)
+{
+   cmd::reset_command_line_parser();
+
+   StackOption<std::string> Include("I", cmd::Prefix, cmd::init(""));
+   StackOption<std::string> Long("Ilong", cmd::init(""));
+   StackOption<bool> A("a", cmd::Grouping, cmd::init(false));
+   StackOption<bool> B("b", cmd::Grouping, cmd::init(false));
+   StackOption<bool> C("c", cmd::Grouping, cmd::init(false));
+
+   const char *args[] = {"prog", "-Ipath", "-Ilong=x", "-cba"};
+   EXPECT_TRUE(
+            cmd::parse_command_line_options(4, args, StringRef(), &null_stream()));
+   EXPECT_EQ("path", Include.getValue());
+   EXPECT_EQ("x", Long.getValue());
+   EXPECT_TRUE(A);
+   EXPECT_TRUE(B);
+   EXPECT_TRUE(C);
+
+   // The longest option name which starts the argument decides, so "-Ilongs"
+   // is neither "-I longs" nor "-Ilong s".
+   const char *args2[] = {"prog", "-Ilongs"};
+   cmd::reset_all_option_occurrences();
+   EXPECT_FALSE(
+            cmd::parse_command_line_options(2, args2, StringRef(), &null_stream()));
+
+   // Options registered after a parse are found by the next one.
+   cmd::reset_all_option_occurrences();
+   StackOption<std::string> Define("D", cmd::Prefix, cmd::init(""));
+   const char *args3[] = {"prog", "-DFOO=1", "-ab"};
+   EXPECT_TRUE(
+            cmd::parse_command_line_options(3, args3, StringRef(), &null_stream()));
+   EXPECT_EQ("FOO=1", Define.getValue());
+   EXPECT_TRUE(A);
+   EXPECT_TRUE(B);
+
+   // So are options renamed through get_registered_options(), although the
+   // number of names stays the same.
+   cmd::Option *DefineOption = cmd::get_registered_options()["D"];
+   cmd::get_registered_options().erase("D");
+   cmd::get_registered_options()["E"] = DefineOption;
+   cmd::reset_all_option_occurrences();
+   const char *args4[] = {"prog", "-EBAR"};
+   EXPECT_TRUE(
+            cmd::parse_command_line_options(2, args4, StringRef(), &null_stream()));
+   EXPECT_EQ("BAR", Define.getValue());
+   cmd::reset_all_option_occurrences();
+   const char *args5[] = {"prog", "-DBAZ"};
+   EXPECT_FALSE(
+            cmd::parse_command_line_options(2, args5, StringRef(), &null_stream()));
+   cmd::get_registered_options().erase("E");
+   cmd::get_registered_options()["D"] = DefineOption;
+}
+
 TEST(CommandLineTest, RemoveFromRegularSubCommand) {
    cmd::reset_command_line_parser();
 
@@ -711,6 +814,122 @@ TEST(CommandLineTest, testResponseFiles) {
    fs::remove(TestDir);
 }
 
+TEST(CommandLineTest, testRecursiveResponseFiles)
+{
+   SmallString<128> TestDir;
+   std::error_code EC =
+         fs::create_unique_directory("unittest", TestDir);
+   EXPECT_TRUE(!EC);
+
+   // A response file which includes itself is expanded a limited number of
+   // times, and the arguments after it are kept in order.
+   SmallString<128> SelfFileName;
+   fs::path::append(SelfFileName, TestDir, "self.rsp");
+   std::ofstream SelfFile(SelfFileName.getCStr());
+   EXPECT_TRUE(SelfFile.is_open());
+   SelfFile << "-x @" << SelfFileName.getCStr() << " -y\n";
+   SelfFile.close();
+
+   SmallString<128> SelfRef;
+   SelfRef.append(1, '@');
+   SelfRef.append(SelfFileName.getCStr());
+   SmallVector<const char *, 4> Argv = {"test/test", SelfRef.getCStr(), "-z",
+                                        "@does-not-exist"};
+
+   BumpPtrAllocator A;
+   StringSaver Saver(A);
+   EXPECT_FALSE(cmd::expand_response_files(
+                   Saver, cmd::tokenize_gnu_command_line, Argv, false, false));
+   ASSERT_EQ(1u + 21u + 1u + 21u + 2u, Argv.size());
+   EXPECT_STREQ("test/test", Argv[0]);
+   for (unsigned I = 1; I != 22; ++I) {
+      EXPECT_STREQ("-x", Argv[I]);
+   }
+   EXPECT_STREQ(SelfRef.getCStr(), Argv[22]);
+   for (unsigned I = 23; I != 44; ++I) {
+      EXPECT_STREQ("-y", Argv[I]);
+   }
+   EXPECT_STREQ("-z", Argv[44]);
+   EXPECT_STREQ("@does-not-exist", Argv[45]);
+
+   fs::remove(SelfFileName);
+   fs::remove(TestDir);
+}
+
+TEST(CommandLineTest, testResponseFileCache)
+{
+   SmallString<128> TestDir;
+   std::error_code EC =
+         fs::create_unique_directory("unittest", TestDir);
+   EXPECT_TRUE(!EC);
+   SmallString<128> CacheDir;
+   fs::path::append(CacheDir, TestDir, "cache");
+   EC = fs::create_directory(CacheDir);
+   EXPECT_TRUE(!EC);
+   cmd::set_response_file_cache_directory(CacheDir);
+
+   SmallString<128> FileName;
+   fs::path::append(FileName, TestDir, "resp");
+   SmallString<128> FileRef;
+   FileRef.append(1, '@');
+   FileRef.append(FileName.getCStr());
+   auto Expand = [&FileRef](SmallVectorImpl<const char *> &Argv) {
+      BumpPtrAllocator A;
+      StringSaver Saver(A);
+      Argv.clear();
+      Argv.append({"test/test", FileRef.getCStr(), "-last"});
+      EXPECT_TRUE(cmd::expand_response_files(
+                     Saver, cmd::tokenize_gnu_command_line, Argv, true, false));
+      std::string Joined;
+      for (const char *Arg : Argv) {
+         Joined += Arg ? Arg : "<eol>";
+         Joined += ' ';
+      }
+      return Joined;
+   };
+   auto CountCacheFiles = [&CacheDir, &EC]() {
+      unsigned Count = 0;
+      for (fs::DirectoryIterator I(CacheDir, EC), E; I != E && !EC; I.increment(EC)) {
+         ++Count;
+      }
+      return Count;
+   };
+
+   std::ofstream File(FileName.getCStr());
+   File << "-a \"b c\"\n-d";
+   File.close();
+   SmallVector<const char *, 8> Argv;
+   EXPECT_EQ("test/test -a b c -d <eol> -last ", Expand(Argv));
+   EXPECT_EQ(1u, CountCacheFiles());
+   // The second expansion reads the cache, with the same result.
+   EXPECT_EQ("test/test -a b c -d <eol> -last ", Expand(Argv));
+   EXPECT_EQ(1u, CountCacheFiles());
+
+   // A file of the same size rewritten at once is told apart by its
+   // contents.
+   File.open(FileName.getCStr());
+   File << "-x \"y z\"\n-w";
+   File.close();
+   EXPECT_EQ("test/test -x y z -w <eol> -last ", Expand(Argv));
+   EXPECT_EQ(1u, CountCacheFiles());
+
+   // Damaged cache files are not used.
+   for (fs::DirectoryIterator I(CacheDir, EC), E; I != E && !EC; I.increment(EC)) {
+      std::ofstream Cache(I->getPath(), std::ios::binary | std::ios::in | std::ios::out);
+      Cache.seekp(-1, std::ios::end);
+      Cache << 'x';
+   }
+   EXPECT_EQ("test/test -x y z -w <eol> -last ", Expand(Argv));
+
+   cmd::set_response_file_cache_directory("");
+   for (fs::DirectoryIterator I(CacheDir, EC), E; I != E && !EC; I.increment(EC)) {
+      fs::remove(I->getPath());
+   }
+   fs::remove(CacheDir);
+   fs::remove(FileName);
+   fs::remove(TestDir);
+}
+
 TEST(CommandLineTest, SetDefautValue) {
    cmd::reset_command_line_parser();
 
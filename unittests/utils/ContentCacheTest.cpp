@@ -0,0 +1,198 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/ContentCache.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/LockFileMgr.h"
+#include "polar/utils/Path.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+namespace {
+
+class ContentCacheTest : public ::testing::Test
+{
+protected:
+   SmallString<128> TestDirectory;
+
+   void SetUp() override
+   {
+      ASSERT_FALSE(fs::create_unique_directory("content-cache-test", TestDirectory));
+   }
+
+   void TearDown() override
+   {
+      ASSERT_FALSE(fs::remove_directories(TestDirectory.getStr()));
+   }
+
+   std::unique_ptr<ContentCache> createCache(CachePruningPolicy Policy = CachePruningPolicy())
+   {
+      return cant_fail(ContentCache::create((TestDirectory + "/cache").getStr(), Policy));
+   }
+};
+
+TEST_F(ContentCacheTest, testPutAndGet)
+{
+   std::unique_ptr<ContentCache> Cache = createCache();
+   EXPECT_EQ(nullptr, Cache->get("key"));
+   EXPECT_FALSE((bool)Cache->put("key", "value"));
+   std::unique_ptr<MemoryBuffer> Buffer = Cache->get("key");
+   ASSERT_NE(nullptr, Buffer);
+   EXPECT_EQ("value", Buffer->getBuffer());
+
+   // Entries are replaced whole, and buffers handed out before stay valid.
+   std::string Large(1 << 16, 'x');
+   EXPECT_FALSE((bool)Cache->put("key", Large));
+   EXPECT_EQ("value", Buffer->getBuffer());
+   Buffer = Cache->get("key");
+   ASSERT_NE(nullptr, Buffer);
+   EXPECT_EQ(Large, Buffer->getBuffer());
+
+   EXPECT_FALSE((bool)Cache->put("empty", ""));
+   Buffer = Cache->get("empty");
+   ASSERT_NE(nullptr, Buffer);
+   EXPECT_EQ(0u, Buffer->getBufferSize());
+
+   ContentCache::Counters Counters = Cache->getCounters();
+   EXPECT_EQ(3u, Counters.m_hits);
+   EXPECT_EQ(1u, Counters.m_misses);
+   EXPECT_EQ(5u + Large.size(), Counters.m_bytesRead);
+   EXPECT_EQ(5u + Large.size(), Counters.m_bytesWritten);
+}
+
+TEST_F(ContentCacheTest, testLayout)
+{
+   std::unique_ptr<ContentCache> Cache = createCache();
+   std::string Path = Cache->getEntryPath("key");
+   StringRef Filename = fs::path::filename(Path);
+   StringRef Shard = fs::path::filename(fs::path::parent_path(Path));
+   EXPECT_TRUE(Filename.startsWith("polarcache-"));
+   EXPECT_EQ(strlen("polarcache-") + 64, Filename.size());
+   EXPECT_EQ(Filename.substr(strlen("polarcache-"), 2), Shard);
+   EXPECT_EQ(Cache->getDirectory(), fs::path::parent_path(fs::path::parent_path(Path)));
+   EXPECT_NE(Path, Cache->getEntryPath("other key"));
+
+   EXPECT_FALSE(fs::exists(Path));
+   EXPECT_FALSE((bool)Cache->put("key", "value"));
+   EXPECT_TRUE(fs::exists(Path));
+}
+
+TEST_F(ContentCacheTest, testWriter)
+{
+   std::unique_ptr<ContentCache> Cache = createCache();
+   EXPECT_FALSE((bool)Cache->put("key", 4, [](uint8_t *Buffer) {
+      for (uint8_t I = 0; I != 4; ++I) {
+         Buffer[I] = 'a' + I;
+      }
+   }));
+   std::unique_ptr<MemoryBuffer> Buffer = Cache->get("key");
+   ASSERT_NE(nullptr, Buffer);
+   EXPECT_EQ("abcd", Buffer->getBuffer());
+}
+
+TEST_F(ContentCacheTest, testPrune)
+{
+   CachePruningPolicy Policy;
+   Policy.m_interval = std::chrono::seconds(0);
+   Policy.m_maxSizeFiles = 2;
+   std::unique_ptr<ContentCache> Cache = createCache(Policy);
+   for (StringRef Key : {"a", "b", "c", "d"}) {
+      EXPECT_FALSE((bool)Cache->put(Key, Key));
+   }
+   // A zero interval does not prune on put.
+   for (StringRef Key : {"a", "b", "c", "d"}) {
+      EXPECT_TRUE(fs::exists(Cache->getEntryPath(Key)));
+   }
+   EXPECT_TRUE(Cache->prune());
+   unsigned NumLeft = 0;
+   for (StringRef Key : {"a", "b", "c", "d"}) {
+      NumLeft += fs::exists(Cache->getEntryPath(Key));
+   }
+   EXPECT_EQ(2u, NumLeft);
+}
+
+TEST_F(ContentCacheTest, testPruneLockedIndex)
+{
+   CachePruningPolicy Policy;
+   Policy.m_interval = std::chrono::seconds(0);
+   Policy.m_maxSizeFiles = 1;
+   std::unique_ptr<ContentCache> Cache = createCache(Policy);
+   EXPECT_FALSE((bool)Cache->put("a", "a"));
+   EXPECT_FALSE((bool)Cache->put("b", "b"));
+   {
+      // Somebody else is pruning.
+      LockFileManager Locker((TestDirectory + "/cache/polarcache.index").getStr());
+      ASSERT_EQ(LockFileManager::LFS_Owned, Locker.getState());
+      EXPECT_FALSE(Cache->prune());
+   }
+   EXPECT_TRUE(fs::exists(Cache->getEntryPath("a")));
+   EXPECT_TRUE(Cache->prune());
+   EXPECT_NE(fs::exists(Cache->getEntryPath("a")), fs::exists(Cache->getEntryPath("b")));
+}
+
+TEST_F(ContentCacheTest, testBatchedHits)
+{
+   std::string IndexPath = (TestDirectory + "/cache/polarcache.index").getStr();
+   uint64_t Size = 0;
+   std::unique_ptr<ContentCache> Cache = createCache();
+   EXPECT_FALSE((bool)Cache->put("key", "value"));
+   ASSERT_FALSE(fs::file_size(IndexPath, Size));
+   uint64_t SizeAfterPut = Size;
+   // Hits reach the index by batches, not one by one.
+   EXPECT_NE(nullptr, Cache->get("key"));
+   ASSERT_FALSE(fs::file_size(IndexPath, Size));
+   EXPECT_EQ(SizeAfterPut, Size);
+   for (unsigned I = 0; I != 63; ++I) {
+      EXPECT_NE(nullptr, Cache->get("key"));
+   }
+   ASSERT_FALSE(fs::file_size(IndexPath, Size));
+   EXPECT_LT(SizeAfterPut, Size);
+   uint64_t SizeAfterBatch = Size;
+   // What is left goes when the cache does.
+   EXPECT_NE(nullptr, Cache->get("key"));
+   Cache.reset();
+   ASSERT_FALSE(fs::file_size(IndexPath, Size));
+   EXPECT_LT(SizeAfterBatch, Size);
+}
+
+TEST_F(ContentCacheTest, testConcurrentCaches)
+{
+   // Several caches over one directory stand for several processes.
+   std::vector<std::thread> Threads;
+   for (unsigned T = 0; T != 4; ++T) {
+      Threads.emplace_back([&, T] {
+         std::unique_ptr<ContentCache> Cache = createCache();
+         for (unsigned I = 0; I != 50; ++I) {
+            std::string Key = "key" + std::to_string(I % 10);
+            std::string Value = Key + "-value";
+            if (I % 3 == T % 3) {
+               EXPECT_FALSE((bool)Cache->put(Key, Value));
+            }
+            if (std::unique_ptr<MemoryBuffer> Buffer = Cache->get(Key)) {
+               EXPECT_EQ(Value, Buffer->getBuffer());
+            }
+         }
+      });
+   }
+   for (std::thread &Thread : Threads) {
+      Thread.join();
+   }
+}
+
+} // anonymous namespace
@@ -0,0 +1,159 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/DirectoryWalker.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/RawOutStream.h"
+#include "gtest/gtest.h"
+
+#include <map>
+#include <string>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+namespace {
+
+class DirectoryWalkerTest : public ::testing::Test
+{
+protected:
+   SmallString<128> TestDirectory;
+
+   void SetUp() override
+   {
+      ASSERT_FALSE(fs::create_unique_directory("directory-walker-test", TestDirectory));
+      for (StringRef Dir : {"a/aa/aaa", "a/ab", "b", "skip/deep"}) {
+         ASSERT_FALSE(fs::create_directories(Twine(TestDirectory) + "/" + Dir));
+      }
+      for (StringRef File : {"top.cpp", "a/one.h", "a/aa/two.cpp", "a/aa/aaa/three.cpp",
+                             "a/ab/four.txt", "b/five.cpp", "skip/six.cpp",
+                             "skip/deep/seven.cpp"}) {
+         std::error_code EC;
+         RawFdOutStream OS(Twine(TestDirectory + "/" + File).getStr(), EC, fs::F_None);
+         ASSERT_FALSE(EC);
+         OS << File;
+      }
+   }
+
+   void TearDown() override
+   {
+      ASSERT_FALSE(fs::remove_directories(TestDirectory.getStr()));
+   }
+
+   // Relative path to type and level of every entry reported.
+   std::map<std::string, std::pair<fs::FileType, unsigned>>
+   walk(const fs::WalkOptions &Options)
+   {
+      std::map<std::string, std::pair<fs::FileType, unsigned>> Entries;
+      std::error_code EC = fs::walk_directory_tree(
+               TestDirectory, Options, [&](const fs::WalkEntry &Entry) {
+         EXPECT_EQ(Entry.getPath(), (TestDirectory + "/" + Entry.getRelativePath()).getStr());
+         EXPECT_TRUE(StringRef(Entry.getPath()).endsWith(Entry.getFilename()));
+         EXPECT_TRUE(Entries.emplace(Entry.getRelativePath().getStr(),
+                                     std::make_pair(Entry.getType(), Entry.getLevel())).second);
+      });
+      EXPECT_FALSE(EC);
+      return Entries;
+   }
+};
+
+TEST_F(DirectoryWalkerTest, testMatchesRecursiveDirectoryIterator)
+{
+   std::map<std::string, std::pair<fs::FileType, unsigned>> Expected;
+   std::error_code EC;
+   for (fs::RecursiveDirectoryIterator I(TestDirectory, EC), E; I != E; I.increment(EC)) {
+      ASSERT_FALSE(EC);
+      StringRef Relative = StringRef(I->getPath()).substr(TestDirectory.size() + 1);
+      Expected[Relative.getStr()] = std::make_pair(I->getStatus()->getType(),
+                                                   unsigned(I.getLevel()));
+   }
+   EXPECT_EQ(15u, Expected.size());
+   for (bool Parallel : {false, true}) {
+      fs::WalkOptions Options;
+      Options.m_parallel = Parallel;
+      EXPECT_EQ(Expected, walk(Options));
+   }
+}
+
+TEST_F(DirectoryWalkerTest, testFilters)
+{
+   GlobSet Include;
+   EXPECT_FALSE((bool)Include.add("*.cpp"));
+   GlobSet Exclude;
+   EXPECT_FALSE((bool)Exclude.add("skip"));
+   EXPECT_FALSE((bool)Exclude.add("*/aaa"));
+   fs::WalkOptions Options;
+   Options.m_include = &Include;
+   Options.m_exclude = &Exclude;
+   std::map<std::string, std::pair<fs::FileType, unsigned>> Entries = walk(Options);
+   std::vector<std::string> Paths;
+   for (const auto &Entry : Entries) {
+      Paths.push_back(Entry.first);
+      EXPECT_EQ(fs::FileType::regular_file, Entry.second.first);
+   }
+   EXPECT_EQ((std::vector<std::string>{"a/aa/two.cpp", "b/five.cpp", "top.cpp"}), Paths);
+}
+
+TEST_F(DirectoryWalkerTest, testMaxLevelAndStatus)
+{
+   fs::WalkOptions Options;
+   Options.m_maxLevel = 1;
+   Options.m_needStatus = true;
+   unsigned NumEntries = 0;
+   std::error_code EC = fs::walk_directory_tree(
+            TestDirectory, Options, [&](const fs::WalkEntry &Entry) {
+      ++NumEntries;
+      EXPECT_LE(Entry.getLevel(), 1u);
+      ASSERT_NE(nullptr, Entry.getStatus());
+      EXPECT_EQ(Entry.getType(), Entry.getStatus()->getType());
+      if (Entry.getType() == fs::FileType::regular_file) {
+         // Every file holds its relative path.
+         EXPECT_EQ(Entry.getRelativePath().size(), Entry.getStatus()->getSize());
+      }
+   });
+   EXPECT_FALSE(EC);
+   // top.cpp, a, b, skip, then one.h, aa, ab, five.cpp, six.cpp, deep.
+   EXPECT_EQ(10u, NumEntries);
+}
+
+#ifdef POLAR_ON_UNIX
+TEST_F(DirectoryWalkerTest, testSymlinkCycle)
+{
+   ASSERT_FALSE(fs::create_link(TestDirectory, Twine(TestDirectory) + "/a/ab/loop"));
+   fs::WalkOptions Options;
+   std::map<std::string, std::pair<fs::FileType, unsigned>> Entries = walk(Options);
+   EXPECT_EQ(fs::FileType::symlink_file, Entries["a/ab/loop"].first);
+   EXPECT_EQ(16u, Entries.size());
+
+   Options.m_followSymlinks = true;
+   Entries = walk(Options);
+   // The link is reported as the directory it leads to, which is not walked
+   // a second time.
+   EXPECT_EQ(fs::FileType::directory_file, Entries["a/ab/loop"].first);
+   EXPECT_EQ(16u, Entries.size());
+   ASSERT_FALSE(fs::remove(Twine(TestDirectory) + "/a/ab/loop"));
+}
+#endif
+
+TEST_F(DirectoryWalkerTest, testMissingRoot)
+{
+   fs::WalkOptions Options;
+   unsigned NumEntries = 0;
+   std::error_code EC = fs::walk_directory_tree(
+            Twine(TestDirectory) + "/missing", Options,
+            [&](const fs::WalkEntry &) { ++NumEntries; });
+   EXPECT_EQ(std::errc::no_such_file_or_directory, EC);
+   EXPECT_EQ(0u, NumEntries);
+}
+
+} // anonymous namespace
@@ -0,0 +1,176 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/DiskBucketedHashTable.h"
+#include "polar/basic/adt/SmallString.h"
+#include "gtest/gtest.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::utils;
+using namespace polar::basic;
+
+namespace {
+
+/// Maps uint32_t keys to their decimal representation. \c HashMask lets tests
+/// force collisions.
+template <uint32_t HashMask>
+class TestInfo
+{
+public:
+   typedef uint32_t key_type;
+   typedef const uint32_t &key_type_ref;
+   typedef std::string data_type;
+   typedef const std::string &data_type_ref;
+   typedef uint32_t internal_key_type;
+   typedef uint32_t external_key_type;
+   typedef uint32_t hash_value_type;
+   typedef uint32_t OffsetType;
+
+   static hash_value_type computeHash(const uint32_t &key)
+   {
+      return (key * 2654435761u) & HashMask;
+   }
+
+   static bool equalKey(const uint32_t &lhs, const uint32_t &rhs)
+   {
+      return lhs == rhs;
+   }
+
+   static const uint32_t &getInternalKey(const uint32_t &key)
+   {
+      return key;
+   }
+
+   static std::pair<OffsetType, OffsetType>
+   emitKeyDataLength(RawOutStream &outstream, key_type_ref, data_type_ref data)
+   {
+      endian::Writer<Endianness::Little>(outstream).write<uint16_t>(data.size());
+      return std::make_pair(OffsetType(sizeof(uint32_t)), OffsetType(data.size()));
+   }
+
+   static void emitKey(RawOutStream &outstream, key_type_ref key, OffsetType)
+   {
+      endian::Writer<Endianness::Little>(outstream).write<uint32_t>(key);
+   }
+
+   static void emitData(RawOutStream &outstream, key_type_ref, data_type_ref data, OffsetType)
+   {
+      outstream << data;
+   }
+
+   static std::pair<OffsetType, OffsetType> readKeyDataLength(const unsigned char *&buffer)
+   {
+      OffsetType dataLength = endian::read_next<uint16_t, Endianness::Little, UNALIGNED>(buffer);
+      return std::make_pair(OffsetType(sizeof(uint32_t)), dataLength);
+   }
+
+   static uint32_t readKey(const unsigned char *buffer, OffsetType)
+   {
+      return endian::read32le(buffer);
+   }
+
+   static std::string readData(const uint32_t &, const unsigned char *buffer, OffsetType length)
+   {
+      return std::string(reinterpret_cast<const char *>(buffer), length);
+   }
+};
+
+/// Builds a table of \p count keys behind a short header, copies it to a page
+/// aligned buffer as mmap would, and checks every key and some missing ones.
+template <uint32_t HashMask>
+void check_table(uint32_t count)
+{
+   typedef TestInfo<HashMask> Info;
+   typedef utils::internal::BucketedHashTableLayout<uint32_t> Layout;
+   DiskBucketedHashTableGenerator<Info> generator;
+   for (uint32_t key = 0; key < count; ++key) {
+      generator.insert(key * 2, std::to_string(key));
+   }
+   EXPECT_EQ(count, generator.getNumEntries());
+   SmallString<0> storage;
+   RawSvectorOutStream outstream(storage);
+   outstream << "header";
+   Expected<uint32_t> tableOffset = generator.emit(outstream);
+   ASSERT_TRUE(bool(tableOffset));
+
+   std::vector<unsigned char> memory(storage.size() + Layout::PAGE_SIZE);
+   unsigned char *base = memory.data() + offset_to_alignment(
+            reinterpret_cast<uintptr_t>(memory.data()), Layout::PAGE_SIZE);
+   std::memcpy(base, storage.getData(), storage.size());
+
+   std::unique_ptr<DiskBucketedHashTable<Info>> table(
+            DiskBucketedHashTable<Info>::create(base + *tableOffset, base));
+   EXPECT_EQ(count, table->getNumEntries());
+   EXPECT_EQ(0u, (table->getBuckets() - base) %
+             Layout::getBucketsAlignment(table->getNumBuckets()));
+   EXPECT_EQ(storage.size(), size_t(table->getBuckets() - base) +
+             table->getNumBuckets() * Layout::BUCKET_SIZE);
+   for (uint32_t key = 0; key < count; ++key) {
+      auto iter = table->find(key * 2);
+      ASSERT_TRUE(iter != table->end()) << key;
+      EXPECT_EQ(std::to_string(key), *iter);
+      EXPECT_TRUE(table->find(key * 2 + 1) == table->end()) << key;
+   }
+   EXPECT_FALSE(table->adviseBuckets(sys::Memory::MA_WILL_NEED));
+}
+
+TEST(DiskBucketedHashTableTest, testLookup)
+{
+   for (uint32_t count : {0u, 1u, 7u, 10u, 11u, 100u, 5000u, 100000u}) {
+      check_table<0xffffffff>(count);
+   }
+}
+
+TEST(DiskBucketedHashTableTest, testWindowsStayInOnePage)
+{
+   typedef utils::internal::BucketedHashTableLayout<uint32_t> Layout;
+   const uint64_t numBuckets = 1024;
+   for (uint64_t home = 0; home < numBuckets; home += 37) {
+      uint64_t window = Layout::getProbeBucket(home, 0, numBuckets) / Layout::BUCKETS_PER_PAGE;
+      EXPECT_EQ(home, Layout::getProbeBucket(home, 0, numBuckets));
+      for (uint64_t probe = 1; probe < Layout::BUCKETS_PER_PAGE; ++probe) {
+         EXPECT_EQ(window, Layout::getProbeBucket(home, probe, numBuckets) / Layout::BUCKETS_PER_PAGE);
+      }
+   }
+}
+
+TEST(DiskBucketedHashTableTest, testCollidingHashes)
+{
+   // Only eight distinct hashes: entries pile up in a few buckets, and the
+   // table grows until they fit in their windows.
+   check_table<0x70000000>(2000);
+   // A single hash value for everything, just filling one window.
+   typedef utils::internal::BucketedHashTableLayout<uint32_t> Layout;
+   check_table<0>(Layout::BUCKETS_PER_PAGE * Layout::SLOTS);
+}
+
+TEST(DiskBucketedHashTableTest, testTooManyCollidingHashes)
+{
+   // One more entry with the same hash than a window holds can never fit.
+   typedef utils::internal::BucketedHashTableLayout<uint32_t> Layout;
+   DiskBucketedHashTableGenerator<TestInfo<0>> generator;
+   for (uint32_t key = 0; key <= Layout::BUCKETS_PER_PAGE * Layout::SLOTS; ++key) {
+      generator.insert(key, std::to_string(key));
+   }
+   SmallString<0> storage;
+   RawSvectorOutStream outstream(storage);
+   outstream << "header";
+   Expected<uint32_t> tableOffset = generator.emit(outstream);
+   ASSERT_FALSE(bool(tableOffset));
+   EXPECT_EQ("too many colliding hashes for a bucketed hash table",
+             to_string(tableOffset.takeError()));
+   EXPECT_EQ(6u, storage.size());
+}
+
+} // anonymous namespace
@@ -0,0 +1,257 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/DiskHashTable.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/utils/FileOutputBuffer.h"
+#include "polar/utils/FileSystem.h"
+#include "gtest/gtest.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace polar;
+using namespace polar::utils;
+using namespace polar::basic;
+
+namespace {
+
+/// Maps uint32_t keys to strings. The hash is deliberately weak so that
+/// buckets hold several entries.
+class TestInfo
+{
+public:
+   typedef uint32_t key_type;
+   typedef const uint32_t &key_type_ref;
+   typedef std::string data_type;
+   typedef const std::string &data_type_ref;
+   typedef uint32_t internal_key_type;
+   typedef uint32_t external_key_type;
+   typedef uint32_t hash_value_type;
+   typedef uint32_t OffsetType;
+
+   static hash_value_type computeHash(const uint32_t &key)
+   {
+      return (key * 2654435761u) & 0xfff0ffff;
+   }
+
+   static bool equalKey(const uint32_t &lhs, const uint32_t &rhs)
+   {
+      return lhs == rhs;
+   }
+
+   static const uint32_t &getInternalKey(const uint32_t &key)
+   {
+      return key;
+   }
+
+   static uint32_t getExternalKey(const uint32_t &key)
+   {
+      return key;
+   }
+
+   static std::pair<OffsetType, OffsetType>
+   emitKeyDataLength(RawOutStream &outstream, key_type_ref, data_type_ref data)
+   {
+      endian::Writer<Endianness::Little> le(outstream);
+      le.write<uint16_t>(sizeof(uint32_t));
+      le.write<uint16_t>(data.size());
+      return std::make_pair(OffsetType(sizeof(uint32_t)), OffsetType(data.size()));
+   }
+
+   static void emitKey(RawOutStream &outstream, key_type_ref key, OffsetType)
+   {
+      endian::Writer<Endianness::Little>(outstream).write<uint32_t>(key);
+   }
+
+   static void emitData(RawOutStream &outstream, key_type_ref, data_type_ref data, OffsetType)
+   {
+      outstream << data;
+   }
+
+   static std::pair<OffsetType, OffsetType> readKeyDataLength(const unsigned char *&buffer)
+   {
+      OffsetType keyLength = endian::read_next<uint16_t, Endianness::Little, UNALIGNED>(buffer);
+      OffsetType dataLength = endian::read_next<uint16_t, Endianness::Little, UNALIGNED>(buffer);
+      return std::make_pair(keyLength, dataLength);
+   }
+
+   static uint32_t readKey(const unsigned char *buffer, OffsetType)
+   {
+      return endian::read32le(buffer);
+   }
+
+   static std::string readData(const uint32_t &, const unsigned char *buffer, OffsetType length)
+   {
+      return std::string(reinterpret_cast<const char *>(buffer), length);
+   }
+};
+
+typedef std::vector<std::pair<uint32_t, std::string>> EntryList;
+
+EntryList make_entries(uint32_t count)
+{
+   EntryList entries;
+   for (uint32_t i = 0; i < count; ++i) {
+      entries.emplace_back(i * 3 + 1, std::string(i % 13, 'a' + i % 26));
+   }
+   return entries;
+}
+
+class DiskHashTableTest : public ::testing::Test
+{
+protected:
+   void SetUp() override
+   {
+      ASSERT_FALSE(fs::create_unique_directory("DiskHashTable-test", m_testDirectory));
+   }
+
+   void TearDown() override
+   {
+      ASSERT_FALSE(fs::remove_directories(m_testDirectory.getStr()));
+   }
+
+   /// Lays out and emits \p generator behind a 13 byte header, then looks
+   /// every entry back up.
+   void checkGenerated(ParallelDiskChainedHashTableGenerator<TestInfo> &generator,
+                       const EntryList &entries)
+   {
+      const uint64_t headerSize = 13;
+      Expected<uint64_t> end = generator.layout(headerSize);
+      ASSERT_TRUE(bool(end));
+      SmallString<128> path(m_testDirectory);
+      path.append("/table");
+      Expected<std::unique_ptr<FileOutputBuffer>> buffer = FileOutputBuffer::create(path, *end);
+      ASSERT_TRUE(bool(buffer));
+      std::memset((*buffer)->getBufferStart(), 0x5a, headerSize);
+      Expected<uint32_t> tableOffset = generator.emit(**buffer);
+      ASSERT_TRUE(bool(tableOffset));
+      const unsigned char *base = (*buffer)->getBufferStart();
+      EXPECT_EQ(0x5a, base[headerSize - 1]);
+      checkLookups(base + *tableOffset, base, entries);
+   }
+
+   void checkLookups(const unsigned char *buckets, const unsigned char *base,
+                     const EntryList &entries)
+   {
+      std::unique_ptr<DiskChainedHashTable<TestInfo>> table(
+               DiskChainedHashTable<TestInfo>::create(buckets, base));
+      EXPECT_EQ(entries.size(), table->getNumEntries());
+      for (const auto &entry : entries) {
+         auto iter = table->find(entry.first);
+         ASSERT_TRUE(iter != table->end()) << entry.first;
+         EXPECT_EQ(entry.second, *iter);
+      }
+      for (uint32_t key = 0; key < 300; key += 3) {
+         EXPECT_TRUE(table->find(key) == table->end());
+      }
+   }
+
+   SmallString<128> m_testDirectory;
+};
+
+TEST_F(DiskHashTableTest, testSerialGenerator)
+{
+   EntryList entries = make_entries(1000);
+   DiskChainedHashTableGenerator<TestInfo> generator;
+   for (const auto &entry : entries) {
+      generator.insert(entry.first, entry.second);
+   }
+   SmallString<0> storage;
+   RawSvectorOutStream outstream(storage);
+   outstream << "header";
+   uint32_t tableOffset = generator.emit(outstream);
+   const unsigned char *base = reinterpret_cast<const unsigned char *>(storage.getData());
+   checkLookups(base + tableOffset, base, entries);
+}
+
+TEST_F(DiskHashTableTest, testFindBatch)
+{
+   EntryList entries = make_entries(3000);
+   DiskChainedHashTableGenerator<TestInfo> generator;
+   for (const auto &entry : entries) {
+      generator.insert(entry.first, entry.second);
+   }
+   SmallString<0> storage;
+   RawSvectorOutStream outstream(storage);
+   outstream << "header";
+   uint32_t tableOffset = generator.emit(outstream);
+   const unsigned char *base = reinterpret_cast<const unsigned char *>(storage.getData());
+
+   // Every stored key, each followed by a missing one.
+   std::vector<uint32_t> keys;
+   for (const auto &entry : entries) {
+      keys.push_back(entry.first);
+      keys.push_back(entry.first + 1);
+   }
+   auto checkBatch = [&](const std::vector<DiskChainedHashTable<TestInfo>::iterator> &results,
+         const DiskChainedHashTable<TestInfo>::iterator &end) {
+      ASSERT_EQ(keys.size(), results.size());
+      for (size_t i = 0; i < entries.size(); ++i) {
+         ASSERT_TRUE(results[2 * i] != end) << entries[i].first;
+         EXPECT_EQ(entries[i].second, *results[2 * i]);
+         EXPECT_TRUE(results[2 * i + 1] == end);
+      }
+   };
+
+   std::unique_ptr<DiskChainedHashTable<TestInfo>> table(
+            DiskChainedHashTable<TestInfo>::create(base + tableOffset, base));
+   checkBatch(table->findBatch(keys), table->end());
+   checkBatch(table->findBatch(keys, /*adviseWillNeed=*/true), table->end());
+   EXPECT_TRUE(table->findBatch(ArrayRef<uint32_t>()).empty());
+
+   std::unique_ptr<OnDiskIterableChainedHashTable<TestInfo>> iterable(
+            OnDiskIterableChainedHashTable<TestInfo>::create(base + tableOffset, base + 6, base));
+   checkBatch(iterable->findBatch(keys, /*adviseWillNeed=*/true), iterable->end());
+   size_t numKeys = 0;
+   for (uint32_t key : iterable->getKeys()) {
+      EXPECT_EQ(1u, key % 3);
+      ++numKeys;
+   }
+   EXPECT_EQ(entries.size(), numKeys);
+   size_t dataLength = 0;
+   for (const std::string &data : iterable->getData()) {
+      dataLength += data.size();
+   }
+   size_t expectedLength = 0;
+   for (const auto &entry : entries) {
+      expectedLength += entry.second.size();
+   }
+   EXPECT_EQ(expectedLength, dataLength);
+}
+
+TEST_F(DiskHashTableTest, testParallelGenerator)
+{
+   for (uint32_t count : {0u, 1u, 2u, 3u, 100u, 20000u}) {
+      EntryList entries = make_entries(count);
+      ParallelDiskChainedHashTableGenerator<TestInfo> generator;
+      generator.insertRange(entries);
+      EXPECT_EQ(count, generator.getNumEntries());
+      EXPECT_EQ(0u, generator.getNumRuns());
+      checkGenerated(generator, entries);
+   }
+}
+
+TEST_F(DiskHashTableTest, testParallelGeneratorSpills)
+{
+   EntryList entries = make_entries(50000);
+   ParallelDiskChainedHashTableGenerator<TestInfo> generator(64 << 10);
+   for (size_t i = 0; i < 1000; ++i) {
+      generator.insert(entries[i].first, entries[i].second);
+   }
+   generator.insertRange(make_range(entries.begin() + 1000, entries.end()));
+   EXPECT_EQ(entries.size(), generator.getNumEntries());
+   EXPECT_LT(0u, generator.getNumRuns());
+   checkGenerated(generator, entries);
+}
+
+} // anonymous namespace
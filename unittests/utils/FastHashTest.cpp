@@ -10,7 +10,9 @@
 // Created by softboy on 2018/07/10.
 
 #include "polar/utils/FastHash.h"
+#include "polar/basic/adt/Twine.h"
 #include "gtest/gtest.h"
+#include <vector>
 
 using namespace polar::utils;
 
@@ -24,4 +26,91 @@ TEST(FastHashTest, testBasic)
              fast_hash64("0123456789abcdefghijklmnopqrstuvwxyz"));
 }
 
+TEST(FastHashTest, testXxh3)
+{
+   EXPECT_EQ(0x2d06800538d394c2U, xxh3_hash64(""));
+   EXPECT_EQ(0xab6e5f64077e7d8aU, xxh3_hash64("foo"));
+   EXPECT_EQ(0xd463c860a032d362U, xxh3_hash64("bar"));
+   EXPECT_EQ(0xffb92a87c6306d55U,
+             xxh3_hash64("0123456789abcdefghijklmnopqrstuvwxyz"));
+   EXPECT_EQ(0xd33da54e20ebf99eU, xxh3_hash64("foo", 42));
+
+   Xxh3Hash128 hash = xxh3_hash128("0123456789abcdefghijklmnopqrstuvwxyz");
+   EXPECT_EQ(0x1072b74f1e5bf3deU, hash.m_low64);
+   EXPECT_EQ(0xb62238c22b8a25a8U, hash.m_high64);
+   hash = xxh3_hash128("");
+   EXPECT_EQ(0x6001c324468d497fU, hash.m_low64);
+   EXPECT_EQ(0x99aa06d3014798d8U, hash.m_high64);
+
+   std::vector<uint8_t> data(4096);
+   for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = i % 251;
+   }
+   EXPECT_EQ(0x7135ffa504f1bc71U, xxh3_hash64(data));
+   EXPECT_EQ(0x993219a67ae6d3fbU, xxh3_hash64(data, 42));
+   hash = xxh3_hash128(data);
+   EXPECT_EQ(0x7135ffa504f1bc71U, hash.m_low64);
+   EXPECT_EQ(0xe12cd72144990fe5U, hash.m_high64);
+}
+
+TEST(FastHashTest, testXxh3Kernels)
+{
+   using internal::Xxh3Implementation;
+   std::vector<uint8_t> data(4096);
+   for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = i % 251;
+   }
+   // 4096 bytes span several blocks, so both accumulation and scrambling run.
+   for (Xxh3Implementation impl : {Xxh3Implementation::Scalar, Xxh3Implementation::Sse2,
+        Xxh3Implementation::Avx2, Xxh3Implementation::Host}) {
+      if (!internal::set_xxh3_implementation(impl)) {
+         continue;
+      }
+      SCOPED_TRACE(int(impl));
+      EXPECT_EQ(0x7135ffa504f1bc71U, xxh3_hash64(data));
+      EXPECT_EQ(0x993219a67ae6d3fbU, xxh3_hash64(data, 42));
+      Xxh3Hash128 hash = xxh3_hash128(data);
+      EXPECT_EQ(0x7135ffa504f1bc71U, hash.m_low64);
+      EXPECT_EQ(0xe12cd72144990fe5U, hash.m_high64);
+
+      Xxh3Hasher hasher;
+      for (size_t offset = 0; offset < data.size(); offset += 300) {
+         hasher.update(ArrayRef<uint8_t>(data).slice(
+                          offset, std::min<size_t>(300, data.size() - offset)));
+      }
+      EXPECT_EQ(0x7135ffa504f1bc71U, hasher.final());
+   }
+}
+
+TEST(FastHashTest, testXxh3Streaming)
+{
+   std::vector<uint8_t> data(10000);
+   for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = (i * 7) % 256;
+   }
+   for (size_t length : {0, 3, 16, 17, 128, 129, 240, 241, 256, 257, 1024, 1025,
+        10000}) {
+      ArrayRef<uint8_t> input(data.data(), length);
+      for (uint64_t seed : {uint64_t(0), uint64_t(42)}) {
+         for (size_t chunk : {1, 7, 64, 300}) {
+            Xxh3Hasher hasher(seed);
+            for (size_t offset = 0; offset < length; offset += chunk) {
+               hasher.update(input.slice(offset, std::min(chunk, length - offset)));
+            }
+            EXPECT_EQ(xxh3_hash64(input, seed), hasher.final());
+            EXPECT_EQ(xxh3_hash128(input, seed), hasher.final128());
+            EXPECT_EQ(length, hasher.getLength());
+         }
+      }
+   }
+
+   Xxh3Hasher hasher;
+   std::string prefix = "stream";
+   hasher.update(Twine(prefix) + "ed " + Twine(128) + " bits");
+   EXPECT_EQ(xxh3_hash64("streamed 128 bits"), hasher.final());
+   // final() leaves the state usable.
+   hasher.update(StringRef("!"));
+   EXPECT_EQ(xxh3_hash64("streamed 128 bits!"), hasher.final());
+}
+
 } // anonymous namespace
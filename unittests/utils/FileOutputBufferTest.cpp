@@ -13,6 +13,9 @@
 #include "polar/utils/ErrorCode.h"
 #include "polar/utils/ErrorHandling.h"
 #include "polar/utils/FileSystem.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "polar/utils/Parallel.h"
+#include "polar/utils/Process.h"
 #include "polar/utils/Path.h"
 #include "polar/utils/RawOutStream.h"
 #include "gtest/gtest.h"
@@ -125,5 +128,169 @@ TEST(FileOutputBufferTest, Test)
    // Clean up.
    ASSERT_NO_ERROR(fs::remove(TestDirectory.getStr()));
 }
+
+TEST(FileOutputBufferTest, testGrowable)
+{
+   SmallString<128> TestDirectory;
+   ASSERT_NO_ERROR(fs::create_unique_directory("FileOutputBuffer-test", TestDirectory));
+
+   // Grow by small steps from nothing, writing back as we go.
+   SmallString<128> File1(TestDirectory);
+   File1.append("/file1");
+   {
+      Expected<std::unique_ptr<FileOutputBuffer>> BufferOrErr =
+            FileOutputBuffer::create(File1, 0, FileOutputBuffer::F_growable);
+      ASSERT_NO_ERROR(error_to_error_code(BufferOrErr.takeError()));
+      std::unique_ptr<FileOutputBuffer> &Buffer = *BufferOrErr;
+      EXPECT_EQ(0u, Buffer->getBufferSize());
+      for (size_t I = 0; I != 100000; ++I) {
+         ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(I + 1)));
+         Buffer->getBufferStart()[I] = uint8_t(I % 251);
+         if ((I + 1) % 16384 == 0) {
+            ASSERT_NO_ERROR(error_to_error_code(Buffer->writeBack(I + 1 - 16384, 16384)));
+         }
+      }
+      EXPECT_EQ(100000u, Buffer->getBufferSize());
+      EXPECT_EQ(Buffer->getBufferStart() + 100000, Buffer->getBufferEnd());
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->commit()));
+   }
+   {
+      OptionalError<std::unique_ptr<MemoryBuffer>> File = MemoryBuffer::getFile(File1);
+      ASSERT_TRUE((bool)File);
+      StringRef Contents = (*File)->getBuffer();
+      ASSERT_EQ(100000u, Contents.size());
+      bool Matches = true;
+      for (size_t I = 0; I != Contents.size(); ++I) {
+         Matches &= uint8_t(Contents[I]) == uint8_t(I % 251);
+      }
+      EXPECT_TRUE(Matches);
+   }
+   ASSERT_NO_ERROR(fs::remove(File1.getStr()));
+
+   // Shrinking then growing again zero-fills.
+   SmallString<128> File2(TestDirectory);
+   File2.append("/file2");
+   {
+      Expected<std::unique_ptr<FileOutputBuffer>> BufferOrErr =
+            FileOutputBuffer::create(File2, 100, FileOutputBuffer::F_growable);
+      ASSERT_NO_ERROR(error_to_error_code(BufferOrErr.takeError()));
+      std::unique_ptr<FileOutputBuffer> &Buffer = *BufferOrErr;
+      memset(Buffer->getBufferStart(), 'x', 100);
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(10)));
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(20)));
+      EXPECT_EQ(std::string(10, 'x') + std::string(10, '\0'),
+                std::string((char *)Buffer->getBufferStart(), 20));
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->commit()));
+   }
+   uint64_t File2Size;
+   ASSERT_NO_ERROR(fs::file_size(Twine(File2), File2Size));
+   EXPECT_EQ(20u, File2Size);
+   ASSERT_NO_ERROR(fs::remove(File2.getStr()));
+
+   // Fixed-size buffers can shrink, but not grow.
+   SmallString<128> File3(TestDirectory);
+   File3.append("/file3");
+   {
+      Expected<std::unique_ptr<FileOutputBuffer>> BufferOrErr =
+            FileOutputBuffer::create(File3, 8192);
+      ASSERT_NO_ERROR(error_to_error_code(BufferOrErr.takeError()));
+      std::unique_ptr<FileOutputBuffer> &Buffer = *BufferOrErr;
+      EXPECT_EQ(ErrorCode::invalid_argument,
+                error_to_error_code(Buffer->resize(8193)));
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(4000)));
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->commit()));
+   }
+   uint64_t File3Size;
+   ASSERT_NO_ERROR(fs::file_size(Twine(File3), File3Size));
+   EXPECT_EQ(4000u, File3Size);
+   ASSERT_NO_ERROR(fs::remove(File3.getStr()));
+
+   ASSERT_NO_ERROR(fs::remove(TestDirectory.getStr()));
+}
+
+TEST(FileOutputBufferTest, testGrowableInMemory)
+{
+   // Special files are written through an in-memory buffer, which grows by
+   // reallocating and copying.
+   Expected<std::unique_ptr<FileOutputBuffer>> BufferOrErr =
+         FileOutputBuffer::create("/dev/null", 0, FileOutputBuffer::F_growable);
+   ASSERT_NO_ERROR(error_to_error_code(BufferOrErr.takeError()));
+   std::unique_ptr<FileOutputBuffer> &Buffer = *BufferOrErr;
+   EXPECT_EQ(0u, Buffer->getBufferSize());
+   for (size_t I = 0; I != 100000; ++I) {
+      ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(I + 1)));
+      Buffer->getBufferStart()[I] = uint8_t(I % 251);
+   }
+   ASSERT_NO_ERROR(error_to_error_code(Buffer->writeBack(0, 100000)));
+   ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(50000)));
+   ASSERT_NO_ERROR(error_to_error_code(Buffer->resize(200000)));
+   EXPECT_EQ(200000u, Buffer->getBufferSize());
+   bool Matches = true;
+   for (size_t I = 0; I != 200000; ++I) {
+      Matches &= Buffer->getBufferStart()[I] == (I < 50000 ? uint8_t(I % 251) : 0);
+   }
+   EXPECT_TRUE(Matches);
+   ASSERT_NO_ERROR(error_to_error_code(Buffer->commit()));
+}
+
+TEST(FileOutputBufferTest, testParallelOutputWriter)
+{
+   SmallString<128> TestDirectory;
+   ASSERT_NO_ERROR(fs::create_unique_directory("FileOutputBuffer-test", TestDirectory));
+
+   SmallString<128> File1(TestDirectory);
+   File1.append("/file1");
+   std::vector<std::pair<size_t, size_t>> Layout;
+   {
+      Expected<std::unique_ptr<FileOutputBuffer>> BufferOrErr =
+            FileOutputBuffer::create(File1, 0, FileOutputBuffer::F_growable);
+      ASSERT_NO_ERROR(error_to_error_code(BufferOrErr.takeError()));
+      ParallelOutputWriter Writer(**BufferOrErr, /*writeBackCompleted=*/true);
+      std::vector<ParallelOutputWriter::Section> Sections;
+      for (unsigned I = 0; I != 16; ++I) {
+         Expected<ParallelOutputWriter::Section> Section =
+               I % 4 ? Writer.allocate(1000 + I * 777, 16) : Writer.allocatePages(5000);
+         ASSERT_NO_ERROR(error_to_error_code(Section.takeError()));
+         Sections.push_back(*Section);
+         Layout.emplace_back(Section->getOffset(), Section->getSize());
+         EXPECT_EQ(0u, Section->getOffset() % (I % 4 ? 16 : sys::Process::getPageSize()));
+      }
+      parallel::for_each_n(parallel::par, size_t(0), Sections.size(), [&](size_t I) {
+         memset(Sections[I].getData(), 'a' + I, Sections[I].getSize());
+         Writer.complete(Sections[I]);
+      });
+      Writer.wait();
+      Writer.fillPadding(0xcc);
+      ASSERT_NO_ERROR(error_to_error_code(Writer.commit()));
+   }
+   {
+      OptionalError<std::unique_ptr<MemoryBuffer>> File = MemoryBuffer::getFile(File1);
+      ASSERT_TRUE((bool)File);
+      StringRef Contents = (*File)->getBuffer();
+      ASSERT_EQ(Layout.back().first + Layout.back().second, Contents.size());
+      size_t End = 0;
+      for (size_t I = 0; I != Layout.size(); ++I) {
+         size_t Offset = Layout[I].first;
+         EXPECT_EQ(std::string(Offset - End, '\xcc'), Contents.slice(End, Offset));
+         EXPECT_EQ(std::string(Layout[I].second, 'a' + I), Contents.substr(Offset, Layout[I].second));
+         End = Offset + Layout[I].second;
+      }
+   }
+   ASSERT_NO_ERROR(fs::remove(File1.getStr()));
+
+   // Sections must fit in buffers that cannot grow.
+   SmallString<128> File2(TestDirectory);
+   File2.append("/file2");
+   {
+      Expected<std::unique_ptr<FileOutputBuffer>> BufferOrErr =
+            FileOutputBuffer::create(File2, 100);
+      ASSERT_NO_ERROR(error_to_error_code(BufferOrErr.takeError()));
+      ParallelOutputWriter Writer(**BufferOrErr);
+      ASSERT_NO_ERROR(error_to_error_code(Writer.allocate(60).takeError()));
+      EXPECT_EQ(ErrorCode::invalid_argument,
+                error_to_error_code(Writer.allocate(60).takeError()));
+   }
+   ASSERT_NO_ERROR(fs::remove(TestDirectory.getStr()));
+}
 } // anonymous namespace
 
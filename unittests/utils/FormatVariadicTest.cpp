@@ -644,4 +644,52 @@ TEST(FormatVariadicTest, testCopiesAndMoves)
    EXPECT_EQ(0, R.Moved);
 }
 
+TEST(FormatVariadicTest, testCompiledFormat)
+{
+   // The replacements parsed at compile time are those parsed at run time.
+   constexpr auto Compiled = polar::utils::internal::compile_format<
+         polar::utils::internal::count_format_items("{0,-5:x} and {{{1}} {0, =3}")>(
+         "{0,-5:x} and {{{1}} {0, =3}");
+   static_assert(Compiled.m_valid, "");
+   static_assert(Compiled.m_numArgs == 2, "");
+   auto Replacements =
+         FormatvObjectBase::parseFormatString("{0,-5:x} and {{{1}} {0, =3}");
+   ASSERT_EQ(Replacements.size(), Compiled.m_items.size());
+   for (size_t I = 0; I < Replacements.size(); ++I) {
+      EXPECT_EQ(Replacements[I].m_type, Compiled.m_items[I].m_type);
+      EXPECT_EQ(Replacements[I].m_spec, Compiled.m_items[I].m_spec);
+      EXPECT_EQ(Replacements[I].m_index, Compiled.m_items[I].m_index);
+      EXPECT_EQ(Replacements[I].m_align, Compiled.m_items[I].m_align);
+      EXPECT_EQ(Replacements[I].m_where, Compiled.m_items[I].m_where);
+      EXPECT_EQ(Replacements[I].m_pad, Compiled.m_items[I].m_pad);
+      EXPECT_EQ(Replacements[I].m_options, Compiled.m_items[I].m_options);
+   }
+   
+   static_assert(!polar::utils::internal::compile_format<1>("{0").m_valid, "");
+   static_assert(!polar::utils::internal::compile_format<1>("{0{1}").m_valid, "");
+   static_assert(!polar::utils::internal::compile_format<1>("{a}").m_valid, "");
+   static_assert(!polar::utils::internal::compile_format<1>("{0 1}").m_valid, "");
+   static_assert(!polar::utils::internal::compile_format<1>("{0,x}").m_valid, "");
+   static_assert(polar::utils::internal::compile_format<0>("").m_numArgs == 0, "");
+}
+
+TEST(FormatVariadicTest, testCompiledFormatv)
+{
+   EXPECT_EQ("", POLAR_FORMATV("").getStr());
+   EXPECT_EQ("Plain text", POLAR_FORMATV("Plain text").getStr());
+   EXPECT_EQ("{", POLAR_FORMATV("{{").getStr());
+   EXPECT_EQ("1 2 1", POLAR_FORMATV("{0} {1} {0}", 1, 2).getStr());
+   EXPECT_EQ(formatv("{0,-5}|{1,=7:x}|{2,+4}|{0,3}", 42, 255, "s").getStr(),
+             POLAR_FORMATV("{0,-5}|{1,=7:x}|{2,+4}|{0,3}", 42, 255, "s").getStr());
+   EXPECT_EQ("Format", POLAR_FORMATV("F{0}t", POLAR_FORMATV("o{0}a", "rm")).getStr());
+   // Arguments past the largest index are allowed, as with formatv().
+   EXPECT_EQ("a", POLAR_FORMATV("{0}", "a", "b").getStr());
+   
+   auto Object = POLAR_FORMATV("{0}{0}", std::string("ab"));
+   auto Moved = std::move(Object);
+   EXPECT_EQ("abab", Moved.getStr());
+   std::string Str = POLAR_FORMATV("{0:X}", 255);
+   EXPECT_EQ("0xFF", Str);
+}
+
 } // anonymous namespace
@@ -11,6 +11,9 @@
 
 #include "polar/utils/GlobPattern.h"
 #include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace polar::basic;
 using namespace polar::utils;
@@ -83,4 +86,131 @@ TEST_F(GlobPatternTest, testExtSym)
   EXPECT_TRUE((bool)Pat2);
   EXPECT_TRUE(Pat2->match("\xFF"));
 }
+
+TEST_F(GlobPatternTest, testManyStars)
+{
+  Expected<GlobPattern> Pat1 = GlobPattern::create("*a*b*c*d*e*f*g*h*");
+  EXPECT_TRUE((bool)Pat1);
+  EXPECT_TRUE(Pat1->match("xaxbxcxdxexfxgxhx"));
+  EXPECT_TRUE(Pat1->match("abcdefgh"));
+  EXPECT_FALSE(Pat1->match(std::string(10000, 'a') + "bcdefg"));
+
+  Expected<GlobPattern> Pat2 = GlobPattern::create("a*[0-9]?z");
+  EXPECT_TRUE((bool)Pat2);
+  EXPECT_TRUE(Pat2->match("a1xz"));
+  EXPECT_TRUE(Pat2->match("abc9xz"));
+  EXPECT_TRUE(Pat2->match("a11z1xz"));
+  EXPECT_FALSE(Pat2->match("a1z"));
+  EXPECT_FALSE(Pat2->match("a1xzx"));
+}
+
+TEST_F(GlobPatternTest, testLongPattern)
+{
+  // More than 64 positions take the lazily built DFA.
+  std::string Prefix(40, 'p');
+  std::string Suffix(40, 's');
+  Expected<GlobPattern> Pat1 = GlobPattern::create(Prefix + "*?" + Suffix + "*[xy]");
+  EXPECT_TRUE((bool)Pat1);
+  EXPECT_TRUE(Pat1->match(Prefix + "-" + Suffix + "x"));
+  EXPECT_TRUE(Pat1->match(Prefix + "abc" + Suffix + "ss" + Suffix + "y"));
+  EXPECT_FALSE(Pat1->match(Prefix + Suffix + "x"));
+  EXPECT_FALSE(Pat1->match(Prefix + "-" + Suffix));
+  EXPECT_FALSE(Pat1->match(Prefix + "-" + Suffix + "z"));
+  // Copies share the DFA built so far.
+  GlobPattern Copy = *Pat1;
+  EXPECT_TRUE(Copy.match(Prefix + "--" + Suffix + "-y"));
+  EXPECT_FALSE(Copy.match("p"));
+}
+
+TEST_F(GlobPatternTest, testLongPatternFromManyThreads)
+{
+  // "*a" followed by 70 '?' matches strings with an 'a' 71 characters from
+  // the end. Its DFA has a state per combination of the last 71 characters
+  // being 'a' or not, far more than are kept, so this also runs past the
+  // state limit.
+  Expected<GlobPattern> Pat = GlobPattern::create("*a" + std::string(70, '?'));
+  ASSERT_TRUE((bool)Pat);
+  std::vector<std::thread> Threads;
+  std::vector<unsigned> Mismatches(4);
+  for (unsigned T = 0; T < Mismatches.size(); ++T) {
+    Threads.emplace_back([&, T] {
+      uint32_t Seed = 12345 + T;
+      for (unsigned N = 0; N < 500; ++N) {
+        std::string Str(100 + N % 50, 'b');
+        for (char &C : Str) {
+          Seed = Seed * 1103515245 + 12345;
+          if (Seed & 0x10000)
+            C = 'a';
+        }
+        bool Wanted = Str[Str.size() - 71] == 'a';
+        if (Pat->match(Str) != Wanted)
+          ++Mismatches[T];
+      }
+    });
+  }
+  for (std::thread &Thread : Threads)
+    Thread.join();
+  EXPECT_EQ(std::vector<unsigned>(Mismatches.size(), 0), Mismatches);
+}
+
+TEST_F(GlobPatternTest, testGlobSet)
+{
+  GlobSet Set;
+  EXPECT_TRUE(Set.isEmpty());
+  EXPECT_FALSE(Set.matchAny("foo"));
+  Error Err = Set.add("[a");
+  EXPECT_TRUE((bool)Err);
+  consume_error(std::move(Err));
+  std::vector<std::string> Patterns = {
+      "*.cpp", "src/*", "src/*.h", "README", "*", "a?c",
+      "[^a]*", std::string(70, 'x') + "*", "*.cpp"};
+  for (const std::string &Pattern : Patterns)
+    EXPECT_FALSE((bool)Set.add(Pattern));
+  EXPECT_EQ(Patterns.size(), Set.getSize());
+
+  SmallVector<unsigned, 8> Indexes;
+  auto Match = [&](StringRef Str) {
+    Indexes.clear();
+    Set.match(Str, Indexes);
+    return std::vector<unsigned>(Indexes.begin(), Indexes.end());
+  };
+  EXPECT_EQ((std::vector<unsigned>{0, 1, 4, 6, 8}), Match("src/main.cpp"));
+  EXPECT_EQ((std::vector<unsigned>{1, 2, 4, 6}), Match("src/main.h"));
+  EXPECT_EQ((std::vector<unsigned>{3, 4, 6}), Match("README"));
+  EXPECT_EQ((std::vector<unsigned>{4, 5}), Match("abc"));
+  EXPECT_EQ((std::vector<unsigned>{4}), Match(""));
+  EXPECT_EQ((std::vector<unsigned>{4, 6, 7}), Match(std::string(75, 'x')));
+  EXPECT_TRUE(Set.matchAny("anything"));
+}
+
+TEST_F(GlobPatternTest, testGlobSetAgreesWithGlobPattern)
+{
+  std::vector<std::string> Patterns = {
+      "a*", "*a", "a*b", "*a*b*", "a?b", "[ab]*[cd]", "*[^a]", "ab*ab*ab",
+      "????", "*?a?*", "[a-c][a-c]", "b**a"};
+  GlobSet Set;
+  std::vector<GlobPattern> Globs;
+  for (const std::string &Pattern : Patterns) {
+    EXPECT_FALSE((bool)Set.add(Pattern));
+    Globs.push_back(cant_fail(GlobPattern::create(Pattern)));
+  }
+  // Every string over {a, b, c, d} of up to 6 characters.
+  std::vector<std::string> Strs = {""};
+  for (size_t I = 0; I < Strs.size(); ++I) {
+    if (Strs[I].size() < 6)
+      for (char C : StringRef("abcd"))
+        Strs.push_back(Strs[I] + C);
+  }
+  SmallVector<unsigned, 16> Indexes;
+  for (const std::string &Str : Strs) {
+    std::vector<unsigned> Want;
+    for (unsigned I = 0; I < Globs.size(); ++I)
+      if (Globs[I].match(Str))
+        Want.push_back(I);
+    Indexes.clear();
+    EXPECT_EQ(!Want.empty(), Set.match(Str, Indexes)) << Str;
+    EXPECT_EQ(Want, std::vector<unsigned>(Indexes.begin(), Indexes.end())) << Str;
+    EXPECT_EQ(!Want.empty(), Set.matchAny(Str)) << Str;
+  }
+}
 } // anonymous namespace
@@ -14,6 +14,7 @@
 #include "polar/utils/Path.h"
 #include "gtest/gtest.h"
 #include <memory>
+#include <thread>
 
 using namespace polar::basic;
 using namespace polar::utils;
@@ -131,4 +132,38 @@ TEST(LockFileManagerTest, testRelativePath)
    ASSERT_FALSE(errorCode);
 }
 
+TEST(LockFileManagerTest, testWaitForUnlock)
+{
+   SmallString<64> TmpDir;
+   std::error_code errorCode;
+   errorCode = fs::create_unique_directory("LockFileManagerTestDir", TmpDir);
+   ASSERT_FALSE(errorCode);
+
+   SmallString<64> LockedFile(TmpDir);
+   fs::path::append(LockedFile, "file");
+
+   auto Owner = std::make_unique<LockFileManager>(LockedFile);
+   ASSERT_EQ(LockFileManager::LFS_Owned, Owner->getState());
+   LockFileManager Waiter(LockedFile);
+   ASSERT_EQ(LockFileManager::LFS_Shared, Waiter.getState());
+   EXPECT_EQ(std::chrono::nanoseconds(0), Waiter.getWaitTime());
+
+   // The owner produces the file, then releases the lock.
+   std::thread Releaser([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      int FD;
+      ASSERT_FALSE(fs::open_file_for_write(StringRef(LockedFile), FD, fs::F_None));
+      close(FD);
+      Owner.reset();
+   });
+   EXPECT_EQ(LockFileManager::Res_Success, Waiter.waitForUnlock());
+   Releaser.join();
+   EXPECT_GE(Waiter.getWaitTime(), std::chrono::milliseconds(100));
+
+   errorCode = fs::remove(StringRef(LockedFile));
+   ASSERT_FALSE(errorCode);
+   errorCode = fs::remove(StringRef(TmpDir));
+   ASSERT_FALSE(errorCode);
+}
+
 } // anonymous namespace
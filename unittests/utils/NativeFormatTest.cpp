@@ -50,6 +50,15 @@ std::string format_number(double D, FloatStyle style,
    return S;
 }
 
+template <typename T> std::string format_shortest(T N)
+{
+   std::string S;
+   RawStringOutStream Str(S);
+   write_shortest(Str, N);
+   Str.flush();
+   return S;
+}
+
 // Test basic number formatting with various styles and default width and
 // precision.
 TEST(NativeFormatTest, testBasicIntegerTests)
@@ -113,6 +122,40 @@ TEST(NativeFormatTest, testBasicFloatingPointTests)
    EXPECT_EQ("1.34", format_number(1.34, FloatStyle::Fixed));
    EXPECT_EQ("1.34", format_number(1.344, FloatStyle::Fixed));
    EXPECT_EQ("1.35", format_number(1.346, FloatStyle::Fixed));
+
+   // Short and long digits, either side of the shortest digits.
+   EXPECT_EQ("1.5e+300", format_number(1.5e300, FloatStyle::Exponent, 1));
+   EXPECT_EQ("2e+00", format_number(1.5, FloatStyle::Exponent, 0));
+   EXPECT_EQ("3.333333e-01", format_number(1.0 / 3, FloatStyle::Exponent));
+   EXPECT_EQ("1.00000000000000005551e-01",
+             format_number(0.1, FloatStyle::Exponent, 20));
+   EXPECT_EQ("4.940656e-324", format_number(5e-324, FloatStyle::Exponent));
+}
+
+TEST(NativeFormatTest, testShortestTests)
+{
+   EXPECT_EQ("0", format_shortest(0.0));
+   EXPECT_EQ("-0", format_shortest(-0.0));
+   EXPECT_EQ("1", format_shortest(1.0));
+   EXPECT_EQ("-2.5", format_shortest(-2.5));
+   EXPECT_EQ("0.1", format_shortest(0.1));
+   EXPECT_EQ("0.30000000000000004", format_shortest(0.1 + 0.2));
+   EXPECT_EQ("1234567", format_shortest(1234567.0));
+   EXPECT_EQ("0.0001", format_shortest(1e-4));
+   EXPECT_EQ("1e-05", format_shortest(1e-5));
+   EXPECT_EQ("10000000000000000", format_shortest(1e16));
+   EXPECT_EQ("1e+17", format_shortest(1e17));
+   EXPECT_EQ("1.7976931348623157e+308",
+             format_shortest(std::numeric_limits<double>::max()));
+   EXPECT_EQ("5e-324", format_shortest(std::numeric_limits<double>::denorm_min()));
+   EXPECT_EQ("nan", format_shortest(std::numeric_limits<double>::quiet_NaN()));
+   EXPECT_EQ("-inf", format_shortest(-std::numeric_limits<double>::infinity()));
+
+   // Floats get the digits which tell them apart from other floats.
+   EXPECT_EQ("0.1", format_shortest(0.1f));
+   EXPECT_EQ("3.1415927", format_shortest(3.14159265f));
+   EXPECT_EQ("3.4028235e+38", format_shortest(std::numeric_limits<float>::max()));
+   EXPECT_EQ("1e-45", format_shortest(std::numeric_limits<float>::denorm_min()));
 }
 
 // Test common boundary cases and min/max conditions.
@@ -158,6 +201,10 @@ TEST(NativeFormatTest, testHexTests)
    // Try printing more digits than can fit in a uint64.
    EXPECT_EQ("0x00000000000000abcde",
              format_number(0xABCDE, HexPrintStyle::PrefixLower, 21));
+
+   EXPECT_EQ("0xFEDCBA9876543210",
+             format_number(0xFEDCBA9876543210, HexPrintStyle::PrefixUpper));
+   EXPECT_EQ("fedcba987", format_number(0xFEDCBA987, HexPrintStyle::Lower));
 }
 
 TEST(NativeFormatTest, testIntegerTests)
@@ -170,6 +217,13 @@ TEST(NativeFormatTest, testIntegerTests)
    EXPECT_EQ("100", format_number(100, IntegerStyle::Integer));
    EXPECT_EQ("1000", format_number(1000, IntegerStyle::Integer));
    EXPECT_EQ("1234567890", format_number(1234567890, IntegerStyle::Integer));
+
+   std::string S;
+   RawStringOutStream Str(S);
+   write_integer(Str, -42, 5, IntegerStyle::Integer);
+   write_integer(Str, 7u, 3, IntegerStyle::Integer);
+   Str.flush();
+   EXPECT_EQ("-00042007", S);
 }
 
 TEST(NativeFormatTest, testCommaTests)
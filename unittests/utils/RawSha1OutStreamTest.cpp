@@ -14,6 +14,7 @@
 #include "gtest/gtest.h"
 
 #include <string>
+#include <vector>
 
 using namespace polar;
 using namespace polar::utils;
@@ -84,3 +85,56 @@ TEST(RawSha1OutStreamTest, testReset)
    ASSERT_EQ("7447F2A5A42185C8CF91E632789C431830B59067", Hash);
 }
 
+
+TEST(RawSha1OutStreamTest, testLargeStream)
+{
+   RawSha1OutStream Sha1Stream;
+   std::string Block(1000, 'a');
+   for (int i = 0; i < 1000; ++i) {
+      Sha1Stream << Block;
+   }
+   ASSERT_EQ("34AA973CD4C4DAA4F61EEB2BDBAD27316534016F", toHex(Sha1Stream.getSha1()));
+}
+
+TEST(RawSha1OutStreamTest, testSha1HashBatch)
+{
+   std::vector<uint8_t> Data(300);
+   for (size_t i = 0; i < Data.size(); ++i) {
+      Data[i] = i % 251;
+   }
+   // Odd lengths around the padding boundaries so that the SIMD lanes finish
+   // at different times.
+   std::vector<ArrayRef<uint8_t>> Inputs;
+   for (size_t Length : {0, 1, 55, 56, 63, 64, 65, 119, 128, 300, 7}) {
+      Inputs.push_back(ArrayRef<uint8_t>(Data.data(), Length));
+   }
+   const char *const Expected[] = {
+      "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709",
+      "5BA93C9DB0CFF93F52B521D7420E43F6EDA2784F",
+      "8AE2D46729CFE68FF927AF5EEC9C7D1B66D65AC2",
+      "636E2EC698DAC903498E648BD2F3AF641D3C88CB",
+      "6D942DA0C4392B123528F2905C713A3CE28364BD",
+      "C6138D514FFA2135BFCE0ED0B8FAC65669917EC7",
+      "69BD728AD6E13CD76FF19751FDE427B00E395746",
+      "41C89D06001BAB4AB78736B44EFE7CE18CE6AE08",
+      "E6434BC401F98603D7EDA504790C98C67385D535",
+      "449C66C5B0F2CACBDB951D0AE9DDC198B5315098",
+      "6DC86F11B8CDBE879BF8BA3832499C2F93C729BA",
+   };
+   // Run every compression path, whatever the host would pick.
+   for (Sha1::Implementation Impl : {Sha1::Implementation::Portable,
+                                     Sha1::Implementation::MultiBuffer,
+                                     Sha1::Implementation::Host}) {
+      if (!Sha1::setImplementation(Impl)) {
+         continue;
+      }
+      std::vector<std::array<uint8_t, 20>> Hashes = Sha1::hashBatch(Inputs);
+      ASSERT_EQ(Inputs.size(), Hashes.size());
+      for (size_t i = 0; i < Inputs.size(); ++i) {
+         EXPECT_EQ(Expected[i], toHex(StringRef((const char *)Hashes[i].data(), 20)))
+               << "implementation " << int(Impl) << ", length " << Inputs[i].getSize();
+         EXPECT_EQ(Sha1::hash(Inputs[i]), Hashes[i]);
+      }
+      EXPECT_TRUE(Sha1::hashBatch({}).empty());
+   }
+}
@@ -0,0 +1,102 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/Sha256.h"
+#include "polar/basic/adt/StringExtras.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+namespace {
+
+std::string sha256_hex(StringRef input)
+{
+   Sha256 hash;
+   hash.update(input);
+   return to_hex(hash.final());
+}
+
+TEST(Sha256Test, testKnownVectors)
+{
+   EXPECT_EQ("E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855",
+             sha256_hex(""));
+   EXPECT_EQ("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD",
+             sha256_hex("abc"));
+   EXPECT_EQ("248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1",
+             sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+   EXPECT_EQ("CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0",
+             sha256_hex(std::string(1000000, 'a')));
+}
+
+TEST(Sha256Test, testIncremental)
+{
+   std::string input(1000, 'x');
+   for (size_t i = 0; i < input.size(); ++i) {
+      input[i] = 'a' + i % 26;
+   }
+   std::array<uint8_t, 32> expected =
+         Sha256::hash(ArrayRef<uint8_t>((const uint8_t *)input.data(), input.size()));
+   Sha256 hash;
+   for (size_t pos = 0, step = 1; pos < input.size(); pos += step, step = step * 2 + 1) {
+      hash.update(StringRef(input).substr(pos, step));
+      // Peeking at the intermediate hash must not disturb the state.
+      hash.result();
+   }
+   EXPECT_EQ(to_hex(ArrayRef<uint8_t>(expected)), to_hex(hash.final()));
+}
+
+TEST(Sha256Test, testHashBatch)
+{
+   std::vector<uint8_t> data(300);
+   for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = i % 251;
+   }
+   std::vector<ArrayRef<uint8_t>> inputs;
+   for (size_t length : {0, 1, 55, 56, 63, 64, 65, 119, 128, 300, 7}) {
+      inputs.push_back(ArrayRef<uint8_t>(data.data(), length));
+   }
+   const char *const expected[] = {
+      "E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855",
+      "6E340B9CFFB37A989CA544E6BB780A2C78901D3FB33738768511A30617AFA01D",
+      "463EB28E72F82E0A96C0A4CC53690C571281131F672AA229E0D45AE59B598B59",
+      "DA2AE4D6B36748F2A318F23E7AB1DFDF45ACDC9D049BD80E59DE82A60895F562",
+      "29AF2686FD53374A36B0846694CC342177E428D1647515F078784D69CDB9E488",
+      "FDEAB9ACF3710362BD2658CDC9A29E8F9C757FCF9811603A8C447CD1D9151108",
+      "4BFD2C8B6F1EEC7A2AFEB48B934EE4B2694182027E6D0FC075074F2FABB31781",
+      "DA18797ED7C3A777F0847F429724A2D8CD5138E6ED2895C3FA1A6D39D18F7EC6",
+      "471FB943AA23C511F6F72F8D1652D9C880CFA392AD80503120547703E56A2BE5",
+      "43F9B5D59EB108817176C6F65C2C6203A22F2AE8BC28B7A1DDE45947678C5042",
+      "57355AC3303C148F11AEF7CB179456B9232CDE33A818DFDA2C2FCB9325749A6B",
+   };
+   // Run every compression path, whatever the host would pick.
+   for (Sha256::Implementation impl : {Sha256::Implementation::Portable,
+                                       Sha256::Implementation::MultiBuffer,
+                                       Sha256::Implementation::Host}) {
+      if (!Sha256::setImplementation(impl)) {
+         continue;
+      }
+      std::vector<std::array<uint8_t, 32>> hashes = Sha256::hashBatch(inputs);
+      ASSERT_EQ(inputs.size(), hashes.size());
+      for (size_t i = 0; i < inputs.size(); ++i) {
+         EXPECT_EQ(expected[i], to_hex(ArrayRef<uint8_t>(hashes[i])))
+               << "implementation " << int(impl) << ", length " << inputs[i].getSize();
+         EXPECT_EQ(Sha256::hash(inputs[i]), hashes[i]);
+      }
+      EXPECT_TRUE(Sha256::hashBatch({}).empty());
+   }
+}
+
+} // anonymous namespace
@@ -261,13 +261,79 @@ TEST_F(SpecialCaseListTest, testPopularTrigram)
 TEST_F(SpecialCaseListTest, testEscapedSymbols)
 {
    std::unique_ptr<SpecialCaseList> SCL = makeSpecialCaseList("src:*c\\+\\+abi*\n"
-                                                              "src:*hello\\\\world*\n");
+                                                              "src:*hello\\\\world*\n"
+                                                              "src:a\\dbc\n");
    EXPECT_TRUE(SCL->inSection("", "src", "dir/c++abi"));
    EXPECT_FALSE(SCL->inSection("", "src", "dir/c\\+\\+abi"));
    EXPECT_FALSE(SCL->inSection("", "src", "c\\+\\+abi"));
    EXPECT_TRUE(SCL->inSection("", "src", "C:\\hello\\world"));
    EXPECT_TRUE(SCL->inSection("", "src", "hello\\world"));
    EXPECT_FALSE(SCL->inSection("", "src", "hello\\\\world"));
+   EXPECT_TRUE(SCL->inSection("", "src", "a1bc"));
+   EXPECT_FALSE(SCL->inSection("", "src", "adbc"));
+}
+
+TEST_F(SpecialCaseListTest, testFirstMatchingRuleWins)
+{
+   std::unique_ptr<SpecialCaseList> SCL = makeSpecialCaseList("fun:*bar*\n"
+                                                              "fun:foo*\n"
+                                                              "fun:(foo|baz)bar\n"
+                                                              "fun:fo[o]?\n"
+                                                              "fun:.*qux.*\n"
+                                                              "fun:foobar\n");
+   EXPECT_EQ(6u, SCL->inSectionBlame("", "fun", "foobar"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "fun", "foo"));
+   EXPECT_EQ(1u, SCL->inSectionBlame("", "fun", "bazbar"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "fun", "fooo"));
+   EXPECT_EQ(4u, SCL->inSectionBlame("", "fun", "fo"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "fun", "fooqux"));
+   EXPECT_EQ(5u, SCL->inSectionBlame("", "fun", "xquxx"));
+   EXPECT_EQ(0u, SCL->inSectionBlame("", "fun", "quxx"));
+   EXPECT_EQ(0u, SCL->inSectionBlame("", "fun", "f"));
+}
+
+TEST_F(SpecialCaseListTest, testRequiredLiterals)
+{
+   std::unique_ptr<SpecialCaseList> SCL = makeSpecialCaseList("src:ab?c\n"
+                                                              "src:x{0,2}yz\n"
+                                                              "src:\\x41BC\n"
+                                                              "src:lo+ng\n"
+                                                              "src:[xyz]+end\n"
+                                                              "src:a(bc)?d\n");
+   EXPECT_EQ(1u, SCL->inSectionBlame("", "src", "ac"));
+   EXPECT_EQ(1u, SCL->inSectionBlame("", "src", "abc"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "src", "yz"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "src", "xxyz"));
+   EXPECT_EQ(3u, SCL->inSectionBlame("", "src", "ABC"));
+   EXPECT_EQ(4u, SCL->inSectionBlame("", "src", "looong"));
+   EXPECT_EQ(5u, SCL->inSectionBlame("", "src", "zyxend"));
+   EXPECT_EQ(6u, SCL->inSectionBlame("", "src", "ad"));
+   EXPECT_EQ(6u, SCL->inSectionBlame("", "src", "abcd"));
+   EXPECT_EQ(0u, SCL->inSectionBlame("", "src", "abbc"));
+}
+
+TEST_F(SpecialCaseListTest, testWildcardsDoNotMatchLineBreaks)
+{
+   std::unique_ptr<SpecialCaseList> SCL = makeSpecialCaseList("src:a*b\n"
+                                                              "src:*\n");
+   EXPECT_EQ(1u, SCL->inSectionBlame("", "src", "axxb"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "src", "axx"));
+   EXPECT_EQ(0u, SCL->inSectionBlame("", "src", "a\nb"));
+   EXPECT_EQ(0u, SCL->inSectionBlame("", "src", "a\rb"));
+}
+
+TEST_F(SpecialCaseListTest, testManyRules)
+{
+   std::string list;
+   for (unsigned i = 0; i < 2000; ++i) {
+      list += "fun:*_rule" + std::to_string(i) + "_*\n";
+   }
+   list += "fun:*_rule1_suffix\n";
+   std::unique_ptr<SpecialCaseList> SCL = makeSpecialCaseList(list);
+   EXPECT_EQ(1u, SCL->inSectionBlame("", "fun", "x_rule0_y"));
+   EXPECT_EQ(1235u, SCL->inSectionBlame("", "fun", "x_rule1234_y"));
+   EXPECT_EQ(2u, SCL->inSectionBlame("", "fun", "x_rule1_suffix"));
+   EXPECT_EQ(0u, SCL->inSectionBlame("", "fun", "x_rule2000_y"));
 }
 
 } // anonymous namespace
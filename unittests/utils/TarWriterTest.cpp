@@ -10,6 +10,7 @@
 // Created by softboy on 2018/07/15.
 
 #include "polar/utils/TarWriter.h"
+#include "polar/utils/Compression.h"
 #include "polar/utils/FileSystem.h"
 #include "polar/utils/MemoryBuffer.h"
 #include "gtest/gtest.h"
@@ -189,4 +190,159 @@ TEST_F(TarWriterTest, testDuplicate)
    EXPECT_EQ(TarSize, 2048ULL);
 }
 
+TEST_F(TarWriterTest, testAppendFile)
+{
+   SmallString<128> InputPath;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "txt", InputPath));
+   std::string Contents(100000, 'a');
+   for (size_t I = 0; I < Contents.size(); I += 7) {
+      Contents[I] = 'b';
+   }
+   {
+      std::error_code EC;
+      RawFdOutStream OS(InputPath, EC, fs::F_None);
+      ASSERT_FALSE(EC);
+      OS << Contents;
+   }
+
+   // Streaming a file gives the archive appending its contents gives.
+   SmallString<128> FromData;
+   SmallString<128> FromFile;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "tar", FromData));
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "tar", FromFile));
+   {
+      std::unique_ptr<TarWriter> Tar = cant_fail(TarWriter::create(FromData, "base"));
+      Tar->append("small", "foo");
+      Tar->append("file", Contents);
+      EXPECT_FALSE((bool)Tar->finish());
+   }
+   {
+      std::unique_ptr<TarWriter> Tar = cant_fail(TarWriter::create(FromFile, "base"));
+      Tar->append("small", "foo");
+      EXPECT_FALSE((bool)Tar->appendFile("file", InputPath));
+      EXPECT_FALSE((bool)Tar->appendFile("file", InputPath));
+      Error Err = Tar->appendFile("missing", (InputPath + ".missing").getStr());
+      EXPECT_TRUE((bool)Err);
+      consume_error(std::move(Err));
+      EXPECT_FALSE((bool)Tar->finish());
+   }
+   std::unique_ptr<MemoryBuffer> Expected = std::move(*MemoryBuffer::getFile(FromData));
+   std::unique_ptr<MemoryBuffer> Actual = std::move(*MemoryBuffer::getFile(FromFile));
+   EXPECT_EQ(Expected->getBuffer(), Actual->getBuffer());
+
+   Expected = nullptr;
+   Actual = nullptr;
+   fs::remove(InputPath);
+   fs::remove(FromData);
+   fs::remove(FromFile);
+}
+
+TEST_F(TarWriterTest, testAppendSparseFile)
+{
+   // Holes are archived as the zeros they read as; the sparse member formats
+   // are not written.
+   SmallString<128> InputPath;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "bin", InputPath));
+   {
+      std::error_code EC;
+      RawFdOutStream OS(InputPath, EC, fs::F_None);
+      ASSERT_FALSE(EC);
+      OS << "head";
+      OS.seek(1 << 20);
+      OS << "tail";
+   }
+   std::string Contents = "head" + std::string((1 << 20) - 4, '\0') + "tail";
+
+   SmallString<128> FromData;
+   SmallString<128> FromFile;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "tar", FromData));
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "tar", FromFile));
+   {
+      std::unique_ptr<TarWriter> Tar = cant_fail(TarWriter::create(FromData, "base"));
+      Tar->append("sparse", Contents);
+      EXPECT_FALSE((bool)Tar->finish());
+   }
+   {
+      std::unique_ptr<TarWriter> Tar = cant_fail(TarWriter::create(FromFile, "base"));
+      EXPECT_FALSE((bool)Tar->appendFile("sparse", InputPath));
+      EXPECT_FALSE((bool)Tar->finish());
+   }
+   std::unique_ptr<MemoryBuffer> Expected = std::move(*MemoryBuffer::getFile(FromData));
+   std::unique_ptr<MemoryBuffer> Actual = std::move(*MemoryBuffer::getFile(FromFile));
+   EXPECT_TRUE(Expected->getBuffer() == Actual->getBuffer());
+
+   Expected = nullptr;
+   Actual = nullptr;
+   fs::remove(InputPath);
+   fs::remove(FromData);
+   fs::remove(FromFile);
+}
+
+TEST_F(TarWriterTest, testIndexedGzip)
+{
+   if (!zlib::is_available()) {
+      return;
+   }
+   SmallString<128> InputPath;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "txt", InputPath));
+   {
+      std::error_code EC;
+      RawFdOutStream OS(InputPath, EC, fs::F_None);
+      ASSERT_FALSE(EC);
+      OS << "from a file";
+   }
+   SmallString<128> path;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "tar.gz", path));
+
+   std::vector<std::string> Paths;
+   std::string LongPath = std::string(200, 'x');
+   {
+      std::unique_ptr<TarWriter> Tar =
+            cant_fail(TarWriter::create(path, "base", TarWriter::IndexedGzip));
+      for (unsigned I = 0; I != 100; ++I) {
+         Paths.push_back("dir/file" + std::to_string(I));
+         Tar->append(Paths.back(), std::string(I * 97, char('a' + I % 26)));
+      }
+      Tar->append(LongPath, "long");
+      Tar->append("dir/file0", "duplicate");
+      EXPECT_FALSE((bool)Tar->appendFile("from-file", InputPath));
+      EXPECT_FALSE((bool)Tar->finish());
+   }
+   Paths.push_back(LongPath);
+   Paths.push_back("from-file");
+
+   std::unique_ptr<IndexedTarReader> Reader = cant_fail(IndexedTarReader::create(path));
+   std::vector<StringRef> MemberPaths = Reader->getMemberPaths();
+   EXPECT_EQ(std::vector<StringRef>(Paths.begin(), Paths.end()), MemberPaths);
+   // Read members out of order.
+   for (unsigned I = 100; I-- != 0;) {
+      std::unique_ptr<MemoryBuffer> Member = cant_fail(Reader->read(Paths[I]));
+      EXPECT_EQ(std::string(I * 97, char('a' + I % 26)), Member->getBuffer());
+   }
+   EXPECT_EQ("long", cant_fail(Reader->read(LongPath))->getBuffer());
+   EXPECT_EQ("from a file", cant_fail(Reader->read("from-file"))->getBuffer());
+   EXPECT_FALSE(Reader->hasMember("missing"));
+   Expected<std::unique_ptr<MemoryBuffer>> Missing = Reader->read("missing");
+   EXPECT_FALSE((bool)Missing);
+   consume_error(Missing.takeError());
+
+   Reader = nullptr;
+   fs::remove(InputPath);
+   fs::remove(path);
+}
+
+TEST_F(TarWriterTest, testIndexedReaderRejectsPlainArchives)
+{
+   SmallString<128> path;
+   ASSERT_FALSE(fs::create_temporary_file("TarWriterTest", "tar", path));
+   {
+      std::unique_ptr<TarWriter> Tar = cant_fail(TarWriter::create(path, "base"));
+      Tar->append("file", "contents");
+   }
+   Expected<std::unique_ptr<IndexedTarReader>> Reader = IndexedTarReader::create(path);
+   EXPECT_FALSE((bool)Reader);
+   consume_error(Reader.takeError());
+   fs::remove(path);
+}
+
 } // anonymous namespace
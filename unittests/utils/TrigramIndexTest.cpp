@@ -18,6 +18,7 @@
 
 using namespace polar;
 using namespace polar::utils;
+using polar::basic::SmallVector;
 
 namespace {
 
@@ -108,16 +109,32 @@ TEST_F(TrigramIndexTest, testTooComplicatedRegex2)
 TEST_F(TrigramIndexTest, testEscapedSymbols)
 {
    std::unique_ptr<TrigramIndex> titer =
-         makeTrigramIndex({"*c\\+\\+*", "*hello\\\\world*", "a\\tb", "a\\0b"});
+         makeTrigramIndex({"*c\\+\\+*", "*hello\\\\world*", "a\\.bc"});
    EXPECT_FALSE(titer->isDefeated());
    EXPECT_FALSE(titer->isDefinitelyOut("c++"));
    EXPECT_TRUE(titer->isDefinitelyOut("c\\+\\+"));
    EXPECT_FALSE(titer->isDefinitelyOut("hello\\world"));
    EXPECT_TRUE(titer->isDefinitelyOut("hello\\\\world"));
-   EXPECT_FALSE(titer->isDefinitelyOut("atb"));
-   EXPECT_TRUE(titer->isDefinitelyOut("a\\tb"));
-   EXPECT_TRUE(titer->isDefinitelyOut("a\tb"));
-   EXPECT_FALSE(titer->isDefinitelyOut("a0b"));
+   EXPECT_FALSE(titer->isDefinitelyOut("a.bc"));
+   EXPECT_TRUE(titer->isDefinitelyOut("axbc"));
+}
+
+TEST_F(TrigramIndexTest, testClassEscapes)
+{
+   // Escaped letters and digits are classes, assertions or numeric escapes,
+   // not the letter itself, so they end a run.
+   std::unique_ptr<TrigramIndex> titer =
+         makeTrigramIndex({"*hello*", "a\\dbcd", "\\bfoo\\sbar", "a\\tb", "a\\x41bcd"});
+   EXPECT_TRUE(titer->isDefeated());
+   SmallVector<unsigned, 4> candidates;
+   titer->getCandidates("a1bcd", candidates);
+   EXPECT_EQ((std::vector<unsigned>{1, 3, 4}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("foo bar", candidates);
+   EXPECT_EQ((std::vector<unsigned>{2, 3}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("hello", candidates);
+   EXPECT_EQ((std::vector<unsigned>{0, 3}), std::vector<unsigned>(candidates.begin(), candidates.end()));
 }
 
 TEST_F(TrigramIndexTest, testBackreference1)
@@ -144,4 +161,65 @@ TEST_F(TrigramIndexTest, testSequence)
    EXPECT_TRUE(titer->isDefinitelyOut("class"));
 }
 
+TEST_F(TrigramIndexTest, testCandidates)
+{
+   std::unique_ptr<TrigramIndex> titer =
+         makeTrigramIndex({"*hello*", "*world*", "hello*world", "[0-9]+"});
+   EXPECT_TRUE(titer->isDefeated());
+   EXPECT_EQ(4u, titer->getNumRules());
+   SmallVector<unsigned, 4> candidates;
+   titer->getCandidates("foo", candidates);
+   EXPECT_EQ((std::vector<unsigned>{3}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("say hello", candidates);
+   EXPECT_EQ((std::vector<unsigned>{0, 3}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("hello, world", candidates);
+   EXPECT_EQ((std::vector<unsigned>{0, 1, 2, 3}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+}
+
+TEST_F(TrigramIndexTest, testPartialIndexing)
+{
+   std::unique_ptr<TrigramIndex> titer =
+         makeTrigramIndex({"foo(bar)?baz[0-9]", "src/.*\\.cpp", "qu+x{2}yzzy", "ab?cde"});
+   EXPECT_FALSE(titer->isDefeated());
+   SmallVector<unsigned, 4> candidates;
+   titer->getCandidates("foobaz1", candidates);
+   EXPECT_EQ((std::vector<unsigned>{0}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("src/lib/a.cpp", candidates);
+   EXPECT_EQ((std::vector<unsigned>{1}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("quuuxyzzy", candidates);
+   EXPECT_EQ((std::vector<unsigned>{2}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   candidates.clear();
+   titer->getCandidates("acde", candidates);
+   EXPECT_EQ((std::vector<unsigned>{3}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+   EXPECT_TRUE(titer->isDefinitelyOut("foo"));
+}
+
+TEST(TrigramIndexRunsTest, testRequiredRuns)
+{
+   std::vector<std::string> runs;
+   EXPECT_TRUE(get_required_regex_runs("src/*\\.cpp", runs));
+   EXPECT_EQ((std::vector<std::string>{"src/", ".cpp"}), runs);
+   runs.clear();
+   EXPECT_TRUE(get_required_regex_runs("ab?c\\d+lo+ng(x)?[yz]end{2}", runs));
+   EXPECT_EQ((std::vector<std::string>{"a", "c", "lo", "ng", "en"}), runs);
+   runs.clear();
+   EXPECT_FALSE(get_required_regex_runs("foo|bar", runs));
+   EXPECT_FALSE(get_required_regex_runs("(a)\\1", runs));
+}
+
+TEST_F(TrigramIndexTest, testUnindexedRule)
+{
+   std::unique_ptr<TrigramIndex> titer =
+         makeTrigramIndex({"*hello*"});
+   titer->insertUnindexed();
+   titer->insert("*world*");
+   SmallVector<unsigned, 4> candidates;
+   titer->getCandidates("world", candidates);
+   EXPECT_EQ((std::vector<unsigned>{1, 2}), std::vector<unsigned>(candidates.begin(), candidates.end()));
+}
+
 }  // namespace
@@ -0,0 +1,374 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/yaml/YamlBinaryIO.h"
+#include "polar/basic/adt/SmallString.h"
+#include "polar/utils/FileSystem.h"
+#include "polar/utils/MemoryBuffer.h"
+#include "gtest/gtest.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+using polar::yaml::BinaryInput;
+using polar::yaml::BinaryOutput;
+using polar::yaml::IO;
+
+namespace {
+
+enum Color
+{
+   Red,
+   Green,
+   Blue
+};
+
+enum Flags
+{
+   Read = 1,
+   Write = 2,
+   Exec = 4
+};
+
+struct Point
+{
+   int x;
+   int y;
+};
+
+struct Shape
+{
+   std::string name;
+   Color color;
+   Flags flags;
+   double scale;
+   uint64_t id;
+   std::vector<Point> points;
+   std::vector<int> ids;
+   std::map<std::string, int> attributes;
+   std::optional<int> depth;
+   bool circle;
+};
+
+using Shapes = std::vector<Shape>;
+
+/// Shape with its name only.
+struct SmallShape
+{
+   std::string name;
+};
+
+} // anonymous namespace
+
+POLAR_YAML_IS_SEQUENCE_VECTOR(Point)
+POLAR_YAML_IS_DOCUMENT_LIST_VECTOR(Shape)
+
+namespace polar {
+namespace yaml {
+
+template <>
+struct ScalarEnumerationTraits<Color>
+{
+   static void enumeration(IO &io, Color &value)
+   {
+      io.enumCase(value, "red", Red);
+      io.enumCase(value, "green", Green);
+      io.enumCase(value, "blue", Blue);
+   }
+};
+
+template <>
+struct ScalarBitSetTraits<Flags>
+{
+   static void bitset(IO &io, Flags &value)
+   {
+      io.bitSetCase(value, "read", Read);
+      io.bitSetCase(value, "write", Write);
+      io.bitSetCase(value, "exec", Exec);
+   }
+};
+
+template <>
+struct MappingTraits<Point>
+{
+   static void mapping(IO &io, Point &point)
+   {
+      io.mapRequired("x", point.x);
+      io.mapRequired("y", point.y);
+   }
+};
+
+template <>
+struct CustomMappingTraits<std::map<std::string, int>>
+{
+   static void inputOne(IO &io, StringRef key, std::map<std::string, int> &map)
+   {
+      io.mapRequired(key.getStr().c_str(), map[key.getStr()]);
+   }
+
+   static void output(IO &io, std::map<std::string, int> &map)
+   {
+      for (auto &entry : map) {
+         io.mapRequired(entry.first.c_str(), entry.second);
+      }
+   }
+};
+
+template <>
+struct MappingTraits<Shape>
+{
+   static void mapping(IO &io, Shape &shape)
+   {
+      shape.circle = io.mapTag("!circle", shape.circle);
+      io.mapRequired("name", shape.name);
+      io.mapRequired("color", shape.color);
+      io.mapRequired("flags", shape.flags);
+      io.mapOptional("scale", shape.scale, 1.0);
+      io.mapRequired("id", shape.id);
+      io.mapOptional("points", shape.points);
+      io.mapOptional("ids", shape.ids);
+      io.mapRequired("attributes", shape.attributes);
+      io.mapOptional("depth", shape.depth);
+   }
+};
+
+template <>
+struct MappingTraits<SmallShape>
+{
+   static void mapping(IO &io, SmallShape &shape)
+   {
+      io.mapRequired("name", shape.name);
+   }
+};
+
+} // yaml
+} // polar
+
+namespace {
+
+Shape make_shape(int index)
+{
+   Shape shape;
+   shape.name = "shape " + std::to_string(index) + " \"quoted\"\n";
+   shape.color = Color(index % 3);
+   shape.flags = Flags(index % 8);
+   shape.scale = index % 2 ? 1.0 : 0.5 * index;
+   shape.id = uint64_t(index) << 40;
+   for (int i = 0; i < index % 4; ++i) {
+      shape.points.push_back(Point{i, -i * index});
+      shape.ids.push_back(i * 1000);
+   }
+   shape.attributes["weight"] = index;
+   shape.attributes["height"] = -index;
+   if (index % 5 == 0) {
+      shape.depth = index;
+   }
+   shape.circle = index % 2 == 0;
+   return shape;
+}
+
+void expect_equal(const Shape &Expected, const Shape &Actual)
+{
+   EXPECT_EQ(Expected.name, Actual.name);
+   EXPECT_EQ(Expected.color, Actual.color);
+   EXPECT_EQ(Expected.flags, Actual.flags);
+   EXPECT_EQ(Expected.scale, Actual.scale);
+   EXPECT_EQ(Expected.id, Actual.id);
+   ASSERT_EQ(Expected.points.size(), Actual.points.size());
+   for (size_t I = 0; I != Expected.points.size(); ++I) {
+      EXPECT_EQ(Expected.points[I].x, Actual.points[I].x);
+      EXPECT_EQ(Expected.points[I].y, Actual.points[I].y);
+   }
+   EXPECT_EQ(Expected.ids, Actual.ids);
+   EXPECT_EQ(Expected.attributes, Actual.attributes);
+   EXPECT_EQ(Expected.depth, Actual.depth);
+   EXPECT_EQ(Expected.circle, Actual.circle);
+}
+
+std::string write_shapes(int Count)
+{
+   Shapes Documents;
+   for (int I = 0; I < Count; ++I) {
+      Documents.push_back(make_shape(I));
+   }
+   std::string Storage;
+   RawStringOutStream OS(Storage);
+   BinaryOutput Out(OS);
+   Out << Documents;
+   OS.flush();
+   return Storage;
+}
+
+TEST(YamlBinaryIOTest, testRoundTrip)
+{
+   std::string Storage = write_shapes(50);
+   EXPECT_TRUE(BinaryInput::isBinaryInput(Storage));
+   EXPECT_FALSE(BinaryInput::isBinaryInput("name: value\n"));
+
+   BinaryInput In(Storage);
+   Shapes Documents;
+   In >> Documents;
+   EXPECT_FALSE(In.getError()) << In.getErrorMessage().getStr();
+   ASSERT_EQ(50u, Documents.size());
+   for (int I = 0; I < 50; ++I) {
+      expect_equal(make_shape(I), Documents[I]);
+   }
+}
+
+TEST(YamlBinaryIOTest, testSingleDocument)
+{
+   Shape Expected = make_shape(7);
+   std::string Storage;
+   {
+      RawStringOutStream OS(Storage);
+      BinaryOutput Out(OS);
+      Out << Expected;
+   }
+   BinaryInput In(Storage);
+   Shape Actual = Shape();
+   In >> Actual;
+   EXPECT_FALSE(In.getError());
+   expect_equal(Expected, Actual);
+}
+
+TEST(YamlBinaryIOTest, testKeysAreInterned)
+{
+   // The keys and enumeration names are stored once, however many shapes
+   // use them.
+   std::string Storage = write_shapes(1000);
+   size_t Count = 0;
+   for (size_t Pos = Storage.find("attributes"); Pos != std::string::npos;
+        Pos = Storage.find("attributes", Pos + 1)) {
+      ++Count;
+   }
+   EXPECT_EQ(1u, Count);
+}
+
+TEST(YamlBinaryIOTest, testStrictKeys)
+{
+   Shape Expected = make_shape(3);
+   std::string Storage;
+   {
+      RawStringOutStream OS(Storage);
+      BinaryOutput Out(OS);
+      Out << Expected;
+   }
+   {
+      // Keys that are not read are errors, as with Input.
+      BinaryInput In(Storage);
+      SmallShape Actual;
+      In >> Actual;
+      EXPECT_TRUE(!!In.getError());
+      EXPECT_EQ("unknown key 'color'", In.getErrorMessage());
+      EXPECT_EQ(Expected.name, Actual.name);
+   }
+   {
+      Point Origin{0, 0};
+      std::string PointStorage;
+      RawStringOutStream OS(PointStorage);
+      BinaryOutput Out(OS);
+      Out << Origin;
+      OS.flush();
+      BinaryInput In(PointStorage);
+      Shape Actual;
+      In >> Actual;
+      EXPECT_TRUE(!!In.getError());
+      EXPECT_EQ("missing required key 'name'", In.getErrorMessage());
+   }
+}
+
+TEST(YamlBinaryIOTest, testMalformedInput)
+{
+   std::string Storage = write_shapes(20);
+   for (StringRef Input : {StringRef(), StringRef(Storage).dropBack(1),
+                           StringRef(Storage).dropFront(1), StringRef("PYB\x01")}) {
+      BinaryInput In(Input);
+      Shapes Documents;
+      In >> Documents;
+      EXPECT_TRUE(!!In.getError());
+      EXPECT_EQ("malformed binary YAML", In.getErrorMessage());
+   }
+   // Damage is reported, or read as other values, but never read past the
+   // input.
+   for (size_t I = 4; I < Storage.size() - 12; I += 7) {
+      std::string Damaged = Storage;
+      Damaged[I] ^= 0x5a;
+      BinaryInput In(Damaged);
+      Shapes Documents;
+      In >> Documents;
+   }
+}
+
+TEST(YamlBinaryIOTest, testDeeplyNestedInput)
+{
+   // Sequences nested one in the other, around an empty scalar, with an
+   // empty string table.
+   auto NestedInput = [](size_t Depth) {
+      std::string Storage("PYB\x01", 4);
+      for (size_t I = 0; I != Depth; ++I) {
+         Storage += '\x04';
+         Storage += '\x01';
+      }
+      Storage += '\x01';
+      Storage += '\x00';
+      uint64_t StringsOffset = Storage.size();
+      Storage += '\x00';
+      for (unsigned I = 0; I != 8; ++I) {
+         Storage += char(StringsOffset >> (8 * I));
+      }
+      Storage.append("PYB\x01", 4);
+      return Storage;
+   };
+   {
+      std::string Storage = NestedInput(100);
+      BinaryInput In(Storage);
+      ASSERT_TRUE(In.setCurrentDocument());
+      EXPECT_FALSE(In.nextDocument());
+      EXPECT_FALSE(In.getError());
+   }
+   {
+      // Skipping the document gives up on the input before the stack.
+      std::string Storage = NestedInput(1000000);
+      BinaryInput In(Storage);
+      ASSERT_TRUE(In.setCurrentDocument());
+      EXPECT_FALSE(In.nextDocument());
+      EXPECT_TRUE(!!In.getError());
+      EXPECT_EQ("malformed binary YAML", In.getErrorMessage());
+   }
+}
+
+TEST(YamlBinaryIOTest, testMappedFile)
+{
+   int FD;
+   SmallString<64> Path;
+   ASSERT_FALSE(fs::create_temporary_file("yaml-binary", "bin", FD, Path));
+   {
+      std::string Storage = write_shapes(2000);
+      RawFdOutStream OS(FD, true);
+      OS << Storage;
+   }
+   OptionalError<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+   ASSERT_TRUE(bool(Buffer));
+   BinaryInput In((*Buffer)->getMemBufferRef());
+   Shapes Documents;
+   In >> Documents;
+   EXPECT_FALSE(In.getError());
+   ASSERT_EQ(2000u, Documents.size());
+   expect_equal(make_shape(1999), Documents.back());
+   fs::remove(Path);
+}
+
+} // anonymous namespace
@@ -0,0 +1,154 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/yaml/YamlFlatDocument.h"
+#include "polar/utils/Casting.h"
+#include "polar/utils/SourceMgr.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+namespace {
+
+using FlatNode = yaml::FlatDocument::FlatNode;
+using NodeKind = yaml::FlatDocument::NodeKind;
+
+static void SuppressDiagnosticsOutput(const SMDiagnostic &, void *)
+{
+}
+
+class YamlFlatDocumentTest : public ::testing::Test
+{
+protected:
+   SourceMgr SM;
+   std::unique_ptr<yaml::Stream> Stream;
+   yaml::FlatDocument Document;
+   std::vector<std::string> Errors;
+
+   bool build(StringRef Input)
+   {
+      SM.setDiagHandler(SuppressDiagnosticsOutput);
+      Stream.reset(new yaml::Stream(Input, SM));
+      return Document.build(Stream->begin()->getRoot(), [&](yaml::Node *, const Twine &Message) {
+         Errors.push_back(Message.getStr());
+      });
+   }
+
+   StringRef lookup(const FlatNode &Mapping, StringRef Key)
+   {
+      const yaml::FlatDocument::Entry *Entry = Document.lookup(Mapping, Key);
+      if (!Entry) {
+         return "<missing>";
+      }
+      return Document.getValue(*Entry).getValue();
+   }
+};
+
+TEST_F(YamlFlatDocumentTest, testLayout)
+{
+   StringRef Input = "a: [1, 2, {b: c}]\n"
+                     "d: e\n"
+                     "f:\n";
+   ASSERT_TRUE(build(Input));
+   const FlatNode *Root = Document.getRoot();
+   ASSERT_NE(nullptr, Root);
+   EXPECT_EQ(NodeKind::Mapping, Root->getKind());
+   // The root, three values, three elements and one more value.
+   EXPECT_EQ(8u, Document.getNumNodes());
+   EXPECT_EQ(7u, Document.getNumEntries());
+
+   ArrayRef<yaml::FlatDocument::Entry> Entries = Document.getEntries(*Root);
+   ASSERT_EQ(3u, Entries.getSize());
+   EXPECT_EQ("a", Entries[0].m_key);
+   EXPECT_EQ("d", Entries[1].m_key);
+   EXPECT_EQ("f", Entries[2].m_key);
+   EXPECT_EQ(NodeKind::Empty, Document.getValue(Entries[2]).getKind());
+
+   const FlatNode &Sequence = Document.getValue(Entries[0]);
+   ASSERT_EQ(NodeKind::Sequence, Sequence.getKind());
+   ArrayRef<yaml::FlatDocument::Entry> Elements = Document.getEntries(Sequence);
+   ASSERT_EQ(3u, Elements.getSize());
+   EXPECT_EQ("", Elements[0].m_key);
+   EXPECT_EQ("2", Document.getValue(Elements[1]).getValue());
+   EXPECT_EQ("c", lookup(Document.getValue(Elements[2]), "b"));
+
+   // Plain scalars point into the input.
+   StringRef Value = Document.getValue(Entries[1]).getValue();
+   EXPECT_EQ("e", Value);
+   EXPECT_TRUE(Value.getData() >= Input.getData() &&
+               Value.getData() < Input.getData() + Input.size());
+   EXPECT_TRUE(isa<yaml::ScalarNode>(Document.getValue(Entries[1]).getNode()));
+}
+
+TEST_F(YamlFlatDocumentTest, testScalars)
+{
+   ASSERT_TRUE(build("plain: a b\n"
+                     "single: 'it''s'\n"
+                     "double: \"x\\ty\"\n"
+                     "'quoted key': 1\n"
+                     "block: |\n"
+                     "  line\n"));
+   const FlatNode &Root = *Document.getRoot();
+   EXPECT_EQ("a b", lookup(Root, "plain"));
+   EXPECT_EQ("it's", lookup(Root, "single"));
+   EXPECT_EQ("x\ty", lookup(Root, "double"));
+   EXPECT_EQ("1", lookup(Root, "quoted key"));
+   EXPECT_EQ("line\n", lookup(Root, "block"));
+   EXPECT_EQ("<missing>", lookup(Root, "other"));
+}
+
+TEST_F(YamlFlatDocumentTest, testLookup)
+{
+   // Large mappings are searched through their index, small ones not.
+   for (unsigned NumKeys : {3u, 50u}) {
+      std::string Input;
+      for (unsigned I = NumKeys; I != 0; --I) {
+         Input += "key" + std::to_string(I) + ": " + std::to_string(I) + "\n";
+      }
+      Input += "key2: again\n";
+      ASSERT_TRUE(build(Input));
+      const FlatNode &Root = *Document.getRoot();
+      EXPECT_EQ(NumKeys + 1, Root.getSize());
+      for (unsigned I = 1; I <= NumKeys; ++I) {
+         std::string Key = "key" + std::to_string(I);
+         EXPECT_EQ(I == 2 ? "again" : std::to_string(I), lookup(Root, Key));
+      }
+      EXPECT_EQ("<missing>", lookup(Root, "key0"));
+      EXPECT_EQ("<missing>", lookup(Root, "key"));
+      EXPECT_EQ("<missing>", lookup(Root, "zzz"));
+      // The last of repeated keys is found.
+      EXPECT_EQ(&Document.getEntries(Root).back(), Document.lookup(Root, "key2"));
+   }
+}
+
+TEST_F(YamlFlatDocumentTest, testErrors)
+{
+   EXPECT_FALSE(build("a: b\n[x]: c\nd: e\n"));
+   ASSERT_EQ(1u, Errors.size());
+   EXPECT_EQ("Map key must be a scalar", Errors[0]);
+   // The mapping is cut short at the error.
+   EXPECT_EQ(1u, Document.getRoot()->getSize());
+
+   Errors.clear();
+   EXPECT_FALSE(build("- *anchor\n"));
+   ASSERT_EQ(1u, Errors.size());
+   EXPECT_EQ("unknown node kind", Errors[0]);
+
+   Document.clear();
+   EXPECT_EQ(nullptr, Document.getRoot());
+}
+
+} // anonymous namespace
@@ -13,7 +13,9 @@
 #include "polar/basic/adt/Twine.h"
 #include "polar/utils/Casting.h"
 #include "polar/utils/Endian.h"
+#include "polar/utils/FileSystem.h"
 #include "polar/utils/Format.h"
+#include "polar/utils/MemoryBuffer.h"
 #include "polar/utils/yaml/YamlTraits.h"
 #include "gtest/gtest.h"
 
@@ -244,6 +246,87 @@ TEST(YamlIOTest, testSequenceMapWriteAndRead)
    }
 }
 
+//
+// test writing a sequence one element at a time
+//
+TEST(YamlIOTest, testSequenceWriter)
+{
+   FooBarSequence seq;
+   for (int i = 0; i < 100; ++i) {
+      seq.push_back(FooBar{i, -i});
+   }
+   std::string whole;
+   {
+      RawStringOutStream ostr(whole);
+      Output yout(ostr);
+      yout << seq;
+   }
+   std::string pushed;
+   {
+      RawStringOutStream ostr(pushed);
+      Output yout(ostr);
+      yaml::SequenceWriter writer(yout);
+      for (FooBar &entry : seq) {
+         writer.write(entry);
+      }
+      EXPECT_EQ(100u, writer.getNumElements());
+      writer.finish();
+   }
+   EXPECT_EQ(whole, pushed);
+
+   std::string empty;
+   {
+      RawStringOutStream ostr(empty);
+      Output yout(ostr);
+      yaml::SequenceWriter writer(yout);
+   }
+   std::string emptyWhole;
+   {
+      FooBarSequence none;
+      RawStringOutStream ostr(emptyWhole);
+      Output yout(ostr);
+      yout << none;
+   }
+   EXPECT_EQ(emptyWhole, empty);
+}
+
+//
+// test writing to a file in large blocks
+//
+TEST(YamlIOTest, testFdOutput)
+{
+   FooBarSequence seq;
+   for (int i = 0; i < 5000; ++i) {
+      seq.push_back(FooBar{i, i * 7});
+   }
+   std::string expected;
+   {
+      RawStringOutStream ostr(expected);
+      Output yout(ostr);
+      yout << seq;
+   }
+   int fd;
+   SmallString<64> path;
+   ASSERT_FALSE(fs::create_temporary_file("yaml-output", "yaml", fd, path));
+   {
+      RawFdOutStream ostr(fd, true);
+      size_t bufferSize = ostr.getBufferSize();
+      {
+         Output yout(ostr);
+         EXPECT_LE(size_t(Output::FdBufferSize), ostr.getBufferSize());
+         yaml::SequenceWriter writer(yout);
+         for (FooBar &entry : seq) {
+            writer.write(entry);
+         }
+      }
+      EXPECT_EQ(bufferSize, ostr.getBufferSize());
+   }
+   auto buffer = MemoryBuffer::getFile(path);
+   ASSERT_TRUE(bool(buffer));
+   EXPECT_EQ(expected, (*buffer)->getBuffer());
+   fs::remove(path);
+}
+
 //
 // test YAML filename handling.
 //
@@ -1501,6 +1584,69 @@ namespace polar {
 //
 // test the reading of a yaml mapping
 //
+struct StringRefBlock {
+   StringRef value;
+};
+
+struct StringRefDocument {
+   StringRef plain;
+   StringRef escaped;
+   StringRefBlock block;
+};
+
+namespace polar {
+namespace yaml {
+template <>
+struct BlockScalarTraits<StringRefBlock> {
+   static void output(const StringRefBlock &value, void *ctxt,
+                      RawOutStream &out) {
+      out << value.value;
+   }
+   static StringRef input(StringRef scalar, void *ctxt,
+                          StringRefBlock &value) {
+      value.value = scalar;
+      return StringRef();
+   }
+};
+
+template <>
+struct MappingTraits<StringRefDocument> {
+   static void mapping(IO &io, StringRefDocument &doc) {
+      io.mapRequired("plain", doc.plain);
+      io.mapRequired("escaped", doc.escaped);
+      io.mapRequired("block", doc.block);
+   }
+};
+}
+}
+
+POLAR_YAML_IS_DOCUMENT_LIST_VECTOR(StringRefDocument)
+
+//
+// test that scalars read from a document list stay valid after the documents
+// they were read from are gone
+//
+TEST(YamlIOTest, testDocListStringRefLifetime)
+{
+   std::vector<StringRefDocument> docList;
+   Input yin("---\nplain: one\nescaped: \"a\\tb\"\nblock: |\n  first\n  block\n"
+             "---\nplain: two\nescaped: \"c\\nd\"\nblock: |\n  second\n"
+             "---\nplain: three\nescaped: \"\\x41\"\nblock: |\n  third\n");
+   yin >> docList;
+
+   EXPECT_FALSE(yin.getError());
+   ASSERT_EQ(3u, docList.size());
+   EXPECT_EQ("one", docList[0].plain);
+   EXPECT_EQ("a\tb", docList[0].escaped);
+   EXPECT_EQ("first\nblock\n", docList[0].block.value);
+   EXPECT_EQ("two", docList[1].plain);
+   EXPECT_EQ("c\nd", docList[1].escaped);
+   EXPECT_EQ("second\n", docList[1].block.value);
+   EXPECT_EQ("three", docList[2].plain);
+   EXPECT_EQ("A", docList[2].escaped);
+   EXPECT_EQ("third\n", docList[2].block.value);
+}
+
 TEST(YamlIOTest, testDocRead)
 {
    FooBarMap doc;
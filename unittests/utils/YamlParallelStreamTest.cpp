@@ -0,0 +1,121 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2018 polarPHP software foundation
+// Copyright (c) 2017 - 2018 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://polarphp.org/LICENSE.txt for license information
+// See http://polarphp.org/CONTRIBUTORS.txt for the list of polarPHP project authors
+//
+// Created by softboy on 2026/10/18.
+
+#include "polar/utils/yaml/YamlParallelStream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace polar;
+using namespace polar::basic;
+using namespace polar::utils;
+
+namespace {
+
+using NodeKind = yaml::FlatDocument::NodeKind;
+
+static void CollectDiagnostics(const SMDiagnostic &Diag, void *Ctx)
+{
+   static_cast<std::vector<SMDiagnostic> *>(Ctx)->push_back(Diag);
+}
+
+// Describes every document of Input, as found by a ParallelStream or by a
+// Stream.
+static std::vector<std::string> Describe(StringRef Input, bool Parallel)
+{
+   std::vector<std::string> Documents;
+   auto Describe = [&](const yaml::FlatDocument &Document) {
+      const yaml::FlatDocument::FlatNode &Root = *Document.getRoot();
+      std::string Description;
+      if (Root.getKind() == NodeKind::Scalar) {
+         Description = Root.getValue();
+      } else {
+         for (const yaml::FlatDocument::Entry &Entry : Document.getEntries(Root)) {
+            Description += Entry.m_key.getStr() + "=" +
+                  Document.getValue(Entry).getValue().getStr() + ";";
+         }
+      }
+      Documents.push_back(Description);
+   };
+   SourceMgr SM;
+   if (Parallel) {
+      yaml::ParallelStream Stream(Input, SM);
+      EXPECT_TRUE(Stream.forEachDocument(Describe));
+      EXPECT_FALSE(Stream.failed());
+   } else {
+      yaml::Stream Stream(Input, SM);
+      yaml::FlatDocument Document;
+      for (yaml::Document &Doc : Stream) {
+         EXPECT_TRUE(Document.build(Doc.getRoot(), [](yaml::Node *, const Twine &) {}));
+         Describe(Document);
+      }
+   }
+   return Documents;
+}
+
+TEST(YamlParallelStreamTest, testDocumentsInOrder)
+{
+   std::string Input = "# leading comment\n";
+   for (unsigned I = 0; I != 5000; ++I) {
+      Input += "---\nid: " + std::to_string(I) + "\nlist: [a, b]\nname: \"doc\\t" +
+            std::to_string(I) + "\"\n";
+   }
+   std::vector<std::string> Documents = Describe(Input, true);
+   ASSERT_EQ(5000u, Documents.size());
+   EXPECT_EQ("id=0;list=;name=doc\t0;", Documents[0]);
+   EXPECT_EQ("id=4999;list=;name=doc\t4999;", Documents[4999]);
+   EXPECT_EQ(Describe(Input, false), Documents);
+}
+
+TEST(YamlParallelStreamTest, testMarkersWhichDoNotSplit)
+{
+   // A top-level plain scalar runs on over "---" lines, and quoted scalars
+   // hold them; either way the documents are those of Stream.
+   for (StringRef Input : {"a: b\n---\nplain\n--- c\n---\nd: e\n",
+                           "a: 'x\n---\ny'\n---\nb: c\n",
+                           "a: b\n...\n---\nc: d\n",
+                           "%YAML 1.2\n---\na: b\n---\nc: d\n",
+                           "---\n---\na: b\n"}) {
+      EXPECT_EQ(Describe(Input, false), Describe(Input, true)) << Input.getStr();
+   }
+}
+
+TEST(YamlParallelStreamTest, testDiagnosticLocations)
+{
+   std::string Input;
+   for (unsigned I = 0; I != 100; ++I) {
+      Input += "---\nkey: value\n";
+   }
+   // Line 201.
+   Input += "---\nkey: [unterminated\n";
+   SourceMgr SM;
+   std::vector<SMDiagnostic> Diagnostics;
+   SM.setDiagHandler(CollectDiagnostics, &Diagnostics);
+   yaml::ParallelStream Stream(Input, SM);
+   unsigned NumDocuments = 0;
+   EXPECT_FALSE(Stream.forEachDocument([&](const yaml::FlatDocument &Document) {
+      if (++NumDocuments == 50) {
+         const yaml::FlatDocument::FlatNode &Root = *Document.getRoot();
+         Stream.printError(Document.getValue(Document.getEntries(Root)[0]).getNode(), "bad value");
+      }
+   }));
+   EXPECT_TRUE(Stream.failed());
+   EXPECT_EQ(100u, NumDocuments);
+   ASSERT_EQ(2u, Diagnostics.size());
+   EXPECT_EQ("bad value", Diagnostics[0].getMessage());
+   EXPECT_EQ(100, Diagnostics[0].getLineNo());
+   EXPECT_EQ(5, Diagnostics[0].getColumnNo());
+   EXPECT_EQ("YAML", Diagnostics[1].getFilename());
+   EXPECT_LE(202, Diagnostics[1].getLineNo());
+}
+
+} // anonymous namespace
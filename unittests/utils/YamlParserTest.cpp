@@ -253,6 +253,53 @@ TEST(YamlParserTest, testParsesStrings)
    ExpectCanParseString("    \\\\  \\\"  \\\\\\\"   ");
 }
 
+TEST(YamlParserTest, testScansRunsAcrossBlocks)
+{
+   // Runs of plain bytes are scanned in blocks, so put the bytes that end them
+   // at every offset of a block.
+   for (size_t Length = 0; Length != 40; ++Length) {
+      std::string Run(Length, 'x');
+      for (StringRef Special : {"", "\xC3\xA9", "\t", "#"}) {
+         std::string Value = Run + Special.getStr() + "y";
+         std::string Indent(Length + 2, ' ');
+         std::string Input = "plain: " + Value + "\n" +
+               "folded: " + Value + "\n" + Indent + Value + "\n" +
+               "single: '" + Value + "''" + Value + "'\n" +
+               "double: \"" + Value + "\\\"" + Value + "\" # " + Value + "\n" +
+               "literal: |\n" + Indent + Value + "\n" +
+               "last: " + Value;
+         SourceMgr SM;
+         yaml::Stream Stream(Input, SM);
+         yaml::MappingNode *Map = dyn_cast<yaml::MappingNode>(Stream.begin()->getRoot());
+         ASSERT_NE(nullptr, Map) << Input;
+         std::vector<std::string> Values;
+         for (yaml::KeyValueNode &Pair : *Map) {
+            SmallString<32> Storage;
+            if (auto *Scalar = dyn_cast<yaml::ScalarNode>(Pair.getValue())) {
+               Values.push_back(Scalar->getValue(Storage).getStr());
+            } else if (auto *Block = dyn_cast<yaml::BlockScalarNode>(Pair.getValue())) {
+               Values.push_back(Block->getValue().getStr());
+            } else {
+               Values.push_back("<none>");
+            }
+         }
+         EXPECT_FALSE(Stream.failed()) << Input;
+         // A leading tab or '#' does not belong to a plain scalar.
+         if (Length == 0 && (Special == "#" || Special == "\t")) {
+            continue;
+         }
+         ASSERT_EQ(6u, Values.size()) << Input;
+         EXPECT_EQ(Value, Values[0]);
+         // Plain scalars are not folded.
+         EXPECT_EQ(Value + "\n" + Indent + Value, Values[1]);
+         EXPECT_EQ(Value + "'" + Value, Values[2]);
+         EXPECT_EQ(Value + "\"" + Value, Values[3]);
+         EXPECT_EQ(Value + "\n", Values[4]);
+         EXPECT_EQ(Value, Values[5]);
+      }
+   }
+}
+
 TEST(YamlParserTest, testWorksWithIteratorAlgorithms)
 {
    SourceMgr SM;